@@ -1,7 +1,7 @@
 #pragma vertex
 
 #pragma using SceneData // Get the scene data (viewMatrix, projectionMatrix)
-#pragma using ModelData // Get the model data (modelMatrix)
+#pragma using ModelDataInstanced // Get the model data (modelMatrix), allows instancing
 
 layout(location = POSITION) in vec3 aPos;
 layout(location = NORMAL) in vec3 aNormal;
@@ -27,6 +27,7 @@ in vec3 normal;
 in vec3 worldPos;
 out vec4 FragColor; 
 
+#pragma material
 [Slider(0, 1)]uniform vec3  albedo;
 [Slider(0, 1)]uniform float metallic;
 [Slider(0, 1)]uniform float roughness;
@@ -5,6 +5,7 @@
 layout(location = POSITION) in vec3 aPos;
 layout(location = TEXCOORDS) in vec2 aUV;
 
+#pragma material
 uniform vec3 CameraRightWS;
 uniform vec3 CameraUpWS;
 
@@ -23,6 +23,7 @@ out vec4 FragColor;
 in vec2 WorldPos;
 in vec2 PlayerPos;
 
+#pragma material
 uniform float falloffDistance;
 uniform int gridSize;
 
@@ -30,6 +30,9 @@ int WinMain()
 	// Temp to save some time while testing
 	ProjectManager::Load("../../../RexEditor/Projects/TestProject/TestProject.rexengine");
 
+	// The main thread builds the next frame while the render thread submits the previous one
+	RenderApi::StartRenderThread();
+
 	Timer editorFrameTime;
 	editorFrameTime.Start();
 	while (!win.ShouldClose())
@@ -48,6 +51,8 @@ int WinMain()
 
 		win.SwapBuffers();
 	}
+
+	RenderApi::StopRenderThread();
 	
 	EngineEvents::OnEngineStop().Dispatch();
 	EditorEvents::OnEditorStop().Dispatch();
@@ -33,23 +33,23 @@ namespace RexEditor::AssetIcons
 
 		auto texture = std::make_shared<Texture>(RenderApi::PixelFormat::RGBA, PreviewSize);
 
-		static NoDestroy<FrameBuffer> frameBuffer;
-		static NoDestroy<RenderBuffer> depth(RenderApi::PixelType::Depth, PreviewSize);
+		auto oldViewportSize = RenderApi::GetViewportSize();
+		RenderApi::SetViewportSize(PreviewSize); // The projection is made from the viewport size
 
-		frameBuffer->BindTexture(*texture, RenderApi::FrameBufferTextureType::Color);
-		frameBuffer->BindRenderBuffer(depth, RenderApi::FrameBufferTextureType::Depth);
+		RenderQueues::ClearQueues();
+		static const auto previewView = ForwardRenderer::MakeViewID();
+		ForwardRenderer::RenderScene(scene, cam, previewView);
 
-		frameBuffer->Bind();
-		RenderApi::SetViewportSize(PreviewSize);
+		FrameGraph graph;
+		auto color = graph.ImportTexture("Preview", *texture);
+		auto depth = graph.CreateTarget("Depth", { PreviewSize, RenderApi::PixelFormat::Depth });
+		ForwardRenderer::AddPasses(graph, color, depth);
+		graph.Execute();
+		RenderQueues::ClearQueues();
 
-		RenderApi::ClearColorBit();
-		RenderApi::ClearDepthBit();
-
-		ForwardRenderer::RenderScene(scene, cam);
+		RenderApi::SetViewportSize(oldViewportSize);
 
 		s_previews[key] = texture;
-		FrameBuffer::UnBind();
-
 		return *texture;
 	}
 
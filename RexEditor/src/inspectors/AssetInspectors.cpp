@@ -242,6 +242,27 @@ namespace RexEditor::AssetInspectors
 			UI::ReadOnly<UI::IntInput> triangles("Triangle Count", (int)mesh->GetIndexCount() / 3);
 			UI::ReadOnly<UI::CheckBox> normals("Has normals", mesh->HasNormals());
 			UI::ReadOnly<UI::CheckBox> uvs("Has UVs", mesh->HasUVs());
+
+			// Quantized formats
+			const auto format = mesh->GetVertexFormatReport();
+			UI::Text vertexFormat(std::format("Vertex : {}B (unquantized {}B), index : {}B (unquantized {}B)", format.vertexSize, format.sourceVertexSize, format.indexSize, format.sourceIndexSize));
+			size_t indexCount = 0; // Of every lod
+			for (size_t i = 0; i < mesh->GetLodCount(); i++)
+				indexCount += mesh->GetLod(i).indexCount;
+
+			UI::Text gpuSize(std::format("Gpu data : {:.1f}KB (unquantized {:.1f}KB)",
+				(mesh->GetVertexCount() * format.vertexSize + indexCount * format.indexSize) / 1024.0,
+				(mesh->GetVertexCount() * format.sourceVertexSize + indexCount * format.sourceIndexSize) / 1024.0));
+
+			// Cpu copy
+			constexpr const char* policies[] = { "kept", "released", "positions only" };
+			UI::Text cpuSize(std::format("Cpu data : {:.1f}KB ({})", mesh->GetCPUMemory() / 1024.0, policies[(int)mesh->GetUploadPolicy()]));
+
+			for (size_t i = 1; i < mesh->GetLodCount(); i++)
+			{
+				auto& lod = mesh->GetLod(i);
+				UI::Text text(std::format("Lod {} : {} triangles, under {:.0f}% of the screen (error {:.4f})", i, lod.indexCount / 3, lod.screenSize * 100.0f, lod.error));
+			}
 		});
 
 		// Scene
@@ -10,6 +10,18 @@ namespace RexEditor::ComponentInspectors
 		UI::AssetInput<Mesh>       mesh("Mesh    ", meshRenderer.mesh);
 	}
 
+	void InspectOccluder(RexEngine::Entity entity)
+	{
+		auto& occluder = entity.GetComponent<OccluderComponent>();
+		UI::AssetInput<Mesh> mesh("Mesh", occluder.mesh);
+	}
+
+	void InspectStatic(RexEngine::Entity entity)
+	{
+		auto& staticComponent = entity.GetComponent<StaticComponent>();
+		UI::CheckBox castShadows("Cast Shadows", staticComponent.castShadows);
+	}
+
 	void InspectCamera(RexEngine::Entity entity)
 	{
 		auto& camera = entity.GetComponent<CameraComponent>();
@@ -77,6 +89,8 @@ namespace RexEditor::ComponentInspectors
 
 	RE_STATIC_CONSTRUCTOR({
 		InspectorPanel::ComponentInspectors().Add<MeshRendererComponent>(InspectMeshRenderer);
+		InspectorPanel::ComponentInspectors().Add<OccluderComponent>(InspectOccluder);
+		InspectorPanel::ComponentInspectors().Add<StaticComponent>(InspectStatic);
 		InspectorPanel::ComponentInspectors().Add<CameraComponent>(InspectCamera);
 		InspectorPanel::ComponentInspectors().Add<SkyboxComponent>(InspectSkybox);
 		InspectorPanel::ComponentInspectors().Add<PointLightComponent>(InspectPointLight);
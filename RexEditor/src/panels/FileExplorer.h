@@ -79,7 +79,8 @@ namespace RexEditor
 					else // File
 					{
 						auto extension = entry.path().extension().string();
-						if (extension != AssetFileExtension) // Dont show .asset metadata files
+						// Dont show .asset metadata files and cooked data
+						if (extension != AssetFileExtension && std::ranges::find(GeneratedFileExtensions, extension) == GeneratedFileExtensions.end())
 						{
 							// Get the asset type
 							auto type = RexEngine::AssetTypes::GetAssetTypeFromExtension(extension);
@@ -13,11 +13,8 @@ namespace RexEditor
 	public:
 		GameViewPanel() : Panel("Game View"),
 			m_viewTexture(RexEngine::RenderApi::PixelFormat::RGB, { 0,0 }),
-			m_viewDepth(RexEngine::RenderApi::PixelType::Depth, { 0,0 }),
 			m_stats(false), m_lastStatUpdate(0.0f), m_lastDeltaTime(0.0f), m_lastRenderTime(0.0f)
 		{
-			m_viewBuffer.BindTexture(m_viewTexture, RexEngine::RenderApi::FrameBufferTextureType::Color);
-			m_viewBuffer.BindRenderBuffer(m_viewDepth, RexEngine::RenderApi::FrameBufferTextureType::Depth);
 
 			m_escape = std::make_unique<RexEngine::KeyboardInput>(RexEngine::KeyCode::Escape);
 			m_capture = std::make_unique<RexEngine::MouseButtonInput>(RexEngine::MouseButton::Left);
@@ -27,7 +24,6 @@ namespace RexEditor
 		virtual void OnResize([[maybe_unused]] RexEngine::Vector2 oldSize, RexEngine::Vector2 newSize) override
 		{
 			m_viewTexture.SetData((RexEngine::Vector2Int)newSize, nullptr, RexEngine::RenderApi::PixelFormat::RGB, RexEngine::RenderApi::PixelType::UByte);
-			m_viewDepth.SetSize((RexEngine::Vector2Int)newSize);
 		}
 
 
@@ -59,21 +55,20 @@ namespace RexEditor
 				return;
 			}
 
-			m_viewBuffer.Bind();
-
 			auto oldViewportSize = RexEngine::RenderApi::GetViewportSize(); // Cache the size to revert at the end
-			RexEngine::RenderApi::SetViewportSize((Vector2Int)PanelSize());
-
-			RexEngine::RenderApi::ClearColorBit();
-			RexEngine::RenderApi::ClearDepthBit();
+			RexEngine::RenderApi::SetViewportSize((Vector2Int)PanelSize()); // The projection is made from the viewport size
 
 			// Render the scene from the pov of the editor camera
 			Timer renderTimer;
 			renderTimer.Start();
-			RexEngine::ForwardRenderer::RenderScene(Scene::CurrentScene(), cameras[0].second);
-
-			// Actually run the render calls
-			RenderQueues::ExecuteQueues();
+			RexEngine::ForwardRenderer::RenderScene(Scene::CurrentScene(), cameras[0].second, m_viewID);
+
+			// Actually run the render calls, the depth is a transient target of the graph
+			FrameGraph graph;
+			auto color = graph.ImportTexture("View", m_viewTexture);
+			auto depth = graph.CreateTarget("Depth", { (Vector2Int)PanelSize(), RenderApi::PixelFormat::Depth });
+			ForwardRenderer::AddPasses(graph, color, depth);
+			graph.Execute();
 			RenderQueues::ClearQueues();
 
 			renderTimer.Pause();
@@ -83,7 +78,6 @@ namespace RexEditor
 			Window()->DrawFullWindowTexture(m_viewTexture);
 
 			// Revert back to the cached states
-			m_viewBuffer.UnBind();
 			RexEngine::RenderApi::SetViewportSize(oldViewportSize);
 
 
@@ -91,6 +85,12 @@ namespace RexEditor
 			if (UI::ContextMenu context("GameViewContext"); context.IsOpen())
 			{
 				UI::CheckBox statsToggle("Show Stats", m_stats);
+				UI::CheckBox occlusionToggle("Occlusion Culling", ForwardRenderer::EnableOcclusionCulling);
+				UI::CheckBox lodToggle("Mesh Lods", ForwardRenderer::EnableLods);
+				UI::CheckBox prepassToggle("Depth Pre-pass", ForwardRenderer::EnableDepthPrepass);
+				UI::CheckBox shadowsToggle("Shadows", ShadowMaps::Enabled);
+				UI::CheckBox recordOnlyToggle("Record Only", RenderApi::RecordOnly);
+				UI::CheckBox multiDrawToggle("Multi Draw", OpaqueRenderCommand::EnableMultiDraw);
 			}
 
 			// Stats
@@ -103,11 +103,40 @@ namespace RexEditor
 						m_lastStatUpdate = Time::CurrentTime();
 						m_lastDeltaTime = Time::DeltaTime();
 						m_lastRenderTime = renderTimer.ElapsedSeconds();
+						m_lastFrameStats = RenderFrame::GetLastFrameStats();
+						m_lastRenderStats = ForwardRenderer::GetLastStats();
+						m_lastStateStats = RenderApi::GetLastStateStats();
+						m_lastTextureStats = TextureManager::GetLastStats();
+						m_lastGraphStats = FrameGraph::GetLastStats();
+						m_lastPassTimes = FrameGraph::GetLastPassTimes();
+						m_lastShadowStats = ShadowMaps::GetLastStats();
+						m_lastGeometryStats = GeometryPool::GetStats();
+						m_lastMeshMemory = Mesh::GetMemoryStats();
 					}
 
 					UI::Text(std::format("Fps         : {:.0f}", 1.0f / m_lastDeltaTime));
 					UI::Text(std::format("Frame Time  : {:.1f}ms", m_lastDeltaTime * 1000.0f));
 					UI::Text(std::format("Render Time : {:.1f}ms", m_lastRenderTime * 1000.0));
+					UI::Text(std::format("Render Alloc: {:.1f}KB (heap : {}B)", m_lastFrameStats.bytesUsed / 1024.0, m_lastFrameStats.heapBytesAllocated));
+					UI::Text(std::format("Draw Calls  : {} ({} objects, {} triangles)", m_lastFrameStats.drawCalls, m_lastFrameStats.instances, m_lastFrameStats.triangles));
+					UI::Text(std::format("GL State    : {} changes, {} redundant skipped", m_lastStateStats.issued, m_lastStateStats.filtered));
+					UI::Text(std::format("Textures    : {} rebinds / {} requests", m_lastTextureStats.rebinds, m_lastTextureStats.requests));
+					UI::Text(std::format("Frame Graph : {} passes ({} culled), {} targets ({} pooled)", m_lastGraphStats.passes, m_lastGraphStats.culledPasses, m_lastGraphStats.transientTargets, m_lastGraphStats.pooledTargets));
+					UI::Text(std::format("Commands    : {} ({:.1f}KB), record {:.2f}ms, submit {:.2f}ms, {} flushes", m_lastGraphStats.recordedCommands, m_lastGraphStats.recordedBytes / 1024.0,
+						m_lastGraphStats.recordMilliseconds, m_lastGraphStats.submitMilliseconds, m_lastStateStats.flushes));
+
+					// GPU time of each pass, summed over the views
+					for (auto& [name, milliseconds] : m_lastPassTimes)
+						UI::Text(std::format("  {:<12}: {:.2f}ms", name, milliseconds));
+					UI::Text(std::format("Culling     : {} visible, {} frustum culled, {} occluded", m_lastRenderStats.visible, m_lastRenderStats.frustumCulled, m_lastRenderStats.occlusionCulled));
+					UI::Text(std::format("Lights      : {} cluster entries, {}B uploaded", m_lastRenderStats.clusterLightIndices, m_lastRenderStats.lightBytesUploaded));
+					UI::Text(std::format("Shadows     : {} cascades ({} refits), {} cached layers, {} static / {} dynamic casters", m_lastShadowStats.cascadesRendered, m_lastShadowStats.refits,
+						m_lastShadowStats.staticLayersRendered, m_lastShadowStats.staticCasters, m_lastShadowStats.dynamicCasters));
+					UI::Text(std::format("Geometry    : {} meshes, {:.1f}/{:.1f}MB vertices, {:.1f}/{:.1f}MB indices, {} free ranges ({:.0f}% fragmented), {} compactions",
+						m_lastGeometryStats.allocations, m_lastGeometryStats.vertexBytesUsed / 1048576.0, m_lastGeometryStats.vertexBytes / 1048576.0,
+						m_lastGeometryStats.indexBytesUsed / 1048576.0, m_lastGeometryStats.indexBytes / 1048576.0, m_lastGeometryStats.freeRanges,
+						m_lastGeometryStats.fragmentation * 100.0f, m_lastGeometryStats.compactions));
+					UI::Text(std::format("Mesh Memory : {} meshes, {:.1f}MB cpu, {:.1f}MB gpu", m_lastMeshMemory.meshes, m_lastMeshMemory.cpuBytes / 1048576.0, m_lastMeshMemory.gpuBytes / 1048576.0));
 				}
 			}
 
@@ -115,9 +144,8 @@ namespace RexEditor
 
 	private:
 
-		RexEngine::FrameBuffer m_viewBuffer;
 		RexEngine::Texture m_viewTexture;
-		RexEngine::RenderBuffer m_viewDepth;
+		const RexEngine::ForwardRenderer::ViewID m_viewID = RexEngine::ForwardRenderer::MakeViewID();
 
 		std::unique_ptr<RexEngine::Input> m_escape;
 		std::unique_ptr<RexEngine::Input> m_capture;
@@ -126,6 +154,15 @@ namespace RexEditor
 		double m_lastStatUpdate;
 		float m_lastDeltaTime;
 		double m_lastRenderTime;
+		RexEngine::RenderFrame::Stats m_lastFrameStats;
+		RexEngine::ForwardRenderer::Stats m_lastRenderStats;
+		RexEngine::RenderApi::StateStats m_lastStateStats;
+		RexEngine::TextureManager::Stats m_lastTextureStats;
+		RexEngine::FrameGraph::Stats m_lastGraphStats;
+		std::vector<RexEngine::FrameGraph::PassTime> m_lastPassTimes;
+		RexEngine::ShadowMaps::Stats m_lastShadowStats;
+		RexEngine::GeometryPool::Stats m_lastGeometryStats;
+		RexEngine::Mesh::MemoryStats m_lastMeshMemory;
 
 		static constexpr double StatUpdateDelta = 0.15f;
 	};
@@ -187,6 +187,7 @@ namespace RexEditor
 
 				// Default components
 				m.AddMenuItem("Rendering/Mesh Renderer", [](RexEngine::Entity e) { TryAddComponent<MeshRendererComponent>(e); });
+				m.AddMenuItem("Rendering/Occluder", [](RexEngine::Entity e) { TryAddComponent<OccluderComponent>(e); });
 				m.AddMenuItem("Rendering/Camera", [](RexEngine::Entity e) { TryAddComponent<CameraComponent>(e); });
 				m.AddMenuItem("Environment/Skybox", [](RexEngine::Entity e) { TryAddComponent<SkyboxComponent>(e); });
 				m.AddMenuItem("Lighting/Point Light", [](RexEngine::Entity e) { TryAddComponent<PointLightComponent>(e); });
@@ -15,12 +15,9 @@ namespace RexEditor
 	public:
 		SceneViewPanel() : Panel("Scene View"),
 			m_viewTexture(RexEngine::RenderApi::PixelFormat::RGB, {0,0}),
-			m_viewDepth(RexEngine::RenderApi::PixelType::Depth, { 0,0 }),
 			m_roll(0.0f), m_pitch(0.0f), m_captured(false)
 		{
 			using namespace RexEngine;
-			m_viewBuffer.BindTexture(m_viewTexture, RexEngine::RenderApi::FrameBufferTextureType::Color);
-			m_viewBuffer.BindRenderBuffer(m_viewDepth, RexEngine::RenderApi::FrameBufferTextureType::Depth);
 
 			m_cameraTransform.position.y = 2.0f; // Dont start in the grid
 
@@ -40,7 +37,6 @@ namespace RexEditor
 		virtual void OnResize([[maybe_unused]] RexEngine::Vector2 oldSize, RexEngine::Vector2 newSize) override
 		{
 			m_viewTexture.SetData((RexEngine::Vector2Int)newSize, nullptr, RexEngine::RenderApi::PixelFormat::RGB, RexEngine::RenderApi::PixelType::UByte);
-			m_viewDepth.SetSize((RexEngine::Vector2Int)newSize);
 		}
 
 		virtual void OnGui([[maybe_unused]]float deltaTime) override
@@ -108,18 +104,13 @@ namespace RexEditor
 			gridComponent.material = m_gridMaterial;
 			grid.AddComponent<MeshRendererComponent>(gridComponent);
 
-			m_viewBuffer.Bind();
-
 			auto oldViewportSize = RexEngine::RenderApi::GetViewportSize(); // Cache the size to revert at the end
-			RexEngine::RenderApi::SetViewportSize((Vector2Int)PanelSize());
-			
-			RexEngine::RenderApi::ClearColorBit();
-			RexEngine::RenderApi::ClearDepthBit();
+			RexEngine::RenderApi::SetViewportSize((Vector2Int)PanelSize()); // The projection is made from the viewport size
 			
 			RenderQueues::ClearQueues();
 
 			// Render the scene from the pov of the editor camera
-			RexEngine::ForwardRenderer::RenderScene(Scene::CurrentScene(), cameraComponent);
+			RexEngine::ForwardRenderer::RenderScene(Scene::CurrentScene(), cameraComponent, m_viewID);
 
 			// Remove the editor camera (so it does not have a gizmo)
 			Scene::CurrentScene()->DestroyEntity(camera);
@@ -128,29 +119,31 @@ namespace RexEditor
 			// Render the gizmos
 			Gizmos::DrawGizmos(m_cameraTransform);
 
-			// Actually run the render calls
-			RenderQueues::ExecuteQueues();
+			// Actually run the render calls, the depth is a transient target of the graph
+			FrameGraph graph;
+			auto color = graph.ImportTexture("View", m_viewTexture);
+			auto depth = graph.CreateTarget("Depth", { (Vector2Int)PanelSize(), RenderApi::PixelFormat::Depth });
+			ForwardRenderer::AddPasses(graph, color, depth);
+			graph.Execute();
 			RenderQueues::ClearQueues();
 
 			// Display the texture to the ui
 			Window()->DrawFullWindowTexture(m_viewTexture);
 			
 			// Revert back to the cached states
-			m_viewBuffer.UnBind();
 			RexEngine::RenderApi::SetViewportSize(oldViewportSize);
 		}
 
 	private:
-		RexEngine::CameraComponent m_editorCamera;
+		RexEngine::CameraComponent m_editorCamera; // The camera entity is made again every frame, the view id stays
+		const RexEngine::ForwardRenderer::ViewID m_viewID = RexEngine::ForwardRenderer::MakeViewID();
 		RexEngine::TransformComponent m_cameraTransform;
 		float m_roll, m_pitch;
 		const float m_moveSpeed = 2.0f;
 		const float m_rotationSpeed = 40000.0f;
 		bool m_captured;
 
-		RexEngine::FrameBuffer m_viewBuffer;
 		RexEngine::Texture m_viewTexture;
-		RexEngine::RenderBuffer m_viewDepth;
 
 		std::shared_ptr<RexEngine::Material> m_gridMaterial;
 
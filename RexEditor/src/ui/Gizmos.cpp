@@ -16,8 +16,8 @@ namespace RexEditor
 		// size * 0.5 because the Quad is 2x2x2
 		RenderQueues::GetQueue<TransparentRenderCommand>("Gizmos")
 			.AddCommand<TransparentRenderCommand>(
-				s_billboardMaterial, 
-				Shapes::GetQuadMesh(), 
+				s_billboardMaterial.get(), 
+				Shapes::GetQuadMesh().get(), 
 				Matrix4::MakeTransform(position, Quaternion::Identity(), size * 0.5f),
 				s_cameraPos
 			);
@@ -1,6 +1,8 @@
 #include "REDPch.h"
 #include "UI.h"
 
+#include <atomic>
+
 #include <imgui/imgui.h>
 #include <imgui/imgui_internal.h>
 #include <imgui/backends/imgui_impl_glfw.h>
@@ -11,6 +13,9 @@
 #include "core/EditorEvents.h"
 #include "GuiThemes.h"
 
+// The current imgui context of each thread, see imconfig.h
+thread_local ImGuiContext* RexImGuiContext = nullptr;
+
 namespace RexEditor::UI::Internal
 {
 	// Manually add a bool in the .ini file to restore the open/closed state of each panel
@@ -55,6 +60,50 @@ namespace RexEditor::UI::Internal
 		}
 	}
 
+	// The render thread draws the ui through this context, so it never reads the main context while imgui builds the next frame in it.
+	// Its only state is the renderer data of the backend, which is only changed on the render thread (device objects, fonts texture)
+	ImGuiContext* RenderContext = nullptr;
+
+	// Runs on the render thread with the main context, this thread waits so the context is never used by both threads
+	void RunWithMainContext(void(*function)())
+	{
+		ImGuiContext* context = ImGui::GetCurrentContext();
+		RenderApi::RunOnRenderThread([context, function] {
+			ImGuiContext* previous = ImGui::GetCurrentContext();
+			ImGui::SetCurrentContext(context);
+			function();
+			ImGui::SetCurrentContext(previous);
+		});
+	}
+
+	// Copy of the draw data of a frame, the render thread draws it while imgui builds the next frame in the original
+	struct DrawDataCopy
+	{
+		ImDrawData data;
+		std::vector<ImDrawList*> lists;
+		std::atomic<bool> drawn = false;
+
+		~DrawDataCopy()
+		{
+			for (auto list : lists)
+				IM_DELETE(list);
+		}
+	};
+
+	// Deleted by the main thread once drawn, the imgui allocator is not thread safe
+	std::vector<std::unique_ptr<DrawDataCopy>> DrawDataCopies;
+
+	DrawDataCopy* CopyDrawData(const ImDrawData& source)
+	{
+		auto& copy = DrawDataCopies.emplace_back(std::make_unique<DrawDataCopy>());
+		copy->data = source;
+		for (int i = 0; i < source.CmdListsCount; i++)
+			copy->lists.push_back(source.CmdLists[i]->CloneOutput());
+		copy->data.CmdLists = copy->lists.data();
+
+		return copy.get();
+	}
+
 	// 0 = small, 1 = normal, 2 = large
 	typedef std::array<ImFont*, 3> FontCollection;
 
@@ -100,10 +149,24 @@ namespace RexEditor::UI::Internal
 
 		// Set the default to normal
 		io.FontDefault = Fonts[1.0f][(int)FontScale::Normal];
+
+		// Made now instead of in the first ImGui_ImplOpenGL3_NewFrame(), which then never uses the context
+		RunWithMainContext([] { ImGui_ImplOpenGL3_CreateDeviceObjects(); });
+
+		// Shares the renderer data of the backend, the fonts atlas is never used through it
+		RenderContext = ImGui::CreateContext(io.Fonts);
+		RenderContext->IO.IniFilename = nullptr;
+		RenderContext->IO.BackendRendererUserData = io.BackendRendererUserData;
 	};
 
 	void ImGuiClose()
 	{
+		DrawDataCopies.clear();
+
+		RenderContext->IO.BackendRendererUserData = nullptr;
+		ImGui::DestroyContext(RenderContext);
+		RenderContext = nullptr;
+
 		ImGui_ImplOpenGL3_Shutdown();
 		ImGui_ImplGlfw_Shutdown();
 		ImGui::DestroyContext();
@@ -124,7 +187,7 @@ namespace RexEditor::UI::Internal
 
 		if (Internal::FontsNeeded.size() > 0)
 		{
-			ImGui_ImplOpenGL3_CreateFontsTexture();
+			RunWithMainContext([] { ImGui_ImplOpenGL3_CreateFontsTexture(); });
 			Internal::FontsNeeded.clear();
 		}
 
@@ -193,13 +256,33 @@ namespace RexEditor::UI
 	{
 		RenderApi::BindFrameBuffer(RenderApi::InvalidFrameBufferID);
 		ImGui::Render();
-		ImGui_ImplOpenGL3_RenderDrawData(::ImGui::GetDrawData());
+
+		// The draw lists are reused by the next frame, the render thread draws a copy without blocking this one
+		std::erase_if(Internal::DrawDataCopies, [](const auto& copy) { return copy->drawn.load(); });
+		auto* copy = Internal::CopyDrawData(*::ImGui::GetDrawData());
+		RenderApi::PostToRenderThread([copy] {
+			ImGuiContext* previous = ImGui::GetCurrentContext();
+			ImGui::SetCurrentContext(Internal::RenderContext);
+			ImGui_ImplOpenGL3_RenderDrawData(&copy->data);
+			ImGui::SetCurrentContext(previous);
+			copy->drawn = true;
+		});
 
 		ImGui::UpdatePlatformWindows();
-		ImGui::RenderPlatformWindowsDefault();
 
 		// The context might get changed by imgui, revert back to the window
 		if (RexEngine::Window::ActiveWindow() != nullptr)
 			RexEngine::Window::ActiveWindow()->MakeActive();
+
+		// The windows out of the main one are drawn while this thread waits, their draw data is not copied
+		if (ImGui::GetPlatformIO().Viewports.Size > 1)
+		{
+			Internal::RunWithMainContext([] {
+				ImGui::RenderPlatformWindowsDefault();
+
+				if (RexEngine::Window::ActiveWindow() != nullptr)
+					RexEngine::Window::ActiveWindow()->MakeActive();
+			});
+		}
 	}
 }
\ No newline at end of file
@@ -16,6 +16,8 @@
 #include "src/math/Vectors.h"
 #include "src/math/Quaternion.h"
 #include "src/math/Matrix.h"
+#include "src/math/Bounds.h"
+#include "src/math/Frustum.h"
 
 // Scene
 #include "src/scene/Scene.h"
@@ -26,9 +28,13 @@
 // Rendering
 #include "src/rendering/Shader.h"
 #include "src/rendering/Mesh.h"
+#include "src/rendering/GeometryPool.h"
 #include "src/rendering/RenderQueue.h"
 #include "src/rendering/RenderCommands.h"
+#include "src/rendering/RenderFrame.h"
 #include "src/rendering/ForwardRenderer.h"
+#include "src/rendering/FrameGraph.h"
+#include "src/rendering/ShadowMaps.h"
 #include "src/rendering/Shapes.h"
 #include "src/rendering/PBR.h"
 #include "src/rendering/MSAATexture.h"
@@ -55,6 +55,9 @@ namespace RexEngine
 			}
 			else
 			{ // File
+				if (std::ranges::find(GeneratedFileExtensions, entry.path().extension().string()) != GeneratedFileExtensions.end())
+					continue;
+
 				if (entry.path().has_extension() && entry.path().extension() != AssetFileExtension)
 				{
 					auto metaPath = entry.path();
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <unordered_map>
+#include <vector>
 #include <any>
 #include <fstream>
 #include <filesystem>
@@ -77,6 +78,9 @@ namespace RexEngine
 		const T* operator->() const  { return m_asset->get(); }
 		T* operator->()  { return m_asset->get(); }
 
+		// Raw pointer to the underlying asset, nullptr if empty, does not change the refcount
+		T* Get() const { return m_asset ? m_asset->get() : nullptr; }
+
 		// Check if an asset is empty
 		operator bool() const { return m_asset != nullptr; }
 
@@ -89,6 +93,8 @@ namespace RexEngine
 
 
 	inline const std::string AssetFileExtension = ".asset";
+	// Files made by the engine next to the assets, they are not assets (Mesh::CookedExtension)
+	inline const std::vector<std::string> GeneratedFileExtensions = { ".rexmesh" };
 
 
 	// Check for this : 
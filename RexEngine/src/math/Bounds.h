@@ -0,0 +1,163 @@
+#pragma once
+
+#include <span>
+#include <cmath>
+#include <algorithm>
+
+#include "Vectors.h"
+#include "Matrix.h"
+#include "../core/Serialization.h"
+
+namespace RexEngine
+{
+	// Axis aligned bounding box
+	struct BoundingBox
+	{
+		Vector3 min = Vector3(0, 0, 0);
+		Vector3 max = Vector3(0, 0, 0);
+
+		Vector3 Center() const { return (min + max) * 0.5f; }
+		Vector3 Extents() const { return (max - min) * 0.5f; } // Half of the size
+
+		// Smallest axis aligned box containing this box once transformed
+		BoundingBox Transformed(const Matrix4& matrix) const
+		{
+			const Vector3 center = Center();
+			const Vector3 extents = Extents();
+
+			Vector3 newCenter = matrix.Position();
+			Vector3 newExtents(0, 0, 0);
+			for (int col = 0; col < 3; col++)
+			{
+				for (int row = 0; row < 3; row++)
+				{
+					newCenter[row] += matrix[col][row] * center[col];
+					newExtents[row] += std::abs(matrix[col][row]) * extents[col];
+				}
+			}
+
+			return { newCenter - newExtents, newCenter + newExtents };
+		}
+
+		float SurfaceArea() const
+		{
+			const Vector3 size = max - min;
+			return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+		}
+
+		bool Contains(const BoundingBox& other) const
+		{
+			return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z
+				&& max.x >= other.max.x && max.y >= other.max.y && max.z >= other.max.z;
+		}
+
+		bool Intersects(const BoundingBox& other) const
+		{
+			return min.x <= other.max.x && min.y <= other.max.y && min.z <= other.max.z
+				&& max.x >= other.min.x && max.y >= other.min.y && max.z >= other.min.z;
+		}
+
+		// Slab test, inverseDirection is 1 / direction (per component)
+		// distance is set to the entry distance along the ray (0 if the origin is inside)
+		bool IntersectsRay(const Vector3& origin, const Vector3& inverseDirection, float maxDistance, float& distance) const
+		{
+			float tMin = 0.0f;
+			float tMax = maxDistance;
+			for (int i = 0; i < 3; i++)
+			{
+				float t1 = (min[i] - origin[i]) * inverseDirection[i];
+				float t2 = (max[i] - origin[i]) * inverseDirection[i];
+				if (t1 > t2)
+					std::swap(t1, t2);
+
+				tMin = std::max(tMin, t1);
+				tMax = std::min(tMax, t2);
+				if (tMin > tMax)
+					return false;
+			}
+
+			distance = tMin;
+			return true;
+		}
+
+		BoundingBox Expanded(float margin) const
+		{
+			const Vector3 offset(margin, margin, margin);
+			return { min - offset, max + offset };
+		}
+
+		static BoundingBox Merge(const BoundingBox& a, const BoundingBox& b)
+		{
+			BoundingBox box;
+			for (int i = 0; i < 3; i++)
+			{
+				box.min[i] = std::min(a.min[i], b.min[i]);
+				box.max[i] = std::max(a.max[i], b.max[i]);
+			}
+
+			return box;
+		}
+
+		static BoundingBox FromPoints(std::span<const Vector3> points)
+		{
+			if (points.empty())
+				return BoundingBox{};
+
+			BoundingBox box{ points[0], points[0] };
+			for (auto& point : points)
+			{
+				for (int i = 0; i < 3; i++)
+				{
+					box.min[i] = std::min(box.min[i], point[i]);
+					box.max[i] = std::max(box.max[i], point[i]);
+				}
+			}
+
+			return box;
+		}
+
+		template<typename Archive>
+		void serialize(Archive& archive)
+		{
+			archive(KEEP_NAME(min), KEEP_NAME(max));
+		}
+	};
+
+	struct BoundingSphere
+	{
+		Vector3 center = Vector3(0, 0, 0);
+		float radius = 0.0f;
+
+		bool Intersects(const BoundingBox& box) const
+		{
+			// Distance from the center to the closest point of the box
+			float sqrDistance = 0.0f;
+			for (int i = 0; i < 3; i++)
+			{
+				const float closest = std::clamp(center[i], box.min[i], box.max[i]);
+				sqrDistance += (center[i] - closest) * (center[i] - closest);
+			}
+
+			return sqrDistance <= radius * radius;
+		}
+
+		// Centered on the box, with the radius of the furthest point
+		static BoundingSphere FromPoints(std::span<const Vector3> points)
+		{
+			BoundingSphere sphere{ BoundingBox::FromPoints(points).Center(), 0.0f };
+
+			float sqrRadius = 0.0f;
+			for (auto& point : points)
+				sqrRadius = std::max(sqrRadius, Vector3(point - sphere.center).SqrMagnitude());
+
+			sphere.radius = std::sqrt(sqrRadius);
+			return sphere;
+		}
+
+		template<typename Archive>
+		void serialize(Archive& archive)
+		{
+			archive(KEEP_NAME(center), KEEP_NAME(radius));
+		}
+	};
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+	#define RE_FRUSTUM_SSE
+	#include <xmmintrin.h>
+#endif
+
+#include "Vectors.h"
+#include "Matrix.h"
+#include "Bounds.h"
+
+namespace RexEngine
+{
+	// Boxes stored as a structure of arrays (center, extents), to test them 4 at a time
+	struct BoxList
+	{
+		std::vector<float> centerX, centerY, centerZ;
+		std::vector<float> extentX, extentY, extentZ;
+
+		void Add(const BoundingBox& box)
+		{
+			const Vector3 center = box.Center();
+			const Vector3 extents = box.Extents();
+
+			centerX.push_back(center.x); centerY.push_back(center.y); centerZ.push_back(center.z);
+			extentX.push_back(extents.x); extentY.push_back(extents.y); extentZ.push_back(extents.z);
+		}
+
+		// Keeps the capacity
+		void Clear()
+		{
+			centerX.clear(); centerY.clear(); centerZ.clear();
+			extentX.clear(); extentY.clear(); extentZ.clear();
+		}
+
+		size_t Size() const { return centerX.size(); }
+	};
+
+	// 6 planes (left, right, bottom, top, near, far) with the normals pointing inside
+	class Frustum
+	{
+	public:
+		// Gribb/Hartmann extraction, for a [-1, 1] clip space depth
+		explicit Frustum(const Matrix4& viewProjection)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				const Vector4 row(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+				const Vector4 w(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+				m_planes[i * 2] = Normalize(w + row);
+				m_planes[i * 2 + 1] = Normalize(w - row);
+			}
+		}
+
+		const std::array<Vector4, 6>& Planes() const { return m_planes; }
+
+		bool Intersects(const BoundingBox& box) const
+		{
+			const Vector3 center = box.Center();
+			const Vector3 extents = box.Extents();
+
+			for (auto& plane : m_planes)
+			{
+				const float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+				const float radius = std::abs(plane.x) * extents.x + std::abs(plane.y) * extents.y + std::abs(plane.z) * extents.z;
+				if (distance + radius < 0.0f)
+					return false;
+			}
+
+			return true;
+		}
+
+		bool Intersects(const BoundingSphere& sphere) const
+		{
+			for (auto& plane : m_planes)
+			{
+				if (plane.x * sphere.center.x + plane.y * sphere.center.y + plane.z * sphere.center.z + plane.w < -sphere.radius)
+					return false;
+			}
+
+			return true;
+		}
+
+		// visible[i] will be 1 if the box i intersects the frustum, 0 if not
+		// Returns the number of visible boxes
+		size_t CullBoxes(const BoxList& boxes, std::vector<uint8_t>& visible) const
+		{
+			const size_t count = boxes.Size();
+			visible.resize(count);
+
+			size_t visibleCount = 0;
+			size_t i = 0;
+
+#ifdef RE_FRUSTUM_SSE
+			const __m128 zero = _mm_setzero_ps();
+			for (; i + 4 <= count; i += 4)
+			{
+				const __m128 cx = _mm_loadu_ps(&boxes.centerX[i]);
+				const __m128 cy = _mm_loadu_ps(&boxes.centerY[i]);
+				const __m128 cz = _mm_loadu_ps(&boxes.centerZ[i]);
+				const __m128 ex = _mm_loadu_ps(&boxes.extentX[i]);
+				const __m128 ey = _mm_loadu_ps(&boxes.extentY[i]);
+				const __m128 ez = _mm_loadu_ps(&boxes.extentZ[i]);
+
+				__m128 inside = _mm_cmpeq_ps(zero, zero); // All bits set
+				for (auto& plane : m_planes)
+				{
+					// distance = dot(normal, center) + w
+					__m128 distance = _mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane.x)), _mm_mul_ps(cy, _mm_set1_ps(plane.y)));
+					distance = _mm_add_ps(distance, _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+
+					// radius = dot(abs(normal), extents)
+					__m128 radius = _mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(std::abs(plane.x))), _mm_mul_ps(ey, _mm_set1_ps(std::abs(plane.y))));
+					radius = _mm_add_ps(radius, _mm_mul_ps(ez, _mm_set1_ps(std::abs(plane.z))));
+
+					inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+				}
+
+				const int mask = _mm_movemask_ps(inside);
+				for (int b = 0; b < 4; b++)
+				{
+					visible[i + b] = (uint8_t)((mask >> b) & 1);
+					visibleCount += visible[i + b];
+				}
+			}
+#endif
+
+			// Remaining boxes (or all of them without SSE)
+			for (; i < count; i++)
+			{
+				const BoundingBox box{
+					Vector3(boxes.centerX[i] - boxes.extentX[i], boxes.centerY[i] - boxes.extentY[i], boxes.centerZ[i] - boxes.extentZ[i]),
+					Vector3(boxes.centerX[i] + boxes.extentX[i], boxes.centerY[i] + boxes.extentY[i], boxes.centerZ[i] + boxes.extentZ[i]) };
+
+				visible[i] = Intersects(box) ? 1 : 0;
+				visibleCount += visible[i];
+			}
+
+			return visibleCount;
+		}
+
+	private:
+		static Vector4 Normalize(const Vector4& plane)
+		{
+			const float length = Vector3(plane.x, plane.y, plane.z).Magnitude();
+			return length > 0.0f ? Vector4(plane / length) : plane;
+		}
+
+	private:
+		std::array<Vector4, 6> m_planes;
+	};
+}
@@ -87,6 +87,12 @@ namespace RexEngine
 			return glm::perspective(glm::radians(fov), aspect, zNear, zFar);
 		}
 
+		// Box of the view space seen, the depth is mapped like MakePerspective
+		inline static MatType MakeOrthographic(float left, float right, float bottom, float top, float zNear, float zFar) requires IsEqual<Size, 4>
+		{
+			return glm::ortho(left, right, bottom, top, zNear, zFar);
+		}
+
 		inline static MatType MakeLookAt(Vector<T, 3> eye, Vector<T, 3> lookAt, Vector<T, 3> up) requires IsEqual<Size, 4>
 		{
 			return glm::lookAt(eye, lookAt, up);
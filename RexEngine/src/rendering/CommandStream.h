@@ -0,0 +1,109 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include <cstring>
+#include <utility>
+#include <cstdint>
+#include <type_traits>
+
+namespace RexEngine
+{
+	// Compact binary list of render commands : a one byte opcode followed by the arguments of the command, copied inline
+	// A byte span argument is copied as its size then its bytes, the reader returns a span in the stream
+	// The meaning of the opcodes belongs to the RenderApi backend, see RenderApi::BeginRecording() and RenderApi::Submit()
+	class CommandStream
+	{
+	public:
+		using OpCode = uint8_t;
+		using Bytes = std::span<const uint8_t>;
+
+		class Reader
+		{
+		public:
+			bool AtEnd() const { return m_offset >= m_stream.m_data.size(); }
+
+			template<typename T>
+			T Read()
+			{
+				if constexpr (std::is_same_v<T, Bytes>)
+				{
+					const size_t size = Read<size_t>();
+					const Bytes bytes(m_stream.m_data.data() + m_offset, size);
+					m_offset += size;
+					return bytes;
+				}
+				else
+				{
+					static_assert(std::is_trivially_copyable_v<T>, "The arguments of a command are copied as bytes");
+
+					T value;
+					std::memcpy(&value, m_stream.m_data.data() + m_offset, sizeof(T));
+					m_offset += sizeof(T);
+					return value;
+				}
+			}
+
+		private:
+			friend class CommandStream;
+			explicit Reader(const CommandStream& stream) : m_stream(stream) {}
+
+			const CommandStream& m_stream;
+			size_t m_offset = 0;
+		};
+
+		CommandStream() = default;
+		CommandStream(const CommandStream&) = delete;
+
+		template<typename... Args>
+		void Record(OpCode op, const Args&... args)
+		{
+			Write(op);
+			(Write(args), ...);
+			m_commandCount++;
+		}
+
+		Reader Read() const { return Reader(*this); }
+
+		// Keeps the capacity, so the stream of every frame doesn't allocate once it reached its size
+		void Clear()
+		{
+			m_data.clear();
+			m_commandCount = 0;
+		}
+
+		// Exchanges the commands and the capacity of the streams
+		void Swap(CommandStream& other) noexcept
+		{
+			m_data.swap(other.m_data);
+			std::swap(m_commandCount, other.m_commandCount);
+		}
+
+		bool Empty() const { return m_data.empty(); }
+		size_t Size() const { return m_data.size(); } // In bytes
+		size_t CommandCount() const { return m_commandCount; }
+
+	private:
+		template<typename T>
+		void Write(const T& value)
+		{
+			if constexpr (std::is_same_v<T, Bytes>)
+			{
+				Write(value.size());
+				m_data.insert(m_data.end(), value.begin(), value.end());
+			}
+			else
+			{
+				static_assert(std::is_trivially_copyable_v<T>, "The arguments of a command are copied as bytes");
+
+				const size_t offset = m_data.size();
+				m_data.resize(offset + sizeof(T));
+				std::memcpy(m_data.data() + offset, &value, sizeof(T));
+			}
+		}
+
+	private:
+		std::vector<uint8_t> m_data;
+		size_t m_commandCount = 0;
+	};
+}
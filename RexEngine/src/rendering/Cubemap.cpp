@@ -125,7 +125,7 @@ namespace RexEngine
 				RenderApi::ClearColorBit();
 				RenderApi::ClearDepthBit();
 
-				RenderApi::DrawElements(cubeMesh->GetIndexCount()); // Render to the cubemap
+				cubeMesh->Draw(); // Render to the cubemap
 			}
 
 			RenderApi::BindFrameBuffer(oldFrameBuffer);
@@ -145,11 +145,21 @@ namespace RexEngine
 
 	Cubemap::~Cubemap()
 	{
+		RenderApi::MakeTextureHandleNonResident(m_handle);
 		RenderApi::DeleteTexture(m_id);
 	}
 
+	RenderApi::TextureHandle Cubemap::GetHandle() const
+	{
+		if (m_handle == RenderApi::InvalidTextureHandle)
+			m_handle = RenderApi::MakeTextureHandleResident(m_id);
+
+		return m_handle;
+	}
+
 	void Cubemap::SetOption(RenderApi::TextureOption option, RenderApi::TextureOptionValue value)
 	{
+		RE_ASSERT(m_handle == RenderApi::InvalidTextureHandle, "Cannot change a cubemap that has a bindless handle");
 		RenderApi::SetTextureOption(m_id, RenderApi::TextureTarget::Cubemap, option, value);
 	}
 
@@ -29,6 +29,9 @@ namespace RexEngine
 		auto GetMode() const { return m_mode; }
 		RenderApi::TextureID GetId() const { return m_id; }
 
+		// Bindless handle, made resident on the first call. The cubemap can't be changed anymore after that
+		RenderApi::TextureHandle GetHandle() const;
+
 		void Bind() const { RenderApi::BindTexture(m_id, RenderApi::TextureTarget::Cubemap); }
 		static void UnBind() { RenderApi::BindTexture(RenderApi::InvalidTextureID, RenderApi::TextureTarget::Cubemap); }
 
@@ -60,6 +63,7 @@ namespace RexEngine
 
 	private:
 		RenderApi::TextureID m_id;
+		mutable RenderApi::TextureHandle m_handle = RenderApi::InvalidTextureHandle;
 
 		Asset<Texture> m_source;
 		ProjectionMode m_mode;
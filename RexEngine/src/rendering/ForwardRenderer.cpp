@@ -4,11 +4,74 @@
 #include "RenderQueue.h"
 #include "RenderCommands.h"
 #include "Shapes.h"
+#include "RingBuffer.h"
+#include "OcclusionBuffer.h"
+#include "StorageArray.h"
+#include "ShadowMaps.h"
+#include "../utils/NoDestroy.h"
 
+namespace RexEngine::Internal
+{
+	// Forward axis of a global transform, without decomposing it
+	Vector3 TransformForward(const Matrix4& transform)
+	{
+		const Vector3 f = Directions::Forward;
+		return Vector3(
+			transform[0][0] * f.x + transform[1][0] * f.y + transform[2][0] * f.z,
+			transform[0][1] * f.x + transform[1][1] * f.y + transform[2][1] * f.z,
+			transform[0][2] * f.x + transform[1][2] * f.y + transform[2][2] * f.z).Normalized();
+	}
+
+	// The proxy of a light with its world position and direction up to date
+	// The local transforms of the light and its parents are compared instead of computing the global transform every frame
+	LightProxyComponent& UpdateLightProxy(Entity e)
+	{
+		auto& proxy = e.HasComponent<LightProxyComponent>() ? e.GetComponent<LightProxyComponent>() : e.AddComponent<LightProxyComponent>();
+
+		bool changed = false;
+		uint32_t depth = 0;
+		for (const TransformComponent* transform = &e.Transform(); transform != nullptr; depth++)
+		{
+			if (depth == LightProxyComponent::MaxTrackedDepth)
+			{
+				changed = true;
+				break;
+			}
+
+			const Entity parent = transform->parent && transform->parent.HasComponent<TransformComponent>() ? transform->parent : Entity();
+
+			auto& local = proxy.transforms[depth];
+			if (std::memcmp(&local.position, &transform->position, sizeof(Vector3)) != 0
+				|| std::memcmp(&local.scale, &transform->scale, sizeof(Vector3)) != 0
+				|| std::memcmp(&local.rotation, &transform->rotation, sizeof(Quaternion)) != 0
+				|| local.parent != parent)
+			{
+				local = { transform->position, transform->scale, transform->rotation, parent };
+				changed = true;
+			}
+
+			transform = parent ? &parent.Transform() : nullptr;
+		}
+
+		if (changed || depth != proxy.depth)
+		{
+			const Matrix4 transform = e.Transform().GetGlobalTransform();
+			proxy.position = transform.Position();
+			proxy.direction = TransformForward(transform);
+			proxy.depth = depth;
+		}
+
+		return proxy;
+	}
+
+	// Lod drawn last frame by each view, by spatial proxy, so the hysteresis of a view doesn't depend on the other views
+	// A reused proxy starts from the lod of the previous entity, it only shifts the thresholds for a frame
+	NoDestroy<std::unordered_map<uint32_t, std::vector<uint8_t>>> s_viewLods; // By ForwardRenderer::ViewID
+}
 
 namespace RexEngine
 {
-	void ForwardRenderer::RenderScene(Asset<Scene> scene, const CameraComponent& camera)
+	void ForwardRenderer::RenderScene(Asset<Scene> scene, const CameraComponent& camera, ViewID view)
 	{
 		if (!scene) // No scene
 			return;
@@ -27,60 +90,99 @@ namespace RexEngine
 		auto projectionMatrix = Matrix4::MakePerspective(camera.fov, (float)viewport.x / (float)viewport.y, camera.zNear, camera.zFar);
 
 		// Update the scene data for the uniform blocks
- 		SceneDataUniforms sceneData{viewMatrix, projectionMatrix, cameraPos};
-
-		auto sceneDataBuffer = UniformBlocks::GetBlock<SceneDataUniforms>("SceneData").GetBufferID();
-		RenderApi::SubBufferData(sceneDataBuffer, RenderApi::BufferType::Uniforms, 0, sizeof(SceneDataUniforms), &sceneData);
+		static const int sceneDataLocation = UniformBlocks::GetLocation("SceneData");
+		RingBuffer::Push(SceneDataUniforms{ viewMatrix, projectionMatrix, cameraPos }, RenderApi::BufferType::Uniforms, sceneDataLocation);
 
 		
 		// Update the lighting data
+		// The light arrays stay on the GPU, an entry is only uploaded when its light or transform changed
+		// The world position and direction of a light are only computed when its transform changed, see LightProxyComponent
+		auto lightRange = [](LightProxyComponent& proxy, const Color& color) {
+			if (std::memcmp(&proxy.color, &color, sizeof(Color)) != 0)
+			{
+				proxy.color = color;
+				proxy.range = LightRange(color);
+			}
+			return proxy.range;
+		};
 
-		// Point lights and Directional lights
-		std::vector<LightData> lights;
-
-		for (auto&& [e, c] : scene->GetComponents<PointLightComponent>())
-			lights.emplace_back(e.Transform().GlobalPosition(), (Vector3)c.color, false);
+		// Directional lights first, then the point lights
+		static NoDestroy<StorageArray<LightData>> lights;
+		static std::vector<LightClusters::PointLight> clusterPointLights;
+		clusterPointLights.clear();
 
+		size_t lightCount = 0;
+		std::optional<Vector3> shadowLightDirection; // The first directional light has the shadows
 		for (auto&& [e, c] : scene->GetComponents<DirectionalLightComponent>())
-			lights.emplace_back(e.Transform().GlobalForward(), (Vector3)c.color, true);
+		{
+			const Vector3 direction = Internal::UpdateLightProxy(e).direction;
+			lights->Set(lightCount++, LightData(direction, (Vector3)c.color, true, 0.0f));
 
-		auto lightBufferID = UniformBlocks::GetBlock<LightData>("LightsData").GetBufferID();
+			if (!shadowLightDirection)
+				shadowLightDirection = direction;
+		}
 
-		if (lights.size() > LightsMax)
-		{ // Resize the buffer
-			LightsMax = (uint32_t)(LightsMax * 1.5f) + 1;
-			RenderApi::SetBufferData(lightBufferID, RenderApi::BufferType::ShaderStorage, RenderApi::BufferMode::Dynamic, nullptr, sizeof(LightData) * lights.size() + sizeof(uint32_t) + 12); // 12 is the padding
+		const uint32_t directionalCount = static_cast<uint32_t>(lightCount);
+
+		for (auto&& [e, c] : scene->GetComponents<PointLightComponent>())
+		{
+			auto& proxy = Internal::UpdateLightProxy(e);
+			const Vector3 position = proxy.position;
+			const float range = lightRange(proxy, c.color);
+			lights->Set(lightCount++, LightData(position, (Vector3)c.color, false, range));
+			clusterPointLights.push_back({ position, range });
 		}
 
-		uint32_t LightsCount = static_cast<uint32_t>(lights.size());
-		RenderApi::SubBufferData(lightBufferID, RenderApi::BufferType::ShaderStorage, 0, sizeof(uint32_t), &LightsCount);
-		if(LightsMax > 0)
-			RenderApi::SubBufferData(lightBufferID, RenderApi::BufferType::ShaderStorage, sizeof(uint32_t) + 12, sizeof(LightData) * lights.size(), lights.data()); // 12 is the padding
+		lights->Truncate(lightCount);
+		lights->SetExtra(directionalCount);
 
 
 		// Spot lights
-		std::vector<SpotLightData> spotLights;
+		static NoDestroy<StorageArray<SpotLightData>> spotLights;
+		static std::vector<LightClusters::SpotLight> clusterSpotLights;
+		clusterSpotLights.clear();
 
+		size_t spotLightCount = 0;
 		for (auto&& [e, c] : scene->GetComponents<SpotLightComponent>())
-			spotLights.emplace_back(e.Transform().GlobalPosition(), e.Transform().GlobalForward(), (Vector3)c.color, std::cos(glm::radians(c.cutOff)), std::cos(glm::radians(c.outerCutOff)));
-
-		auto spotLightBufferID = UniformBlocks::GetBlock<SpotLightData>("SpotLightsData").GetBufferID();
-		if (spotLights.size() > SpotLightsMax)
-		{ // Resize the buffer
-			SpotLightsMax = (uint32_t)(SpotLightsMax * 1.5f) + 1;
-			RenderApi::SetBufferData(spotLightBufferID, RenderApi::BufferType::ShaderStorage, RenderApi::BufferMode::Dynamic, nullptr, sizeof(SpotLightData) * spotLights.size() + sizeof(uint32_t) + 12); // 12 is the padding
+		{
+			auto& proxy = Internal::UpdateLightProxy(e);
+			const Vector3 position = proxy.position;
+			const Vector3 direction = proxy.direction;
+			const float range = lightRange(proxy, c.color);
+			spotLights->Set(spotLightCount++, SpotLightData(position, direction, (Vector3)c.color, range, std::cos(glm::radians(c.cutOff)), std::cos(glm::radians(c.outerCutOff))));
+			clusterSpotLights.push_back({ position, range, direction, glm::radians(c.outerCutOff) });
 		}
 
-		uint32_t SpotLightsCount = static_cast<uint32_t>(spotLights.size());
-		RenderApi::SubBufferData(spotLightBufferID, RenderApi::BufferType::ShaderStorage, 0, sizeof(uint32_t), &SpotLightsCount);
-		if (SpotLightsMax > 0)
-			RenderApi::SubBufferData(spotLightBufferID, RenderApi::BufferType::ShaderStorage, sizeof(uint32_t) + 12, sizeof(SpotLightData) * spotLights.size(), spotLights.data()); // 12 is the padding
+		spotLights->Truncate(spotLightCount);
+
+		LastStats().lightBytesUploaded = static_cast<uint32_t>(lights->Upload(LightsBinding) + spotLights->Upload(SpotLightsBinding));
+
+
+		// Assign the point and spot lights to the clusters of the view
+		static LightClusters clusters;
+		clusters.Build(viewMatrix, camera.fov, (float)viewport.x / (float)viewport.y, camera.zNear, camera.zFar, clusterPointLights, clusterSpotLights, directionalCount);
+
+		LightClustersHeader clustersHeader{
+			{ LightClusters::TilesX, LightClusters::TilesY, LightClusters::Slices, 0 },
+			{ clusters.SliceScale(), clusters.SliceBias(), (float)viewport.x / LightClusters::TilesX, (float)viewport.y / LightClusters::TilesY },
+			Vector4(viewMatrix[0][2], viewMatrix[1][2], viewMatrix[2][2], viewMatrix[3][2]) };
+
+		auto clustersAllocation = RingBuffer::Allocate(sizeof(LightClustersHeader) + clusters.GetClusters().size_bytes());
+		std::memcpy(clustersAllocation.data, &clustersHeader, sizeof(LightClustersHeader));
+		std::memcpy(clustersAllocation.data + sizeof(LightClustersHeader), clusters.GetClusters().data(), clusters.GetClusters().size_bytes());
+		RingBuffer::Bind(clustersAllocation, RenderApi::BufferType::ShaderStorage, LightClustersBinding);
+
+		static const uint32_t noIndex = 0; // An empty buffer can't be bound
+		auto indices = clusters.GetIndices();
+		RingBuffer::PushArray(indices.empty() ? std::span<const uint32_t>(&noIndex, 1) : indices, RenderApi::BufferType::ShaderStorage, LightClusterIndicesBinding);
+
+		LastStats().clusterLightIndices = static_cast<uint32_t>(indices.size());
 
 
 		auto& opaqueQueue = RenderQueues::GetQueue<OpaqueRenderCommand>("Opaque");
+		auto& prepassQueue = RenderQueues::GetQueue<DepthPrepassRenderCommand>("DepthPrepass");
 
-		// Skybox TODO : render this after the opaque objects, but before the transparent ones
-		// Get the skybox component
+		// Skybox, in its own queue rendered between the opaque and the transparent objects
 		auto&& skyboxes = scene->GetComponents<SkyboxComponent>();
 		if (skyboxes.size() > 1)
 			RE_LOG_WARN("Multiple skyboxes active !");
@@ -91,17 +193,160 @@ namespace RexEngine
 			auto& c = skyboxes[0].second;
 
 			if (c.material && c.material->GetShader())
-				opaqueQueue.AddCommand<OpaqueRenderCommand>(c.material, skyboxMesh, Matrix4::MakeTransform(cameraPos, Quaternion::Identity(), {1,1,1})); // Remove the translation (the skybox is always around the player)
+			{
+				auto& skyboxQueue = RenderQueues::GetQueue<SkyboxRenderCommand>("Skybox");
+				skyboxQueue.AddCommand<SkyboxRenderCommand>(c.material.Get(), skyboxMesh.get(), Matrix4::MakeTransform(cameraPos, Quaternion::Identity(), {1,1,1})); // Centered on the camera (the skybox is always around the player)
+			}
 		}
 
 
+		// Frustum culling, the bounds are tested before any command is made
+		// The spatial index gives the entities whose fat bounds touch the frustum, their real bounds are then tested 4 at a time
+		const Frustum frustum(projectionMatrix * viewMatrix);
+		scene->UpdateSpatialIndex();
+
+		// Cascades and casters of the shadows, rendered by the Shadows pass (see AddPasses)
+		ShadowMaps::Prepare(scene, view, camera, cameraPos, cameraRotation * Directions::Forward, (float)viewport.x / (float)viewport.y, shadowLightDirection);
+
+		struct Candidate
+		{
+			SpatialProxyComponent* proxy;
+			Material* material;
+			Mesh* mesh;
+			bool occluder;
+		};
+
+		static std::vector<Candidate> candidates; // Static to keep the capacity between frames
+		static BoxList boxes;
+		static std::vector<uint8_t> visible;
+		candidates.clear();
+		boxes.Clear();
+
+		scene->QueryFrustum(frustum, [](Entity e) {
+			auto& c = e.GetComponent<MeshRendererComponent>();
+			if (c.material && c.mesh && c.material->GetShader()) // Has a material, a shader and a mesh
+			{
+				auto& proxy = e.GetComponent<SpatialProxyComponent>();
+				candidates.push_back({ &proxy, c.material.Get(), c.mesh.Get(), e.HasComponent<OccluderComponent>() });
+				boxes.Add(proxy.bounds);
+			}
+		});
+
+		size_t visibleCount = frustum.CullBoxes(boxes, visible);
+		LastStats().frustumCulled = static_cast<uint32_t>(candidates.size() - visibleCount);
+		LastStats().occlusionCulled = 0;
+
+		// Occlusion culling, the occluders are rasterized on the cpu and the remaining boxes are tested against the depth
+		if (EnableOcclusionCulling)
+		{
+			const Matrix4 viewProjection = projectionMatrix * viewMatrix;
+
+			static OcclusionBuffer occlusionBuffer;
+			occlusionBuffer.Clear();
+
+			for (auto&& [e, c] : scene->GetComponents<OccluderComponent>())
+			{
+				Mesh* mesh = c.mesh.Get();
+				if (!mesh && e.HasComponent<MeshRendererComponent>())
+					mesh = e.GetComponent<MeshRendererComponent>().mesh.Get();
+
+				// A mesh without its cpu data can't occlude
+				if (mesh && !mesh->GetPositionData().empty())
+					occlusionBuffer.AddOccluder(viewProjection * e.Transform().GetGlobalTransform(), mesh->GetPositionData(), mesh->GetPositionStride(), mesh->GetIndices());
+			}
+
+			if (occlusionBuffer.GetTriangleCount() > 0)
+			{
+				occlusionBuffer.Rasterize();
+
+				for (size_t i = 0; i < candidates.size(); i++)
+				{
+					// The occluders would hide themselves
+					if (visible[i] && !candidates[i].occluder && !occlusionBuffer.IsVisible(candidates[i].proxy->bounds, viewProjection))
+					{
+						visible[i] = 0;
+						visibleCount--;
+						LastStats().occlusionCulled++;
+					}
+				}
+			}
+		}
+
+		LastStats().visible = static_cast<uint32_t>(visibleCount);
+
 		// Draw objects (put them in the RenderQueue)
-		for (auto&& [e, c] : scene->GetComponents<MeshRendererComponent>())
+		// The lod is picked from the height of the bounding sphere on the screen (1 = the full screen height)
+		const float screenScale = 1.0f / std::tan(glm::radians(camera.fov) * 0.5f);
+		auto& lods = (*Internal::s_viewLods)[view];
+		for (size_t i = 0; i < candidates.size(); i++)
 		{
-			const Matrix4 modelMatrix = e.GetComponent<TransformComponent>().GetGlobalTransform();
-			
-			if(c.material && c.mesh && c.material->GetShader()) // Has a material, a shader and a mesh
-				opaqueQueue.AddCommand<OpaqueRenderCommand>(c.material, c.mesh, modelMatrix);
+			if (!visible[i])
+				continue;
+
+			auto& candidate = candidates[i];
+			const auto proxy = static_cast<size_t>(candidate.proxy->proxy);
+			if (proxy >= lods.size())
+				lods.resize(proxy + 1, 0);
+
+			if (EnableLods)
+			{
+				const float radius = candidate.proxy->bounds.Extents().Magnitude();
+				const float distance = Vector3(candidate.proxy->bounds.Center() - cameraPos).Magnitude();
+				const float screenSize = distance > radius ? radius * screenScale / distance : 1.0f;
+				lods[proxy] = static_cast<uint8_t>(candidate.mesh->SelectLod(screenSize, lods[proxy]));
+			}
+			else
+				lods[proxy] = 0;
+
+			const uint32_t lod = lods[proxy];
+			opaqueQueue.AddCommand<OpaqueRenderCommand>(candidate.material, candidate.mesh, candidate.proxy->globalTransform, cameraPos, lod);
+
+			const Shader* shader = candidate.material->GetShader().Get();
+			if (EnableDepthPrepass && shader->UsesDepthPrepass())
+				prepassQueue.AddCommand<DepthPrepassRenderCommand>(candidate.mesh, candidate.proxy->globalTransform, cameraPos, shader->CullingMode(), lod);
+		}
+	}
+
+	void ForwardRenderer::AddPasses(FrameGraph& graph, FrameGraph::Resource color, FrameGraph::Resource depth)
+	{
+		auto writeTargets = [color, depth](FrameGraph::PassBuilder& builder) {
+			builder.Write(color);
+			builder.Write(depth);
+		};
+
+		graph.AddPass("Clear", writeTargets, [](const FrameGraph::PassResources&) {
+			RenderApi::ClearColorBit();
+			RenderApi::ClearDepthBit();
+		});
+
+		// Shadow maps of the view prepared by RenderScene(), sampled by the queues
+		FrameGraph::Resource shadows = FrameGraph::InvalidResource;
+		if (const Texture* atlas = ShadowMaps::GetPreparedAtlas())
+		{
+			shadows = graph.ImportTexture("ShadowAtlas", *atlas);
+			graph.AddPass("Shadows", [shadows](FrameGraph::PassBuilder& builder) { builder.Write(shadows); }, [](const FrameGraph::PassResources&) {
+				ShadowMaps::Render();
+			});
+		}
+
+		auto queueTargets = [writeTargets, shadows](FrameGraph::PassBuilder& builder) {
+			if (shadows != FrameGraph::InvalidResource)
+				builder.Read(shadows);
+
+			writeTargets(builder);
+		};
+
+		for (auto& name : RenderQueues::GetQueueNames())
+		{
+			// The opaque objects drawn in the pre-pass are tested against their own depth
+			const bool prepassed = EnableDepthPrepass && name == "Opaque";
+
+			graph.AddPass(name, queueTargets, [name, prepassed](const FrameGraph::PassResources&) {
+				Shader::SetDepthPrepassed(prepassed);
+				RenderQueues::ExecuteQueue(name);
+				Shader::SetDepthPrepassed(false);
+				RenderApi::SetDepthWrite(true);
+			});
 		}
 	}
-}
\ No newline at end of file
+}
@@ -4,14 +4,21 @@
 #include "../scene/Components.h"
 
 #include "FrameBuffer.h"
+#include "FrameGraph.h"
+#include "../math/Frustum.h"
 #include "UniformBlock.h"
+#include "LightClusters.h"
 
 namespace RexEngine
 {
 	class ForwardRenderer
 	{
 	public:
-		static constexpr int MaxLights = 32; // Max lights for each type
+		// Shader storage bindings of the lighting data, see the Lighting shader using
+		inline static constexpr int LightsBinding = 1;
+		inline static constexpr int SpotLightsBinding = 2;
+		inline static constexpr int LightClustersBinding = 3;
+		inline static constexpr int LightClusterIndicesBinding = 4;
 
 		// Uniform block sent to the shaders for the scene data
 		struct SceneDataUniforms
@@ -31,10 +38,10 @@ namespace RexEngine
 		{
 			Vector4 Pos; // If the w component == 0, the light is directional and if == 1 it is a point light
 			Vector3 Color;
-			float padding; // To match opengl
+			float Range; // Distance where the light reaches 0, not used by the directional lights
 
-			LightData(Vector3 pos, Vector3 color, bool directional)
-				: Pos(pos, directional ? 0.0f : 1.0f), Color(color), padding(0.0f)
+			LightData(Vector3 pos, Vector3 color, bool directional, float range)
+				: Pos(pos, directional ? 0.0f : 1.0f), Color(color), Range(range)
 			{ }
 		};
 
@@ -45,40 +52,108 @@ namespace RexEngine
 			Vector3 Pos;
 			float padding2; // to match opengl
 			Vector3 Color;
-			float padding3; // to match opengl
+			float Range; // Color.w in the shader
 			float CutOff;
 			float OuterCutOff;
 			float padding4; // to match opengl
 			float padding5; // to match opengl
 
-			SpotLightData(Vector3 pos, Vector3 dir, Vector3 color, float cutOff, float outerCutOff)
-				: Dir(dir), padding1(0.0f), Pos(pos), padding2(0.0f), Color(color), padding3(0.0f), CutOff(cutOff), OuterCutOff(outerCutOff), padding4(0.0f), padding5(0.0f)
+			SpotLightData(Vector3 pos, Vector3 dir, Vector3 color, float range, float cutOff, float outerCutOff)
+				: Dir(dir), padding1(0.0f), Pos(pos), padding2(0.0f), Color(color), Range(range), CutOff(cutOff), OuterCutOff(outerCutOff), padding4(0.0f), padding5(0.0f)
 			{ }
 
 		private:
+			// The directional lights are the first DirectionalLightCount Lights, they affect every fragment
+			// The point and spot lights are read through the cluster of the fragment (see LightClusters)
 			RE_STATIC_CONSTRUCTOR({
-	const int lights = UniformBlocks::ReserveBlock<LightData>("LightsData");
-	const int spotLights = UniformBlocks::ReserveBlock<SpotLightData>("SpotLightsData");
 Shader::RegisterParserUsing("Lighting", std::format(R"(
-struct LightData {{ vec4 Pos; vec3 Color; }};
-layout (std140, binding = {}) uniform LightsData {{ uint LightCount; LightData Lights[]; }};
+struct LightData {{ vec4 Pos; vec3 Color; float Range; }};
+layout (std430, binding = {}) readonly buffer LightsData {{ uint LightCount; uint DirectionalLightCount; LightData Lights[]; }};
 struct SpotLightData {{ vec4 Dir; vec4 Pos; vec4 Color; float CutOff; float OuterCutOff; }};
-layout (std140, binding = {}) uniform SpotLightsData {{ uint SpotLightCount; SpotLightData SpotLights[]; }};
-)", lights, spotLights));
+layout (std430, binding = {}) readonly buffer SpotLightsData {{ uint SpotLightCount; SpotLightData SpotLights[]; }};
+layout (std430, binding = {}) readonly buffer LightClustersData {{ uvec4 ClusterCount; vec4 ClusterParams; vec4 ClusterViewDepth; uvec2 Clusters[]; }};
+layout (std430, binding = {}) readonly buffer LightClusterIndicesData {{ uint ClusterLightIndices[]; }};
+
+// Cluster of a fragment, x is the offset in ClusterLightIndices, y is the point light count | spot light count << 16
+uvec2 GetLightCluster(vec2 fragCoord, vec3 worldPos)
+{{
+    float viewDepth = max(dot(ClusterViewDepth, vec4(worldPos, 1.0)), 1e-4);
+    uint slice = uint(clamp(log(viewDepth) * ClusterParams.x - ClusterParams.y, 0.0, float(ClusterCount.z - 1u)));
+    uvec2 tile = min(uvec2(fragCoord / ClusterParams.zw), ClusterCount.xy - 1u);
+    return Clusters[tile.x + ClusterCount.x * (tile.y + ClusterCount.y * slice)];
+}}
+
+// Fades the light to 0 at its range, so it doesn't pop at the edge of its clusters
+float LightRangeWindow(float distance, float range)
+{{
+    float ratio = distance / range;
+    float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+    return window * window;
+}}
+)", LightsBinding, SpotLightsBinding, LightClustersBinding, LightClusterIndicesBinding));
 				})
 		};
 
+		// Header of the LightClustersData buffer
+		struct LightClustersHeader
+		{
+			uint32_t count[4]; // Tiles x, tiles y, slices, 0
+			float params[4]; // Slice scale, slice bias, tile width and height in pixels
+			Vector4 viewDepth; // Third row of the view matrix, dot with a world position gives its view depth
+		};
+
+		// Radiance under which a light is ignored, sets the range of the lights (1 / distance^2 attenuation)
+		inline static float LightCutoff = 0.01f;
+
+		static float LightRange(const Color& color)
+		{
+			return std::sqrt(std::max({ color.r, color.g, color.b, 0.0f }) / LightCutoff);
+		}
+
 	public:
 
+		// Cull the mesh renderers hidden behind the OccluderComponents, on the cpu
+		inline static bool EnableOcclusionCulling = false;
+
+		// Draw the simplified lods of the meshes when they are small on the screen
+		inline static bool EnableLods = true;
+
+		// Render the depth of the opaque objects front to back before shading them (see Shader::UsesDepthPrepass)
+		// The opaque pass then only shades the closest fragment of each pixel
+		inline static bool EnableDepthPrepass = false;
+
+		struct Stats
+		{
+			uint32_t visible = 0; // Mesh renderers sent to the render queues
+			uint32_t frustumCulled = 0; // Drawable mesh renderers given by the spatial index whose bounds are outside of the camera frustum
+			uint32_t occlusionCulled = 0; // Mesh renderers hidden behind an occluder
+			uint32_t clusterLightIndices = 0; // Sum of the lights of every light cluster
+			uint32_t lightBytesUploaded = 0; // Light data sent to the GPU, 0 when no light changed
+		};
+
+		// A view rendered every frame (a panel, a preview, ...), the data cached between the frames (the shadow maps) is kept by view
+		using ViewID = uint32_t;
+		static ViewID MakeViewID() { return s_nextViewID++; }
+
 		// Render a scene using a camera
 		// All the render calls will be added to the respective queues,
 		// call RenderQueues::ExecuteQueues() to render
-		static void RenderScene(Asset<Scene> scene, const CameraComponent& camera);
+		static void RenderScene(Asset<Scene> scene, const CameraComponent& camera, ViewID view);
+
+		// Add the passes drawing the render queues into color and depth to the graph
+		// A clear pass, the shadow maps of the view, then one pass per render queue in the order of their priority (Opaque, Transparent, ...)
+		static void AddPasses(FrameGraph& graph, FrameGraph::Resource color, FrameGraph::Resource depth);
+
+		// Stats of the last RenderScene() call
+		static const Stats& GetLastStats() { return LastStats(); }
 
 	private:
+		inline static ViewID s_nextViewID = 1;
 
-		// Size of the current Lights buffer, this will change if more are needed
-		inline static uint32_t LightsMax = 0;
-		inline static uint32_t SpotLightsMax = 0;
+		static Stats& LastStats()
+		{
+			static Stats stats;
+			return stats;
+		}
 	};
 }
\ No newline at end of file
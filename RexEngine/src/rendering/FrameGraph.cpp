@@ -0,0 +1,377 @@
+#include <REPch.h>
+#include "FrameGraph.h"
+
+#include "FrameBuffer.h"
+#include "RenderBuffer.h"
+#include "CommandStream.h"
+#include "../core/Time.h"
+#include "../utils/NoDestroy.h"
+
+namespace RexEngine::Internal
+{
+	// Render target owned by the pool, shared by the transient targets of the graphs
+	struct PooledTarget
+	{
+		FrameGraph::TargetDesc desc;
+		std::unique_ptr<Texture> texture;
+		std::unique_ptr<RenderBuffer> renderBuffer; // Depth targets
+		bool inUse = false; // Used by a transient target of the graph being allocated
+		uint64_t lastUsedFrame = 0;
+	};
+
+	// A pooled target not used for this many frames is deleted (ex : the size of the view changed)
+	constexpr uint64_t MaxUnusedFrames = 60;
+
+	NoDestroy<std::vector<PooledTarget>> s_targetPool;
+	NoDestroy<CommandStream> s_graphCommands; // Reused by every graph, keeps its capacity
+	uint64_t s_frame = 0;
+
+	FrameGraph::Stats s_frameGraphStats;
+	FrameGraph::Stats s_lastFrameGraphStats;
+
+	// Time query of an executed pass, waiting for the GPU
+	struct PassQuery
+	{
+		std::string name;
+		RenderApi::QueryID query;
+		uint64_t frame;
+	};
+
+	// The queries are resolved by the render thread while the graphs of the next frame are executed
+	std::mutex s_queryMutex;
+	std::deque<PassQuery> s_pendingQueries;
+	std::vector<RenderApi::QueryID> s_freeQueries;
+
+	std::vector<FrameGraph::PassTime> s_passTimes; // Of s_passTimesFrame, still receiving results
+	std::vector<FrameGraph::PassTime> s_lastPassTimes;
+	uint64_t s_passTimesFrame = 0;
+
+	size_t AcquirePooledTarget(const FrameGraph::TargetDesc& desc)
+	{
+		auto& pool = *s_targetPool;
+		for (size_t i = 0; i < pool.size(); i++)
+		{
+			if (!pool[i].inUse && pool[i].desc == desc)
+			{
+				pool[i].inUse = true;
+				pool[i].lastUsedFrame = s_frame;
+				return i;
+			}
+		}
+
+		PooledTarget target;
+		target.desc = desc;
+		target.inUse = true;
+		target.lastUsedFrame = s_frame;
+
+		if (desc.format == RenderApi::PixelFormat::Depth)
+			target.renderBuffer = std::make_unique<RenderBuffer>(RenderApi::PixelType::Depth, desc.size);
+		else
+			target.texture = std::make_unique<Texture>(desc.format, desc.size);
+
+		pool.push_back(std::move(target));
+		return pool.size() - 1;
+	}
+}
+
+namespace RexEngine
+{
+	void FrameGraph::PassBuilder::Read(Resource resource)
+	{
+		RE_ASSERT(resource < m_graph.m_resources.size(), "Invalid frame graph resource");
+		RE_ASSERT(!m_graph.m_resources[resource].writers.empty() || m_graph.m_resources[resource].isImported,
+			"Pass {} reads {} before any pass writes it", m_graph.m_passes[m_pass].name, m_graph.m_resources[resource].name);
+
+		m_graph.m_passes[m_pass].reads.push_back(resource);
+	}
+
+	void FrameGraph::PassBuilder::Write(Resource resource)
+	{
+		RE_ASSERT(resource < m_graph.m_resources.size(), "Invalid frame graph resource");
+
+		auto& data = m_graph.m_resources[resource];
+		if (!data.writers.empty())
+			m_graph.m_passes[m_pass].reads.push_back(resource); // Keeps what the previous writers rendered
+
+		data.writers.push_back(m_pass);
+		m_graph.m_passes[m_pass].writes.push_back(resource);
+	}
+
+	RenderApi::TextureID FrameGraph::PassResources::GetTexture(Resource resource) const
+	{
+		auto& data = m_graph.m_resources[resource];
+		if (data.isImported)
+			return data.imported;
+
+		RE_ASSERT(data.pooled != SIZE_MAX, "{} is not used by this pass", data.name);
+		RE_ASSERT(data.desc.format != RenderApi::PixelFormat::Depth, "{} is a depth target, it can't be sampled", data.name);
+		return (*Internal::s_targetPool)[data.pooled].texture->GetId();
+	}
+
+	FrameGraph::Resource FrameGraph::CreateTarget(const std::string& name, const TargetDesc& desc)
+	{
+		m_resources.push_back({ name, desc });
+		return static_cast<Resource>(m_resources.size() - 1);
+	}
+
+	FrameGraph::Resource FrameGraph::ImportTexture(const std::string& name, const Texture& texture)
+	{
+		ResourceData data{ name, { texture.Size(), texture.GetFormat() } };
+		data.imported = texture.GetId();
+		data.isImported = true;
+
+		m_resources.push_back(std::move(data));
+		return static_cast<Resource>(m_resources.size() - 1);
+	}
+
+	void FrameGraph::AddPass(const std::string& name, const std::function<void(PassBuilder&)>& setup, std::function<void(const PassResources&)> execute)
+	{
+		m_passes.push_back({ name, std::move(execute) });
+
+		PassBuilder builder(*this, m_passes.size() - 1);
+		setup(builder);
+	}
+
+	void FrameGraph::Execute()
+	{
+		Cull();
+		AllocateTargets();
+
+		const auto oldRead = RenderApi::GetBoundReadFrameBuffer();
+		const auto oldDraw = RenderApi::GetBoundDrawFrameBuffer();
+		const auto oldViewportSize = RenderApi::GetViewportSize();
+
+		static NoDestroy<FrameBuffer> frameBuffer;
+		const PassResources resources(*this);
+
+		Timer recordTimer;
+		recordTimer.Start();
+		RenderApi::BeginRecording(*Internal::s_graphCommands);
+
+		for (auto& pass : m_passes)
+		{
+			if (!pass.alive)
+				continue;
+
+			// Attach the written targets, the framebuffer is shared by every pass
+			Resource color = InvalidResource;
+			Resource depth = InvalidResource;
+			for (auto resource : pass.writes)
+			{
+				Resource& attachment = m_resources[resource].desc.format == RenderApi::PixelFormat::Depth ? depth : color;
+				RE_ASSERT(attachment == InvalidResource || attachment == resource, "Pass {} writes more than one color or depth target", pass.name);
+				attachment = resource;
+			}
+
+			if (color != InvalidResource || depth != InvalidResource)
+			{
+				auto& pool = *Internal::s_targetPool;
+
+				if (color != InvalidResource)
+					RenderApi::BindFrameBufferTexture(frameBuffer->GetID(), resources.GetTexture(color), RenderApi::FrameBufferTextureType::Color);
+				else
+					RenderApi::BindFrameBufferTexture(frameBuffer->GetID(), RenderApi::InvalidTextureID, RenderApi::FrameBufferTextureType::Color);
+
+				if (depth != InvalidResource && m_resources[depth].isImported)
+					RenderApi::BindFrameBufferTexture(frameBuffer->GetID(), m_resources[depth].imported, RenderApi::FrameBufferTextureType::Depth);
+				else if (depth != InvalidResource)
+					frameBuffer->BindRenderBuffer(*pool[m_resources[depth].pooled].renderBuffer, RenderApi::FrameBufferTextureType::Depth);
+				else
+					frameBuffer->UnBindRenderBuffer(RenderApi::FrameBufferTextureType::Depth);
+
+				frameBuffer->Bind();
+				RenderApi::SetViewportSize(m_resources[color != InvalidResource ? color : depth].desc.size);
+			}
+
+			// The queries would not be replayed, so they would never get a result
+			if (RenderApi::RecordOnly)
+			{
+				pass.execute(resources);
+				Internal::s_frameGraphStats.passes++;
+				continue;
+			}
+
+			RenderApi::QueryID query = RenderApi::InvalidQueryID;
+			{
+				std::lock_guard lock(Internal::s_queryMutex);
+				if (!Internal::s_freeQueries.empty())
+				{
+					query = Internal::s_freeQueries.back();
+					Internal::s_freeQueries.pop_back();
+				}
+			}
+
+			if (query == RenderApi::InvalidQueryID)
+				query = RenderApi::MakeQuery();
+
+			RenderApi::BeginTimeQuery(query);
+			pass.execute(resources);
+			RenderApi::EndTimeQuery();
+
+			{
+				std::lock_guard lock(Internal::s_queryMutex);
+				Internal::s_pendingQueries.push_back({ pass.name, query, Internal::s_frame });
+			}
+			Internal::s_frameGraphStats.passes++;
+		}
+
+		RenderApi::BindFrameBufferRead(oldRead);
+		RenderApi::BindFrameBufferDraw(oldDraw);
+		RenderApi::SetViewportSize(oldViewportSize);
+
+		RenderApi::EndRecording();
+		recordTimer.Pause();
+
+		Internal::s_frameGraphStats.recordedCommands += Internal::s_graphCommands->CommandCount();
+		Internal::s_frameGraphStats.recordedBytes += Internal::s_graphCommands->Size();
+
+		// With a render thread, only the time to hand the stream over
+		Timer submitTimer;
+		submitTimer.Start();
+		RenderApi::Submit(*Internal::s_graphCommands);
+		submitTimer.Pause();
+
+		Internal::s_frameGraphStats.recordMilliseconds += recordTimer.ElapsedSeconds() * 1000.0;
+		Internal::s_frameGraphStats.submitMilliseconds += submitTimer.ElapsedSeconds() * 1000.0;
+
+		// The pooled targets can be used by the next graph
+		for (auto& resource : m_resources)
+		{
+			if (resource.pooled != SIZE_MAX)
+				(*Internal::s_targetPool)[resource.pooled].inUse = false;
+		}
+	}
+
+	FrameGraph::Stats FrameGraph::GetLastStats()
+	{
+		return Internal::s_lastFrameGraphStats;
+	}
+
+	std::vector<FrameGraph::PassTime> FrameGraph::GetLastPassTimes()
+	{
+		std::lock_guard lock(Internal::s_queryMutex);
+		return Internal::s_lastPassTimes;
+	}
+
+	void FrameGraph::ResolvePassTimes()
+	{
+		std::lock_guard lock(Internal::s_queryMutex);
+
+		// The GPU finishes the queries in order, stop at the first one not ready
+		auto& pending = Internal::s_pendingQueries;
+		while (!pending.empty() && RenderApi::IsQueryResultAvailable(pending.front().query))
+		{
+			auto& query = pending.front();
+
+			// Every query of the previous frame is done
+			if (query.frame != Internal::s_passTimesFrame)
+			{
+				std::swap(Internal::s_lastPassTimes, Internal::s_passTimes);
+				Internal::s_passTimes.clear();
+				Internal::s_passTimesFrame = query.frame;
+			}
+
+			const float milliseconds = RenderApi::GetQueryResult(query.query) / 1'000'000.0f;
+
+			auto& times = Internal::s_passTimes;
+			auto time = std::find_if(times.begin(), times.end(), [&query](const PassTime& time) { return time.name == query.name; });
+			if (time != times.end())
+				time->milliseconds += milliseconds;
+			else
+				times.push_back({ query.name, milliseconds });
+
+			Internal::s_freeQueries.push_back(query.query);
+			pending.pop_front();
+		}
+	}
+
+	void FrameGraph::Cull()
+	{
+		// The passes writing an imported target are the outputs of the graph
+		for (auto& pass : m_passes)
+		{
+			pass.alive = std::any_of(pass.writes.begin(), pass.writes.end(), [this](Resource resource) { return m_resources[resource].isImported; });
+		}
+
+		// From the last pass to the first, the last writer (before the pass) of each read target is needed
+		for (size_t i = m_passes.size(); i-- > 0;)
+		{
+			if (!m_passes[i].alive)
+				continue;
+
+			for (auto resource : m_passes[i].reads)
+			{
+				auto& writers = m_resources[resource].writers;
+				auto writer = std::lower_bound(writers.begin(), writers.end(), i);
+				if (writer != writers.begin())
+					m_passes[*std::prev(writer)].alive = true;
+			}
+		}
+
+		for (auto& pass : m_passes)
+		{
+			if (!pass.alive)
+				Internal::s_frameGraphStats.culledPasses++;
+		}
+	}
+
+	void FrameGraph::AllocateTargets()
+	{
+		// Lifetime of each transient target : the first and last alive pass using it
+		std::vector<size_t> first(m_resources.size(), SIZE_MAX);
+		std::vector<size_t> last(m_resources.size(), 0);
+		for (size_t i = 0; i < m_passes.size(); i++)
+		{
+			if (!m_passes[i].alive)
+				continue;
+
+			auto use = [&](Resource resource) {
+				first[resource] = std::min(first[resource], i);
+				last[resource] = std::max(last[resource], i);
+			};
+
+			std::for_each(m_passes[i].reads.begin(), m_passes[i].reads.end(), use);
+			std::for_each(m_passes[i].writes.begin(), m_passes[i].writes.end(), use);
+		}
+
+		// Acquire the targets when their lifetime starts, release them after their last pass
+		for (size_t i = 0; i < m_passes.size(); i++)
+		{
+			for (Resource resource = 0; resource < m_resources.size(); resource++)
+			{
+				if (first[resource] == i && !m_resources[resource].isImported)
+				{
+					m_resources[resource].pooled = Internal::AcquirePooledTarget(m_resources[resource].desc);
+					Internal::s_frameGraphStats.transientTargets++;
+				}
+			}
+
+			for (Resource resource = 0; resource < m_resources.size(); resource++)
+			{
+				if (last[resource] == i && first[resource] != SIZE_MAX && !m_resources[resource].isImported)
+					(*Internal::s_targetPool)[m_resources[resource].pooled].inUse = false;
+			}
+		}
+
+		// Execute() marks them as used until the end of the graph
+		for (auto& resource : m_resources)
+		{
+			if (resource.pooled != SIZE_MAX)
+				(*Internal::s_targetPool)[resource.pooled].inUse = true;
+		}
+	}
+
+	void FrameGraph::NextFrame()
+	{
+		// Reading a query result waits for the render thread, it reads them without blocking this one
+		RenderApi::PostToRenderThread(&FrameGraph::ResolvePassTimes);
+
+		auto& pool = *Internal::s_targetPool;
+		std::erase_if(pool, [](const Internal::PooledTarget& target) { return target.lastUsedFrame + Internal::MaxUnusedFrames < Internal::s_frame; });
+
+		Internal::s_frameGraphStats.pooledTargets = static_cast<uint32_t>(pool.size());
+		Internal::s_lastFrameGraphStats = Internal::s_frameGraphStats;
+		Internal::s_frameGraphStats = {};
+		Internal::s_frame++;
+	}
+}
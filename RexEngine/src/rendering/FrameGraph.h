@@ -0,0 +1,147 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <cstdint>
+
+#include "RenderApi.h"
+#include "Texture.h"
+#include "../math/Vectors.h"
+#include "../core/EngineEvents.h"
+#include "../utils/StaticConstructor.h"
+
+namespace RexEngine
+{
+	// Render passes declaring the targets they read and write, built every frame
+	// Execute() culls the passes whose results are never used, then runs the others in the order they were added
+	// The transient targets come from a pool shared by every graph, a pooled target is reused
+	// by the next transient with the same size and format once the last pass using it is done
+	class FrameGraph
+	{
+	public:
+		using Resource = uint32_t;
+		inline static constexpr Resource InvalidResource = UINT32_MAX;
+
+		// A transient Depth target is a render buffer, it can only be attached, the other formats are textures
+		// An imported Depth texture is attached as the depth of the passes writing it, and can be sampled by the passes reading it
+		struct TargetDesc
+		{
+			Vector2Int size;
+			RenderApi::PixelFormat format;
+
+			bool operator==(const TargetDesc& other) const { return size == other.size && format == other.format; }
+		};
+
+		class PassBuilder
+		{
+		public:
+			// The pass samples this target
+			void Read(Resource resource);
+
+			// The pass renders into this target, it is attached to the framebuffer of the pass (one color and one depth at most)
+			// The content written by the previous passes is kept, so they are dependencies of this pass
+			void Write(Resource resource);
+
+		private:
+			friend class FrameGraph;
+			PassBuilder(FrameGraph& graph, size_t pass) : m_graph(graph), m_pass(pass) {}
+
+			FrameGraph& m_graph;
+			size_t m_pass;
+		};
+
+		class PassResources
+		{
+		public:
+			RenderApi::TextureID GetTexture(Resource resource) const;
+			Vector2Int GetSize(Resource resource) const { return m_graph.m_resources[resource].desc.size; }
+
+		private:
+			friend class FrameGraph;
+			explicit PassResources(const FrameGraph& graph) : m_graph(graph) {}
+
+			const FrameGraph& m_graph;
+		};
+
+		struct Stats
+		{
+			uint32_t passes = 0; // Passes executed
+			uint32_t culledPasses = 0; // Passes skipped because nothing used their output
+			uint32_t transientTargets = 0; // Targets requested by the graphs
+			uint32_t pooledTargets = 0; // Targets allocated in the pool, the difference with transientTargets is the aliasing
+			size_t recordedCommands = 0; // Commands in the streams submitted at the end of the graphs
+			size_t recordedBytes = 0;
+			double recordMilliseconds = 0.0; // CPU time of the passes, recording included
+			double submitMilliseconds = 0.0; // CPU time to replay the streams
+		};
+
+		// GPU time of the passes with this name, summed over the graphs of a frame
+		struct PassTime
+		{
+			std::string name;
+			float milliseconds;
+		};
+
+		FrameGraph() = default;
+		FrameGraph(const FrameGraph&) = delete;
+
+		// Target allocated from the pool for the duration of the passes using it
+		Resource CreateTarget(const std::string& name, const TargetDesc& desc);
+
+		// Target owned outside of the graph, the passes writing it are never culled
+		Resource ImportTexture(const std::string& name, const Texture& texture);
+
+		// setup is called right away to declare the reads and writes, execute is called by Execute() if the pass is not culled
+		void AddPass(const std::string& name, const std::function<void(PassBuilder&)>& setup, std::function<void(const PassResources&)> execute);
+
+		// Restores the bound framebuffer and the viewport after the passes
+		// The passes are recorded in a CommandStream submitted once they are all done (see RenderApi::BeginRecording())
+		// Each pass is timed on the GPU, so a pass can't execute another graph
+		void Execute();
+
+		// Stats of the graphs executed last frame
+		static Stats GetLastStats();
+
+		// The GPU times are read a few frames after the passes were executed, in the order of the first execution
+		static std::vector<PassTime> GetLastPassTimes();
+
+	private:
+		struct ResourceData
+		{
+			std::string name;
+			TargetDesc desc;
+			RenderApi::TextureID imported = RenderApi::InvalidTextureID; // Only for the imported textures
+			bool isImported = false;
+
+			std::vector<size_t> writers; // Passes, in the order they were added
+			size_t pooled = SIZE_MAX; // Index in the pool while the resource is alive
+		};
+
+		struct PassData
+		{
+			std::string name;
+			std::function<void(const PassResources&)> execute;
+			std::vector<Resource> reads; // Includes the targets written by an earlier pass
+			std::vector<Resource> writes;
+			bool alive = false;
+		};
+
+		void Cull();
+
+		// Fills the pool index of the transient resources of the alive passes, and reuses the pool entries between them
+		void AllocateTargets();
+
+		// Reads the time queries that are ready, on the render thread if it runs
+		static void ResolvePassTimes();
+		static void NextFrame();
+
+		RE_STATIC_CONSTRUCTOR({
+			EngineEvents::OnPreUpdate().Register<&FrameGraph::NextFrame>();
+		});
+
+	private:
+		std::vector<ResourceData> m_resources;
+		std::vector<PassData> m_passes;
+	};
+}
@@ -0,0 +1,332 @@
+#include <REPch.h>
+#include "GeometryPool.h"
+
+namespace RexEngine
+{
+	namespace
+	{
+		constexpr size_t MinVertexCapacity = 64 * 1024; // Per layout, in vertices
+		constexpr size_t MinIndexCapacity = 256 * 1024; // Per index type
+
+		// New buffer of newSize bytes, with the content of the old one
+		RenderApi::BufferID GrowBuffer(RenderApi::BufferID buffer, RenderApi::BufferType type, size_t oldSize, size_t newSize)
+		{
+			const auto grown = RenderApi::MakeBuffer();
+			RenderApi::SetBufferData(grown, type, RenderApi::BufferMode::Static, nullptr, newSize);
+
+			if (buffer != RenderApi::InvalidBufferID)
+			{
+				if (oldSize > 0)
+					RenderApi::CopyBufferData(buffer, grown, 0, 0, oldSize);
+				RenderApi::DeleteBuffer(buffer);
+			}
+
+			return grown;
+		}
+	}
+
+	GeometryPool::AllocationID GeometryPool::Allocate(const Layout& layout, RenderApi::IndexType indexType, std::span<const uint8_t> vertexData, std::span<const unsigned int> indices)
+	{
+		AllocationID id;
+		if (s_freeIDs.empty())
+		{
+			id = static_cast<AllocationID>(s_allocations.size());
+			s_allocations.emplace_back();
+			s_alive.push_back(true);
+		}
+		else
+		{
+			id = s_freeIDs.back();
+			s_freeIDs.pop_back();
+			s_alive[id] = true;
+		}
+
+		auto& allocation = s_allocations[id];
+		allocation.layout = FindLayout(layout, indexType);
+		allocation.indexType = indexType;
+
+		auto& layoutData = s_layouts[allocation.layout];
+		RE_ASSERT(vertexData.size() % layoutData.stride == 0, "The vertex data doesn't match the layout");
+
+		// The indices first, the vertex attributes of a new layout need the index buffer
+		AllocateIndices(allocation, indices.size());
+		AllocateVertices(allocation, vertexData.size() / layoutData.stride);
+
+		if (!vertexData.empty())
+			RenderApi::SubBufferData(layoutData.buffer, RenderApi::BufferType::Vertex, allocation.firstVertex * layoutData.stride, vertexData.size(), vertexData.data());
+		UploadIndices(allocation, indices);
+
+		return id;
+	}
+
+	void GeometryPool::SetIndices(AllocationID id, std::span<const unsigned int> indices)
+	{
+		auto& allocation = s_allocations[id];
+		auto& allocator = s_indexBuffers[(int)allocation.indexType].allocator;
+
+		if (indices.size() <= allocation.indexCount)
+		{ // Fits, give back the end of the range
+			allocator.Free(allocation.firstIndex + indices.size(), allocation.indexCount - indices.size());
+			allocation.indexCount = indices.size();
+		}
+		else
+		{
+			allocator.Free(allocation.firstIndex, allocation.indexCount);
+			AllocateIndices(allocation, indices.size());
+		}
+
+		UploadIndices(allocation, indices);
+	}
+
+	void GeometryPool::Free(AllocationID id)
+	{
+		// The pool is cleared when the engine stops, before the last meshes are deleted
+		if (id >= s_allocations.size() || !s_alive[id])
+			return;
+
+		auto& allocation = s_allocations[id];
+		s_layouts[allocation.layout].allocator.Free(allocation.firstVertex, allocation.vertexCount);
+		s_indexBuffers[(int)allocation.indexType].allocator.Free(allocation.firstIndex, allocation.indexCount);
+
+		allocation = {};
+		s_alive[id] = false;
+		s_freeIDs.push_back(id);
+	}
+
+	void GeometryPool::Bind(AllocationID id)
+	{
+		RenderApi::BindVertexAttributes(s_layouts[s_allocations[id].layout].vertexAttributes);
+	}
+
+	void GeometryPool::Compact()
+	{
+		// Live allocations in the order of their ranges, the moves keep that order
+		std::vector<AllocationID> live;
+		for (AllocationID id = 0; id < s_allocations.size(); id++)
+		{
+			if (s_alive[id])
+				live.push_back(id);
+		}
+
+		// The buffers whose free space is already a single range are kept, with their vertex attributes
+		std::vector<bool> movedVertices(s_layouts.size(), false);
+		std::array<bool, 2> movedIndices = { false, false };
+
+		for (uint32_t layoutIndex = 0; layoutIndex < s_layouts.size(); layoutIndex++)
+		{
+			auto& layout = s_layouts[layoutIndex];
+			if (layout.buffer == RenderApi::InvalidBufferID || layout.allocator.Fragmentation() == 0.0f)
+				continue;
+
+			std::sort(live.begin(), live.end(), [](AllocationID a, AllocationID b) { return s_allocations[a].firstVertex < s_allocations[b].firstVertex; });
+
+			const auto buffer = RenderApi::MakeBuffer();
+			RenderApi::SetBufferData(buffer, RenderApi::BufferType::Vertex, RenderApi::BufferMode::Static, nullptr, layout.allocator.Capacity() * layout.stride);
+
+			// A single free range, so the ranges are allocated one after the other
+			layout.allocator.Reset();
+			for (auto id : live)
+			{
+				auto& allocation = s_allocations[id];
+				if (allocation.layout != layoutIndex)
+					continue;
+
+				const size_t firstVertex = *layout.allocator.Allocate(allocation.vertexCount);
+				RenderApi::CopyBufferData(layout.buffer, buffer, allocation.firstVertex * layout.stride, firstVertex * layout.stride, allocation.vertexCount * layout.stride);
+				allocation.firstVertex = firstVertex;
+			}
+
+			RenderApi::DeleteBuffer(layout.buffer);
+			layout.buffer = buffer;
+			movedVertices[layoutIndex] = true;
+		}
+
+		std::sort(live.begin(), live.end(), [](AllocationID a, AllocationID b) { return s_allocations[a].firstIndex < s_allocations[b].firstIndex; });
+
+		for (int type = 0; type < (int)s_indexBuffers.size(); type++)
+		{
+			auto& indexBuffer = s_indexBuffers[type];
+			if (indexBuffer.buffer == RenderApi::InvalidBufferID || indexBuffer.allocator.Fragmentation() == 0.0f)
+				continue;
+
+			const size_t indexSize = RenderApi::GetIndexSize((RenderApi::IndexType)type);
+			const auto buffer = RenderApi::MakeBuffer();
+			RenderApi::SetBufferData(buffer, RenderApi::BufferType::Indice, RenderApi::BufferMode::Static, nullptr, indexBuffer.allocator.Capacity() * indexSize);
+
+			indexBuffer.allocator.Reset();
+			for (auto id : live)
+			{
+				auto& allocation = s_allocations[id];
+				if ((int)allocation.indexType != type)
+					continue;
+
+				const size_t firstIndex = *indexBuffer.allocator.Allocate(allocation.indexCount);
+				RenderApi::CopyBufferData(indexBuffer.buffer, buffer, allocation.firstIndex * indexSize, firstIndex * indexSize, allocation.indexCount * indexSize);
+				allocation.firstIndex = firstIndex;
+			}
+
+			RenderApi::DeleteBuffer(indexBuffer.buffer);
+			indexBuffer.buffer = buffer;
+			movedIndices[type] = true;
+		}
+
+		// The vertex attributes objects referencing a moved buffer, the layouts without vertices have none yet
+		for (uint32_t layoutIndex = 0; layoutIndex < s_layouts.size(); layoutIndex++)
+		{
+			auto& layout = s_layouts[layoutIndex];
+			if (layout.buffer != RenderApi::InvalidBufferID && (movedVertices[layoutIndex] || movedIndices[(int)layout.indexType]))
+				MakeVertexAttributes(layout);
+		}
+
+		s_compactions++;
+	}
+
+	GeometryPool::Stats GeometryPool::GetStats()
+	{
+		Stats stats = {};
+
+		for (auto& layout : s_layouts)
+		{
+			stats.vertexBytes += layout.allocator.Capacity() * layout.stride;
+			stats.vertexBytesUsed += layout.allocator.UsedSize() * layout.stride;
+			stats.freeRanges += layout.allocator.FreeRangeCount();
+			stats.fragmentation = std::max(stats.fragmentation, layout.allocator.Fragmentation());
+		}
+
+		for (int type = 0; type < (int)s_indexBuffers.size(); type++)
+		{
+			auto& allocator = s_indexBuffers[type].allocator;
+			const size_t indexSize = RenderApi::GetIndexSize((RenderApi::IndexType)type);
+
+			stats.indexBytes += allocator.Capacity() * indexSize;
+			stats.indexBytesUsed += allocator.UsedSize() * indexSize;
+			stats.freeRanges += allocator.FreeRangeCount();
+			stats.fragmentation = std::max(stats.fragmentation, allocator.Fragmentation());
+		}
+
+		stats.allocations = static_cast<uint32_t>(s_allocations.size() - s_freeIDs.size());
+		stats.layouts = static_cast<uint32_t>(s_layouts.size());
+		stats.compactions = s_compactions;
+		return stats;
+	}
+
+	uint32_t GeometryPool::FindLayout(const Layout& layout, RenderApi::IndexType indexType)
+	{
+		for (uint32_t i = 0; i < s_layouts.size(); i++)
+		{
+			if (s_layouts[i].attributes == layout && s_layouts[i].indexType == indexType)
+				return i;
+		}
+
+		size_t stride = 0;
+		for (auto& [type, location] : layout)
+			stride += RenderApi::GetVertexAttributeSize(type);
+
+		s_layouts.push_back({ layout, indexType, stride, RenderApi::InvalidBufferID, 0, RangeAllocator() });
+		return static_cast<uint32_t>(s_layouts.size() - 1);
+	}
+
+	void GeometryPool::AllocateVertices(Allocation& allocation, size_t count)
+	{
+		auto& layout = s_layouts[allocation.layout];
+
+		auto firstVertex = layout.allocator.Allocate(count);
+		if (!firstVertex)
+		{
+			const size_t capacity = std::max({ MinVertexCapacity, layout.allocator.Capacity() * 2, layout.allocator.Capacity() + count });
+			layout.buffer = GrowBuffer(layout.buffer, RenderApi::BufferType::Vertex, layout.allocator.Capacity() * layout.stride, capacity * layout.stride);
+			layout.allocator.Grow(capacity);
+			MakeVertexAttributes(layout);
+
+			firstVertex = layout.allocator.Allocate(count);
+		}
+
+		allocation.firstVertex = *firstVertex;
+		allocation.vertexCount = count;
+	}
+
+	void GeometryPool::AllocateIndices(Allocation& allocation, size_t count)
+	{
+		auto& indexBuffer = s_indexBuffers[(int)allocation.indexType];
+
+		auto firstIndex = indexBuffer.allocator.Allocate(count);
+		if (!firstIndex)
+		{
+			const size_t indexSize = RenderApi::GetIndexSize(allocation.indexType);
+			const size_t capacity = std::max({ MinIndexCapacity, indexBuffer.allocator.Capacity() * 2, indexBuffer.allocator.Capacity() + count });
+			indexBuffer.buffer = GrowBuffer(indexBuffer.buffer, RenderApi::BufferType::Indice, indexBuffer.allocator.Capacity() * indexSize, capacity * indexSize);
+			indexBuffer.allocator.Grow(capacity);
+
+			// The index buffer is part of the vertex attributes of the layouts
+			for (auto& layout : s_layouts)
+			{
+				if (layout.buffer != RenderApi::InvalidBufferID && layout.indexType == allocation.indexType)
+					MakeVertexAttributes(layout);
+			}
+
+			firstIndex = indexBuffer.allocator.Allocate(count);
+		}
+
+		allocation.firstIndex = *firstIndex;
+		allocation.indexCount = count;
+	}
+
+	void GeometryPool::UploadIndices(const Allocation& allocation, std::span<const unsigned int> indices)
+	{
+		if (indices.empty())
+			return;
+
+		const auto buffer = s_indexBuffers[(int)allocation.indexType].buffer;
+		if (allocation.indexType == RenderApi::IndexType::UInt32)
+		{
+			RenderApi::SubBufferData(buffer, RenderApi::BufferType::Indice, allocation.firstIndex * sizeof(uint32_t), indices.size_bytes(), indices.data());
+			return;
+		}
+
+		static std::vector<uint16_t> shortIndices;
+		shortIndices.assign(indices.begin(), indices.end());
+		RenderApi::SubBufferData(buffer, RenderApi::BufferType::Indice, allocation.firstIndex * sizeof(uint16_t), shortIndices.size() * sizeof(uint16_t), shortIndices.data());
+	}
+
+	void GeometryPool::MakeVertexAttributes(LayoutData& layout)
+	{
+		if (layout.vertexAttributes != 0)
+			RenderApi::DeleteVertexAttributes(layout.vertexAttributes);
+
+		layout.vertexAttributes = RenderApi::MakeVertexAttributes(std::span(layout.attributes), layout.buffer, s_indexBuffers[(int)layout.indexType].buffer);
+	}
+
+	void GeometryPool::NextFrame()
+	{
+		// Between two frames, nothing is recorded and no draw uses the old ranges anymore
+		float fragmentation = 0.0f;
+		for (auto& layout : s_layouts)
+			fragmentation = std::max(fragmentation, layout.allocator.Fragmentation());
+		for (auto& indexBuffer : s_indexBuffers)
+			fragmentation = std::max(fragmentation, indexBuffer.allocator.Fragmentation());
+
+		if (fragmentation > AutoCompactFragmentation)
+			Compact();
+	}
+
+	void GeometryPool::OnClose()
+	{
+		for (auto& layout : s_layouts)
+		{
+			RenderApi::DeleteVertexAttributes(layout.vertexAttributes);
+			RenderApi::DeleteBuffer(layout.buffer);
+		}
+
+		for (auto& indexBuffer : s_indexBuffers)
+		{
+			if (indexBuffer.buffer != RenderApi::InvalidBufferID)
+				RenderApi::DeleteBuffer(indexBuffer.buffer);
+			indexBuffer = { RenderApi::InvalidBufferID, RangeAllocator() };
+		}
+
+		s_layouts.clear();
+		s_allocations.clear();
+		s_alive.clear();
+		s_freeIDs.clear();
+	}
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <tuple>
+#include <span>
+#include <cstdint>
+
+#include "RenderApi.h"
+#include "../utils/RangeAllocator.h"
+#include "../core/EngineEvents.h"
+#include "../utils/StaticConstructor.h"
+
+namespace RexEngine
+{
+	// Vertex and index data of the meshes, suballocated in a few large buffers
+	// One vertex buffer and one vertex attributes object per vertex layout, one index buffer per index type shared by the layouts
+	// The meshes of a layout share the same vertex attributes : drawing another mesh doesn't rebind them,
+	// and the draws of different meshes can be merged in a single RenderApi::MultiDrawElementsIndirect()
+	// The indices are relative to the first vertex of their allocation (the baseVertex of the draws)
+	class GeometryPool
+	{
+	public:
+		using Layout = std::vector<std::tuple<RenderApi::VertexAttributeType, int>>; // <type, location>, see RenderApi::MakeVertexAttributes
+		using AllocationID = uint32_t;
+		inline static constexpr AllocationID InvalidAllocation = UINT32_MAX;
+
+		struct Allocation
+		{
+			uint32_t layout; // Index of the vertex layout
+			RenderApi::IndexType indexType; // Part of the layout, the vertex attributes reference the index buffer
+			size_t firstVertex; // In the vertex buffer of the layout
+			size_t vertexCount;
+			size_t firstIndex; // In the index buffer of the index type
+			size_t indexCount;
+		};
+
+		struct Stats
+		{
+			size_t vertexBytes; // Capacity of the vertex buffers
+			size_t vertexBytesUsed;
+			size_t indexBytes; // Capacity of the index buffers
+			size_t indexBytesUsed;
+			size_t freeRanges; // In every buffer
+			float fragmentation; // Worst of the buffers, see RangeAllocator::Fragmentation()
+			uint32_t allocations;
+			uint32_t layouts;
+			uint32_t compactions; // Since the start
+		};
+
+		// vertexData is interleaved following the layout, the indices are stored with indexType
+		static AllocationID Allocate(const Layout& layout, RenderApi::IndexType indexType, std::span<const uint8_t> vertexData, std::span<const unsigned int> indices);
+		// Replaces the indices of the allocation, the range moves if the new indices don't fit in it
+		static void SetIndices(AllocationID id, std::span<const unsigned int> indices);
+		static void Free(AllocationID id);
+
+		// The ranges move when the pool is compacted, don't keep them over a frame
+		static const Allocation& Get(AllocationID id) { return s_allocations[id]; }
+
+		// Binds the vertex attributes of the layout of the allocation
+		static void Bind(AllocationID id);
+
+		// Moves the allocations to the start of their buffers, so the free space is a single range at the end
+		// The buffers without fragmentation are not copied
+		// The data is copied on the GPU into new buffers, called at the start of a frame when the fragmentation is over AutoCompactFragmentation
+		static void Compact();
+		inline static float AutoCompactFragmentation = 0.5f;
+
+		static Stats GetStats();
+
+	private:
+		struct LayoutData
+		{
+			Layout attributes;
+			RenderApi::IndexType indexType;
+			size_t stride; // In bytes
+			RenderApi::BufferID buffer;
+			RenderApi::VertexAttribID vertexAttributes;
+			RangeAllocator allocator; // In vertices
+		};
+
+		struct IndexBufferData
+		{
+			RenderApi::BufferID buffer;
+			RangeAllocator allocator; // In indices
+		};
+
+		static uint32_t FindLayout(const Layout& layout, RenderApi::IndexType indexType);
+		static void AllocateVertices(Allocation& allocation, size_t count);
+		static void AllocateIndices(Allocation& allocation, size_t count);
+		static void UploadIndices(const Allocation& allocation, std::span<const unsigned int> indices);
+		static void MakeVertexAttributes(LayoutData& layout);
+
+		static void NextFrame();
+		static void OnClose();
+
+		RE_STATIC_CONSTRUCTOR({
+			EngineEvents::OnPreUpdate().Register<&GeometryPool::NextFrame>();
+			EngineEvents::OnEngineStop().Register<&GeometryPool::OnClose>();
+		});
+
+	private:
+		inline static std::vector<LayoutData> s_layouts;
+		inline static std::vector<Allocation> s_allocations;
+		inline static std::vector<bool> s_alive; // Of each allocation
+		inline static std::vector<AllocationID> s_freeIDs;
+
+		inline static std::array<IndexBufferData, 2> s_indexBuffers{}; // By RenderApi::IndexType
+
+		inline static uint32_t s_compactions = 0;
+	};
+}
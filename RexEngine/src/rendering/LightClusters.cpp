@@ -0,0 +1,238 @@
+#include "REPch.h"
+#include "LightClusters.h"
+
+#include <numeric>
+#include <execution>
+
+namespace RexEngine
+{
+	namespace
+	{
+		Vector3 TransformPoint(const Matrix4& matrix, const Vector3& p, float w)
+		{
+			return Vector3(
+				matrix[0][0] * p.x + matrix[1][0] * p.y + matrix[2][0] * p.z + matrix[3][0] * w,
+				matrix[0][1] * p.x + matrix[1][1] * p.y + matrix[2][1] * p.z + matrix[3][1] * w,
+				matrix[0][2] * p.x + matrix[1][2] * p.y + matrix[2][2] * p.z + matrix[3][2] * w);
+		}
+
+		float Dot(const Vector3& a, const Vector3& b)
+		{
+			return a.x * b.x + a.y * b.y + a.z * b.z;
+		}
+	}
+
+	void LightClusters::Build(const Matrix4& viewMatrix, float fov, float aspect, float zNear, float zFar,
+		std::span<const PointLight> pointLights, std::span<const SpotLight> spotLights, uint32_t pointIndexOffset)
+	{
+		UpdateGrid(fov, aspect, zNear, zFar);
+
+		// Move the lights to view space, and find the clusters they might touch
+		m_pointLights.clear();
+		for (uint32_t i = 0; i < pointLights.size(); i++)
+		{
+			ViewLight light{};
+			light.position = TransformPoint(viewMatrix, pointLights[i].position, 1.0f);
+			light.range = pointLights[i].range;
+			light.index = pointIndexOffset + i;
+
+			const Vector3 extents(light.range, light.range, light.range);
+			if (ComputeClusterRange(light, { light.position - extents, light.position + extents }))
+				m_pointLights.push_back(light);
+		}
+
+		m_spotLights.clear();
+		for (uint32_t i = 0; i < spotLights.size(); i++)
+		{
+			const auto& spot = spotLights[i];
+
+			ViewLight light{};
+			light.position = TransformPoint(viewMatrix, spot.position, 1.0f);
+			light.direction = TransformPoint(viewMatrix, spot.direction, 0.0f).Normalized();
+			light.range = spot.range;
+			light.cosAngle = std::cos(spot.outerAngle);
+			light.sinAngle = std::sin(spot.outerAngle);
+			light.index = i;
+
+			// Bounding sphere of the cone
+			Vector3 center = light.position;
+			float radius = light.range;
+			if (light.cosAngle >= 0.70710678f) // Under 45 degrees
+			{
+				radius = light.range / (2.0f * light.cosAngle);
+				center = Vector3(light.position + light.direction * radius);
+			}
+			else if (light.cosAngle > 0.0f)
+			{
+				radius = light.range * light.sinAngle;
+				center = Vector3(light.position + light.direction * (light.range * light.cosAngle));
+			}
+
+			const Vector3 extents(radius, radius, radius);
+			if (ComputeClusterRange(light, { center - extents, center + extents }))
+				m_spotLights.push_back(light);
+		}
+
+		// The slices don't share any cluster, so they are filled in parallel
+		std::vector<uint32_t> slices(Slices);
+		std::iota(slices.begin(), slices.end(), 0);
+		std::for_each(std::execution::par, slices.begin(), slices.end(), [this](uint32_t slice) { AssignSlice(slice); });
+
+		// Compact the lists
+		m_indices.clear();
+		for (uint32_t cluster = 0; cluster < ClusterCount; cluster++)
+		{
+			const uint32_t pointCount = m_pointCounts[cluster];
+			const uint32_t spotCount = m_spotCounts[cluster];
+
+			m_clusters[cluster] = { static_cast<uint32_t>(m_indices.size()), pointCount | (spotCount << 16) };
+
+			const uint32_t* lights = &m_grid[(size_t)cluster * MaxLightsPerCluster];
+			m_indices.insert(m_indices.end(), lights, lights + pointCount + spotCount);
+		}
+	}
+
+	void LightClusters::UpdateGrid(float fov, float aspect, float zNear, float zFar)
+	{
+		if (fov == m_fov && aspect == m_aspect && zNear == m_zNear && zFar == m_zFar)
+			return;
+
+		m_fov = fov;
+		m_aspect = aspect;
+		m_zNear = zNear;
+		m_zFar = zFar;
+
+		m_tanY = std::tan(glm::radians(fov) * 0.5f);
+		m_tanX = m_tanY * aspect;
+
+		const float logRatio = std::log(zFar / zNear);
+		m_sliceScale = Slices / logRatio;
+		m_sliceBias = Slices * std::log(zNear) / logRatio;
+
+		m_bounds.resize(ClusterCount);
+		m_grid.resize((size_t)ClusterCount * MaxLightsPerCluster);
+		m_pointCounts.resize(ClusterCount);
+		m_spotCounts.resize(ClusterCount);
+		m_clusters.resize(ClusterCount);
+
+		// View space box around the 8 corners of each cluster
+		for (uint32_t z = 0; z < Slices; z++)
+		{
+			const float depths[2] = {
+				zNear * std::pow(zFar / zNear, (float)z / Slices),
+				zNear * std::pow(zFar / zNear, (float)(z + 1) / Slices) };
+
+			for (uint32_t y = 0; y < TilesY; y++)
+			{
+				const float ndcY[2] = { -1.0f + 2.0f * y / TilesY, -1.0f + 2.0f * (y + 1) / TilesY };
+
+				for (uint32_t x = 0; x < TilesX; x++)
+				{
+					const float ndcX[2] = { -1.0f + 2.0f * x / TilesX, -1.0f + 2.0f * (x + 1) / TilesX };
+
+					Vector3 corners[8];
+					for (int i = 0; i < 8; i++)
+					{
+						const float depth = depths[(i >> 2) & 1];
+						corners[i] = Vector3(ndcX[i & 1] * m_tanX * depth, ndcY[(i >> 1) & 1] * m_tanY * depth, depth);
+					}
+
+					m_bounds[x + TilesX * (y + TilesY * z)] = BoundingBox::FromPoints(corners);
+				}
+			}
+		}
+	}
+
+	bool LightClusters::ComputeClusterRange(ViewLight& light, const BoundingBox& bounds) const
+	{
+		if (bounds.max.z < m_zNear || bounds.min.z > m_zFar)
+			return false;
+
+		const float minDepth = std::max(bounds.min.z, m_zNear);
+		const float maxDepth = std::min(bounds.max.z, m_zFar);
+
+		// Screen rectangle of the box, all its corners are in front of the camera once clamped to the near plane
+		float minX = std::numeric_limits<float>::max(), maxX = -std::numeric_limits<float>::max();
+		float minY = std::numeric_limits<float>::max(), maxY = -std::numeric_limits<float>::max();
+		for (int i = 0; i < 8; i++)
+		{
+			const float depth = (i & 4) ? maxDepth : minDepth;
+			const float x = ((i & 1) ? bounds.max.x : bounds.min.x) / (depth * m_tanX);
+			const float y = ((i & 2) ? bounds.max.y : bounds.min.y) / (depth * m_tanY);
+			minX = std::min(minX, x); maxX = std::max(maxX, x);
+			minY = std::min(minY, y); maxY = std::max(maxY, y);
+		}
+
+		if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f)
+			return false;
+
+		auto toTile = [](float ndc, uint32_t tiles) {
+			return std::clamp((int)std::floor((ndc * 0.5f + 0.5f) * tiles), 0, (int)tiles - 1);
+		};
+
+		auto toSlice = [this](float depth) {
+			return std::clamp((int)std::floor(std::log(depth) * m_sliceScale - m_sliceBias), 0, (int)Slices - 1);
+		};
+
+		light.minX = toTile(minX, TilesX); light.maxX = toTile(maxX, TilesX);
+		light.minY = toTile(minY, TilesY); light.maxY = toTile(maxY, TilesY);
+		light.minZ = toSlice(minDepth); light.maxZ = toSlice(maxDepth);
+		return true;
+	}
+
+	void LightClusters::AssignSlice(uint32_t slice)
+	{
+		const uint32_t first = TilesX * TilesY * slice;
+		std::fill(m_pointCounts.begin() + first, m_pointCounts.begin() + first + TilesX * TilesY, 0);
+		std::fill(m_spotCounts.begin() + first, m_spotCounts.begin() + first + TilesX * TilesY, 0);
+
+		for (auto& light : m_pointLights)
+		{
+			if ((int)slice < light.minZ || (int)slice > light.maxZ)
+				continue;
+
+			const BoundingSphere sphere{ light.position, light.range };
+			for (int y = light.minY; y <= light.maxY; y++)
+			{
+				for (int x = light.minX; x <= light.maxX; x++)
+				{
+					const uint32_t cluster = first + x + TilesX * y;
+					uint32_t& count = m_pointCounts[cluster];
+					if (count < MaxLightsPerCluster && sphere.Intersects(m_bounds[cluster]))
+						m_grid[(size_t)cluster * MaxLightsPerCluster + count++] = light.index;
+				}
+			}
+		}
+
+		for (auto& light : m_spotLights)
+		{
+			if ((int)slice < light.minZ || (int)slice > light.maxZ)
+				continue;
+
+			for (int y = light.minY; y <= light.maxY; y++)
+			{
+				for (int x = light.minX; x <= light.maxX; x++)
+				{
+					const uint32_t cluster = first + x + TilesX * y;
+					const uint32_t pointCount = m_pointCounts[cluster];
+					uint32_t& count = m_spotCounts[cluster];
+					if (pointCount + count >= MaxLightsPerCluster)
+						continue;
+
+					// Cone against the bounding sphere of the cluster
+					const BoundingBox& bounds = m_bounds[cluster];
+					const float radius = bounds.Extents().Magnitude();
+					const Vector3 toCluster = Vector3(bounds.Center() - light.position);
+					const float sqrDistance = Dot(toCluster, toCluster);
+					const float alongAxis = Dot(toCluster, light.direction);
+					const float distanceToCone = light.cosAngle * std::sqrt(std::max(sqrDistance - alongAxis * alongAxis, 0.0f)) - alongAxis * light.sinAngle;
+
+					if (distanceToCone > radius || alongAxis > radius + light.range || alongAxis < -radius)
+						continue;
+
+					m_grid[(size_t)cluster * MaxLightsPerCluster + pointCount + count++] = light.index;
+				}
+			}
+		}
+	}
+}
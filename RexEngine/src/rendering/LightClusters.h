@@ -0,0 +1,97 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include <cstdint>
+
+#include "../math/Vectors.h"
+#include "../math/Matrix.h"
+#include "../math/Bounds.h"
+
+namespace RexEngine
+{
+	// Assigns the point and spot lights to the cells of a froxel grid (screen tiles x depth slices)
+	// The slices are distributed logarithmically between the near and far planes
+	// Each fragment then only loops the lights of its cluster, see the Lighting shader using
+	class LightClusters
+	{
+	public:
+		inline static constexpr uint32_t TilesX = 16;
+		inline static constexpr uint32_t TilesY = 9;
+		inline static constexpr uint32_t Slices = 24;
+		inline static constexpr uint32_t ClusterCount = TilesX * TilesY * Slices;
+		inline static constexpr uint32_t MaxLightsPerCluster = 128; // The extra lights are ignored
+
+		struct PointLight
+		{
+			Vector3 position; // World space
+			float range;
+		};
+
+		struct SpotLight
+		{
+			Vector3 position; // World space
+			float range;
+			Vector3 direction;
+			float outerAngle; // Radians, from the direction to the edge of the cone
+		};
+
+		// As read by the shaders : the lights of the cluster are indices[offset, offset + pointCount + spotCount)
+		// The point lights are first, counts = pointCount | spotCount << 16
+		struct Cluster
+		{
+			uint32_t offset;
+			uint32_t counts;
+		};
+
+		// pointIndexOffset is added to the indices of the point lights (to skip the directional lights in the shader array)
+		void Build(const Matrix4& viewMatrix, float fov, float aspect, float zNear, float zFar,
+			std::span<const PointLight> pointLights, std::span<const SpotLight> spotLights, uint32_t pointIndexOffset = 0);
+
+		std::span<const Cluster> GetClusters() const { return m_clusters; }
+		std::span<const uint32_t> GetIndices() const { return m_indices; }
+
+		// slice = log(viewDepth) * SliceScale() - SliceBias()
+		float SliceScale() const { return m_sliceScale; }
+		float SliceBias() const { return m_sliceBias; }
+
+	private:
+		// View space light, z is the distance along the camera forward axis
+		struct ViewLight
+		{
+			Vector3 position;
+			float range;
+			Vector3 direction;
+			float cosAngle;
+			float sinAngle;
+			uint32_t index;
+			int minX, maxX, minY, maxY, minZ, maxZ; // Clusters touched by the bounds of the light
+		};
+
+		void UpdateGrid(float fov, float aspect, float zNear, float zFar);
+		bool ComputeClusterRange(ViewLight& light, const BoundingBox& bounds) const;
+		void AssignSlice(uint32_t slice);
+
+	private:
+		// Grid parameters, the cluster bounds are only recomputed when they change
+		float m_fov = 0.0f;
+		float m_aspect = 0.0f;
+		float m_zNear = 0.0f;
+		float m_zFar = 0.0f;
+		float m_tanX = 0.0f;
+		float m_tanY = 0.0f;
+		float m_sliceScale = 0.0f;
+		float m_sliceBias = 0.0f;
+
+		std::vector<BoundingBox> m_bounds; // View space bounds of the clusters
+		std::vector<ViewLight> m_pointLights;
+		std::vector<ViewLight> m_spotLights;
+
+		std::vector<uint32_t> m_grid; // MaxLightsPerCluster lights for each cluster, before compaction
+		std::vector<uint32_t> m_pointCounts;
+		std::vector<uint32_t> m_spotCounts;
+
+		std::vector<Cluster> m_clusters;
+		std::vector<uint32_t> m_indices;
+	};
+}
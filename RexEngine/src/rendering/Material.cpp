@@ -8,10 +8,17 @@
 namespace RexEngine
 {
 	Material::Material(Asset<Shader> shader)
+		: m_sortId(s_nextSortId++)
 	{
 		SetShader(shader);
 	}
 
+	Material::~Material()
+	{
+		if (m_blockBuffer != RenderApi::InvalidBufferID)
+			RenderApi::DeleteBuffer(m_blockBuffer);
+	}
+
 	void Material::Bind()
 	{
 		if (!m_shader)
@@ -21,40 +28,51 @@ namespace RexEngine
 		}
 
 		m_shader->Bind();
-		TextureManager::StartShader();
-		// Set the uniforms
-		for (auto& [name, value] : m_uniforms)
+
+		// New entries in m_uniforms are not in the layout yet
+		if (m_layoutShaderId != m_shader->GetUniqueId() || m_layoutUniformCount != m_uniforms.size())
+			UpdateLayout();
+
+		if (m_blockBuffer != RenderApi::InvalidBufferID)
 		{
-			if (!m_shader->HasUniform(name) || m_shader->GetUniformType(name) != (RenderApi::UniformType)value.index())
-				continue; // Some uniforms might be invalid if the shader changed, discard them
+			// The texture of an asset changes when it is reloaded, so the handles are checked on every bind
+			if (m_blockDirty || m_blockHasSamplers)
+				UpdateBlock();
 
+			RenderApi::BindBufferBase(m_blockBuffer, Shader::GetMaterialBlockBinding(), RenderApi::BufferType::Uniforms);
+		}
+
+		TextureManager::StartShader();
+		// Set the uniforms outside of the block
+		for (auto& [value, location] : m_bindings)
+		{
 			using UT = RenderApi::UniformType;
-			switch (value.index())
+			switch (value->index())
 			{
 			case (size_t)UT::Float:
-				m_shader->SetUniformFloat(name, std::get<float>(value));
+				RenderApi::SetUniformFloat(location, std::get<float>(*value));
 				break;
 			case (size_t)UT::Vec3:
-				m_shader->SetUniformVector3(name, std::get<Vector3>(value));
+				RenderApi::SetUniformVector3(location, std::get<Vector3>(*value));
 				break;
 			case (size_t)UT::Int:
-				m_shader->SetUniformInt(name, std::get<int>(value));
+				RenderApi::SetUniformInt(location, std::get<int>(*value));
 				break;
 			case (size_t)UT::Mat4: 
-				m_shader->SetUniformMatrix4(name, std::get<Matrix4>(value));
+				RenderApi::SetUniformMatrix4(location, std::get<Matrix4>(*value));
 				break;
 			case (size_t)UT::Sampler2D:  
-				if (auto asset = std::get<Asset<Texture>>(value); asset)
+				if (auto& asset = std::get<Asset<Texture>>(*value); asset)
 				{
 					int slot = TextureManager::GetTextureSlot(asset->GetId(), RenderApi::TextureTarget::Texture2D);
-					m_shader->SetUniformInt(name, slot);
+					RenderApi::SetUniformInt(location, slot);
 				}
 				break;
 			case (size_t)UT::SamplerCube:
-				if (auto asset = std::get<Asset<Cubemap>>(value); asset)
+				if (auto& asset = std::get<Asset<Cubemap>>(*value); asset)
 				{
 					int slot = TextureManager::GetTextureSlot(asset->GetId(), RenderApi::TextureTarget::Cubemap);
-					m_shader->SetUniformInt(name, slot);
+					RenderApi::SetUniformInt(location, slot);
 				}
 				break;
 
@@ -73,10 +91,142 @@ namespace RexEngine
 		}
 	}
 
+	void Material::PlanTextures()
+	{
+		if (!m_shader)
+			return;
+
+		if (m_layoutShaderId != m_shader->GetUniqueId() || m_layoutUniformCount != m_uniforms.size())
+			UpdateLayout();
+
+		// Same order as Bind(), the samplers in the block are bindless and don't use slots
+		for (auto& [value, location] : m_bindings)
+		{
+			if (value->index() == (size_t)RenderApi::UniformType::Sampler2D)
+			{
+				if (auto& asset = std::get<Asset<Texture>>(*value); asset)
+					TextureManager::PlanTexture(asset->GetId());
+			}
+			else if (value->index() == (size_t)RenderApi::UniformType::SamplerCube)
+			{
+				if (auto& asset = std::get<Asset<Cubemap>>(*value); asset)
+					TextureManager::PlanTexture(asset->GetId());
+			}
+		}
+	}
+
+	void Material::UpdateLayout()
+	{
+		m_layoutShaderId = m_shader->GetUniqueId();
+		m_layoutUniformCount = m_uniforms.size();
+		m_bindings.clear();
+		m_blockMembers.clear();
+		m_blockHasSamplers = false;
+
+		for (auto& [name, value] : m_uniforms)
+		{
+			const Uniform* uniform = m_shader->GetUniformInfo(name);
+			if (uniform == nullptr || uniform->Type != (RenderApi::UniformType)value.index())
+				continue; // Some uniforms might be invalid if the shader changed, discard them
+
+			if (uniform->Offset >= 0)
+			{
+				m_blockMembers.push_back({ &value, (size_t)uniform->Offset });
+				m_blockHasSamplers |= uniform->Type == RenderApi::UniformType::Sampler2D || uniform->Type == RenderApi::UniformType::SamplerCube;
+			}
+			else
+				m_bindings.push_back({ &value, uniform->ID });
+		}
+
+		// (Re)create the block, everything is uploaded again
+		const size_t blockSize = m_shader->GetMaterialBlockSize();
+		if (blockSize != m_blockData.size())
+		{
+			m_blockData.assign(blockSize, 0);
+
+			if (m_blockBuffer == RenderApi::InvalidBufferID && blockSize > 0)
+				m_blockBuffer = RenderApi::MakeBuffer();
+
+			if (m_blockBuffer != RenderApi::InvalidBufferID)
+				RenderApi::SetBufferData(m_blockBuffer, RenderApi::BufferType::Uniforms, RenderApi::BufferMode::Static, m_blockData.data(), std::max<size_t>(blockSize, 1));
+		}
+
+		m_blockDirty = true;
+	}
+
+	void Material::UpdateBlock()
+	{
+		m_blockDirty = false;
+
+		// std140 : scalars and vectors are tightly packed, the matrix columns are aligned on 16 bytes, the samplers are bindless handles
+		size_t changedBegin = m_blockData.size();
+		size_t changedEnd = 0;
+		auto write = [&](size_t offset, const void* data, size_t size) {
+			uint8_t* destination = m_blockData.data() + offset;
+			if (std::memcmp(destination, data, size) == 0)
+				return;
+
+			std::memcpy(destination, data, size);
+			changedBegin = std::min(changedBegin, offset);
+			changedEnd = std::max(changedEnd, offset + size);
+		};
+
+		for (auto& [value, offset] : m_blockMembers)
+		{
+			using UT = RenderApi::UniformType;
+			switch (value->index())
+			{
+			case (size_t)UT::Float: write(offset, &std::get<float>(*value), sizeof(float)); break;
+			case (size_t)UT::Vec2:  write(offset, &std::get<Vector2>(*value)[0], sizeof(float) * 2); break;
+			case (size_t)UT::Vec3:  write(offset, &std::get<Vector3>(*value)[0], sizeof(float) * 3); break;
+			case (size_t)UT::Vec4:  write(offset, &std::get<Vector4>(*value)[0], sizeof(float) * 4); break;
+			case (size_t)UT::Int:   write(offset, &std::get<int>(*value), sizeof(int)); break;
+			case (size_t)UT::Vec2I: write(offset, &std::get<Vector2Int>(*value)[0], sizeof(int) * 2); break;
+			case (size_t)UT::Vec3I: write(offset, &std::get<Vector3Int>(*value)[0], sizeof(int) * 3); break;
+			case (size_t)UT::Vec4I: write(offset, &std::get<Vector4Int>(*value)[0], sizeof(int) * 4); break;
+			case (size_t)UT::UInt:  write(offset, &std::get<unsigned int>(*value), sizeof(unsigned int)); break;
+			case (size_t)UT::Bool:
+			{
+				const uint32_t boolean = std::get<bool>(*value) ? 1 : 0;
+				write(offset, &boolean, sizeof(uint32_t));
+				break;
+			}
+			case (size_t)UT::Mat3:
+			{
+				const auto& matrix = std::get<Matrix3>(*value);
+				for (int column = 0; column < 3; column++)
+					write(offset + column * sizeof(float) * 4, &matrix[column][0], sizeof(float) * 3);
+				break;
+			}
+			case (size_t)UT::Mat4:  write(offset, &std::get<Matrix4>(*value)[0][0], sizeof(float) * 16); break;
+			case (size_t)UT::Sampler2D:
+			{
+				const Texture* texture = std::get<Asset<Texture>>(*value).Get();
+				const RenderApi::TextureHandle handle = texture ? texture->GetHandle() : TextureManager::GetFallbackHandle(RenderApi::TextureTarget::Texture2D);
+				write(offset, &handle, sizeof(handle));
+				break;
+			}
+			case (size_t)UT::SamplerCube:
+			{
+				const Cubemap* cubemap = std::get<Asset<Cubemap>>(*value).Get();
+				const RenderApi::TextureHandle handle = cubemap ? cubemap->GetHandle() : TextureManager::GetFallbackHandle(RenderApi::TextureTarget::Cubemap);
+				write(offset, &handle, sizeof(handle));
+				break;
+			}
+			default:
+				RE_ASSERT(false, "UniformType not supported in the material block");
+			}
+		}
+
+		if (changedBegin < changedEnd)
+			RenderApi::SubBufferData(m_blockBuffer, RenderApi::BufferType::Uniforms, changedBegin, changedEnd - changedBegin, m_blockData.data() + changedBegin);
+	}
+
 	void Material::SetShader(Asset<Shader> shader)
 	{
 		m_shader = shader;
 		m_uniforms.clear();
+		InvalidateLayout();
 
 		// Get all the uniforms
 		if (shader && shader->IsValid())
@@ -24,16 +24,22 @@ namespace RexEngine
 	public:
 
 		Material(Asset<Shader> shader);
+		~Material();
+
+		Material(const Material&) = delete;
 		
 		// Use Asset<Texture> and Asset<Cubemap> for sampler2D and samplerCube
+		// The value might be changed through the reference, the material block is checked for changes on the next Bind()
 		template<typename T>
 		T& GetUniform(const std::string& name)
 		{
+			m_blockDirty = true;
 			return std::get<T>(m_uniforms[name]);
 		}
 
 		UniformType& GetUniform(const std::string& name)
 		{
+			m_blockDirty = true;
 			return m_uniforms[name];
 		}
 
@@ -55,9 +61,15 @@ namespace RexEngine
 
 		Asset<Shader> GetShader() const { return m_shader; }
 
-		// Bind the shader and set the uniforms
+		// Unique id of this material, used to build the render queue sort keys
+		uint32_t GetSortId() const { return m_sortId; }
+
+		// Bind the shader, the material block and set the other uniforms
 		void Bind();
 
+		// Add the textures Bind() will request to the TextureManager plan, see TextureManager::BeginPlan()
+		void PlanTextures();
+
 		static void UnBind()
 		{
 			Shader::UnBind();
@@ -73,8 +85,11 @@ namespace RexEngine
 			archive(CUSTOM_NAME(guid, "Shader"));
 
 			auto ptr = std::make_shared<Material>(AssetManager::GetAsset<Shader>(guid));
-			if(ptr)
+			if (ptr)
+			{
 				archive(CUSTOM_NAME(ptr->m_uniforms, "Uniforms"));
+				ptr->InvalidateLayout();
+			}
 
 			return ptr;
 		}
@@ -94,10 +109,48 @@ namespace RexEngine
 		}
 
 	private:
+		// Find where each uniform goes in the shader, the uniforms are then set without looking up their names
+		void UpdateLayout();
+		void InvalidateLayout() { m_layoutShaderId = InvalidLayout; }
+
+		// Pack the uniforms of the material block, uploads it if it changed
+		void UpdateBlock();
+
+	private:
+		// Uniform set with RenderApi::SetUniform*, outside of the material block
+		struct UniformBinding
+		{
+			const UniformType* value;
+			int location;
+		};
+
+		// Uniform of the material block
+		struct BlockMember
+		{
+			const UniformType* value;
+			size_t offset; // In bytes
+		};
+
+		inline static constexpr uint32_t InvalidLayout = std::numeric_limits<uint32_t>::max();
 		
 		Asset<Shader> m_shader;
+		uint32_t m_sortId;
 
 		// IMPORTANT : the indices of the variant match RenderApi::UniformType
 		std::unordered_map < std::string, UniformType> m_uniforms;
+
+		// Layout, points to the values of m_uniforms
+		uint32_t m_layoutShaderId = InvalidLayout; // Unique id of the shader the layout was made for
+		size_t m_layoutUniformCount = 0;
+		std::vector<UniformBinding> m_bindings;
+		std::vector<BlockMember> m_blockMembers;
+		bool m_blockHasSamplers = false; // Bindless handles
+
+		// Material block, as uploaded to the GPU
+		std::vector<uint8_t> m_blockData;
+		RenderApi::BufferID m_blockBuffer = RenderApi::InvalidBufferID;
+		bool m_blockDirty = true;
+
+		inline static uint32_t s_nextSortId = 0;
 	};
 }
\ No newline at end of file
@@ -2,7 +2,110 @@
 #include "Mesh.h"
 
 #include "Shader.h"
-#include "utils/TupleHash.h"
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include "ObjParser.h"
+#include "assets/AssetManager.h"
+
+namespace RexEngine::Internal
+{
+	// Octahedral encoding, the unit sphere is projected on an octahedron then unfolded in the [-1, 1] square
+	std::array<int16_t, 2> EncodeOctahedralNormal(const Vector3& normal)
+	{
+		const float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+		if (length <= 0.0f)
+			return { 0, 0 };
+
+		float x = normal.x / length;
+		float y = normal.y / length;
+		if (normal.z < 0.0f)
+		{ // Fold the lower half over the corners
+			const float foldedX = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+			const float foldedY = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+			x = foldedX;
+			y = foldedY;
+		}
+
+		auto toShort = [](float value) { return static_cast<int16_t>(std::round(std::clamp(value, -1.0f, 1.0f) * 32767.0f)); };
+		return { toShort(x), toShort(y) };
+	}
+
+	template<typename T>
+	void AppendBytes(std::vector<uint8_t>& data, const T& value)
+	{
+		const auto bytes = reinterpret_cast<const uint8_t*>(&value);
+		data.insert(data.end(), bytes, bytes + sizeof(T));
+	}
+
+	// The rest of the stream in one buffer
+	std::string ReadStream(std::istream& data)
+	{
+		std::string text;
+		const auto start = data.tellg();
+		data.seekg(0, std::ios::end);
+		const auto end = data.tellg();
+		if (start >= 0 && end >= start)
+		{
+			data.seekg(start);
+			text.resize(static_cast<size_t>(end - start));
+			data.read(text.data(), end - start);
+			text.resize(static_cast<size_t>(data.gcount())); // Less in text mode, the line ends are converted
+		}
+		else
+		{ // Not seekable
+			data.clear();
+			text.assign(std::istreambuf_iterator<char>(data), std::istreambuf_iterator<char>());
+		}
+
+		return text;
+	}
+
+	// FNV-1a, 64 bits
+	uint64_t HashBytes(std::span<const std::byte> bytes)
+	{
+		uint64_t hash = 0xCBF29CE484222325ull;
+		for (auto byte : bytes)
+		{
+			hash ^= static_cast<uint64_t>(byte);
+			hash *= 0x100000001B3ull;
+		}
+		return hash;
+	}
+
+	// .rexmesh files : the header, the lods, then the vertex data (as in the GeometryPool) and the 32 bits indices of every lod at aligned offsets
+	inline constexpr std::array<char, 4> CookedMeshMagic = { 'R', 'X', 'M', 'S' };
+	inline constexpr uint32_t CookedMeshVersion = 1; // Increase when the format or the import stages change
+	inline constexpr size_t CookedMeshAlignment = 16;
+
+	struct CookedMeshHeader
+	{
+		std::array<char, 4> magic;
+		uint32_t version;
+		uint64_t sourceHash;
+		uint8_t hasNormals;
+		uint8_t hasUVs;
+		uint8_t halfUVs;
+		uint8_t indexType;
+		uint32_t lodCount;
+		uint64_t vertexCount;
+		uint64_t vertexStride;
+		uint64_t indexCount; // Of every lod
+		uint64_t vertexOffset; // From the start of the file
+		uint64_t indexOffset;
+		float boundsMin[3];
+		float boundsMax[3];
+		float sphereCenter[3];
+		float sphereRadius;
+	};
+
+	struct CookedLod
+	{
+		uint64_t firstIndex;
+		uint64_t indexCount;
+		float screenSize;
+		float error;
+	};
+}
 
 namespace RexEngine
 {
@@ -14,142 +117,477 @@ namespace RexEngine
 
 		RE_ASSERT(vertices.size() == normals.size() || !m_hasNormals, "Mesh normal count was not the same as vertex count !");
 		RE_ASSERT(vertices.size() == uvs.size() || !m_hasUVs, "Mesh uvs count was not the same as vertex count !");
-		
-		m_vertexData.reserve(vertices.size_bytes() + normals.size_bytes() + uvs.size_bytes());
+
+		// Choose the formats
+		m_halfUVs = std::all_of(uvs.begin(), uvs.end(), [](const Vector2& uv) { return std::abs(uv.x) <= 1.0f && std::abs(uv.y) <= 1.0f; });
+		m_indexType = vertices.size() <= (size_t)UINT16_MAX + 1 ? RenderApi::IndexType::UInt16 : RenderApi::IndexType::UInt32;
+
+		m_vertexCount = vertices.size();
+		m_vertexStride = GetLayoutStride(MakeLayout(m_hasNormals, m_hasUVs, m_halfUVs));
+
+		m_vertexData.reserve(vertices.size() * m_vertexStride);
 
 		// Make the vertex data buffer
 		for (int i = 0; i < vertices.size(); i++)
 		{
-			for (int s = 0; s < sizeof(Vector3); s++)
-				m_vertexData.push_back(((uint8_t*)&vertices[i])[s]);
+			Internal::AppendBytes(m_vertexData, vertices[i]);
 
 			if (m_hasNormals)
-			{
-				for (int s = 0; s < sizeof(Vector3); s++)
-					m_vertexData.push_back(((uint8_t*)&normals[i])[s]);
-			}
+				Internal::AppendBytes(m_vertexData, Internal::EncodeOctahedralNormal(normals[i]));
 
-			if (m_hasUVs)
-			{
-				for (int s = 0; s < sizeof(Vector2); s++)
-					m_vertexData.push_back(((uint8_t*)&uvs[i])[s]);
-			}
+			if (m_hasUVs && m_halfUVs)
+				Internal::AppendBytes(m_vertexData, glm::packHalf2x16(glm::vec2(uvs[i].x, uvs[i].y)));
+			else if (m_hasUVs)
+				Internal::AppendBytes(m_vertexData, uvs[i]);
 		}
 
 		// Indices
 		m_indices.assign(indices.begin(), indices.end());
+		m_lods.push_back({ 0, m_indices.size(), 1.0f, 0.0f });
 
-		// Tell the RenderApi
-		m_vertexBuffer = RenderApi::MakeBuffer();
-		RenderApi::SetBufferData(m_vertexBuffer, RenderApi::BufferType::Vertex, RenderApi::BufferMode::Dynamic, std::span(m_vertexData));
+		m_bounds = BoundingBox::FromPoints(vertices);
+		m_boundingSphere = BoundingSphere::FromPoints(vertices);
 
-		m_indexBuffer = RenderApi::MakeBuffer();
-		RenderApi::SetBufferData(m_indexBuffer, RenderApi::BufferType::Indice, RenderApi::BufferMode::Dynamic, std::span(m_indices));
-		
-		// Make the Vertex Attributes
-		std::vector<std::tuple<RenderApi::VertexAttributeType, int>> attributes;
-		attributes.push_back({ RenderApi::VertexAttributeType::Float3 , Shader::PositionLocation}); // Position
-		if(m_hasNormals)
-			attributes.push_back({ RenderApi::VertexAttributeType::Float3 , Shader::NormalLocation }); // Normal
-		if(m_hasUVs)
-			attributes.push_back({ RenderApi::VertexAttributeType::Float2 , Shader::UVLocation }); // UV
+		m_id = s_nextID++;
 
-
-		m_vertexAttributes = RenderApi::MakeVertexAttributes(std::span(attributes), m_vertexBuffer, m_indexBuffer);
+		Upload(m_vertexData, m_indices);
 	}
 
+	Mesh::Mesh()
+		: m_vertexCount(0), m_hasNormals(false), m_hasUVs(false), m_halfUVs(false), m_vertexStride(0), m_indexType(RenderApi::IndexType::UInt32), m_id(s_nextID++)
+	{}
+
 	Mesh::~Mesh()
 	{
-		RenderApi::DeleteVertexAttributes(m_vertexAttributes);
-		RenderApi::DeleteBuffer(m_vertexBuffer);
-		RenderApi::DeleteBuffer(m_indexBuffer);
+		// Counted by Upload()
+		if (m_geometry == GeometryPool::InvalidAllocation)
+			return;
+
+		AccountMemory(false);
+		GeometryPool::Free(m_geometry);
+	}
+
+	void Mesh::Upload(std::span<const uint8_t> vertexData, std::span<const unsigned int> indices)
+	{
+		// Tell the RenderApi
+		m_geometry = GeometryPool::Allocate(MakeLayout(m_hasNormals, m_hasUVs, m_halfUVs), m_indexType, vertexData, indices);
+
+		AccountMemory(true);
+	}
+
+	GeometryPool::Layout Mesh::MakeLayout(bool hasNormals, bool hasUVs, bool halfUVs)
+	{
+		GeometryPool::Layout attributes;
+		attributes.push_back({ RenderApi::VertexAttributeType::Float3, Shader::PositionLocation });
+		if (hasNormals)
+			attributes.push_back({ RenderApi::VertexAttributeType::Short2Normalized, Shader::NormalLocation });
+		if (hasUVs)
+			attributes.push_back({ halfUVs ? RenderApi::VertexAttributeType::Half2 : RenderApi::VertexAttributeType::Float2, Shader::UVLocation });
+		return attributes;
+	}
+
+	size_t Mesh::GetLayoutStride(const GeometryPool::Layout& layout)
+	{
+		size_t stride = 0;
+		for (auto& [type, location] : layout)
+			stride += RenderApi::GetVertexAttributeSize(type);
+		return stride;
 	}
 
 	std::shared_ptr<Mesh> Mesh::FromObj(std::istream& data)
 	{
-		std::vector<Vector3> vertices;
-		std::vector<Vector3> normals = {Vector3(0,0,0)}; // Add a null normal, if the mesh has none this will prevent an out of bounds access
-		std::vector<Vector2> uvs = {Vector2(0,0)}; // Add a null uv, if the mesh has none this will prevent an out of bounds access
-		//                    <vertex, normal, uv>
-		std::vector<std::tuple<int,int, int>> faces;
+		return FromObj(std::string_view(Internal::ReadStream(data)));
+	}
+
+	std::shared_ptr<Mesh> Mesh::FromObj(std::string_view text)
+	{
+		auto mesh = ImportObj(text);
+		mesh->SetUploadPolicy(DefaultUploadPolicy);
+		return mesh;
+	}
+
+	std::shared_ptr<Mesh> Mesh::ImportObj(std::string_view text)
+	{
+		auto obj = ObjParser::Parse(text);
+		if (obj.malformedLines > 0 || obj.invalidTriangles > 0)
+			RE_LOG_WARN("Obj : skipped {} malformed lines and {} triangles with invalid indices", obj.malformedLines, obj.invalidTriangles);
+
+		if (ImportVertexCacheOptimization && !obj.indices.empty())
+		{
+			const auto before = MeshOptimizer::AnalyzeVertexCache(obj.indices, obj.positions.size());
+
+			MeshOptimizer::OptimizeVertexCache(obj.indices, obj.positions.size());
+			if (ImportOverdrawOptimization)
+				MeshOptimizer::OptimizeOverdraw(obj.indices, obj.positions);
+
+			const auto remap = MeshOptimizer::OptimizeVertexFetch(obj.indices, obj.positions.size());
+			MeshOptimizer::RemapVertices(obj.positions, remap);
+			MeshOptimizer::RemapVertices(obj.normals, remap);
+			MeshOptimizer::RemapVertices(obj.uvs, remap);
+
+			const auto after = MeshOptimizer::AnalyzeVertexCache(obj.indices, obj.positions.size());
+			RE_LOG_INFO("Mesh import, {} triangles : ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}", obj.indices.size() / 3, before.acmr, after.acmr, before.atvr, after.atvr);
+		}
+
+		auto mesh = std::make_shared<Mesh>(obj.positions, obj.indices, obj.normals, obj.uvs);
+		mesh->GenerateLods();
+		return mesh;
+	}
+
+	std::shared_ptr<Mesh> Mesh::LoadFromAsset(Guid assetGuid, uint64_t sourceHash, std::istream& assetFile)
+	{
+		// Hashing the source is much faster than parsing it
+		const std::string text = Internal::ReadStream(assetFile);
+		const uint64_t hash = Internal::HashBytes(std::as_bytes(std::span(text)));
+
+		std::filesystem::path cookedPath = AssetManager::GetAssetPathFromGuid(assetGuid);
+		if (cookedPath.empty())
+			return FromObj(std::string_view(text)); // Not in the registry, nowhere to cook
+
+		cookedPath += CookedExtension;
+		if (hash == sourceHash)
+		{
+			if (auto mesh = LoadCooked(cookedPath, hash))
+				return mesh;
+		}
+
+		// Fall back to the obj, and cook it for the next loads
+		auto mesh = ImportObj(text);
+		mesh->m_sourceHash = hash;
+		if (mesh->Cook(cookedPath))
+		{
+			RE_LOG_INFO("Cooked {}", cookedPath.string());
+			if (hash != sourceHash)
+				s_cookedMetaData.push_back(assetGuid);
+		}
+		else
+			RE_LOG_WARN("Could not write the cooked mesh {}", cookedPath.string());
+
+		mesh->SetUploadPolicy(DefaultUploadPolicy);
+		return mesh;
+	}
+
+	std::shared_ptr<Mesh> Mesh::LoadCooked(const std::filesystem::path& path, uint64_t sourceHash)
+	{
+		using Internal::CookedMeshHeader;
+		using Internal::CookedLod;
+
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file.is_open())
+			return nullptr;
+
+		// Read in one go, the vertices and indices are sent to the GeometryPool from this buffer
+		const size_t size = static_cast<size_t>(file.tellg());
+		if (size < sizeof(CookedMeshHeader))
+			return nullptr;
+
+		std::vector<uint8_t> data(size);
+		file.seekg(0);
+		if (!file.read(reinterpret_cast<char*>(data.data()), size))
+			return nullptr;
+
+		CookedMeshHeader header;
+		std::memcpy(&header, data.data(), sizeof(header));
+		if (header.magic != Internal::CookedMeshMagic || header.version != Internal::CookedMeshVersion || header.sourceHash != sourceHash)
+			return nullptr;
+
+		// Everything is checked before the mesh is made, a cooked file that doesn't match falls back to the obj
+		auto invalid = [&]() -> std::shared_ptr<Mesh> {
+			RE_LOG_WARN("Invalid cooked mesh {}", path.string());
+			return nullptr;
+		};
+
+		// The vertex format may have changed since the cooking
+		const size_t stride = GetLayoutStride(MakeLayout(header.hasNormals, header.hasUVs, header.halfUVs));
+		if (stride != header.vertexStride)
+			return nullptr;
+
+		const auto indexType = (RenderApi::IndexType)header.indexType;
+		if (header.lodCount == 0 || header.lodCount > MaxLods || header.indexType > (uint8_t)RenderApi::IndexType::UInt32
+			|| (indexType == RenderApi::IndexType::UInt16 && header.vertexCount > (uint64_t)UINT16_MAX + 1)
+			|| header.vertexCount > size / stride || header.indexCount > size / sizeof(unsigned int))
+			return invalid();
+
+		const size_t lodsSize = header.lodCount * sizeof(CookedLod);
+		const size_t vertexSize = header.vertexCount * header.vertexStride;
+		const size_t indexSize = header.indexCount * sizeof(unsigned int);
+		if (sizeof(header) + lodsSize > size || header.vertexOffset % Internal::CookedMeshAlignment != 0 || header.indexOffset % Internal::CookedMeshAlignment != 0
+			|| header.vertexOffset > size || vertexSize > size - header.vertexOffset || header.indexOffset > size || indexSize > size - header.indexOffset)
+			return invalid();
+
+		std::vector<Lod> lods;
+		for (uint32_t i = 0; i < header.lodCount; i++)
+		{
+			CookedLod lod;
+			std::memcpy(&lod, data.data() + sizeof(header) + i * sizeof(CookedLod), sizeof(lod));
+			if (lod.firstIndex > header.indexCount || lod.indexCount > header.indexCount - lod.firstIndex)
+				return invalid();
+
+			lods.push_back({ lod.firstIndex, lod.indexCount, lod.screenSize, lod.error });
+		}
+
+		const std::span<const uint8_t> vertexData(data.data() + header.vertexOffset, vertexSize);
+		const std::span<const unsigned int> indices(reinterpret_cast<const unsigned int*>(data.data() + header.indexOffset), header.indexCount);
+
+		// The gpu would read out of the vertices of the mesh
+		if (std::any_of(indices.begin(), indices.end(), [&](unsigned int index) { return index >= header.vertexCount; }))
+			return invalid();
+
+		std::shared_ptr<Mesh> mesh(new Mesh());
+		mesh->m_hasNormals = header.hasNormals;
+		mesh->m_hasUVs = header.hasUVs;
+		mesh->m_halfUVs = header.halfUVs;
+		mesh->m_indexType = indexType;
+		mesh->m_vertexCount = header.vertexCount;
+		mesh->m_vertexStride = stride;
+		mesh->m_lods = std::move(lods);
+		mesh->m_sourceHash = sourceHash;
+
+		mesh->m_bounds = { Vector3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]), Vector3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]) };
+		mesh->m_boundingSphere = { Vector3(header.sphereCenter[0], header.sphereCenter[1], header.sphereCenter[2]), header.sphereRadius };
+
+		// Copy the cpu data only if the policy keeps some
+		if (DefaultUploadPolicy == UploadPolicy::Release)
+			mesh->m_uploadPolicy = UploadPolicy::Release;
+		else
+		{
+			mesh->m_vertexData.assign(vertexData.begin(), vertexData.end());
+			mesh->m_indices.assign(indices.begin(), indices.end());
+		}
+
+		mesh->Upload(vertexData, indices);
+		mesh->SetUploadPolicy(DefaultUploadPolicy);
+		return mesh;
+	}
+
+	bool Mesh::Cook(const std::filesystem::path& path) const
+	{
+		using Internal::CookedMeshHeader;
+		using Internal::CookedLod;
+
+		if (m_uploadPolicy != UploadPolicy::Keep)
+			return false;
+
+		auto align = [](size_t offset) { return (offset + Internal::CookedMeshAlignment - 1) / Internal::CookedMeshAlignment * Internal::CookedMeshAlignment; };
+
+		CookedMeshHeader header{};
+		header.magic = Internal::CookedMeshMagic;
+		header.version = Internal::CookedMeshVersion;
+		header.sourceHash = m_sourceHash;
+		header.hasNormals = m_hasNormals;
+		header.hasUVs = m_hasUVs;
+		header.halfUVs = m_halfUVs;
+		header.indexType = (uint8_t)m_indexType;
+		header.lodCount = (uint32_t)m_lods.size();
+		header.vertexCount = m_vertexCount;
+		header.vertexStride = m_vertexStride;
+		header.indexCount = m_indices.size();
+		header.vertexOffset = align(sizeof(header) + m_lods.size() * sizeof(CookedLod));
+		header.indexOffset = align(header.vertexOffset + m_vertexData.size());
+		for (int i = 0; i < 3; i++)
+		{
+			header.boundsMin[i] = m_bounds.min[i];
+			header.boundsMax[i] = m_bounds.max[i];
+			header.sphereCenter[i] = m_boundingSphere.center[i];
+		}
+		header.sphereRadius = m_boundingSphere.radius;
+
+		// The whole file in memory, then written at once
+		std::vector<uint8_t> data(header.indexOffset + m_indices.size() * sizeof(unsigned int), 0);
+		std::memcpy(data.data(), &header, sizeof(header));
+		for (size_t i = 0; i < m_lods.size(); i++)
+		{
+			const CookedLod lod{ m_lods[i].firstIndex, m_lods[i].indexCount, m_lods[i].screenSize, m_lods[i].error };
+			std::memcpy(data.data() + sizeof(header) + i * sizeof(CookedLod), &lod, sizeof(lod));
+		}
+		std::memcpy(data.data() + header.vertexOffset, m_vertexData.data(), m_vertexData.size());
+		std::memcpy(data.data() + header.indexOffset, m_indices.data(), m_indices.size() * sizeof(unsigned int));
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+			return false;
+
+		file.write(reinterpret_cast<const char*>(data.data()), data.size());
+		return file.good();
+	}
+
+	void Mesh::SaveCookedMetaData()
+	{
+		for (auto& guid : s_cookedMetaData)
+			AssetManager::SaveAsset<Mesh>(guid);
+		s_cookedMetaData.clear();
+	}
+
+	void Mesh::GenerateLods()
+	{
+		constexpr size_t MinIndexCount = 3 * 64; // Not worth simplifying under that
+		constexpr float MinReduction = 0.75f; // Stop if a lod keeps more than 75% of the triangles of the previous one
+		constexpr float BaseError = 0.01f; // Max error of the first lod, relative to the radius of the mesh, doubled at each lod
 
-		// Go line by line
-		std::string line;
-		while (std::getline(data, line))
+		const auto positionData = GetPositionData();
+		if (positionData.empty() || m_indices.empty())
 		{
-			if (line.empty())
-				continue;
-			
-			auto args = StringHelper::Split(line, ' ');
-
-			if (args[0] == "v")
-			{ // vertex
-				vertices.push_back(Vector3(std::stof(args[1]), std::stof(args[2]), std::stof(args[3])));
-			}
-			else if (args[0] == "vn")
-			{ // normal
-				normals.push_back(Vector3(std::stof(args[1]), std::stof(args[2]), std::stof(args[3])).Normalized());
-			}
-			else if (args[0] == "vt")
-			{
-				uvs.push_back(Vector2(std::stof(args[1]), std::stof(args[2])));
-			}
-			else if (args[0] == "f")
-			{ // face
-				for (int i = 0; i < 3; i++)
-				{ // Get each component : vertexIndex/textureIndex/normalIndex
-					auto components = StringHelper::Split(args[i + 1], '/');
-
-					int v = std::stoi(components[0]) - 1;
-					int uv = 0;
-					int n = 0;
-
-					if (components.size() >= 2 && !components[1].empty())
-						uv = std::stoi(components[1]); // not -1 because of the default normal
-					if (components.size() >= 3 && !components[2].empty())
-						n = std::stoi(components[2]); // not -1 because of the default uv
-
-					faces.push_back({ v, n, uv });
-				}
-			}
-		}
-
-		// Loop all the faces and make the vertex buffer
-
-		// This will store the index of each unique vertex
-		//							<<vertex, normal, uv>, meshIndex>
-		std::unordered_map<std::tuple<int, int, int>, size_t> vertexIndex;
-		std::vector<unsigned int> meshIndices;
-		std::vector<Vector3> meshVertices;
-		std::vector<Vector3> meshNormals;
-		std::vector<Vector2> meshUVs;
-		
-		for (int i = 0; i < faces.size(); i++)
+			RE_LOG_WARN("Can't generate the lods of a mesh without its cpu data");
+			return;
+		}
+
+		AccountMemory(false);
+
+		// Regenerate from the full mesh
+		m_indices.resize(m_lods[0].indexCount);
+		m_lods.resize(1);
+
+		const size_t stride = GetPositionStride();
+		std::vector<Vector3> positions(m_vertexCount);
+		for (size_t i = 0; i < positions.size(); i++)
+			std::memcpy(&positions[i], positionData.data() + i * stride, sizeof(Vector3));
+
+		float maxError = BaseError * m_boundingSphere.radius;
+		float screenSize = 0.5f;
+
+		std::vector<unsigned int> previous = m_indices;
+		while (m_lods.size() < MaxLods && previous.size() >= MinIndexCount)
 		{
-			auto&[vIndex, nIndex, uvIndex] = faces[i];
-			auto index = vertexIndex.find(faces[i]);
-			if (index != vertexIndex.end())
-				meshIndices.push_back((unsigned int)index->second);
-			else
-			{
-				meshIndices.push_back((unsigned int)vertexIndex.size());
-				vertexIndex.insert({ faces[i], meshVertices.size() });
-
-				meshVertices.push_back(vertices[vIndex]);
-				if(normals.size() > 1)
-					meshNormals.push_back(normals[nIndex]);
-				if (uvs.size() > 1)
-					meshUVs.push_back(uvs[uvIndex]);
-			}
-		}
-		
-		return std::make_shared<Mesh>(meshVertices, meshIndices, meshNormals, meshUVs);
+			auto simplified = MeshSimplifier::Simplify(positions, previous, previous.size() / 6 * 3, maxError);
+			if (simplified.indices.empty() || (float)simplified.indices.size() > (float)previous.size() * MinReduction)
+				break;
+
+			if (ImportVertexCacheOptimization)
+				MeshOptimizer::OptimizeVertexCache(simplified.indices, m_vertexCount);
+
+			m_lods.push_back({ m_indices.size(), simplified.indices.size(), screenSize, m_lods.back().error + simplified.error });
+			m_indices.insert(m_indices.end(), simplified.indices.begin(), simplified.indices.end());
+
+			previous = std::move(simplified.indices);
+			maxError *= 2.0f;
+			screenSize *= 0.5f;
+		}
+
+		GeometryPool::SetIndices(m_geometry, m_indices);
+
+		AccountMemory(true);
+	}
+
+	void Mesh::SetUploadPolicy(UploadPolicy policy)
+	{
+		if (policy == m_uploadPolicy)
+			return;
+
+		RE_ASSERT(m_uploadPolicy != UploadPolicy::Release, "The cpu data of the mesh was already released !");
+		RE_ASSERT(policy != UploadPolicy::Keep, "The interleaved vertex data of the mesh was already released !");
+
+		AccountMemory(false);
+
+		if (policy == UploadPolicy::KeepPositions)
+		{ // Compact copy of the positions, the first element of each vertex
+			m_positions.resize(m_vertexCount);
+			for (size_t i = 0; i < m_positions.size(); i++)
+				std::memcpy(&m_positions[i], m_vertexData.data() + i * m_vertexStride, sizeof(Vector3));
+		}
+		else
+		{
+			std::vector<Vector3>().swap(m_positions);
+			std::vector<unsigned int>().swap(m_indices);
+		}
+
+		// Swap with an empty vector, clear() keeps the capacity
+		std::vector<uint8_t>().swap(m_vertexData);
+		m_uploadPolicy = policy;
+
+		AccountMemory(true);
+	}
+
+	std::span<const uint8_t> Mesh::GetPositionData() const
+	{
+		if (m_uploadPolicy == UploadPolicy::KeepPositions)
+			return std::span(reinterpret_cast<const uint8_t*>(m_positions.data()), m_positions.size() * sizeof(Vector3));
+
+		return m_vertexData;
+	}
+
+	std::span<const unsigned int> Mesh::GetIndices(size_t lod) const
+	{
+		if (m_indices.empty())
+			return {};
+
+		return std::span(m_indices).subspan(m_lods[lod].firstIndex, m_lods[lod].indexCount);
+	}
+
+	size_t Mesh::GetCPUMemory() const
+	{
+		return m_vertexData.capacity() + m_positions.capacity() * sizeof(Vector3) + m_indices.capacity() * sizeof(unsigned int) + m_lods.capacity() * sizeof(Lod);
+	}
+
+	size_t Mesh::GetGPUMemory() const
+	{
+		const size_t indexCount = m_lods.back().firstIndex + m_lods.back().indexCount; // Of every lod
+		return m_vertexCount * m_vertexStride + indexCount * RenderApi::GetIndexSize(m_indexType);
+	}
+
+	void Mesh::AccountMemory(bool add) const
+	{
+		if (add)
+		{
+			s_memory.meshes++;
+			s_memory.cpuBytes += GetCPUMemory();
+			s_memory.gpuBytes += GetGPUMemory();
+		}
+		else
+		{
+			s_memory.meshes--;
+			s_memory.cpuBytes -= GetCPUMemory();
+			s_memory.gpuBytes -= GetGPUMemory();
+		}
+	}
+
+	size_t Mesh::SelectLod(float screenSize, size_t currentLod) const
+	{
+		constexpr float Hysteresis = 0.1f;
+
+		size_t lod = std::min(currentLod, m_lods.size() - 1);
+
+		while (lod + 1 < m_lods.size() && screenSize < m_lods[lod + 1].screenSize * (1.0f - Hysteresis))
+			lod++;
+
+		while (lod > 0 && screenSize > m_lods[lod].screenSize * (1.0f + Hysteresis))
+			lod--;
+
+		return lod;
 	}
 
 	void Mesh::Bind() const
 	{
-		RenderApi::BindVertexAttributes(m_vertexAttributes);
-		RenderApi::BindBuffer(m_indexBuffer, RenderApi::BufferType::Indice);
+		// The index buffer is part of the vertex attributes
+		GeometryPool::Bind(m_geometry);
+	}
+
+	void Mesh::Draw(size_t lod) const
+	{
+		const auto& allocation = GeometryPool::Get(m_geometry);
+		RenderApi::DrawElements(m_lods[lod].indexCount, allocation.firstIndex + m_lods[lod].firstIndex, (int)allocation.firstVertex, m_indexType);
+	}
+
+	void Mesh::DrawInstanced(size_t lod, size_t instanceCount, size_t firstInstance) const
+	{
+		const auto& allocation = GeometryPool::Get(m_geometry);
+		RenderApi::DrawElementsInstanced(m_lods[lod].indexCount, instanceCount, firstInstance, allocation.firstIndex + m_lods[lod].firstIndex, (int)allocation.firstVertex, m_indexType);
+	}
+
+	RenderApi::DrawIndirectCommand Mesh::GetDrawCommand(size_t lod, uint32_t instanceCount, uint32_t firstInstance) const
+	{
+		const auto& allocation = GeometryPool::Get(m_geometry);
+		return {
+			static_cast<uint32_t>(m_lods[lod].indexCount),
+			instanceCount,
+			static_cast<uint32_t>(allocation.firstIndex + m_lods[lod].firstIndex),
+			static_cast<int32_t>(allocation.firstVertex),
+			firstInstance };
+	}
+
+	Mesh::VertexFormatReport Mesh::GetVertexFormatReport() const
+	{
+		const size_t sourceVertexSize = sizeof(Vector3) + (m_hasNormals ? sizeof(Vector3) : 0) + (m_hasUVs ? sizeof(Vector2) : 0);
+		return { sourceVertexSize, m_vertexStride, sizeof(uint32_t), RenderApi::GetIndexSize(m_indexType) };
 	}
 
 }
\ No newline at end of file
@@ -1,59 +1,225 @@
 #pragma once
 
+#include <filesystem>
+
 #include "RenderApi.h"
+#include "GeometryPool.h"
 #include "../math/Vectors.h"
+#include "../math/Bounds.h"
+#include "../core/Guid.h"
+#include "../core/Serialization.h"
+#include "../core/EngineEvents.h"
+#include "../utils/StaticConstructor.h"
 
 namespace RexEngine
 {
 
+	// The vertices and indices are stored in the GeometryPool, the meshes with the same attributes share their vertex attributes
 	class Mesh
 	{
 	public:
+		inline static constexpr size_t MaxLods = 4; // Including the full detail mesh (lod 0)
+
+		// Level of detail, a range of the index buffer using the same vertices
+		struct Lod
+		{
+			size_t firstIndex;
+			size_t indexCount;
+			float screenSize; // Used when the object covers less than this fraction of the screen height
+			float error; // Distance to the full detail surface, in model space
+		};
+
 		// Type of vertex attributes : 
-		// Position(Vertex) and Normal : Vector3
-		// TexCoords : Vector4, if less fill as : (0,0,0,1) <-- currently vec2
+		// Position(Vertex) : Vector3
+		// Normal : octahedral encoded in 2 normalized shorts, decoded by the shaders (see Shader::ParseLine)
+		// TexCoords : 2 halfs when every uv is in [-1, 1] (precise to 1/2048), else Vector2
+		// The indices are 16 bits when the mesh has few enough vertices
+
+		// Bytes per vertex and per index of the mesh, and what they would be without the quantization
+		struct VertexFormatReport
+		{
+			size_t sourceVertexSize;
+			size_t vertexSize;
+			size_t sourceIndexSize;
+			size_t indexSize;
+		};
+
+		// What the mesh keeps on the cpu once its data is uploaded to the GeometryPool
+		enum class UploadPolicy
+		{
+			Keep, // The interleaved vertex data and the indices
+			Release, // Nothing, the mesh can only be drawn
+			KeepPositions // The positions and the indices of every lod, for the occlusion culling and the picking
+		};
+
+		// Memory held by all the loaded meshes, in bytes
+		struct MemoryStats
+		{
+			size_t meshes;
+			size_t cpuBytes;
+			size_t gpuBytes; // The ranges of the meshes in the GeometryPool, without its free space
+		};
+
+		// Applied by FromObj() once the lods are generated, the other meshes keep their data until SetUploadPolicy()
+		inline static UploadPolicy DefaultUploadPolicy = UploadPolicy::KeepPositions;
+
+		// Import stages of FromObj(), see MeshOptimizer
+		// The triangles are reordered for the vertex cache (the lods too) and the vertices in the order they are used
+		inline static bool ImportVertexCacheOptimization = true;
+		// Then the triangles facing out of the mesh are drawn first, needs the vertex cache optimization
+		inline static bool ImportOverdrawOptimization = true;
 
 		Mesh(std::span<const Vector3> vertices, std::span<const unsigned int> indices, std::span<const Vector3> normals = {}, std::span<const Vector2> uvs = {});
 		~Mesh();
 		
 		Mesh(const Mesh&) = delete;
 
-		// Make a mesh from some obj data
-		// Supported face types : Triangles
-		// Supported data : Vertex position, normals and indices
+		// Make a mesh from some obj data, see ObjParser
+		// Supported face types : Polygons, triangulated
+		// Supported data : Vertex position, normals, uvs and indices
 		static std::shared_ptr<Mesh> FromObj(std::istream& data);
+		static std::shared_ptr<Mesh> FromObj(std::string_view text);
 
 		void Bind() const;
 		inline static void UnBind() { RenderApi::BindVertexAttributes(0); }
 
-		auto GetID() const { return m_vertexAttributes; }
-		size_t GetIndexCount() const { return m_indices.size(); }
-		size_t GetVertexCount() const 
-		{ 
-			return m_vertexData.size() / sizeof(Vector3) 
-				+ (m_hasNormals ? sizeof(Vector3) : 0
-				+ (m_hasUVs ? sizeof(Vector2) : 0));
-		}
+		// Draw calls of a lod, the mesh must be bound
+		void Draw(size_t lod = 0) const;
+		void DrawInstanced(size_t lod, size_t instanceCount, size_t firstInstance) const;
+		// For RenderApi::MultiDrawElementsIndirect(), with the meshes of the same vertex layout
+		RenderApi::DrawIndirectCommand GetDrawCommand(size_t lod, uint32_t instanceCount, uint32_t firstInstance) const;
+
+		// Unique id of the mesh, used by the sort keys
+		uint32_t GetID() const { return m_id; }
+		// Meshes with the same vertex layout use the same vertex attributes
+		uint32_t GetLayout() const { return GeometryPool::Get(m_geometry).layout; }
+		size_t GetIndexCount() const { return m_lods[0].indexCount; }
+		size_t GetVertexCount() const { return m_vertexCount; }
 
 		bool HasNormals() const { return m_hasNormals; }
 		bool HasUVs() const { return m_hasUVs; }
+		RenderApi::IndexType GetIndexType() const { return m_indexType; }
+		VertexFormatReport GetVertexFormatReport() const;
+
+		// Interleaved vertex data (position, normal, uv), as sent to the gpu, the position is always the first Vector3
+		// Empty unless the upload policy is UploadPolicy::Keep
+		std::span<const uint8_t> GetVertexData() const { return m_vertexData; }
+		size_t GetVertexStride() const { return m_vertexStride; }
+		// The positions kept on the cpu, one Vector3 every GetPositionStride() bytes, empty once released
+		std::span<const uint8_t> GetPositionData() const;
+		size_t GetPositionStride() const { return m_uploadPolicy == UploadPolicy::Keep ? m_vertexStride : sizeof(Vector3); }
+		// Empty once released
+		std::span<const unsigned int> GetIndices(size_t lod = 0) const;
+
+		// Simplify the mesh, each lod has half the triangles of the previous one
+		// Stops early when the simplification would not remove enough triangles
+		// Needs the positions and the indices on the cpu
+		void GenerateLods();
+
+		// Frees the cpu data the policy doesn't keep, released data can't be brought back
+		void SetUploadPolicy(UploadPolicy policy);
+		UploadPolicy GetUploadPolicy() const { return m_uploadPolicy; }
+
+		// Bytes of this mesh
+		size_t GetCPUMemory() const;
+		size_t GetGPUMemory() const;
+		static MemoryStats GetMemoryStats() { return s_memory; }
+
+		size_t GetLodCount() const { return m_lods.size(); }
+		const Lod& GetLod(size_t lod) const { return m_lods[lod]; }
+
+		// The lod for an object covering screenSize of the screen height
+		// currentLod is the lod used last frame, the switch happens a bit after the threshold so the lod doesn't flicker
+		size_t SelectLod(float screenSize, size_t currentLod) const;
+
+		// In model space, computed from the vertices when the mesh is made
+		const BoundingBox& GetBounds() const { return m_bounds; }
+		const BoundingSphere& GetBoundingSphere() const { return m_boundingSphere; }
+
+		// The obj assets are cooked in a binary file next to them (model.obj -> model.obj.rexmesh), loaded instead of the obj while the source doesn't change
+		// The metadata has the hash of the source the cooked file was made from, a different hash cooks the mesh again
+		inline static const std::string CookedExtension = ".rexmesh"; // Ignored by the AssetManager, see GeneratedFileExtensions
+
+		template<typename Archive>
+		inline static std::shared_ptr<Mesh> LoadFromAssetFile(Guid assetGuid, Archive& metaDataArchive, std::istream& assetFile)
+		{
+			uint64_t sourceHash = 0;
+			try
+			{
+				metaDataArchive(CUSTOM_NAME(sourceHash, "SourceHash"));
+			}
+			catch ([[maybe_unused]]const cereal::Exception& e)
+			{ // Metadata made before the cooked meshes, cooked by this load
+			}
+
+			return LoadFromAsset(assetGuid, sourceHash, assetFile);
+		}
+
+		template<typename Archive>
+		void SaveToAssetFile(Archive& metaDataArchive) const
+		{
+			metaDataArchive(CUSTOM_NAME(m_sourceHash, "SourceHash"));
+		}
 
 		template<typename Archive>
-		inline static std::shared_ptr<Mesh> LoadFromAssetFile([[maybe_unused]]Guid _, [[maybe_unused]]const Archive& metaDataArchive, std::istream& assetFile)
+		inline static void CreateMetaData(Archive& metaDataArchive)
 		{
-			return FromObj(assetFile);
+			metaDataArchive(CUSTOM_NAME(uint64_t(0), "SourceHash")); // Not cooked yet
 		}
 
+	private:
+		// Filled by LoadCooked()
+		Mesh();
+
+		// Allocates the mesh in the GeometryPool, the members describing the data must be set
+		void Upload(std::span<const uint8_t> vertexData, std::span<const unsigned int> indices);
+		// Vertex attributes of the GeometryPool for the formats of a mesh
+		static GeometryPool::Layout MakeLayout(bool hasNormals, bool hasUVs, bool halfUVs);
+		static size_t GetLayoutStride(const GeometryPool::Layout& layout);
+
+		// Obj parsing and import stages, the cpu data is kept
+		static std::shared_ptr<Mesh> ImportObj(std::string_view text);
+
+		static std::shared_ptr<Mesh> LoadFromAsset(Guid assetGuid, uint64_t sourceHash, std::istream& assetFile);
+		// nullptr if the file is missing, invalid or made from another source
+		static std::shared_ptr<Mesh> LoadCooked(const std::filesystem::path& path, uint64_t sourceHash);
+		// Needs the cpu data
+		bool Cook(const std::filesystem::path& path) const;
+
+		// The metadata of the meshes cooked again is saved once they are in the AssetManager
+		static void SaveCookedMetaData();
+
+		RE_STATIC_CONSTRUCTOR({
+			EngineEvents::OnPreUpdate().Register<&Mesh::SaveCookedMetaData>();
+		});
+
+		// Adds or removes the memory of the mesh from the totals, around every change of its data
+		void AccountMemory(bool add) const;
+
 	private:
 
 		std::vector<uint8_t> m_vertexData;
-		std::vector<unsigned int> m_indices;
+		std::vector<Vector3> m_positions; // Only with UploadPolicy::KeepPositions
+		std::vector<unsigned int> m_indices; // The indices of every lod, one after the other
+		UploadPolicy m_uploadPolicy = UploadPolicy::Keep;
+		size_t m_vertexCount;
+		std::vector<Lod> m_lods;
 		bool m_hasNormals;
 		bool m_hasUVs;
+		bool m_halfUVs;
+		size_t m_vertexStride;
+		RenderApi::IndexType m_indexType;
+
+		BoundingBox m_bounds;
+		BoundingSphere m_boundingSphere;
+
+		uint32_t m_id;
+		GeometryPool::AllocationID m_geometry = GeometryPool::InvalidAllocation;
+		uint64_t m_sourceHash = 0; // Of the obj the mesh was loaded from
 
-		RenderApi::BufferID m_vertexBuffer = 0;
-		RenderApi::BufferID m_indexBuffer = 0;
-		RenderApi::VertexAttribID m_vertexAttributes = 0;
+		inline static uint32_t s_nextID = 1;
+		inline static MemoryStats s_memory{};
+		inline static std::vector<Guid> s_cookedMetaData;
 	};
 
 }
\ No newline at end of file
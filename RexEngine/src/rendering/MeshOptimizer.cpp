@@ -0,0 +1,303 @@
+#include "REPch.h"
+#include "MeshOptimizer.h"
+
+namespace RexEngine
+{
+	namespace
+	{
+		// Scoring of "Linear-Speed Vertex Cache Optimisation"
+		constexpr float CacheDecayPower = 1.5f;
+		constexpr float LastTriangleScore = 0.75f;
+		constexpr float ValenceBoostScale = 2.0f;
+		constexpr float ValenceBoostPower = 0.5f;
+
+		// cachePosition is -1 when the vertex is not in the cache, valence is the number of triangles left to emit using the vertex
+		float VertexScore(int cachePosition, uint32_t valence)
+		{
+			if (valence == 0)
+				return -1.0f; // Nothing left to draw with it
+
+			float score = 0.0f;
+			if (cachePosition >= 0)
+			{
+				if (cachePosition < 3)
+					score = LastTriangleScore; // Used by the last triangle, the same score whatever the order so the strips don't matter
+				else
+					score = std::pow(1.0f - (float)(cachePosition - 3) / (MeshOptimizer::OptimizeCacheSize - 3), CacheDecayPower);
+			}
+
+			// Finish the vertices with few triangles left first, so they don't stay alone
+			return score + ValenceBoostScale * std::pow((float)valence, -ValenceBoostPower);
+		}
+
+		Vector3 Cross(const Vector3& a, const Vector3& b)
+		{
+			return Vector3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+		}
+
+		float Dot(const Vector3& a, const Vector3& b)
+		{
+			return a.x * b.x + a.y * b.y + a.z * b.z;
+		}
+
+		struct Cluster
+		{
+			size_t firstTriangle;
+			size_t triangleCount;
+			float sortKey;
+		};
+	}
+
+	void MeshOptimizer::OptimizeVertexCache(std::span<unsigned int> indices, size_t vertexCount)
+	{
+		const size_t triangleCount = indices.size() / 3;
+		if (triangleCount == 0)
+			return;
+
+		// Triangles using each vertex, in a single array
+		std::vector<uint32_t> valence(vertexCount, 0); // Triangles not emitted yet
+		for (auto index : indices)
+			valence[index]++;
+
+		std::vector<uint32_t> triangleOffsets(vertexCount + 1, 0);
+		for (size_t v = 0; v < vertexCount; v++)
+			triangleOffsets[v + 1] = triangleOffsets[v] + valence[v];
+
+		std::vector<uint32_t> vertexTriangles(indices.size());
+		std::fill(valence.begin(), valence.end(), 0);
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			for (size_t k = 0; k < 3; k++)
+			{
+				const unsigned int v = indices[t * 3 + k];
+				vertexTriangles[triangleOffsets[v] + valence[v]++] = (uint32_t)t;
+			}
+		}
+
+		std::vector<int> cachePositions(vertexCount, -1);
+		std::vector<float> vertexScores(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++)
+			vertexScores[v] = VertexScore(-1, valence[v]);
+
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<unsigned int> output;
+		output.reserve(indices.size());
+
+		std::vector<unsigned int> cache;
+		std::vector<unsigned int> newCache;
+		cache.reserve(OptimizeCacheSize + 3);
+		newCache.reserve(OptimizeCacheSize + 3);
+
+		size_t cursor = 0; // Every triangle before is emitted
+		int64_t best = -1;
+		while (output.size() < triangleCount * 3)
+		{
+			if (best < 0)
+			{ // Nothing in the cache has triangles left, start again from the first triangle not emitted
+				while (emitted[cursor])
+					cursor++;
+				best = (int64_t)cursor;
+			}
+
+			const unsigned int* triangle = &indices[(size_t)best * 3];
+			emitted[(size_t)best] = true;
+			output.insert(output.end(), triangle, triangle + 3);
+
+			// Remove the triangle from its vertices
+			for (size_t k = 0; k < 3; k++)
+			{
+				const unsigned int v = triangle[k];
+				uint32_t* first = &vertexTriangles[triangleOffsets[v]];
+				uint32_t* last = first + valence[v];
+				auto it = std::find(first, last, (uint32_t)best);
+				if (it != last)
+				{
+					*it = *(last - 1);
+					valence[v]--;
+				}
+			}
+
+			// The vertices of the triangle go to the front of the cache
+			newCache.clear();
+			for (size_t k = 0; k < 3; k++)
+			{
+				if (std::find(newCache.begin(), newCache.end(), triangle[k]) == newCache.end())
+					newCache.push_back(triangle[k]);
+			}
+			for (auto v : cache)
+			{
+				if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+					newCache.push_back(v);
+			}
+
+			// Update the scores, the vertices past the size of the cache are evicted
+			for (size_t i = 0; i < newCache.size(); i++)
+			{
+				const unsigned int v = newCache[i];
+				cachePositions[v] = i < OptimizeCacheSize ? (int)i : -1;
+				vertexScores[v] = VertexScore(cachePositions[v], valence[v]);
+			}
+
+			// Best triangle using a vertex of the cache
+			best = -1;
+			float bestScore = -FLT_MAX;
+			for (auto v : newCache)
+			{
+				for (uint32_t i = 0; i < valence[v]; i++)
+				{
+					const uint32_t t = vertexTriangles[triangleOffsets[v] + i];
+					const float score = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+					if (cachePositions[v] >= 0 && score > bestScore)
+					{
+						best = t;
+						bestScore = score;
+					}
+				}
+			}
+
+			if (newCache.size() > OptimizeCacheSize)
+				newCache.resize(OptimizeCacheSize);
+			std::swap(cache, newCache);
+		}
+
+		std::copy(output.begin(), output.end(), indices.begin());
+	}
+
+	void MeshOptimizer::OptimizeOverdraw(std::span<unsigned int> indices, std::span<const Vector3> positions)
+	{
+		const size_t triangleCount = indices.size() / 3;
+		if (triangleCount == 0)
+			return;
+
+		// Cut where the three vertices of a triangle miss the cache : the order jumped to another part of the mesh
+		std::vector<Cluster> clusters;
+		std::vector<uint32_t> timestamps(positions.size(), 0);
+		uint32_t time = AnalyzeCacheSize + 1;
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			int misses = 0;
+			for (size_t k = 0; k < 3; k++)
+			{
+				const unsigned int v = indices[t * 3 + k];
+				if (time - timestamps[v] > AnalyzeCacheSize)
+				{
+					timestamps[v] = time++;
+					misses++;
+				}
+			}
+
+			if (clusters.empty() || misses == 3)
+				clusters.push_back({ t, 0, 0.0f });
+			clusters.back().triangleCount++;
+		}
+
+		if (clusters.size() <= 1)
+			return;
+
+		// Center of the mesh, weighted by the area of the triangles
+		Vector3 meshCenter(0, 0, 0);
+		float meshArea = 0.0f;
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			const Vector3& a = positions[indices[t * 3]];
+			const Vector3& b = positions[indices[t * 3 + 1]];
+			const Vector3& c = positions[indices[t * 3 + 2]];
+			const Vector3 normal = Cross(Vector3(b.x - a.x, b.y - a.y, b.z - a.z), Vector3(c.x - a.x, c.y - a.y, c.z - a.z));
+			const float area = std::sqrt(Dot(normal, normal));
+
+			meshCenter = Vector3(meshCenter.x + (a.x + b.x + c.x) * area, meshCenter.y + (a.y + b.y + c.y) * area, meshCenter.z + (a.z + b.z + c.z) * area);
+			meshArea += area * 3.0f;
+		}
+		if (meshArea > 0.0f)
+			meshCenter = Vector3(meshCenter.x / meshArea, meshCenter.y / meshArea, meshCenter.z / meshArea);
+
+		// The clusters far from the center in the direction they face are drawn first
+		for (auto& cluster : clusters)
+		{
+			Vector3 center(0, 0, 0);
+			Vector3 normal(0, 0, 0); // Sum of the normals weighted by the area
+			float area = 0.0f;
+
+			for (size_t t = cluster.firstTriangle; t < cluster.firstTriangle + cluster.triangleCount; t++)
+			{
+				const Vector3& a = positions[indices[t * 3]];
+				const Vector3& b = positions[indices[t * 3 + 1]];
+				const Vector3& c = positions[indices[t * 3 + 2]];
+				const Vector3 triangleNormal = Cross(Vector3(b.x - a.x, b.y - a.y, b.z - a.z), Vector3(c.x - a.x, c.y - a.y, c.z - a.z));
+				const float triangleArea = std::sqrt(Dot(triangleNormal, triangleNormal));
+
+				center = Vector3(center.x + (a.x + b.x + c.x) * triangleArea, center.y + (a.y + b.y + c.y) * triangleArea, center.z + (a.z + b.z + c.z) * triangleArea);
+				normal = Vector3(normal.x + triangleNormal.x, normal.y + triangleNormal.y, normal.z + triangleNormal.z);
+				area += triangleArea * 3.0f;
+			}
+
+			const float normalLength = std::sqrt(Dot(normal, normal));
+			if (area <= 0.0f || normalLength <= 0.0f)
+				continue; // Degenerate, keep a key of 0
+
+			center = Vector3(center.x / area - meshCenter.x, center.y / area - meshCenter.y, center.z / area - meshCenter.z);
+			cluster.sortKey = Dot(center, normal) / normalLength;
+		}
+
+		std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+		std::vector<unsigned int> output;
+		output.reserve(triangleCount * 3);
+		for (auto& cluster : clusters)
+			output.insert(output.end(), indices.begin() + cluster.firstTriangle * 3, indices.begin() + (cluster.firstTriangle + cluster.triangleCount) * 3);
+
+		std::copy(output.begin(), output.end(), indices.begin());
+	}
+
+	std::vector<unsigned int> MeshOptimizer::OptimizeVertexFetch(std::span<unsigned int> indices, size_t vertexCount)
+	{
+		constexpr unsigned int Unused = UINT_MAX;
+
+		std::vector<unsigned int> remap(vertexCount, Unused);
+		unsigned int next = 0;
+		for (auto& index : indices)
+		{
+			if (remap[index] == Unused)
+				remap[index] = next++;
+			index = remap[index];
+		}
+
+		for (auto& newIndex : remap)
+		{
+			if (newIndex == Unused)
+				newIndex = next++;
+		}
+
+		return remap;
+	}
+
+	MeshOptimizer::CacheStats MeshOptimizer::AnalyzeVertexCache(std::span<const unsigned int> indices, size_t vertexCount, size_t cacheSize)
+	{
+		if (indices.size() < 3)
+			return {};
+
+		// Fifo : a vertex is in the cache if less than cacheSize vertices were transformed since its own transform
+		std::vector<uint32_t> timestamps(vertexCount, 0);
+		std::vector<bool> used(vertexCount, false);
+		uint32_t time = (uint32_t)cacheSize + 1;
+		size_t transformed = 0;
+		size_t usedCount = 0;
+
+		for (auto index : indices)
+		{
+			if (time - timestamps[index] > cacheSize)
+			{
+				timestamps[index] = time++;
+				transformed++;
+			}
+
+			if (!used[index])
+			{
+				used[index] = true;
+				usedCount++;
+			}
+		}
+
+		return { (float)transformed / (indices.size() / 3), (float)transformed / usedCount };
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "../math/Vectors.h"
+
+namespace RexEngine
+{
+	// Reorders the triangles and the vertices of an indexed mesh for the gpu, the shape of the mesh doesn't change
+	// Run OptimizeVertexCache(), then OptimizeOverdraw(), then OptimizeVertexFetch() : each step keeps most of the locality of the previous one
+	class MeshOptimizer
+	{
+	public:
+		// Post-transform cache statistics, from a simulated fifo cache
+		struct CacheStats
+		{
+			float acmr = 0.0f; // Average cache miss ratio : transformed vertices per triangle, 0.5 at best, 3 at worst
+			float atvr = 0.0f; // Average transformed vertex ratio : transformed vertices per used vertex, 1 at best
+		};
+
+		inline static constexpr size_t OptimizeCacheSize = 32; // Lru cache simulated by the triangle ordering
+		inline static constexpr size_t AnalyzeCacheSize = 16; // Fifo cache of the statistics, close to the real hardware
+
+		// Triangle order that reuses the recently transformed vertices (Tom Forsyth, "Linear-Speed Vertex Cache Optimisation")
+		static void OptimizeVertexCache(std::span<unsigned int> indices, size_t vertexCount);
+
+		// Splits the triangles in clusters where the cache order jumps to another part of the mesh,
+		// then draws the clusters facing out of the mesh first so they hide the others (Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw")
+		static void OptimizeOverdraw(std::span<unsigned int> indices, std::span<const Vector3> positions);
+
+		// Numbers the vertices in the order the triangles use them, the unused ones go at the end
+		// Rewrites the indices and returns the new index of each vertex, apply it to the vertex data with RemapVertices()
+		static std::vector<unsigned int> OptimizeVertexFetch(std::span<unsigned int> indices, size_t vertexCount);
+
+		template<typename T>
+		static void RemapVertices(std::vector<T>& vertices, std::span<const unsigned int> remap)
+		{
+			std::vector<T> remapped(vertices.size());
+			for (size_t i = 0; i < vertices.size(); i++)
+				remapped[remap[i]] = vertices[i];
+			vertices = std::move(remapped);
+		}
+
+		static CacheStats AnalyzeVertexCache(std::span<const unsigned int> indices, size_t vertexCount, size_t cacheSize = AnalyzeCacheSize);
+	};
+}
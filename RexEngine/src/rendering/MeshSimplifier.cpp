@@ -0,0 +1,263 @@
+#include "REPch.h"
+#include "MeshSimplifier.h"
+
+#include "utils/TupleHash.h"
+
+namespace RexEngine
+{
+	namespace
+	{
+		// Symmetric 4x4 matrix of the sum of the squared distances to a set of planes, weighted by the area of the triangles
+		struct Quadric
+		{
+			double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+			double b0 = 0, b1 = 0, b2 = 0;
+			double c = 0;
+			double weight = 0;
+
+			static Quadric FromPlane(double x, double y, double z, double d, double weight)
+			{
+				Quadric q;
+				q.a00 = weight * x * x; q.a01 = weight * x * y; q.a02 = weight * x * z;
+				q.a11 = weight * y * y; q.a12 = weight * y * z; q.a22 = weight * z * z;
+				q.b0 = weight * x * d; q.b1 = weight * y * d; q.b2 = weight * z * d;
+				q.c = weight * d * d;
+				q.weight = weight;
+				return q;
+			}
+
+			Quadric& operator+=(const Quadric& other)
+			{
+				a00 += other.a00; a01 += other.a01; a02 += other.a02;
+				a11 += other.a11; a12 += other.a12; a22 += other.a22;
+				b0 += other.b0; b1 += other.b1; b2 += other.b2;
+				c += other.c;
+				weight += other.weight;
+				return *this;
+			}
+
+			// Mean squared distance to the planes
+			double Error(const Vector3& p) const
+			{
+				const double x = p.x, y = p.y, z = p.z;
+				const double error = a00 * x * x + a11 * y * y + a22 * z * z
+					+ 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+					+ 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+
+				return weight > 0.0 ? std::abs(error) / weight : 0.0;
+			}
+		};
+
+		struct Collapse
+		{
+			unsigned int from;
+			unsigned int to;
+			double error;
+		};
+
+		float Dot(const Vector3& a, const Vector3& b)
+		{
+			return a.x * b.x + a.y * b.y + a.z * b.z;
+		}
+
+		uint64_t EdgeKey(unsigned int a, unsigned int b)
+		{
+			return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+		}
+	}
+
+	MeshSimplifier::Result MeshSimplifier::Simplify(std::span<const Vector3> positions, std::span<const unsigned int> indices, size_t targetIndexCount, float maxError)
+	{
+		Result result;
+		result.indices.assign(indices.begin(), indices.end());
+
+		const size_t vertexCount = positions.size();
+		if (result.indices.size() <= targetIndexCount || vertexCount == 0)
+			return result;
+
+		// Vertices sharing a position (attribute seams) are welded for the topology
+		std::vector<unsigned int> welded(vertexCount);
+		std::vector<unsigned int> weldCount(vertexCount, 0);
+		{
+			std::unordered_map<std::tuple<float, float, float>, unsigned int> firstVertex;
+			firstVertex.reserve(vertexCount);
+			for (unsigned int v = 0; v < vertexCount; v++)
+			{
+				auto [it, _] = firstVertex.try_emplace({ positions[v].x, positions[v].y, positions[v].z }, v);
+				welded[v] = it->second;
+				weldCount[it->second]++;
+			}
+		}
+
+		// Locked vertices : attribute seams, and the borders (an edge used by a single triangle)
+		std::vector<bool> locked(vertexCount, false);
+		{
+			std::unordered_map<uint64_t, int> edgeUses;
+			edgeUses.reserve(result.indices.size());
+			for (size_t i = 0; i + 2 < result.indices.size(); i += 3)
+			{
+				for (int e = 0; e < 3; e++)
+					edgeUses[EdgeKey(welded[result.indices[i + e]], welded[result.indices[i + (e + 1) % 3]])]++;
+			}
+
+			std::vector<bool> lockedPosition(vertexCount, false);
+			for (auto& [edge, uses] : edgeUses)
+			{
+				if (uses == 1)
+				{
+					lockedPosition[edge >> 32] = true;
+					lockedPosition[edge & 0xFFFFFFFF] = true;
+				}
+			}
+
+			for (unsigned int v = 0; v < vertexCount; v++)
+				locked[v] = lockedPosition[welded[v]] || weldCount[welded[v]] > 1;
+		}
+
+		// Quadrics of the planes around each vertex
+		std::vector<Quadric> quadrics(vertexCount);
+		for (size_t i = 0; i + 2 < result.indices.size(); i += 3)
+		{
+			const Vector3& p0 = positions[result.indices[i]];
+			const Vector3 normal = Vector3(positions[result.indices[i + 1]] - p0).Cross(Vector3(positions[result.indices[i + 2]] - p0));
+			const float length = normal.Magnitude();
+			if (length <= 0.0f)
+				continue;
+
+			const Vector3 n = Vector3(normal / length);
+			const Quadric plane = Quadric::FromPlane(n.x, n.y, n.z, -Dot(n, p0), length * 0.5);
+			for (int c = 0; c < 3; c++)
+				quadrics[result.indices[i + c]] += plane;
+		}
+
+		const double maxSqrError = (double)maxError * maxError;
+
+		std::vector<Collapse> collapses;
+		std::vector<unsigned int> remap(vertexCount);
+		std::vector<bool> touched(vertexCount);
+		std::vector<unsigned int> triangleStart(vertexCount + 1);
+		std::vector<unsigned int> vertexTriangles;
+
+		// Each pass collapses a set of independent edges (no shared triangle), cheapest first
+		while (result.indices.size() > targetIndexCount)
+		{
+			auto& current = result.indices;
+			const size_t triangleCount = current.size() / 3;
+
+			// Triangles using each vertex
+			std::fill(triangleStart.begin(), triangleStart.end(), 0);
+			for (auto index : current)
+				triangleStart[index + 1]++;
+			for (size_t v = 0; v < vertexCount; v++)
+				triangleStart[v + 1] += triangleStart[v];
+
+			vertexTriangles.resize(current.size());
+			{
+				std::vector<unsigned int> fill(triangleStart.begin(), triangleStart.end() - 1);
+				for (size_t i = 0; i < current.size(); i++)
+					vertexTriangles[fill[current[i]]++] = (unsigned int)(i / 3);
+			}
+
+			// Cost of the collapses, in the cheapest direction of each edge
+			collapses.clear();
+			for (size_t i = 0; i < current.size(); i += 3)
+			{
+				for (int e = 0; e < 3; e++)
+				{
+					const unsigned int a = current[i + e];
+					const unsigned int b = current[i + (e + 1) % 3];
+					if (a > b && !locked[a] && !locked[b])
+						continue; // The other triangle of the edge adds it
+
+					Quadric q = quadrics[a];
+					q += quadrics[b];
+
+					const double aToB = locked[a] ? std::numeric_limits<double>::max() : q.Error(positions[b]);
+					const double bToA = locked[b] ? std::numeric_limits<double>::max() : q.Error(positions[a]);
+					if (aToB == std::numeric_limits<double>::max() && bToA == std::numeric_limits<double>::max())
+						continue;
+
+					collapses.push_back(aToB <= bToA ? Collapse{ a, b, aToB } : Collapse{ b, a, bToA });
+				}
+			}
+
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& l, const Collapse& r) { return l.error < r.error; });
+
+			for (unsigned int v = 0; v < vertexCount; v++)
+				remap[v] = v;
+			std::fill(touched.begin(), touched.end(), false);
+
+			size_t removedTriangles = 0;
+			const size_t trianglesToRemove = triangleCount - targetIndexCount / 3;
+
+			for (auto& collapse : collapses)
+			{
+				if (collapse.error > maxSqrError || removedTriangles >= trianglesToRemove)
+					break;
+
+				if (touched[collapse.from] || touched[collapse.to])
+					continue;
+
+				// Reject the collapses that would flip a triangle
+				bool flips = false;
+				size_t removed = 0;
+				for (unsigned int t = triangleStart[collapse.from]; t < triangleStart[collapse.from + 1] && !flips; t++)
+				{
+					const unsigned int* triangle = &current[(size_t)vertexTriangles[t] * 3];
+					if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+					{
+						removed++; // Becomes degenerate
+						continue;
+					}
+
+					Vector3 before[3], after[3];
+					for (int c = 0; c < 3; c++)
+					{
+						before[c] = positions[triangle[c]];
+						after[c] = positions[triangle[c] == collapse.from ? collapse.to : triangle[c]];
+					}
+
+					const Vector3 normalBefore = Vector3(before[1] - before[0]).Cross(Vector3(before[2] - before[0]));
+					const Vector3 normalAfter = Vector3(after[1] - after[0]).Cross(Vector3(after[2] - after[0]));
+					flips = Dot(normalBefore, normalAfter) <= 0.0f;
+				}
+
+				if (flips)
+					continue;
+
+				// The triangles around the collapse must not change again in this pass
+				for (unsigned int t = triangleStart[collapse.from]; t < triangleStart[collapse.from + 1]; t++)
+				{
+					const unsigned int* triangle = &current[(size_t)vertexTriangles[t] * 3];
+					touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+				}
+
+				remap[collapse.from] = collapse.to;
+				quadrics[collapse.to] += quadrics[collapse.from];
+				result.error = std::max(result.error, (float)std::sqrt(collapse.error));
+				removedTriangles += removed;
+			}
+
+			if (removedTriangles == 0)
+				break; // Nothing left that can be collapsed under maxError
+
+			// Apply the collapses and remove the degenerate triangles
+			size_t write = 0;
+			for (size_t i = 0; i < current.size(); i += 3)
+			{
+				const unsigned int a = remap[current[i]];
+				const unsigned int b = remap[current[i + 1]];
+				const unsigned int c = remap[current[i + 2]];
+				if (a == b || b == c || a == c)
+					continue;
+
+				current[write++] = a;
+				current[write++] = b;
+				current[write++] = c;
+			}
+			current.resize(write);
+		}
+
+		return result;
+	}
+}
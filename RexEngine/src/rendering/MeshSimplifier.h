@@ -0,0 +1,25 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "../math/Vectors.h"
+
+namespace RexEngine
+{
+	// Reduces the triangle count of an indexed mesh with edge collapses ordered by the quadric error metric (Garland & Heckbert)
+	// A vertex is always collapsed onto one of its neighbours, so the vertex buffer (normals, uvs) can be reused by the simplified indices
+	// The vertices on a border or on an attribute seam (same position, other normal/uv) never move
+	class MeshSimplifier
+	{
+	public:
+		struct Result
+		{
+			std::vector<unsigned int> indices;
+			float error = 0.0f; // Largest distance to the original surface introduced by a collapse (approximated by the quadrics)
+		};
+
+		// Stops at targetIndexCount, or before a collapse with an error above maxError (in the unit of the positions)
+		static Result Simplify(std::span<const Vector3> positions, std::span<const unsigned int> indices, size_t targetIndexCount, float maxError);
+	};
+}
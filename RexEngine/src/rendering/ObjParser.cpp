@@ -0,0 +1,315 @@
+#include "REPch.h"
+#include "ObjParser.h"
+
+#include <charconv>
+#include <execution>
+#include <thread>
+
+namespace RexEngine
+{
+	namespace
+	{
+		constexpr size_t MinChunkSize = 256 * 1024; // Under this, a thread doesn't have enough work
+		constexpr int32_t NoIndex = INT32_MIN; // The face corner has no uv or normal
+
+		// Which indices of a corner are relative to the chunk, resolved when the sizes of the previous chunks are known
+		constexpr uint8_t RelativePosition = 1 << 0;
+		constexpr uint8_t RelativeUV = 1 << 1;
+		constexpr uint8_t RelativeNormal = 1 << 2;
+
+		struct Corner
+		{
+			int32_t position;
+			int32_t uv;
+			int32_t normal;
+			uint8_t relative;
+		};
+
+		struct Chunk
+		{
+			std::string_view text;
+			std::vector<Vector3> positions;
+			std::vector<Vector3> normals;
+			std::vector<Vector2> uvs;
+			std::vector<Corner> corners; // 3 per triangle
+			size_t malformedLines = 0;
+		};
+
+		bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+		void SkipSpaces(const char*& p, const char* end)
+		{
+			while (p < end && IsSpace(*p))
+				p++;
+		}
+
+		bool AtLineEnd(const char* p, const char* end) { return p >= end || *p == '\n' || *p == '#'; }
+
+		bool ParseFloat(const char*& p, const char* end, float& value)
+		{
+			SkipSpaces(p, end);
+			if (p < end && *p == '+')
+				p++; // Not accepted by from_chars
+
+			auto [next, error] = std::from_chars(p, end, value);
+			if (error != std::errc())
+				return false;
+
+			p = next;
+			return true;
+		}
+
+		// Obj indices start at 1, the negative ones count from the end of the data read so far
+		// A relative index is stored as an index in the chunk (negative if it's in a previous chunk) and flagged
+		bool ParseIndex(const char*& p, const char* end, size_t chunkCount, int32_t& index, uint8_t& relative, uint8_t flag)
+		{
+			int32_t value;
+			auto [next, error] = std::from_chars(p, end, value);
+			if (error != std::errc() || value == 0)
+				return false;
+
+			p = next;
+			if (value > 0)
+				index = value - 1;
+			else
+			{
+				index = (int32_t)((int64_t)chunkCount + value);
+				relative |= flag;
+			}
+			return true;
+		}
+
+		bool ParseFace(const char*& p, const char* end, Chunk& chunk)
+		{
+			const size_t cornerCount = chunk.corners.size();
+			Corner first{};
+			Corner previous{};
+			int count = 0;
+
+			while (true)
+			{
+				SkipSpaces(p, end);
+				if (AtLineEnd(p, end))
+					break;
+
+				// v, v/vt, v//vn or v/vt/vn
+				Corner corner{ NoIndex, NoIndex, NoIndex, 0 };
+				bool valid = ParseIndex(p, end, chunk.positions.size(), corner.position, corner.relative, RelativePosition);
+				if (valid && p < end && *p == '/')
+				{
+					p++;
+					if (p < end && *p != '/')
+						valid = ParseIndex(p, end, chunk.uvs.size(), corner.uv, corner.relative, RelativeUV);
+
+					if (valid && p < end && *p == '/')
+					{
+						p++;
+						valid = ParseIndex(p, end, chunk.normals.size(), corner.normal, corner.relative, RelativeNormal);
+					}
+				}
+
+				if (!valid || (!AtLineEnd(p, end) && !IsSpace(*p)))
+				{
+					chunk.corners.resize(cornerCount);
+					return false;
+				}
+
+				// Fan triangulation
+				if (count == 0)
+					first = corner;
+				else if (count >= 2)
+					chunk.corners.insert(chunk.corners.end(), { first, previous, corner });
+
+				previous = corner;
+				count++;
+			}
+
+			return count >= 3;
+		}
+
+		void ParseChunk(Chunk& chunk)
+		{
+			const char* p = chunk.text.data();
+			const char* end = p + chunk.text.size();
+
+			while (p < end)
+			{
+				SkipSpaces(p, end);
+				const char* keyword = p;
+				while (p < end && !IsSpace(*p) && *p != '\n')
+					p++;
+				const std::string_view key(keyword, p - keyword);
+
+				bool valid = true;
+				if (key == "v")
+				{
+					Vector3 position;
+					valid = ParseFloat(p, end, position.x) && ParseFloat(p, end, position.y) && ParseFloat(p, end, position.z);
+					if (valid)
+						chunk.positions.push_back(position);
+				}
+				else if (key == "vn")
+				{
+					Vector3 normal;
+					valid = ParseFloat(p, end, normal.x) && ParseFloat(p, end, normal.y) && ParseFloat(p, end, normal.z);
+					if (valid)
+					{
+						const float length = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+						if (length > 0.0f)
+							normal = Vector3(normal.x / length, normal.y / length, normal.z / length);
+						chunk.normals.push_back(normal);
+					}
+				}
+				else if (key == "vt")
+				{
+					Vector2 uv(0, 0);
+					valid = ParseFloat(p, end, uv.x);
+					SkipSpaces(p, end);
+					if (valid && !AtLineEnd(p, end))
+						valid = ParseFloat(p, end, uv.y); // Optional
+					if (valid)
+						chunk.uvs.push_back(uv);
+				}
+				else if (key == "f")
+				{
+					valid = ParseFace(p, end, chunk);
+				}
+				// Comments, objects, groups, materials, ... are ignored
+
+				if (!valid)
+					chunk.malformedLines++;
+
+				// Next line, the end of a valid line (w of a vertex, third uv coordinate, ...) is ignored
+				const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+				p = newline ? newline + 1 : end;
+			}
+		}
+
+		// Index from the start of the file, NoIndex if out of [0, count[
+		int64_t Resolve(int32_t index, bool relative, size_t base, size_t count)
+		{
+			const int64_t resolved = relative ? (int64_t)base + index : (int64_t)index;
+			return resolved >= 0 && resolved < (int64_t)count ? resolved : (int64_t)NoIndex;
+		}
+
+		uint32_t HashVertex(const std::array<int32_t, 3>& key)
+		{
+			uint32_t hash = (uint32_t)key[0] * 0x9E3779B1u;
+			hash ^= (uint32_t)key[1] * 0x85EBCA77u + (hash << 6) + (hash >> 2);
+			hash ^= (uint32_t)key[2] * 0xC2B2AE3Du + (hash << 6) + (hash >> 2);
+			return hash ^ (hash >> 15);
+		}
+	}
+
+	ObjParser::Result ObjParser::Parse(std::string_view text)
+	{
+		// Cut the text at the first line end after each even split
+		const size_t maxChunks = std::max(1u, std::thread::hardware_concurrency()) * 4; // More chunks than threads, their cost isn't even
+		const size_t chunkCount = std::clamp<size_t>(text.size() / MinChunkSize, 1, maxChunks);
+
+		std::vector<Chunk> chunks(chunkCount);
+		size_t start = 0;
+		for (size_t i = 0; i < chunkCount; i++)
+		{
+			size_t stop = text.size();
+			if (i + 1 < chunkCount)
+			{
+				stop = text.find('\n', std::max(start, text.size() * (i + 1) / chunkCount));
+				stop = stop == std::string_view::npos ? text.size() : stop + 1;
+			}
+
+			chunks[i].text = text.substr(start, stop - start);
+			start = stop;
+		}
+
+		std::for_each(std::execution::par, chunks.begin(), chunks.end(), [](Chunk& chunk) { ParseChunk(chunk); });
+
+		// Data of the whole file
+		Result result;
+		std::vector<Vector3> positions;
+		std::vector<Vector3> normals;
+		std::vector<Vector2> uvs;
+		size_t cornerCount = 0;
+		for (auto& chunk : chunks)
+		{
+			positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+			normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+			uvs.insert(uvs.end(), chunk.uvs.begin(), chunk.uvs.end());
+			cornerCount += chunk.corners.size();
+			result.malformedLines += chunk.malformedLines;
+		}
+
+		// Unique vertices, open addressing with linear probing
+		constexpr uint32_t Empty = UINT32_MAX;
+		size_t capacity = 16;
+		while (capacity < cornerCount * 2)
+			capacity *= 2;
+
+		std::vector<uint32_t> table(capacity, Empty);
+		std::vector<std::array<int32_t, 3>> vertices; // <position, uv, normal> of each unique vertex
+		result.indices.reserve(cornerCount);
+
+		size_t positionBase = 0, uvBase = 0, normalBase = 0;
+		for (auto& chunk : chunks)
+		{
+			for (size_t i = 0; i + 2 < chunk.corners.size(); i += 3)
+			{
+				std::array<std::array<int32_t, 3>, 3> triangle;
+				bool valid = true;
+				for (size_t k = 0; k < 3; k++)
+				{
+					const Corner& corner = chunk.corners[i + k];
+					const int64_t position = Resolve(corner.position, corner.relative & RelativePosition, positionBase, positions.size());
+					const int64_t uv = corner.uv == NoIndex ? NoIndex : Resolve(corner.uv, corner.relative & RelativeUV, uvBase, uvs.size());
+					const int64_t normal = corner.normal == NoIndex ? NoIndex : Resolve(corner.normal, corner.relative & RelativeNormal, normalBase, normals.size());
+
+					valid &= position != NoIndex && (corner.uv == NoIndex || uv != NoIndex) && (corner.normal == NoIndex || normal != NoIndex);
+					triangle[k] = { (int32_t)position, (int32_t)uv, (int32_t)normal };
+				}
+
+				if (!valid)
+				{
+					result.invalidTriangles++;
+					continue;
+				}
+
+				for (auto& key : triangle)
+				{
+					size_t slot = HashVertex(key) & (capacity - 1);
+					while (table[slot] != Empty && vertices[table[slot]] != key)
+						slot = (slot + 1) & (capacity - 1);
+
+					if (table[slot] == Empty)
+					{
+						table[slot] = (uint32_t)vertices.size();
+						vertices.push_back(key);
+					}
+
+					result.indices.push_back(table[slot]);
+				}
+			}
+
+			positionBase += chunk.positions.size();
+			uvBase += chunk.uvs.size();
+			normalBase += chunk.normals.size();
+		}
+
+		// Vertex data
+		result.positions.reserve(vertices.size());
+		if (!normals.empty())
+			result.normals.reserve(vertices.size());
+		if (!uvs.empty())
+			result.uvs.reserve(vertices.size());
+
+		for (auto& [position, uv, normal] : vertices)
+		{
+			result.positions.push_back(positions[position]);
+			if (!normals.empty())
+				result.normals.push_back(normal != NoIndex ? normals[normal] : Vector3(0, 0, 0));
+			if (!uvs.empty())
+				result.uvs.push_back(uv != NoIndex ? uvs[uv] : Vector2(0, 0));
+		}
+
+		return result;
+	}
+}
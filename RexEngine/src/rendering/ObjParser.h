@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+#include <string_view>
+
+#include "../math/Vectors.h"
+
+namespace RexEngine
+{
+	// Reads the geometry of an obj file, used by Mesh::FromObj()
+	// The text is cut in chunks at line ends, parsed in parallel without copying the lines, then the vertices are merged
+	// Supported : v, vn, vt and f (polygons are triangulated as fans, negative indices are relative), the other lines are ignored
+	// Malformed lines and faces referencing missing data are skipped and counted
+	class ObjParser
+	{
+	public:
+		// Indexed mesh, one vertex per unique <position, uv, normal> of the faces
+		struct Result
+		{
+			std::vector<Vector3> positions;
+			std::vector<Vector3> normals; // Empty if the file has none, a vertex without normal gets a null one
+			std::vector<Vector2> uvs; // Empty if the file has none, a vertex without uv gets (0, 0)
+			std::vector<unsigned int> indices;
+			size_t malformedLines = 0;
+			size_t invalidTriangles = 0; // Index out of the data of the file
+		};
+
+		static Result Parse(std::string_view text);
+	};
+}
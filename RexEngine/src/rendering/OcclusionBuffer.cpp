@@ -0,0 +1,303 @@
+#include "REPch.h"
+#include "OcclusionBuffer.h"
+
+#include <cstring>
+#include <numeric>
+#include <execution>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+	#define RE_OCCLUSION_SSE
+	#include <xmmintrin.h>
+#endif
+
+namespace RexEngine
+{
+	namespace
+	{
+		constexpr float MinW = 1e-5f;
+		constexpr int BandHeight = 16; // Rows rasterized by a single task
+
+		struct ClipPosition { float x, y, z, w; };
+
+		ClipPosition ToClip(const Matrix4& matrix, float x, float y, float z)
+		{
+			ClipPosition clip;
+			clip.x = matrix[0][0] * x + matrix[1][0] * y + matrix[2][0] * z + matrix[3][0];
+			clip.y = matrix[0][1] * x + matrix[1][1] * y + matrix[2][1] * z + matrix[3][1];
+			clip.z = matrix[0][2] * x + matrix[1][2] * y + matrix[2][2] * z + matrix[3][2];
+			clip.w = matrix[0][3] * x + matrix[1][3] * y + matrix[2][3] * z + matrix[3][3];
+			return clip;
+		}
+	}
+
+	OcclusionBuffer::OcclusionBuffer(int width, int height)
+		: m_width(width), m_height(height)
+	{
+		RE_ASSERT(width > 0 && height > 0 && width % 4 == 0, "Invalid occlusion buffer size : {}x{}", width, height);
+
+		// Full resolution down to 1x1
+		int levelWidth = width;
+		int levelHeight = height;
+		while (true)
+		{
+			m_levels.push_back({ levelWidth, levelHeight, std::vector<float>((size_t)levelWidth * levelHeight, 1.0f) });
+			if (levelWidth == 1 && levelHeight == 1)
+				break;
+
+			levelWidth = (levelWidth + 1) / 2;
+			levelHeight = (levelHeight + 1) / 2;
+		}
+	}
+
+	void OcclusionBuffer::Clear()
+	{
+		m_triangles.clear();
+		for (auto& level : m_levels)
+			std::fill(level.depth.begin(), level.depth.end(), 1.0f);
+	}
+
+	void OcclusionBuffer::AddOccluder(const Matrix4& modelViewProjection, std::span<const uint8_t> vertexData, size_t vertexStride, std::span<const unsigned int> indices)
+	{
+		RE_ASSERT(vertexStride >= sizeof(float) * 3, "Invalid vertex stride : {}", vertexStride);
+
+		const size_t vertexCount = vertexData.size() / vertexStride;
+
+		// Screen space positions, w <= 0 marks the vertices behind the camera
+		static std::vector<ClipPosition> screen;
+		screen.resize(vertexCount);
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			float position[3];
+			std::memcpy(position, vertexData.data() + i * vertexStride, sizeof(position));
+
+			ClipPosition clip = ToClip(modelViewProjection, position[0], position[1], position[2]);
+			if (clip.w > MinW)
+			{
+				const float inverseW = 1.0f / clip.w;
+				clip.x = (clip.x * inverseW * 0.5f + 0.5f) * m_width;
+				clip.y = (clip.y * inverseW * 0.5f + 0.5f) * m_height;
+				clip.z = clip.z * inverseW * 0.5f + 0.5f;
+			}
+			screen[i] = clip;
+		}
+
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			const ClipPosition* v[3] = { &screen[indices[i]], &screen[indices[i + 1]], &screen[indices[i + 2]] };
+
+			// Crosses the near plane, skipping it is conservative
+			if (v[0]->w <= MinW || v[1]->w <= MinW || v[2]->w <= MinW)
+				continue;
+
+			// Make the triangles counter clockwise, the occluders are double sided
+			const float area = (v[1]->x - v[0]->x) * (v[2]->y - v[0]->y) - (v[1]->y - v[0]->y) * (v[2]->x - v[0]->x);
+			if (area == 0.0f)
+				continue;
+			if (area < 0.0f)
+				std::swap(v[1], v[2]);
+
+			Triangle triangle;
+			for (int j = 0; j < 3; j++)
+			{
+				triangle.x[j] = v[j]->x;
+				triangle.y[j] = v[j]->y;
+				triangle.z[j] = v[j]->z;
+			}
+
+			// Pixels whose center is inside the bounds of the triangle
+			const float minX = std::min({ triangle.x[0], triangle.x[1], triangle.x[2] });
+			const float maxX = std::max({ triangle.x[0], triangle.x[1], triangle.x[2] });
+			const float minY = std::min({ triangle.y[0], triangle.y[1], triangle.y[2] });
+			const float maxY = std::max({ triangle.y[0], triangle.y[1], triangle.y[2] });
+
+			triangle.minX = std::max(0, (int)std::ceil(minX - 0.5f));
+			triangle.maxX = std::min(m_width - 1, (int)std::floor(maxX - 0.5f));
+			triangle.minY = std::max(0, (int)std::ceil(minY - 0.5f));
+			triangle.maxY = std::min(m_height - 1, (int)std::floor(maxY - 0.5f));
+
+			if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+				continue; // Off screen or too small to cover a pixel center
+
+			m_triangles.push_back(triangle);
+		}
+	}
+
+	void OcclusionBuffer::Rasterize()
+	{
+		// The bands don't share any pixel, so they don't need any synchronisation
+		std::vector<int> bands((m_height + BandHeight - 1) / BandHeight);
+		std::iota(bands.begin(), bands.end(), 0);
+
+		std::for_each(std::execution::par, bands.begin(), bands.end(), [this](int band) {
+			RasterizeBand(band * BandHeight, std::min(m_height, (band + 1) * BandHeight) - 1);
+		});
+
+		BuildHierarchy();
+	}
+
+	void OcclusionBuffer::RasterizeBand(int startY, int endY)
+	{
+		for (auto& triangle : m_triangles)
+		{
+			if (triangle.maxY < startY || triangle.minY > endY)
+				continue;
+
+			RasterizeTriangle(triangle, std::max(startY, triangle.minY), std::min(endY, triangle.maxY));
+		}
+	}
+
+	void OcclusionBuffer::RasterizeTriangle(const Triangle& triangle, int startY, int endY)
+	{
+		// Edge functions : e(x, y) = a * x + b * y + c, positive inside the triangle
+		float a[3], b[3], c[3];
+		for (int i = 0; i < 3; i++)
+		{
+			const int j = (i + 1) % 3;
+			a[i] = triangle.y[i] - triangle.y[j];
+			b[i] = triangle.x[j] - triangle.x[i];
+			c[i] = triangle.x[i] * triangle.y[j] - triangle.x[j] * triangle.y[i];
+		}
+
+		// Edge i is opposite to the vertex (i + 2) % 3, so the depth is interpolated with these weights
+		const float area = c[0] + c[1] + c[2];
+		const float z[3] = { triangle.z[2] / area, triangle.z[0] / area, triangle.z[1] / area };
+
+		// Depth plane : z(x, y) = zA * x + zB * y + zC
+		const float zA = a[0] * z[0] + a[1] * z[1] + a[2] * z[2];
+		const float zB = b[0] * z[0] + b[1] * z[1] + b[2] * z[2];
+		const float zC = c[0] * z[0] + c[1] * z[1] + c[2] * z[2];
+
+		float* depth = m_levels[0].depth.data();
+		const int startX = triangle.minX & ~3; // Aligned on 4 pixels for the SIMD path
+
+		for (int y = startY; y <= endY; y++)
+		{
+			const float py = y + 0.5f;
+			float* row = depth + (size_t)y * m_width;
+			int x = startX;
+
+#ifdef RE_OCCLUSION_SSE
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+
+			__m128 e[3];
+			__m128 step[3];
+			for (int i = 0; i < 3; i++)
+			{
+				e[i] = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[i]), _mm_add_ps(_mm_set1_ps((float)x), offsets)), _mm_set1_ps(b[i] * py + c[i]));
+				step[i] = _mm_set1_ps(a[i] * 4.0f);
+			}
+
+			__m128 z4 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(zA), _mm_add_ps(_mm_set1_ps((float)x), offsets)), _mm_set1_ps(zB * py + zC));
+			const __m128 zStep = _mm_set1_ps(zA * 4.0f);
+
+			for (; x <= triangle.maxX; x += 4)
+			{
+				const __m128 inside = _mm_and_ps(_mm_cmpge_ps(e[0], zero), _mm_and_ps(_mm_cmpge_ps(e[1], zero), _mm_cmpge_ps(e[2], zero)));
+				if (_mm_movemask_ps(inside) != 0)
+				{
+					const __m128 old = _mm_loadu_ps(row + x);
+					const __m128 closest = _mm_min_ps(old, z4);
+					_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, closest), _mm_andnot_ps(inside, old)));
+				}
+
+				for (int i = 0; i < 3; i++)
+					e[i] = _mm_add_ps(e[i], step[i]);
+				z4 = _mm_add_ps(z4, zStep);
+			}
+#else
+			for (; x <= triangle.maxX; x++)
+			{
+				const float px = x + 0.5f;
+				if (a[0] * px + b[0] * py + c[0] < 0.0f || a[1] * px + b[1] * py + c[1] < 0.0f || a[2] * px + b[2] * py + c[2] < 0.0f)
+					continue;
+
+				row[x] = std::min(row[x], zA * px + zB * py + zC);
+			}
+#endif
+		}
+	}
+
+	void OcclusionBuffer::BuildHierarchy()
+	{
+		for (size_t l = 1; l < m_levels.size(); l++)
+		{
+			const Level& source = m_levels[l - 1];
+			Level& level = m_levels[l];
+
+			for (int y = 0; y < level.height; y++)
+			{
+				const int y0 = y * 2;
+				const int y1 = std::min(y0 + 1, source.height - 1);
+				for (int x = 0; x < level.width; x++)
+				{
+					const int x0 = x * 2;
+					const int x1 = std::min(x0 + 1, source.width - 1);
+
+					level.depth[(size_t)y * level.width + x] = std::max(
+						std::max(source.depth[(size_t)y0 * source.width + x0], source.depth[(size_t)y0 * source.width + x1]),
+						std::max(source.depth[(size_t)y1 * source.width + x0], source.depth[(size_t)y1 * source.width + x1]));
+				}
+			}
+		}
+	}
+
+	bool OcclusionBuffer::IsVisible(const BoundingBox& worldBox, const Matrix4& viewProjection) const
+	{
+		float minX = std::numeric_limits<float>::max(), maxX = -std::numeric_limits<float>::max();
+		float minY = std::numeric_limits<float>::max(), maxY = -std::numeric_limits<float>::max();
+		float minZ = std::numeric_limits<float>::max();
+
+		for (int i = 0; i < 8; i++)
+		{
+			const ClipPosition clip = ToClip(viewProjection,
+				(i & 1) ? worldBox.max.x : worldBox.min.x,
+				(i & 2) ? worldBox.max.y : worldBox.min.y,
+				(i & 4) ? worldBox.max.z : worldBox.min.z);
+
+			if (clip.w <= MinW)
+				return true; // Crosses the near plane, the camera is (almost) inside
+
+			const float inverseW = 1.0f / clip.w;
+			const float x = (clip.x * inverseW * 0.5f + 0.5f) * m_width;
+			const float y = (clip.y * inverseW * 0.5f + 0.5f) * m_height;
+			minX = std::min(minX, x); maxX = std::max(maxX, x);
+			minY = std::min(minY, y); maxY = std::max(maxY, y);
+			minZ = std::min(minZ, clip.z * inverseW * 0.5f + 0.5f);
+		}
+
+		// Fully off screen, this is for the frustum culling to decide
+		if (maxX < 0.0f || maxY < 0.0f || minX >= (float)m_width || minY >= (float)m_height)
+			return true;
+
+		if (minZ <= 0.0f)
+			return true;
+
+		// Every pixel touched by the screen rectangle of the box
+		int x0 = std::max(0, (int)std::floor(minX));
+		int x1 = std::min(m_width - 1, (int)std::floor(maxX));
+		int y0 = std::max(0, (int)std::floor(minY));
+		int y1 = std::min(m_height - 1, (int)std::floor(maxY));
+
+		// The first level where the rectangle is at most 2x2 texels
+		size_t l = 0;
+		while (l + 1 < m_levels.size() && (x1 - x0 > 1 || y1 - y0 > 1))
+		{
+			x0 >>= 1; x1 >>= 1;
+			y0 >>= 1; y1 >>= 1;
+			l++;
+		}
+
+		const Level& level = m_levels[l];
+		for (int y = y0; y <= y1; y++)
+		{
+			for (int x = x0; x <= x1; x++)
+			{
+				if (minZ <= level.depth[(size_t)y * level.width + x])
+					return true;
+			}
+		}
+
+		return false;
+	}
+}
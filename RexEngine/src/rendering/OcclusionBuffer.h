@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <cstdint>
+
+#include "../math/Vectors.h"
+#include "../math/Matrix.h"
+#include "../math/Bounds.h"
+
+namespace RexEngine
+{
+	// Low resolution depth buffer rasterized on the CPU, used to cull the objects hidden behind occluders
+	// Does not use the RenderApi, so it also works without a GPU
+	// Depth is in [0, 1] (0 = near plane), the buffer is cleared to 1
+	class OcclusionBuffer
+	{
+	public:
+		// width must be a multiple of 4
+		OcclusionBuffer(int width = 256, int height = 128);
+
+		// Removes the occluders and clears the depth
+		void Clear();
+
+		// Queue the triangles of a mesh, the position is the first Vector3 of each vertex
+		// The triangles crossing the near plane are skipped (less occlusion, never wrong)
+		void AddOccluder(const Matrix4& modelViewProjection, std::span<const uint8_t> vertexData, size_t vertexStride, std::span<const unsigned int> indices);
+
+		// Rasterize the occluders added since Clear(), in horizontal bands on multiple threads, then build the hierarchical depth
+		void Rasterize();
+
+		// False if the box is completely behind the occluders
+		bool IsVisible(const BoundingBox& worldBox, const Matrix4& viewProjection) const;
+
+		int GetWidth() const { return m_width; }
+		int GetHeight() const { return m_height; }
+		float GetDepth(int x, int y) const { return m_levels[0].depth[y * m_width + x]; }
+		size_t GetTriangleCount() const { return m_triangles.size(); }
+
+	private:
+		// Screen space triangle
+		struct Triangle
+		{
+			float x[3];
+			float y[3];
+			float z[3];
+			int minX, maxX, minY, maxY; // Pixel bounds, inclusive
+		};
+
+		// Each level keeps the max (furthest) depth of 2x2 texels of the previous one
+		struct Level
+		{
+			int width;
+			int height;
+			std::vector<float> depth;
+		};
+
+		void RasterizeBand(int startY, int endY);
+		void RasterizeTriangle(const Triangle& triangle, int startY, int endY);
+		void BuildHierarchy();
+
+	private:
+		int m_width;
+		int m_height;
+
+		std::vector<Triangle> m_triangles;
+		std::vector<Level> m_levels; // 0 is the full resolution buffer
+	};
+}
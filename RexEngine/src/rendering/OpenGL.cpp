@@ -1,10 +1,14 @@
 #include <REPch.h>
 
+#include <optional>
+#include <condition_variable>
+
 #include "RenderApi.h"
 
 #include "core/Libs.h"
 #include "Texture.h"
 #include "Cubemap.h"
+#include "CommandStream.h"
 
 namespace RexEngine::Internal {
 	unsigned int BufferTypeToGLType(RenderApi::BufferType type)
@@ -19,27 +23,44 @@ namespace RexEngine::Internal {
 			return GL_UNIFORM_BUFFER;
 		case RenderApi::BufferType::ShaderStorage:
 			return GL_SHADER_STORAGE_BUFFER;
+		case RenderApi::BufferType::Indirect:
+			return GL_DRAW_INDIRECT_BUFFER;
 		}
 
 		return 0;
 	}
 
-	// <GL type, count, size(bytes)>
-	std::tuple<unsigned int, int, size_t> AttributeTypeToGLType(RenderApi::VertexAttributeType type)
+	// <GL type, count, size(bytes) of a component, normalized>
+	std::tuple<unsigned int, int, size_t, bool> AttributeTypeToGLType(RenderApi::VertexAttributeType type)
 	{
 		switch (type)
 		{
 		case RenderApi::VertexAttributeType::Float:
-			return std::make_tuple(GL_FLOAT, 1, sizeof(float));
+			return std::make_tuple(GL_FLOAT, 1, sizeof(float), false);
 		case RenderApi::VertexAttributeType::Float2:
-			return std::make_tuple(GL_FLOAT, 2, sizeof(float));
+			return std::make_tuple(GL_FLOAT, 2, sizeof(float), false);
 		case RenderApi::VertexAttributeType::Float3:
-			return std::make_tuple(GL_FLOAT, 3, sizeof(float));
+			return std::make_tuple(GL_FLOAT, 3, sizeof(float), false);
 		case RenderApi::VertexAttributeType::Float4:
-			return std::make_tuple(GL_FLOAT, 4, sizeof(float));
+			return std::make_tuple(GL_FLOAT, 4, sizeof(float), false);
+		case RenderApi::VertexAttributeType::Half2:
+			return std::make_tuple(GL_HALF_FLOAT, 2, sizeof(uint16_t), false);
+		case RenderApi::VertexAttributeType::Half4:
+			return std::make_tuple(GL_HALF_FLOAT, 4, sizeof(uint16_t), false);
+		case RenderApi::VertexAttributeType::Short2Normalized:
+			return std::make_tuple(GL_SHORT, 2, sizeof(int16_t), true);
+		case RenderApi::VertexAttributeType::Short4Normalized:
+			return std::make_tuple(GL_SHORT, 4, sizeof(int16_t), true);
+		case RenderApi::VertexAttributeType::Byte4Normalized:
+			return std::make_tuple(GL_BYTE, 4, sizeof(int8_t), true);
 		}
 
-		return std::make_tuple(0,0,0);
+		return std::make_tuple(0, 0, 0, false);
+	}
+
+	unsigned int IndexTypeToGL(RenderApi::IndexType type)
+	{
+		return type == RenderApi::IndexType::UInt16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
 	}
 
 	unsigned int TextureTargetToGL(RenderApi::TextureTarget target)
@@ -126,6 +147,8 @@ namespace RexEngine::Internal {
 			return GL_LINEAR;
 		case RenderApi::TextureOptionValue::LinearMipmap:
 			return GL_LINEAR_MIPMAP_LINEAR;
+		case RenderApi::TextureOptionValue::Nearest:
+			return GL_NEAREST;
 		}
 
 		RE_ASSERT(false, "Invalid texture option value !");
@@ -144,6 +167,8 @@ namespace RexEngine::Internal {
 			return RenderApi::TextureOptionValue::Linear;
 		case GL_LINEAR_MIPMAP_LINEAR:
 			return RenderApi::TextureOptionValue::LinearMipmap;
+		case GL_NEAREST:
+			return RenderApi::TextureOptionValue::Nearest;
 		}
 
 		RE_ASSERT(false, "Invalid texture option value !");
@@ -193,12 +218,162 @@ namespace RexEngine::Internal {
 		}
 	}
 
+	// Last state set through the RenderApi, the calls that would not change it are not sent to the driver
+	// Unknown values are always set again : never set yet, or changed outside of the RenderApi
+	struct GLState
+	{
+		inline static constexpr unsigned int Unknown = std::numeric_limits<unsigned int>::max();
+		inline static constexpr int BufferTypes = 5; // RenderApi::BufferType
+		inline static constexpr int IndexedBindings = 16; // Uniforms and ShaderStorage binding points
+		inline static constexpr int TextureUnits = 32;
+		inline static constexpr int TextureTargets = 3; // RenderApi::TextureTarget
+
+		struct IndexedBinding
+		{
+			unsigned int id = Unknown;
+			size_t offset = 0;
+			size_t size = 0; // 0 for the whole buffer
+
+			bool operator==(const IndexedBinding&) const = default;
+		};
+
+		unsigned int program = Unknown;
+		unsigned int vertexAttributes = Unknown;
+		unsigned int buffers[BufferTypes];
+		IndexedBinding indexedBuffers[BufferTypes][IndexedBindings];
+		int activeTexture = -1;
+		unsigned int textures[TextureUnits][TextureTargets];
+		int cullingMode = -1;
+		int depthFunction = -1;
+		int depthWrite = -1;
+		std::pair<float, float> depthRange = { -1.0f, -1.0f };
+		unsigned int readFrameBuffer = Unknown;
+		unsigned int drawFrameBuffer = Unknown;
+		Vector2Int viewportSize = { -1, -1 }; // Not filtered, kept so reading it doesn't wait for the driver
+
+		GLState()
+		{
+			std::fill(std::begin(buffers), std::end(buffers), Unknown);
+			for (auto& unit : textures)
+				std::fill(std::begin(unit), std::end(unit), Unknown);
+		}
+	};
+
+	// GL_ARB_bindless_texture is not part of the glad loader, loaded on the first RenderApi::SupportsBindlessTextures() call
+	struct BindlessTextureFunctions
+	{
+		GLuint64(APIENTRYP getTextureHandle)(GLuint texture) = nullptr;
+		void(APIENTRYP makeTextureHandleResident)(GLuint64 handle) = nullptr;
+		void(APIENTRYP makeTextureHandleNonResident)(GLuint64 handle) = nullptr;
+	};
+
+	static BindlessTextureFunctions s_bindless;
+
+	bool LoadBindlessTextures()
+	{
+		GLint extensionCount;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+
+		for (GLint i = 0; i < extensionCount; i++)
+		{
+			const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+			if (std::strcmp(name, "GL_ARB_bindless_texture") != 0)
+				continue;
+
+			s_bindless.getTextureHandle = reinterpret_cast<decltype(s_bindless.getTextureHandle)>(glfwGetProcAddress("glGetTextureHandleARB"));
+			s_bindless.makeTextureHandleResident = reinterpret_cast<decltype(s_bindless.makeTextureHandleResident)>(glfwGetProcAddress("glMakeTextureHandleResidentARB"));
+			s_bindless.makeTextureHandleNonResident = reinterpret_cast<decltype(s_bindless.makeTextureHandleNonResident)>(glfwGetProcAddress("glMakeTextureHandleNonResidentARB"));
+
+			return s_bindless.getTextureHandle && s_bindless.makeTextureHandleResident && s_bindless.makeTextureHandleNonResident;
+		}
+
+		return false;
+	}
+
+	static GLState s_state;
+	static RenderApi::StateStats s_stateStats;
+	static RenderApi::StateStats s_lastStateStats;
+
+	// Returns true if the call has to be issued, cached is updated to the new value
+	template<typename T>
+	bool ShouldSetState(T& cached, const T& value)
+	{
+		if (cached == value)
+		{
+			s_stateStats.filtered++;
+			return false;
+		}
+
+		cached = value;
+		s_stateStats.issued++;
+		return true;
+	}
+
+	// Binding points that are not cached, always issued
+	bool ShouldSetState()
+	{
+		s_stateStats.issued++;
+		return true;
+	}
+
+	// The thread owning the context, see RenderApi::StartRenderThread()
+	// The functions sent to it run in order, a caller waits for its own by comparing its ticket to finished
+	struct RenderThread
+	{
+		std::thread thread;
+		std::thread::id id;
+		GLFWwindow* window = nullptr; // Its context is current on the thread
+		bool running = false; // Main thread only
+
+		std::mutex mutex;
+		std::condition_variable jobAdded;
+		std::condition_variable jobFinished;
+		std::deque<std::function<void()>> jobs;
+		uint64_t posted = 0;
+		uint64_t finished = 0;
+		bool stopping = false;
+
+		// Logged by the main thread, the log listeners are not thread safe
+		std::vector<std::string> errors;
+	};
+
+	static NoDestroy<RenderThread> s_renderThread;
+
+	bool IsRenderThread()
+	{
+		return std::this_thread::get_id() == s_renderThread->id;
+	}
+
+	void ReportError(const std::string& message)
+	{
+		if (!IsRenderThread())
+		{
+			RE_LOG_ERROR("{}", message);
+			return;
+		}
+
+		std::lock_guard lock(s_renderThread->mutex);
+		s_renderThread->errors.push_back(message);
+	}
+
+	void LogRenderThreadErrors()
+	{
+		std::vector<std::string> errors;
+		{
+			std::lock_guard lock(s_renderThread->mutex);
+			std::swap(errors, s_renderThread->errors);
+		}
+
+		for (auto& error : errors)
+			RE_LOG_ERROR("{}", error);
+	}
+
 	void GlCheckErrors()
 	{
 		GLenum err;
 		while ((err = glGetError()) != GL_NO_ERROR)
 		{
-			RE_LOG_ERROR("OpenGL error : {}", err);
+			ReportError(std::format("OpenGL error : {}", err));
 			RE_DEBUG_BREAK();
 		}
 	}
@@ -206,10 +381,377 @@ namespace RexEngine::Internal {
 
 #define GL_CALL(x) x;Internal::GlCheckErrors();
 
+namespace RexEngine::Internal
+{
+	// The GL calls that can be recorded in a CommandStream, their parameters are the payload of the command
+	namespace GLCommands
+	{
+		void UseProgram(GLuint id) { GL_CALL(glUseProgram(id)); }
+		void UniformMatrix4(GLint location, Matrix4 matrix) { GL_CALL(glUniformMatrix4fv(location, 1, GL_FALSE, &matrix[0][0])); }
+		void Uniform3(GLint location, Vector3 vec) { GL_CALL(glUniform3fv(location, 1, &vec[0])); }
+		void Uniform1f(GLint location, float value) { GL_CALL(glUniform1f(location, value)); }
+		void Uniform1i(GLint location, int value) { GL_CALL(glUniform1i(location, value)); }
+		void BindBuffer(GLenum target, GLuint id) { GL_CALL(glBindBuffer(target, id)); }
+		void BufferSubData(GLenum target, GLintptr offset, CommandStream::Bytes data) { GL_CALL(glBufferSubData(target, offset, data.size(), data.data())); }
+		void CopyBufferSubData(GLuint from, GLuint to, GLintptr fromOffset, GLintptr toOffset, GLsizeiptr size) { GL_CALL(glCopyNamedBufferSubData(from, to, fromOffset, toOffset, size)); }
+		void BindBufferBase(GLenum target, GLuint index, GLuint id) { GL_CALL(glBindBufferBase(target, index, id)); }
+		void BindBufferRange(GLenum target, GLuint index, GLuint id, GLintptr offset, GLsizeiptr size) { GL_CALL(glBindBufferRange(target, index, id, offset, size)); }
+		void BindVertexArray(GLuint id) { GL_CALL(glBindVertexArray(id)); }
+		void BindTexture(GLenum target, GLuint id) { GL_CALL(glBindTexture(target, id)); }
+		void TexParameter(GLenum target, GLenum option, GLint value) { GL_CALL(glTexParameteri(target, option, value)); }
+		void ActiveTexture(GLenum unit) { GL_CALL(glActiveTexture(unit)); }
+		void GenerateMipmap(GLenum target) { GL_CALL(glGenerateMipmap(target)); }
+		void Viewport(GLint x, GLint y, GLsizei width, GLsizei height) { GL_CALL(glViewport(x, y, width, height)); }
+		void Clear(GLbitfield mask) { GL_CALL(glClear(mask)); }
+		// The offsets in the index buffer are in bytes
+		void DrawElements(GLsizei count, size_t offset, GLint baseVertex, GLenum indexType) { GL_CALL(glDrawElementsBaseVertex(GL_TRIANGLES, count, indexType, (const void*)offset, baseVertex)); }
+		void MultiDrawElementsIndirect(GLsizei drawCount, size_t offset, GLenum indexType) { GL_CALL(glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, (const void*)offset, drawCount, 0)); }
+
+		void DrawElementsInstanced(GLsizei count, size_t offset, GLsizei instanceCount, GLuint firstInstance, GLint baseVertex, GLenum indexType)
+		{
+			GL_CALL(glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, count, indexType, (const void*)offset, instanceCount, baseVertex, firstInstance));
+		}
+		void DepthFunc(GLenum function) { GL_CALL(glDepthFunc(function)); }
+		void DepthMask(GLboolean enabled) { GL_CALL(glDepthMask(enabled)); }
+		void DepthRange(float zNear, float zFar) { GL_CALL(glDepthRange(zNear, zFar)); }
+		void BeginQuery(GLuint id) { GL_CALL(glBeginQuery(GL_TIME_ELAPSED, id)); }
+		void EndQuery() { GL_CALL(glEndQuery(GL_TIME_ELAPSED)); }
+		void BindRenderbuffer(GLuint id) { GL_CALL(glBindRenderbuffer(GL_RENDERBUFFER, id)); }
+		void BindFramebuffer(GLenum target, GLuint id) { GL_CALL(glBindFramebuffer(target, id)); }
+		void FramebufferTexture2D(GLenum attachment, GLenum target, GLuint texture, GLint mip) { GL_CALL(glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, target, texture, mip)); }
+		void FramebufferRenderbuffer(GLenum attachment, GLuint id) { GL_CALL(glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment, GL_RENDERBUFFER, id)); }
+
+		void BlitFramebuffer(Vector2Int inStart, Vector2Int inEnd, Vector2Int outStart, Vector2Int outEnd, GLbitfield mask)
+		{
+			GL_CALL(glBlitFramebuffer(inStart.x, inStart.y, inEnd.x, inEnd.y, outStart.x, outStart.y, outEnd.x, outEnd.y, mask, GL_NEAREST));
+		}
+
+		void CullingMode(RenderApi::CullingMode mode)
+		{
+			switch (mode)
+			{
+			case RexEngine::RenderApi::CullingMode::Front:
+				GL_CALL(glEnable(GL_CULL_FACE));
+				GL_CALL(glCullFace(GL_BACK)); // Inverted because we want to keep the front face
+				break;
+			case RexEngine::RenderApi::CullingMode::Back:
+				GL_CALL(glEnable(GL_CULL_FACE));
+				GL_CALL(glCullFace(GL_FRONT));
+				break;
+			case RexEngine::RenderApi::CullingMode::Both:
+				GL_CALL(glDisable(GL_CULL_FACE));
+				break;
+			}
+		}
+	}
+
+	template<auto A, auto B>
+	constexpr bool IsSameCommand = std::is_same_v<std::integral_constant<decltype(A), A>, std::integral_constant<decltype(B), B>>;
+
+	// Calls a command with the arguments read from the stream, in the order of its parameters
+	template<typename... Params>
+	void ReplayCommand(void(*command)(Params...), CommandStream::Reader& reader)
+	{
+		std::tuple<std::decay_t<Params>...> args{ reader.Read<std::decay_t<Params>>()... };
+		std::apply(command, args);
+	}
+
+	// Reads the arguments of a command without calling it
+	template<typename... Params>
+	void SkipCommand(void(*)(Params...), CommandStream::Reader& reader)
+	{
+		[[maybe_unused]] std::tuple<std::decay_t<Params>...> args{ reader.Read<std::decay_t<Params>>()... };
+	}
+
+	// The opcode of a command is its index in the list
+	template<auto... Commands>
+	struct CommandTable
+	{
+		static_assert(sizeof...(Commands) <= 256, "The opcodes are one byte");
+
+		template<auto Command>
+		static constexpr CommandStream::OpCode OpCode()
+		{
+			size_t index = 0;
+			size_t found = SIZE_MAX;
+			((found = IsSameCommand<Command, Commands> ? index : found, index++), ...);
+			return static_cast<CommandStream::OpCode>(found);
+		}
+
+		static void Replay(CommandStream::OpCode op, CommandStream::Reader& reader)
+		{
+			using Replayer = void(*)(CommandStream::Reader&);
+			static constexpr Replayer replayers[] = { [](CommandStream::Reader& r) { ReplayCommand(Commands, r); }... };
+			replayers[op](reader);
+		}
+
+		static void Skip(CommandStream::OpCode op, CommandStream::Reader& reader)
+		{
+			using Skipper = void(*)(CommandStream::Reader&);
+			static constexpr Skipper skippers[] = { [](CommandStream::Reader& r) { SkipCommand(Commands, r); }... };
+			skippers[op](reader);
+		}
+	};
+
+	using RecordedCommands = CommandTable<
+		&GLCommands::UseProgram, &GLCommands::UniformMatrix4, &GLCommands::Uniform3, &GLCommands::Uniform1f, &GLCommands::Uniform1i,
+		&GLCommands::BindBuffer, &GLCommands::BufferSubData, &GLCommands::CopyBufferSubData, &GLCommands::BindBufferBase, &GLCommands::BindBufferRange, &GLCommands::BindVertexArray,
+		&GLCommands::BindTexture, &GLCommands::TexParameter, &GLCommands::ActiveTexture, &GLCommands::GenerateMipmap,
+		&GLCommands::Viewport, &GLCommands::Clear, &GLCommands::DrawElements, &GLCommands::DrawElementsInstanced, &GLCommands::MultiDrawElementsIndirect,
+		&GLCommands::CullingMode, &GLCommands::DepthFunc, &GLCommands::DepthMask, &GLCommands::DepthRange, &GLCommands::BeginQuery, &GLCommands::EndQuery,
+		&GLCommands::BindRenderbuffer, &GLCommands::BindFramebuffer, &GLCommands::FramebufferTexture2D, &GLCommands::FramebufferRenderbuffer, &GLCommands::BlitFramebuffer>;
+
+	// The commands still replayed in RenderApi::RecordOnly : the cpu copies of the buffers are already updated, the gpu ones must follow
+	// The bindings are needed by the uploads, the vertex attributes hold the index buffer binding
+	bool IsUploadCommand(CommandStream::OpCode op)
+	{
+		static constexpr CommandStream::OpCode uploads[] = {
+			RecordedCommands::OpCode<&GLCommands::BufferSubData>(), RecordedCommands::OpCode<&GLCommands::CopyBufferSubData>(), RecordedCommands::OpCode<&GLCommands::BindBuffer>(),
+			RecordedCommands::OpCode<&GLCommands::BindBufferBase>(), RecordedCommands::OpCode<&GLCommands::BindBufferRange>(),
+			RecordedCommands::OpCode<&GLCommands::BindVertexArray>() };
+		return std::find(std::begin(uploads), std::end(uploads), op) != std::end(uploads);
+	}
+
+	// The stream recorded by this thread, the calls are sent to the driver if there is none
+	static thread_local CommandStream* s_recording = nullptr;
+
+	// Recording of the calls made by the main thread outside of BeginRecording() while the render thread runs
+	// Sent to the render thread before the next call that can't be recorded, stream or function sent to it
+	static NoDestroy<CommandStream> s_deferred;
+
+	// Streams sent to the render thread, given back once replayed so their capacity is reused
+	static std::mutex s_streamPoolMutex;
+	static NoDestroy<std::vector<std::unique_ptr<CommandStream>>> s_streamPool;
+
+	template<typename... Params, typename... Args>
+	void IssueCommand(void(*command)(Params...), CommandStream::OpCode op, const Args&... args)
+	{
+		if (s_recording)
+		{
+			s_recording->Record(op, static_cast<std::decay_t<Params>>(args)...);
+			s_stateStats.recorded++;
+		}
+		else
+		{
+			RE_ASSERT(!s_renderThread->running || IsRenderThread(), "The RenderApi is used by a thread that doesn't own the context");
+			command(static_cast<std::decay_t<Params>>(args)...);
+		}
+	}
+
+	// Records the call in the stream being recorded, or sends it to the driver
+	template<auto Command, typename... Args>
+	void Issue(const Args&... args)
+	{
+		constexpr CommandStream::OpCode op = RecordedCommands::OpCode<Command>();
+		IssueCommand(Command, op, args...);
+	}
+
+	// The calls made in its scope are sent to the driver
+	class PausedRecording
+	{
+	public:
+		PausedRecording() : m_paused(std::exchange(s_recording, nullptr)) {}
+		~PausedRecording() { s_recording = m_paused; }
+
+		PausedRecording(const PausedRecording&) = delete;
+
+	private:
+		CommandStream* m_paused;
+	};
+
+	// Adds a function to the render thread, returns its ticket for WaitJob()
+	uint64_t PostJob(std::function<void()> job)
+	{
+		uint64_t ticket;
+		{
+			std::lock_guard lock(s_renderThread->mutex);
+			s_renderThread->jobs.push_back(std::move(job));
+			ticket = ++s_renderThread->posted;
+		}
+
+		s_renderThread->jobAdded.notify_one();
+		return ticket;
+	}
+
+	void WaitJob(uint64_t ticket)
+	{
+		std::unique_lock lock(s_renderThread->mutex);
+		s_renderThread->jobFinished.wait(lock, [ticket] { return s_renderThread->finished >= ticket; });
+	}
+
+	void RenderThreadLoop()
+	{
+		auto& thread = *s_renderThread;
+		glfwMakeContextCurrent(thread.window);
+
+		while (true)
+		{
+			std::function<void()> job;
+			{
+				std::unique_lock lock(thread.mutex);
+				thread.jobAdded.wait(lock, [&thread] { return thread.stopping || !thread.jobs.empty(); });
+				if (thread.jobs.empty())
+					break; // Stopping, everything sent before was run
+
+				job = std::move(thread.jobs.front());
+				thread.jobs.pop_front();
+			}
+
+			job();
+			job = nullptr; // Its captures are released before the caller is woken up
+
+			{
+				std::lock_guard lock(thread.mutex);
+				thread.finished++;
+			}
+			thread.jobFinished.notify_all();
+		}
+
+		glfwMakeContextCurrent(nullptr);
+	}
+
+	// Sends the commands to the driver, only the buffer uploads in RenderApi::RecordOnly
+	void Replay(const CommandStream& stream, bool uploadsOnly)
+	{
+		auto reader = stream.Read();
+		while (!reader.AtEnd())
+		{
+			const auto op = reader.Read<CommandStream::OpCode>();
+			if (!uploadsOnly || IsUploadCommand(op))
+				RecordedCommands::Replay(op, reader);
+			else
+				RecordedCommands::Skip(op, reader);
+		}
+	}
+
+	// Replays the commands on the thread owning the context, the stream is empty after
+	// The render thread gets a stream of the pool swapped with this one, the caller doesn't wait for the replay
+	void SubmitCommands(CommandStream& stream, bool uploadsOnly)
+	{
+		if (IsRenderThread() || !s_renderThread->running)
+			Replay(stream, uploadsOnly);
+		else if (!stream.Empty())
+		{
+			std::unique_ptr<CommandStream> commands;
+			{
+				std::lock_guard lock(s_streamPoolMutex);
+				if (!s_streamPool->empty())
+				{
+					commands = std::move(s_streamPool->back());
+					s_streamPool->pop_back();
+				}
+			}
+
+			if (!commands)
+				commands = std::make_unique<CommandStream>();
+			commands->Swap(stream);
+
+			PostJob([commands = commands.release(), uploadsOnly] {
+				Replay(*commands, uploadsOnly);
+				commands->Clear();
+
+				std::lock_guard lock(s_streamPoolMutex);
+				s_streamPool->emplace_back(commands);
+			});
+		}
+
+		stream.Clear();
+
+		// The cache holds the recorded state, most of it never reached the driver
+		if (uploadsOnly)
+			RenderApi::InvalidateStateCache();
+	}
+
+	// Submits what this thread recorded, so it runs before the call that can't be recorded or the function sent to the render thread
+	void SubmitRecorded()
+	{
+		if (!s_recording || s_recording->Empty())
+			return;
+
+		// A stream of the caller is submitted as it would be at its end
+		SubmitCommands(*s_recording, RenderApi::RecordOnly && s_recording != s_deferred.GetPtr());
+		s_stateStats.flushes++;
+	}
+
+	// For the calls that can't be recorded : the commands recorded before are submitted, then the function runs with the context
+	// With a render thread, the function runs on it and the caller waits for the result
+	template<typename Function>
+	std::invoke_result_t<Function> Immediate(Function&& function)
+	{
+		using Result = std::invoke_result_t<Function>;
+
+		SubmitRecorded();
+		if (IsRenderThread() || !s_renderThread->running)
+		{
+			PausedRecording paused;
+			return function();
+		}
+
+		if constexpr (std::is_void_v<Result>)
+			WaitJob(PostJob([&function] { function(); }));
+		else
+		{
+			std::optional<Result> result;
+			WaitJob(PostJob([&function, &result] { result.emplace(function()); }));
+			return std::move(*result);
+		}
+	}
+
+	// The sync object is made by the thread owning the context, after the commands sent before the fence
+	struct Fence
+	{
+		GLsync sync = nullptr;
+		uint64_t index = 0; // In the order of creation
+		bool signaled = false; // The gpu passed it, guarded by s_fenceMutex
+	};
+
+	static std::mutex s_fenceMutex;
+	static NoDestroy<std::condition_variable> s_fenceSignaled;
+	static NoDestroy<std::deque<Fence*>> s_unsignaledFences; // Thread owning the context only
+	static uint64_t s_lastFenceIndex = 0; // Main thread only
+	static uint64_t s_lastSignalingFenceIndex = 0; // Made while the render thread runs, main thread only
+
+	void WaitSync(GLsync sync)
+	{
+		constexpr GLuint64 Timeout = 1'000'000'000; // 1 second, in nanoseconds
+		while (true)
+		{
+			GLenum result = GL_CALL(glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, Timeout));
+			if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+				return;
+			if (result == GL_WAIT_FAILED)
+			{
+				ReportError("Failed to wait on a fence");
+				return;
+			}
+		}
+	}
+
+	// Waits for the gpu to pass the fences up to lastIndex, in order
+	// Called by each fence made on the render thread for the previous ones, so it stays one fence ahead of the gpu at most
+	void SignalFences(uint64_t lastIndex)
+	{
+		auto& fences = *s_unsignaledFences;
+		while (!fences.empty() && fences.front()->index <= lastIndex)
+		{
+			WaitSync(fences.front()->sync);
+			{
+				std::lock_guard lock(s_fenceMutex);
+				fences.front()->signaled = true;
+			}
+			fences.pop_front();
+		}
+
+		s_fenceSignaled->notify_all();
+	}
+}
+
 namespace RexEngine
 {
 	void RenderApi::Init()
 	{
+		InvalidateStateCache();
+
 		GL_CALL(glEnable(GL_DEPTH_TEST));
 		GL_CALL(glFrontFace(GL_CW));
 
@@ -222,453 +764,946 @@ namespace RexEngine
 		GL_CALL(glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS));
 	}
 
+	void RenderApi::NextFrame()
+	{
+		Internal::LogRenderThreadErrors();
 
+		Internal::s_lastStateStats = Internal::s_stateStats;
+		Internal::s_stateStats = {};
+	}
 
-	RenderApi::ShaderID RenderApi::CompileShader(const std::string& source, ShaderType type)
+	RenderApi::StateStats RenderApi::GetLastStateStats()
+	{
+		return Internal::s_lastStateStats;
+	}
+
+	void RenderApi::InvalidateStateCache()
+	{
+		Internal::s_state = Internal::GLState();
+	}
+
+	void RenderApi::BeginRecording(CommandStream& stream)
+	{
+		RE_ASSERT(!Internal::s_recording || Internal::s_recording == Internal::s_deferred.GetPtr(), "A stream is already being recorded");
+
+		// The calls made before the recording are submitted before the stream
+		Internal::SubmitRecorded();
+		Internal::s_recording = &stream;
+	}
+
+	void RenderApi::EndRecording()
+	{
+		const bool deferred = Internal::s_renderThread->running && !Internal::IsRenderThread();
+		Internal::s_recording = deferred ? Internal::s_deferred.GetPtr() : nullptr;
+	}
+
+	void RenderApi::Submit(CommandStream& stream)
+	{
+		Internal::SubmitCommands(stream, RecordOnly);
+	}
+
+	void RenderApi::StartRenderThread()
 	{
-		static constexpr unsigned int TypeToGLType[]{ GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
-		static const std::string TypeToName[]{ "Vertex", "Fragment" };
+		auto& thread = *Internal::s_renderThread;
+		RE_ASSERT(!thread.running, "The render thread is already running");
+		RE_ASSERT(!Internal::s_recording, "The render thread can't be started during a recording");
+
+		// A context is current on one thread at most
+		thread.window = glfwGetCurrentContext();
+		RE_ASSERT(thread.window, "The render thread needs the context of a window, see Window::MakeActive()");
+		glfwMakeContextCurrent(nullptr);
+
+		thread.stopping = false;
+		thread.thread = std::thread(&Internal::RenderThreadLoop);
+		thread.id = thread.thread.get_id();
+		thread.running = true;
 
-		// Create the shader
-		ShaderID id = GL_CALL(glCreateShader(TypeToGLType[(int)type]));
+		Internal::s_recording = Internal::s_deferred.GetPtr();
+	}
+
+	void RenderApi::StopRenderThread()
+	{
+		auto& thread = *Internal::s_renderThread;
+		if (!thread.running)
+			return;
 
-		const char* sourcePtr = source.c_str();
-		GL_CALL(glShaderSource(id, 1, &sourcePtr, NULL));
-		GL_CALL(glCompileShader(id));
+		RE_ASSERT(Internal::s_recording == Internal::s_deferred.GetPtr(), "The render thread can't be stopped during a recording");
+		Internal::SubmitRecorded();
 
-		// Check for errors
-		int success;
-		GL_CALL(glGetShaderiv(id, GL_COMPILE_STATUS, &success));
-		if (success == GL_FALSE)
 		{
-			char infoLog[512];
-			GL_CALL(glGetShaderInfoLog(id, 512, NULL, infoLog));
-			RE_LOG_ERROR("{} shader compilation failed : {}", TypeToName[(int)type], infoLog);
-			return InvalidShaderID;
+			std::lock_guard lock(thread.mutex);
+			thread.stopping = true;
 		}
+		thread.jobAdded.notify_one();
+		thread.thread.join();
 
-		return id;
+		thread.id = {};
+		thread.running = false;
+		Internal::s_recording = nullptr;
+
+		// The context comes back to the caller
+		glfwMakeContextCurrent(thread.window);
+		Internal::LogRenderThreadErrors();
 	}
 
-	RenderApi::ShaderID RenderApi::LinkShaders(ShaderID vertex, ShaderID fragment)
+	bool RenderApi::IsRenderThreadRunning()
 	{
-		ShaderID id = GL_CALL(glCreateProgram());
-		GL_CALL(glAttachShader(id, vertex));
-		GL_CALL(glAttachShader(id, fragment));
+		return Internal::s_renderThread->running;
+	}
 
-		GL_CALL(glLinkProgram(id));
+	void RenderApi::RunOnRenderThread(const std::function<void()>& function)
+	{
+		Internal::Immediate(function);
+	}
 
-		// Check for errors
-		int success;
-		GL_CALL(glGetProgramiv(id, GL_LINK_STATUS, &success));
-		if (success == GL_FALSE)
+	void RenderApi::PostToRenderThread(std::function<void()> function)
+	{
+		Internal::SubmitRecorded();
+		if (Internal::IsRenderThread() || !Internal::s_renderThread->running)
 		{
-			char infoLog[512];
-			GL_CALL(glGetProgramInfoLog(id, 512, NULL, infoLog));
-			RE_LOG_ERROR("Shader linking failed : {}", infoLog);
-			return InvalidShaderID;
+			Internal::PausedRecording paused;
+			function();
 		}
+		else
+			Internal::PostJob(std::move(function));
+	}
+
 
-		return id;
+
+	RenderApi::ShaderID RenderApi::CompileShader(const std::string& source, ShaderType type)
+	{
+		return Internal::Immediate([&]() -> RenderApi::ShaderID {
+			static constexpr unsigned int TypeToGLType[]{ GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+			static const std::string TypeToName[]{ "Vertex", "Fragment" };
+
+			// Create the shader
+			ShaderID id = GL_CALL(glCreateShader(TypeToGLType[(int)type]));
+
+			const char* sourcePtr = source.c_str();
+			GL_CALL(glShaderSource(id, 1, &sourcePtr, NULL));
+			GL_CALL(glCompileShader(id));
+
+			// Check for errors
+			int success;
+			GL_CALL(glGetShaderiv(id, GL_COMPILE_STATUS, &success));
+			if (success == GL_FALSE)
+			{
+				char infoLog[512];
+				GL_CALL(glGetShaderInfoLog(id, 512, NULL, infoLog));
+				Internal::ReportError(std::format("{} shader compilation failed : {}", TypeToName[(int)type], infoLog));
+				return InvalidShaderID;
+			}
+
+			return id;
+		});
+	}
+
+	RenderApi::ShaderID RenderApi::LinkShaders(ShaderID vertex, ShaderID fragment)
+	{
+		return Internal::Immediate([&]() -> RenderApi::ShaderID {
+			ShaderID id = GL_CALL(glCreateProgram());
+			GL_CALL(glAttachShader(id, vertex));
+			GL_CALL(glAttachShader(id, fragment));
+
+			GL_CALL(glLinkProgram(id));
+
+			// Check for errors
+			int success;
+			GL_CALL(glGetProgramiv(id, GL_LINK_STATUS, &success));
+			if (success == GL_FALSE)
+			{
+				char infoLog[512];
+				GL_CALL(glGetProgramInfoLog(id, 512, NULL, infoLog));
+				Internal::ReportError(std::format("Shader linking failed : {}", infoLog));
+				return InvalidShaderID;
+			}
+
+			return id;
+		});
 	}
 
 	void RenderApi::DeleteShader(ShaderID id)
 	{
-		GL_CALL(glDeleteShader(id));
+		Internal::Immediate([&] {
+			GL_CALL(glDeleteShader(id));
+		});
 	}
 	
 	void RenderApi::DeleteLinkedShader(ShaderID id)
 	{
-		GL_CALL(glDeleteProgram(id));
+		Internal::Immediate([&] {
+			GL_CALL(glDeleteProgram(id));
+
+			if (Internal::s_state.program == id)
+				Internal::s_state.program = Internal::GLState::Unknown;
+		});
 	}
 
 	void RenderApi::BindShader(ShaderID id)
 	{
-		GL_CALL(glUseProgram(id));
+		if (!Internal::ShouldSetState(Internal::s_state.program, id))
+			return;
+
+		Internal::Issue<&Internal::GLCommands::UseProgram>(id);
 	}
 
 	std::unordered_map<std::string, std::tuple<int, RenderApi::UniformType>> RenderApi::GetShaderUniforms(ShaderID id)
 	{
-		std::unordered_map<std::string, std::tuple<int, RenderApi::UniformType>>  uniforms;
+		return Internal::Immediate([&]() -> std::unordered_map<std::string, std::tuple<int, RenderApi::UniformType>> {
+			std::unordered_map<std::string, std::tuple<int, RenderApi::UniformType>>  uniforms;
 
-		GLint count;
-		GLint size; // size of the variable
-		GLenum type; // type of the variable (GL_FLOAT, GL_FLOAT_VEC2, ...)
+			GLint count;
+			GLint size; // size of the variable
+			GLenum type; // type of the variable (GL_FLOAT, GL_FLOAT_VEC2, ...)
 
-		const GLsizei bufSize = 32;
-		GLchar name[bufSize];
+			const GLsizei bufSize = 32;
+			GLchar name[bufSize];
 
-		GL_CALL(glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count));
+			GL_CALL(glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count));
 
-		for (GLint i = 0; i < count; i++)
-		{
-			GL_CALL(glGetActiveUniform(id, i, bufSize, NULL, &size, &type, name));
-			int index = GL_CALL(glGetUniformLocation(id, name));
-			if(index != -1) // Will return -1 for uniforms in a uniform block, skip those
-				uniforms.insert({ name, {index, Internal::GLTypeToTypeIndex(type)}});
-		}
+			for (GLint i = 0; i < count; i++)
+			{
+				GL_CALL(glGetActiveUniform(id, i, bufSize, NULL, &size, &type, name));
+				int index = GL_CALL(glGetUniformLocation(id, name));
+				if(index != -1) // Will return -1 for uniforms in a uniform block, skip those
+					uniforms.insert({ name, {index, Internal::GLTypeToTypeIndex(type)}});
+			}
+
+			return uniforms;
+		});
+	}
+
+	std::tuple<size_t, std::unordered_map<std::string, std::tuple<int, RenderApi::UniformType>>> RenderApi::GetUniformBlockLayout(ShaderID id, const std::string& blockName)
+	{
+		return Internal::Immediate([&]() -> std::tuple<size_t, std::unordered_map<std::string, std::tuple<int, RenderApi::UniformType>>> {
+			std::unordered_map<std::string, std::tuple<int, RenderApi::UniformType>> members;
+
+			GLuint blockIndex = GL_CALL(glGetUniformBlockIndex(id, blockName.c_str()));
+			if (blockIndex == GL_INVALID_INDEX)
+				return { 0, members };
+
+			GLint blockSize;
+			GL_CALL(glGetActiveUniformBlockiv(id, blockIndex, GL_UNIFORM_BLOCK_DATA_SIZE, &blockSize));
+
+			GLint count;
+			GLint size;
+			GLenum type;
 
-		return uniforms;
+			const GLsizei bufSize = 32;
+			GLchar name[bufSize];
+
+			GL_CALL(glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count));
+
+			for (GLuint i = 0; i < (GLuint)count; i++)
+			{
+				GLint block;
+				GL_CALL(glGetActiveUniformsiv(id, 1, &i, GL_UNIFORM_BLOCK_INDEX, &block));
+				if (block != (GLint)blockIndex)
+					continue;
+
+				GLint offset;
+				GL_CALL(glGetActiveUniformsiv(id, 1, &i, GL_UNIFORM_OFFSET, &offset));
+				GL_CALL(glGetActiveUniform(id, i, bufSize, NULL, &size, &type, name));
+				members.insert({ name, {offset, Internal::GLTypeToTypeIndex(type)} });
+			}
+
+			return { (size_t)blockSize, members };
+		});
 	}
 
 	void RenderApi::SetUniformMatrix4(int location, const Matrix4& matrix)
 	{
-		GL_CALL(glUniformMatrix4fv(location, 1, GL_FALSE, &matrix[0][0]));
+		Internal::Issue<&Internal::GLCommands::UniformMatrix4>(location, matrix);
 	}
 
 	void RenderApi::SetUniformVector3(int location, const Vector3& vec)
 	{
-		GL_CALL(glUniform3fv(location, 1, &vec[0]));
+		Internal::Issue<&Internal::GLCommands::Uniform3>(location, vec);
 	}
 
 	void RenderApi::SetUniformFloat(int location, float value)
 	{
-		GL_CALL(glUniform1f(location, value));
+		Internal::Issue<&Internal::GLCommands::Uniform1f>(location, value);
 	}
 
 	void RenderApi::SetUniformInt(int location, int value)
 	{
-		GL_CALL(glUniform1i(location, value));
+		Internal::Issue<&Internal::GLCommands::Uniform1i>(location, value);
 	}
 
 
 	RenderApi::BufferID RenderApi::MakeBuffer()
 	{
-		BufferID id;
-		GL_CALL(glGenBuffers(1, &id));
-		return id;
+		return Internal::Immediate([&]() -> RenderApi::BufferID {
+			BufferID id;
+			GL_CALL(glGenBuffers(1, &id));
+			return id;
+		});
 	}
 
 	void RenderApi::BindBuffer(BufferID id, BufferType type)
 	{
-		GL_CALL(glBindBuffer(Internal::BufferTypeToGLType(type), id));
+		if (!Internal::ShouldSetState(Internal::s_state.buffers[(int)type], id))
+			return;
+
+		Internal::Issue<&Internal::GLCommands::BindBuffer>(Internal::BufferTypeToGLType(type), id);
 	}
 
 	void RenderApi::DeleteBuffer(BufferID id)
 	{
-		GL_CALL(glDeleteBuffers(1, &id));
+		Internal::Immediate([&] {
+			GL_CALL(glDeleteBuffers(1, &id));
+
+			// The bindings of a deleted buffer revert to 0
+			auto& state = Internal::s_state;
+			for (int type = 0; type < Internal::GLState::BufferTypes; type++)
+			{
+				if (state.buffers[type] == id)
+					state.buffers[type] = 0;
+
+				for (auto& binding : state.indexedBuffers[type])
+				{
+					if (binding.id == id)
+						binding = {};
+				}
+			}
+		});
+	}
+
+	// The index buffer binding is part of the vertex attributes, 
+	// unbind them so uploading indices doesn't replace the index buffer of the bound mesh
+	static void BindBufferForUpload(RenderApi::BufferID id, RenderApi::BufferType type)
+	{
+		if (type == RenderApi::BufferType::Indice)
+			RenderApi::BindVertexAttributes(0);
+
+		RenderApi::BindBuffer(id, type);
 	}
 
 	void RenderApi::SetBufferData(BufferID id, BufferType type, BufferMode mode, const uint8_t* data, size_t length)
 	{
-		BindBuffer(id, type);
-		GL_CALL(glBufferData(Internal::BufferTypeToGLType(type), length, data, mode == BufferMode::Static ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW));
+		Internal::Immediate([&] {
+			BindBufferForUpload(id, type);
+			GL_CALL(glBufferData(Internal::BufferTypeToGLType(type), length, data, mode == BufferMode::Static ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW));
+		});
 	}
 
 	void RenderApi::SubBufferData(BufferID id, BufferType type, size_t offset, size_t size, const void* data)
 	{
-		BindBuffer(id, type);
-		GL_CALL(glBufferSubData(Internal::BufferTypeToGLType(type), offset, size, data));
+		BindBufferForUpload(id, type);
+		Internal::Issue<&Internal::GLCommands::BufferSubData>(Internal::BufferTypeToGLType(type), offset, CommandStream::Bytes(static_cast<const uint8_t*>(data), size));
 	}
 
-	void RenderApi::BindBufferBase(BufferID id, int location)
+	void RenderApi::CopyBufferData(BufferID from, BufferID to, size_t fromOffset, size_t toOffset, size_t size)
 	{
-		GL_CALL(glBindBufferBase(GL_UNIFORM_BUFFER, location, id));
+		// Direct state access, the bindings are not changed
+		Internal::Issue<&Internal::GLCommands::CopyBufferSubData>(from, to, fromOffset, toOffset, size);
 	}
 
+	void RenderApi::BindBufferBase(BufferID id, int location, BufferType type)
+	{
+		BindBufferRange(id, location, type, 0, 0);
+	}
 
+	void RenderApi::BindBufferRange(BufferID id, int location, BufferType type, size_t offset, size_t size)
+	{
+		auto& state = Internal::s_state;
+		const Internal::GLState::IndexedBinding binding{ id, offset, size };
+		const bool cached = location >= 0 && location < Internal::GLState::IndexedBindings;
+		if (!(cached ? Internal::ShouldSetState(state.indexedBuffers[(int)type][location], binding) : Internal::ShouldSetState()))
+			return;
 
-	RenderApi::VertexAttribID RenderApi::MakeVertexAttributes(std::span<std::tuple<VertexAttributeType, int>> attributes, BufferID vertexBuffer, BufferID indices)
+		if (size == 0)
+			Internal::Issue<&Internal::GLCommands::BindBufferBase>(Internal::BufferTypeToGLType(type), location, id);
+		else
+			Internal::Issue<&Internal::GLCommands::BindBufferRange>(Internal::BufferTypeToGLType(type), location, id, offset, size);
+
+		// Also binds the buffer to the generic binding point
+		state.buffers[(int)type] = id;
+	}
+
+	size_t RenderApi::GetBufferOffsetAlignment(BufferType type)
 	{
-		// Create the vao
-		unsigned int vao;
-		GL_CALL(glGenVertexArrays(1, &vao));
+		return Internal::Immediate([&]() -> size_t {
+			GLint alignment = 1;
+			if (type == BufferType::Uniforms)
+			{
+				GL_CALL(glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment));
+			}
+			else if (type == BufferType::ShaderStorage)
+			{
+				GL_CALL(glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment));
+			}
 
-		BindVertexAttributes(vao);
+			return (size_t)alignment;
+		});
+	}
 
-		// Bind the data
-		BindBuffer(vertexBuffer, RenderApi::BufferType::Vertex);
-		BindBuffer(indices, RenderApi::BufferType::Indice);
-		
-		// Calculate the stride
-		size_t stride = 0;
-		for (auto&& type : attributes)
-		{
-			auto [_, count, size] = Internal::AttributeTypeToGLType(std::get<0>(type));
-			stride += (size_t)count * size;
-		}
+	uint8_t* RenderApi::MakePersistentBuffer(BufferID id, BufferType type, size_t length)
+	{
+		return Internal::Immediate([&]() -> uint8_t* {
+			constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+			BindBufferForUpload(id, type);
+			GL_CALL(glBufferStorage(Internal::BufferTypeToGLType(type), length, nullptr, flags));
+			void* data = GL_CALL(glMapBufferRange(Internal::BufferTypeToGLType(type), 0, length, flags));
+			return static_cast<uint8_t*>(data);
+		});
+	}
+
+	RenderApi::FenceID RenderApi::MakeFence()
+	{
+		auto* fence = new Internal::Fence{ nullptr, ++Internal::s_lastFenceIndex };
+
+		// With a render thread, the fence signals the previous ones once the gpu passed them
+		const bool signalsPrevious = Internal::s_renderThread->running;
+		if (signalsPrevious)
+			Internal::s_lastSignalingFenceIndex = fence->index;
+
+		PostToRenderThread([fence, signalsPrevious] {
+			fence->sync = GL_CALL(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+			Internal::s_unsignaledFences->push_back(fence);
+
+			if (signalsPrevious)
+			{
+				GL_CALL(glFlush()); // The gpu reaches the fence without waiting for the swap
+				Internal::SignalFences(fence->index - 1);
+			}
+		});
+
+		return fence;
+	}
 
-		// Set the attributes
-		size_t offset = 0; // Current offset
-		for (int i = 0; i < attributes.size(); i++)
+	void RenderApi::WaitFence(FenceID id)
+	{
+		if (id == InvalidFenceID)
+			return;
+
+		auto* fence = static_cast<Internal::Fence*>(id);
 		{
-			auto [type, count, size] = Internal::AttributeTypeToGLType(std::get<0>(attributes[i]));
-			int location = std::get<1>(attributes[i]);
-			GL_CALL(glEnableVertexAttribArray(location));
-			GL_CALL(glVertexAttribPointer(location, count, type, GL_FALSE, (GLsizei)stride, (void*)offset));
-			
-			offset += size * count;
+			std::unique_lock lock(Internal::s_fenceMutex);
+			if (fence->signaled)
+				return;
+
+			// Signaled when a later fence reaches the render thread, the work sent after that fence is not waited for
+			if (fence->index < Internal::s_lastSignalingFenceIndex)
+			{
+				Internal::s_fenceSignaled->wait(lock, [fence] { return fence->signaled; });
+				return;
+			}
 		}
 
-		BindVertexAttributes(0);
-		return vao;
+		Internal::Immediate([fence] { Internal::SignalFences(fence->index); });
+	}
+
+	void RenderApi::DeleteFence(FenceID id)
+	{
+		if (id == InvalidFenceID)
+			return;
+
+		auto* fence = static_cast<Internal::Fence*>(id);
+		PostToRenderThread([fence] {
+			std::erase(*Internal::s_unsignaledFences, fence);
+			GL_CALL(glDeleteSync(fence->sync));
+			delete fence;
+		});
+	}
+
+
+
+	RenderApi::VertexAttribID RenderApi::MakeVertexAttributes(std::span<std::tuple<VertexAttributeType, int>> attributes, BufferID vertexBuffer, BufferID indices)
+	{
+		return Internal::Immediate([&]() -> RenderApi::VertexAttribID {
+			// Create the vao
+			unsigned int vao;
+			GL_CALL(glGenVertexArrays(1, &vao));
+
+			BindVertexAttributes(vao);
+
+			// Bind the data
+			BindBuffer(vertexBuffer, RenderApi::BufferType::Vertex);
+			BindBuffer(indices, RenderApi::BufferType::Indice);
+
+			// Calculate the stride
+			size_t stride = 0;
+			for (auto&& type : attributes)
+				stride += GetVertexAttributeSize(std::get<0>(type));
+
+			// Set the attributes
+			size_t offset = 0; // Current offset
+			for (int i = 0; i < attributes.size(); i++)
+			{
+				auto [type, count, size, normalized] = Internal::AttributeTypeToGLType(std::get<0>(attributes[i]));
+				int location = std::get<1>(attributes[i]);
+				GL_CALL(glEnableVertexAttribArray(location));
+				GL_CALL(glVertexAttribPointer(location, count, type, normalized ? GL_TRUE : GL_FALSE, (GLsizei)stride, (void*)offset));
+
+				offset += size * count;
+			}
+
+			BindVertexAttributes(0);
+			return vao;
+		});
+	}
+
+	size_t RenderApi::GetVertexAttributeSize(VertexAttributeType type)
+	{
+		auto [_, count, size, normalized] = Internal::AttributeTypeToGLType(type);
+		return (size_t)count * size;
 	}
 
 	void RenderApi::DeleteVertexAttributes(VertexAttribID id)
 	{
-		GL_CALL(glDeleteVertexArrays(1, &id));
+		Internal::Immediate([&] {
+			GL_CALL(glDeleteVertexArrays(1, &id));
+
+			if (Internal::s_state.vertexAttributes == id)
+			{
+				Internal::s_state.vertexAttributes = 0;
+				Internal::s_state.buffers[(int)BufferType::Indice] = Internal::GLState::Unknown;
+			}
+		});
 	}
 
 	void RenderApi::BindVertexAttributes(VertexAttribID id)
 	{
-		GL_CALL(glBindVertexArray(id));
+		if (!Internal::ShouldSetState(Internal::s_state.vertexAttributes, id))
+			return;
+
+		Internal::Issue<&Internal::GLCommands::BindVertexArray>(id);
+
+		// Each vertex attributes object has its own index buffer binding
+		Internal::s_state.buffers[(int)BufferType::Indice] = Internal::GLState::Unknown;
 	}
 
 	RenderApi::TextureID RenderApi::MakeTexture(TextureTarget target, PixelFormat gpuFormat, Vector2Int size, const void* data, PixelFormat dataFormat, PixelType dataType)
 	{
-		RE_ASSERT(target != TextureTarget::Texture2D_Multisample, "RenderApi::MakeTexture Cannot be used with target == Texture2D_Multisample, use MakeTextureMultisampled instead");
+		return Internal::Immediate([&]() -> RenderApi::TextureID {
+			RE_ASSERT(target != TextureTarget::Texture2D_Multisample, "RenderApi::MakeTexture Cannot be used with target == Texture2D_Multisample, use MakeTextureMultisampled instead");
 
-		TextureID id;
-		GL_CALL(glGenTextures(1, &id));
-		
-		SetTextureData(id, target, gpuFormat, size, data, dataFormat, dataType);
+			TextureID id;
+			GL_CALL(glGenTextures(1, &id));
 
-		return id;
+			SetTextureData(id, target, gpuFormat, size, data, dataFormat, dataType);
+
+			return id;
+		});
 	}
 
 	RenderApi::TextureID RenderApi::MakeTextureMultisampled(TextureTarget target, PixelFormat gpuFormat, Vector2Int size, int sampleCount)
 	{
-		RE_ASSERT(target == TextureTarget::Texture2D_Multisample, "RenderApi::MakeTextureMultisampled Can only be used width target == MakeTexture");
+		return Internal::Immediate([&]() -> RenderApi::TextureID {
+			RE_ASSERT(target == TextureTarget::Texture2D_Multisample, "RenderApi::MakeTextureMultisampled Can only be used width target == MakeTexture");
 
-		TextureID id;
-		GL_CALL(glGenTextures(1, &id));
+			TextureID id;
+			GL_CALL(glGenTextures(1, &id));
 
-		SetTextureDataMultisampled(id, target, gpuFormat, size, sampleCount);
+			SetTextureDataMultisampled(id, target, gpuFormat, size, sampleCount);
 
-		return id;
+			return id;
+		});
 	}
 
 
 	void RenderApi::SetTextureData(TextureID id, TextureTarget target, PixelFormat gpuFormat, Vector2Int size, const void* data, PixelFormat dataFormat, PixelType dataType)
 	{
-		RE_ASSERT(target != TextureTarget::Texture2D_Multisample, "RenderApi::SetTextureData Cannot be used with target == Texture2D_Multisample, use SetTextureDataMultisampled instead");
-		BindTexture(id, target);
+		Internal::Immediate([&] {
+			RE_ASSERT(target != TextureTarget::Texture2D_Multisample, "RenderApi::SetTextureData Cannot be used with target == Texture2D_Multisample, use SetTextureDataMultisampled instead");
+			BindTexture(id, target);
 
-		GL_CALL(glTexImage2D(
-			Internal::TextureTargetToGL(target), 0,
-			Internal::PixelFormatToGL(gpuFormat),
-			size.x, size.y, 0,
-			Internal::PixelFormatToGL(dataFormat),
-			Internal::PixelTypeToGL(dataType),
-			data
-		));
+			GL_CALL(glTexImage2D(
+				Internal::TextureTargetToGL(target), 0,
+				Internal::PixelFormatToGL(gpuFormat),
+				size.x, size.y, 0,
+				Internal::PixelFormatToGL(dataFormat),
+				Internal::PixelTypeToGL(dataType),
+				data
+			));
+		});
 	}
 
 	void RenderApi::SetTextureDataMultisampled(TextureID id, TextureTarget target, PixelFormat gpuFormat, Vector2Int size, int sampleCount)
 	{
-		RE_ASSERT(target == TextureTarget::Texture2D_Multisample, "RenderApi::SetTextureDataMultisampled Can only be used width target == Texture2D_Multisample");
-		BindTexture(id, target);
+		Internal::Immediate([&] {
+			RE_ASSERT(target == TextureTarget::Texture2D_Multisample, "RenderApi::SetTextureDataMultisampled Can only be used width target == Texture2D_Multisample");
+			BindTexture(id, target);
 
-		GL_CALL(glTexImage2DMultisample(
-			Internal::TextureTargetToGL(target),
-			sampleCount,
-			Internal::PixelFormatToGL(gpuFormat),
-			size.x, size.y,
-			GL_TRUE
-		));
+			GL_CALL(glTexImage2DMultisample(
+				Internal::TextureTargetToGL(target),
+				sampleCount,
+				Internal::PixelFormatToGL(gpuFormat),
+				size.x, size.y,
+				GL_TRUE
+			));
+		});
 	}
 
 	void RenderApi::BindTexture(TextureID id, TextureTarget target)
 	{
-		GL_CALL(glBindTexture(Internal::TextureTargetToGL(target), id));
+		auto& state = Internal::s_state;
+		const bool cached = state.activeTexture >= 0 && state.activeTexture < Internal::GLState::TextureUnits;
+		if (!(cached ? Internal::ShouldSetState(state.textures[state.activeTexture][(int)target], id) : Internal::ShouldSetState()))
+			return;
+
+		Internal::Issue<&Internal::GLCommands::BindTexture>(Internal::TextureTargetToGL(target), id);
 	}
 
 	void RenderApi::SetTextureOption(TextureID id, TextureTarget target, TextureOption option, TextureOptionValue value)
 	{
 		BindTexture(id, target);
-		GL_CALL(glTexParameteri(Internal::TextureTargetToGL(target), Internal::TextureOptionToGL(option), Internal::TextureOptionValueToGL(value)));
+		Internal::Issue<&Internal::GLCommands::TexParameter>(Internal::TextureTargetToGL(target), Internal::TextureOptionToGL(option), Internal::TextureOptionValueToGL(value));
 	}
 
 	RenderApi::TextureOptionValue RenderApi::GetTextureOption(TextureID id, TextureTarget target, TextureOption option)
 	{
-		GLint value;
-		BindTexture(id, target);
-		GL_CALL(glGetTexParameterIiv(Internal::TextureTargetToGL(target), Internal::TextureOptionToGL(option), &value));
-		return Internal::GLToTextureOptionValue(value);
+		return Internal::Immediate([&]() -> RenderApi::TextureOptionValue {
+			GLint value;
+			BindTexture(id, target);
+			GL_CALL(glGetTexParameterIiv(Internal::TextureTargetToGL(target), Internal::TextureOptionToGL(option), &value));
+			return Internal::GLToTextureOptionValue(value);
+		});
 	}
 
 	void RenderApi::DeleteTexture(TextureID id)
 	{
-		GL_CALL(glDeleteTextures(1, &id));
+		Internal::Immediate([&] {
+			GL_CALL(glDeleteTextures(1, &id));
+
+			// The bindings of a deleted texture revert to 0, in every unit
+			for (auto& unit : Internal::s_state.textures)
+				std::replace(std::begin(unit), std::end(unit), id, 0u);
+		});
 	}
 
 	RenderApi::TextureID RenderApi::MakeCubemap()
 	{
-		TextureID id;
-		GL_CALL(glGenTextures(1, &id));
-		return id;
+		return Internal::Immediate([&]() -> RenderApi::TextureID {
+			TextureID id;
+			GL_CALL(glGenTextures(1, &id));
+			return id;
+		});
 	}
 
 	void RenderApi::SetCubemapFace(TextureID id, CubemapFace face, PixelFormat gpuFormat, Vector2Int size, const void* data, PixelFormat dataFormat, PixelType dataType)
 	{
-		BindTexture(id, TextureTarget::Cubemap);
+		Internal::Immediate([&] {
+			BindTexture(id, TextureTarget::Cubemap);
 
-		GL_CALL(glTexImage2D(
-			GL_TEXTURE_CUBE_MAP_POSITIVE_X + (int)face, 0,
-			Internal::PixelFormatToGL(gpuFormat),
-			size.x, size.y, 0,
-			Internal::PixelFormatToGL(dataFormat),
-			Internal::PixelTypeToGL(dataType),
-			data
-		));
+			GL_CALL(glTexImage2D(
+				GL_TEXTURE_CUBE_MAP_POSITIVE_X + (int)face, 0,
+				Internal::PixelFormatToGL(gpuFormat),
+				size.x, size.y, 0,
+				Internal::PixelFormatToGL(dataFormat),
+				Internal::PixelTypeToGL(dataType),
+				data
+			));
+		});
+	}
+
+	bool RenderApi::SupportsBindlessTextures()
+	{
+		return Internal::Immediate([&]() -> bool {
+			static const bool supported = Internal::LoadBindlessTextures();
+			return supported;
+		});
+	}
+
+	RenderApi::TextureHandle RenderApi::MakeTextureHandleResident(TextureID id)
+	{
+		return Internal::Immediate([&]() -> RenderApi::TextureHandle {
+			RE_ASSERT(SupportsBindlessTextures(), "Bindless textures are not supported");
+
+			TextureHandle handle = GL_CALL(Internal::s_bindless.getTextureHandle(id));
+			GL_CALL(Internal::s_bindless.makeTextureHandleResident(handle));
+			return handle;
+		});
+	}
+
+	void RenderApi::MakeTextureHandleNonResident(TextureHandle handle)
+	{
+		Internal::Immediate([&] {
+			if (handle != InvalidTextureHandle)
+			{
+				GL_CALL(Internal::s_bindless.makeTextureHandleNonResident(handle));
+			}
+		});
 	}
 
 	int RenderApi::GetActiveTexture()
 	{
-		GLint active;
-		GL_CALL(glGetIntegerv(GL_ACTIVE_TEXTURE, &active));
-		return active;
+		return Internal::Immediate([&]() -> int {
+			GLint active;
+			GL_CALL(glGetIntegerv(GL_ACTIVE_TEXTURE, &active));
+			return active;
+		});
 	}
 
 	void RenderApi::SetActiveTexture(int index)
 	{
-		GL_CALL(glActiveTexture(GL_TEXTURE0 + index));
+		if (!Internal::ShouldSetState(Internal::s_state.activeTexture, index))
+			return;
+
+		Internal::Issue<&Internal::GLCommands::ActiveTexture>(GL_TEXTURE0 + index);
 	}
 
 	int RenderApi::GetTextureSlotCount()
 	{
-		GLint count;
-		GL_CALL(glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &count));
-		return count;
+		return Internal::Immediate([&]() -> int {
+			GLint count;
+			GL_CALL(glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &count));
+			return count;
+		});
 	}
 
 	void RenderApi::GenerateMipmaps(TextureTarget target)
 	{
-		GL_CALL(glGenerateMipmap(Internal::TextureTargetToGL(target)));
+		Internal::Issue<&Internal::GLCommands::GenerateMipmap>(Internal::TextureTargetToGL(target));
 	}
 
 
 
 	void RenderApi::SetViewportSize(Vector2Int size)
 	{
-		GL_CALL(glViewport(0, 0, size.x, size.y));
+		Internal::s_state.viewportSize = size;
+		Internal::Issue<&Internal::GLCommands::Viewport>(0, 0, size.x, size.y);
+	}
+
+	void RenderApi::SetViewport(Vector2Int position, Vector2Int size)
+	{
+		Internal::s_state.viewportSize = size;
+		Internal::Issue<&Internal::GLCommands::Viewport>(position.x, position.y, size.x, size.y);
 	}
 
 	Vector2Int RenderApi::GetViewportSize()
 	{
-		int viewport[4];
-		GL_CALL(glGetIntegerv(GL_VIEWPORT, viewport));
+		auto& state = Internal::s_state;
+		if (state.viewportSize.x < 0)
+		{
+			Internal::Immediate([&state] {
+				int viewport[4];
+				GL_CALL(glGetIntegerv(GL_VIEWPORT, viewport));
+				state.viewportSize = Vector2Int(viewport[2], viewport[3]);
+			});
+		}
 
-		return Vector2Int(viewport[2], viewport[3]);
+		return state.viewportSize;
 	}
 
 	void RenderApi::ClearColorBit()
 	{
-		GL_CALL(glClear(GL_COLOR_BUFFER_BIT));
+		Internal::Issue<&Internal::GLCommands::Clear>(GL_COLOR_BUFFER_BIT);
 	}
 
 	void RenderApi::ClearDepthBit()
 	{
-		GL_CALL(glClear(GL_DEPTH_BUFFER_BIT));
+		SetDepthWrite(true);
+		Internal::Issue<&Internal::GLCommands::Clear>(GL_DEPTH_BUFFER_BIT);
+	}
+
+	void RenderApi::DrawElements(size_t count, size_t firstIndex, int baseVertex, IndexType indexType)
+	{
+		Internal::Issue<&Internal::GLCommands::DrawElements>(count, firstIndex * GetIndexSize(indexType), baseVertex, Internal::IndexTypeToGL(indexType));
 	}
 
-	void RenderApi::DrawElements(size_t count)
+	void RenderApi::DrawElementsInstanced(size_t count, size_t instanceCount, size_t firstInstance, size_t firstIndex, int baseVertex, IndexType indexType)
 	{
-		GL_CALL(glDrawElements(GL_TRIANGLES, (GLsizei)count, GL_UNSIGNED_INT, 0));
+		Internal::Issue<&Internal::GLCommands::DrawElementsInstanced>(count, firstIndex * GetIndexSize(indexType), instanceCount, firstInstance, baseVertex, Internal::IndexTypeToGL(indexType));
+	}
+
+	void RenderApi::MultiDrawElementsIndirect(size_t drawCount, size_t offset, IndexType indexType)
+	{
+		Internal::Issue<&Internal::GLCommands::MultiDrawElementsIndirect>(drawCount, offset, Internal::IndexTypeToGL(indexType));
 	}
 
 
 	void RenderApi::SetCullingMode(CullingMode mode)
 	{
-		switch (mode)
-		{
-		case RexEngine::RenderApi::CullingMode::Front:
-			GL_CALL(glEnable(GL_CULL_FACE));
-			GL_CALL(glCullFace(GL_BACK)); // Inverted because we want to keep the front face
-			break;
-		case RexEngine::RenderApi::CullingMode::Back:
-			GL_CALL(glEnable(GL_CULL_FACE));
-			GL_CALL(glCullFace(GL_FRONT));
-			break;
-		case RexEngine::RenderApi::CullingMode::Both:
-			GL_CALL(glDisable(GL_CULL_FACE));
-			break;
-		}
-		
+		if (!Internal::ShouldSetState(Internal::s_state.cullingMode, (int)mode))
+			return;
+
+		Internal::Issue<&Internal::GLCommands::CullingMode>(mode);
 	}
 
 
 	void RenderApi::SetDepthFunction(DepthFunction function)
 	{
-		GL_CALL(glDepthFunc(Internal::DepthFunctionToGL(function)));
+		if (!Internal::ShouldSetState(Internal::s_state.depthFunction, (int)function))
+			return;
+
+		Internal::Issue<&Internal::GLCommands::DepthFunc>(Internal::DepthFunctionToGL(function));
+	}
+
+	void RenderApi::SetDepthWrite(bool enabled)
+	{
+		if (!Internal::ShouldSetState(Internal::s_state.depthWrite, (int)enabled))
+			return;
+
+		Internal::Issue<&Internal::GLCommands::DepthMask>(enabled ? GL_TRUE : GL_FALSE);
+	}
+
+	void RenderApi::SetDepthRange(float zNear, float zFar)
+	{
+		if (!Internal::ShouldSetState(Internal::s_state.depthRange, { zNear, zFar }))
+			return;
+
+		Internal::Issue<&Internal::GLCommands::DepthRange>(zNear, zFar);
+	}
+
+	RenderApi::QueryID RenderApi::MakeQuery()
+	{
+		return Internal::Immediate([&]() -> RenderApi::QueryID {
+			QueryID id;
+			GL_CALL(glGenQueries(1, &id));
+			return id;
+		});
+	}
+
+	void RenderApi::DeleteQuery(QueryID id)
+	{
+		Internal::Immediate([&] {
+			GL_CALL(glDeleteQueries(1, &id));
+		});
+	}
+
+	void RenderApi::BeginTimeQuery(QueryID id)
+	{
+		Internal::Issue<&Internal::GLCommands::BeginQuery>(id);
+	}
+
+	void RenderApi::EndTimeQuery()
+	{
+		Internal::Issue<&Internal::GLCommands::EndQuery>();
+	}
+
+	bool RenderApi::IsQueryResultAvailable(QueryID id)
+	{
+		return Internal::Immediate([&]() -> bool {
+			GLint available = 0;
+			GL_CALL(glGetQueryObjectiv(id, GL_QUERY_RESULT_AVAILABLE, &available));
+			return available != 0;
+		});
+	}
+
+	uint64_t RenderApi::GetQueryResult(QueryID id)
+	{
+		return Internal::Immediate([&]() -> uint64_t {
+			GLuint64 result = 0;
+			GL_CALL(glGetQueryObjectui64v(id, GL_QUERY_RESULT, &result));
+			return result;
+		});
 	}
 
 	RenderApi::BufferID RenderApi::MakeRenderBuffer(PixelType type, Vector2Int size, int sampleCount)
 	{
-		BufferID id;
-		GL_CALL(glGenRenderbuffers(1, &id));
+		return Internal::Immediate([&]() -> RenderApi::BufferID {
+			BufferID id;
+			GL_CALL(glGenRenderbuffers(1, &id));
 
-		SetRenderBufferSize(id, type, size, sampleCount);
-		return id;
+			SetRenderBufferSize(id, type, size, sampleCount);
+			return id;
+		});
 	}
 
 	void RenderApi::BindRenderBuffer(BufferID id)
 	{
-		GL_CALL(glBindRenderbuffer(GL_RENDERBUFFER, id));
+		Internal::Issue<&Internal::GLCommands::BindRenderbuffer>(id);
 	}
 
 	void RenderApi::DeleteRenderBuffer(BufferID id)
 	{
-		GL_CALL(glDeleteRenderbuffers(1, &id));
+		Internal::Immediate([&] {
+			GL_CALL(glDeleteRenderbuffers(1, &id));
+		});
 	}
 
 	void RenderApi::SetRenderBufferSize(BufferID id, PixelType type, Vector2Int size, int sampleCount)
 	{
-		BindRenderBuffer(id);
-		if(sampleCount == -1)
-		{
-			GL_CALL(glRenderbufferStorage(GL_RENDERBUFFER, Internal::PixelTypeToGL(type), size.x, size.y));
-		}
-		else
-		{
-			GL_CALL(glRenderbufferStorageMultisample(GL_RENDERBUFFER, sampleCount, Internal::PixelTypeToGL(type), size.x, size.y));
-		}
+		Internal::Immediate([&] {
+			BindRenderBuffer(id);
+			if(sampleCount == -1)
+			{
+				GL_CALL(glRenderbufferStorage(GL_RENDERBUFFER, Internal::PixelTypeToGL(type), size.x, size.y));
+			}
+			else
+			{
+				GL_CALL(glRenderbufferStorageMultisample(GL_RENDERBUFFER, sampleCount, Internal::PixelTypeToGL(type), size.x, size.y));
+			}
+		});
 	}
 
 
 	RenderApi::FrameBufferID RenderApi::MakeFrameBuffer()
 	{
-		FrameBufferID id;
-		GL_CALL(glGenFramebuffers(1, &id));
-		return id;
+		return Internal::Immediate([&]() -> RenderApi::FrameBufferID {
+			FrameBufferID id;
+			GL_CALL(glGenFramebuffers(1, &id));
+			return id;
+		});
 	}
 
 	void RenderApi::BindFrameBuffer(FrameBufferID id)
 	{
-		GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, id));
+		auto& state = Internal::s_state;
+		if (state.readFrameBuffer == id)
+		{
+			BindFrameBufferDraw(id);
+			return;
+		}
+		
+		state.readFrameBuffer = id;
+		state.drawFrameBuffer = id;
+		Internal::ShouldSetState();
+		Internal::Issue<&Internal::GLCommands::BindFramebuffer>(GL_FRAMEBUFFER, id);
 	}
 
 	void RenderApi::BindFrameBufferRead(FrameBufferID id)
 	{
-		GL_CALL(glBindFramebuffer(GL_READ_FRAMEBUFFER, id));
+		if (!Internal::ShouldSetState(Internal::s_state.readFrameBuffer, id))
+			return;
+
+		Internal::Issue<&Internal::GLCommands::BindFramebuffer>(GL_READ_FRAMEBUFFER, id);
 	}
 
 	void RenderApi::BindFrameBufferDraw(FrameBufferID id)
 	{
-		GL_CALL(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, id));
+		if (!Internal::ShouldSetState(Internal::s_state.drawFrameBuffer, id))
+			return;
+
+		Internal::Issue<&Internal::GLCommands::BindFramebuffer>(GL_DRAW_FRAMEBUFFER, id);
 	}
 
 	void RenderApi::DeleteFrameBuffer(FrameBufferID id)
 	{
-		GL_CALL(glDeleteFramebuffers(1, &id));
+		Internal::Immediate([&] {
+			GL_CALL(glDeleteFramebuffers(1, &id));
+
+			// The bindings of a deleted framebuffer revert to 0
+			auto& state = Internal::s_state;
+			if (state.readFrameBuffer == id)
+				state.readFrameBuffer = 0;
+			if (state.drawFrameBuffer == id)
+				state.drawFrameBuffer = 0;
+		});
 	}
 
 	void RenderApi::BindFrameBufferTexture(FrameBufferID id, TextureID textureID, FrameBufferTextureType type)
 	{
 		BindFrameBuffer(id);
 
-		GL_CALL(glFramebufferTexture2D(GL_FRAMEBUFFER, 
+		Internal::Issue<&Internal::GLCommands::FramebufferTexture2D>(
 			type == FrameBufferTextureType::Color ? GL_COLOR_ATTACHMENT0 : GL_DEPTH_ATTACHMENT,
-			GL_TEXTURE_2D, textureID, 0));
+			GL_TEXTURE_2D, textureID, 0);
 	}
 
 	void RenderApi::BindFrameBufferTextureMultisampled(FrameBufferID id, TextureID textureID, FrameBufferTextureType type)
 	{
-		BindFrameBuffer(id);
+		Internal::Immediate([&] {
+			BindFrameBuffer(id);
 
-		GL_CALL(glFramebufferTexture2D(GL_FRAMEBUFFER,
-			type == FrameBufferTextureType::Color ? GL_COLOR_ATTACHMENT0 : GL_DEPTH_ATTACHMENT,
-			GL_TEXTURE_2D_MULTISAMPLE, textureID, 0));
+			GL_CALL(glFramebufferTexture2D(GL_FRAMEBUFFER,
+				type == FrameBufferTextureType::Color ? GL_COLOR_ATTACHMENT0 : GL_DEPTH_ATTACHMENT,
+				GL_TEXTURE_2D_MULTISAMPLE, textureID, 0));
+		});
 	}
 
 	void RenderApi::BindFrameBufferRenderBuffer(FrameBufferID id, BufferID renderBufferID, FrameBufferTextureType type)
@@ -677,28 +1712,25 @@ namespace RexEngine
 		
 		//BindRenderBuffer(renderBufferID);
 
-		GL_CALL(glFramebufferRenderbuffer(GL_FRAMEBUFFER, 
-			type == FrameBufferTextureType::Color ? GL_COLOR_ATTACHMENT0 : GL_DEPTH_ATTACHMENT
-			, GL_RENDERBUFFER, renderBufferID));
+		Internal::Issue<&Internal::GLCommands::FramebufferRenderbuffer>(
+			type == FrameBufferTextureType::Color ? GL_COLOR_ATTACHMENT0 : GL_DEPTH_ATTACHMENT, renderBufferID);
 	}
 
 	void RenderApi::BindFrameBufferCubemapFace(FrameBufferID id, CubemapFace face, TextureID cubemap, FrameBufferTextureType type, int mip)
 	{
-		BindFrameBuffer(id);
+		Internal::Immediate([&] {
+			BindFrameBuffer(id);
 
-		GL_CALL(glFramebufferTexture2D(GL_FRAMEBUFFER, 
-			type == FrameBufferTextureType::Color ? GL_COLOR_ATTACHMENT0 : GL_DEPTH_ATTACHMENT,
-			GL_TEXTURE_CUBE_MAP_POSITIVE_X + (int)face, cubemap, mip));
+			GL_CALL(glFramebufferTexture2D(GL_FRAMEBUFFER, 
+				type == FrameBufferTextureType::Color ? GL_COLOR_ATTACHMENT0 : GL_DEPTH_ATTACHMENT,
+				GL_TEXTURE_CUBE_MAP_POSITIVE_X + (int)face, cubemap, mip));
+		});
 	}
 
 	void RenderApi::BlitFrameBuffer(Vector2Int inStart, Vector2Int inEnd, Vector2Int outStart, Vector2Int outEnd, FrameBufferTextureType type)
 	{
-		GL_CALL(glBlitFramebuffer(inStart.x, inStart.y,
-				inEnd.x, inEnd.y,
-				outStart.x, outStart.y,
-				outEnd.x, outEnd.y,
-				type == FrameBufferTextureType::Color ? GL_COLOR_BUFFER_BIT : GL_DEPTH_BUFFER_BIT,
-				GL_NEAREST));
+		Internal::Issue<&Internal::GLCommands::BlitFramebuffer>(inStart, inEnd, outStart, outEnd,
+			type == FrameBufferTextureType::Color ? GL_COLOR_BUFFER_BIT : GL_DEPTH_BUFFER_BIT);
 	}
 
 	RenderApi::FrameBufferID RenderApi::GetBoundFrameBuffer()
@@ -708,15 +1740,32 @@ namespace RexEngine
 
 	RenderApi::FrameBufferID RenderApi::GetBoundDrawFrameBuffer()
 	{
-		GLint id;
-		GL_CALL(glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &id));
-		return id;
+		// Avoid querying the driver when the binding is known
+		auto& state = Internal::s_state;
+		if (state.drawFrameBuffer == Internal::GLState::Unknown)
+		{
+			Internal::Immediate([&state] {
+				GLint id;
+				GL_CALL(glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &id));
+				state.drawFrameBuffer = id;
+			});
+		}
+
+		return state.drawFrameBuffer;
 	}
 
 	RenderApi::FrameBufferID RenderApi::GetBoundReadFrameBuffer()
 	{
-		GLint id;
-		GL_CALL(glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &id));
-		return id;
+		auto& state = Internal::s_state;
+		if (state.readFrameBuffer == Internal::GLState::Unknown)
+		{
+			Internal::Immediate([&state] {
+				GLint id;
+				GL_CALL(glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &id));
+				state.readFrameBuffer = id;
+			});
+		}
+
+		return state.readFrameBuffer;
 	}
 }
\ No newline at end of file
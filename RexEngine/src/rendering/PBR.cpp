@@ -7,6 +7,7 @@
 #include "Shader.h"
 #include "Shapes.h"
 #include "TextureManager.h"
+#include "ShadowMaps.h"
 #include "scene/Scene.h"
 #include "scene/Components.h"
 
@@ -387,7 +388,7 @@ void main()
 			RenderApi::ClearColorBit();
 			RenderApi::ClearDepthBit();
 
-			RenderApi::DrawElements(cubeMesh->GetIndexCount()); // Render to the cubemap
+			cubeMesh->Draw(); // Render to the cubemap
 		}
 		
 		RenderApi::BindFrameBuffer(oldFrameBuffer);
@@ -454,7 +455,7 @@ void main()
 				RenderApi::ClearColorBit();
 				RenderApi::ClearDepthBit();
 
-				RenderApi::DrawElements(cubeMesh->GetIndexCount()); // Render to the cubemap
+				cubeMesh->Draw(); // Render to the cubemap
 			}
 		}
 
@@ -491,7 +492,7 @@ void main()
 		shader->Bind();
 		RenderApi::ClearColorBit();
 		RenderApi::ClearDepthBit();
-		RenderApi::DrawElements(quad->GetIndexCount());
+		quad->Draw();
 
 		RenderApi::BindFrameBuffer(oldFrameBuffer);
 		RenderApi::SetViewportSize(oldViewportSize); // Revert to the cached viewport size
@@ -518,6 +519,7 @@ void main()
 [Hide]layout(binding = {}) uniform samplerCube PBRPrefilterMap;
 [Hide]layout(binding = {}) uniform sampler2D PBRBrdfLUT;
 )", s_irradianceMapSlot, s_prefilterMapSlot, s_brdfLUTSlot) 
++ ShadowMaps::GetShaderCode()
 + R"(
 const float PI_PBR = 3.14159265359;
 
@@ -567,7 +569,7 @@ vec3 fresnelSchlickRoughness(float cosTheta, vec3 F0, float roughness)
 }
 
 // Returns the radiance, for Point lights and directional lights
-float CalculateLight(LightData light, vec3 worldPos, vec3 N, vec3 V, vec3 F0, float metallic, float roughness, vec3 albedo)
+vec3 CalculateLight(LightData light, vec3 worldPos, vec3 N, vec3 V, vec3 F0, float metallic, float roughness, vec3 albedo)
 {
     vec3 L, H, radiance;
     if (light.Pos.w == 1.0f)
@@ -575,7 +577,7 @@ float CalculateLight(LightData light, vec3 worldPos, vec3 N, vec3 V, vec3 F0, fl
         L = normalize(light.Pos.xyz - worldPos);
         H = normalize(V + L);
         float distance = length(light.Pos.xyz - worldPos);
-        float attenuation = 1.0 / (distance * distance);
+        float attenuation = LightRangeWindow(distance, light.Range) / (distance * distance);
         radiance = light.Color * attenuation;
     }
     else
@@ -604,7 +606,7 @@ float CalculateLight(LightData light, vec3 worldPos, vec3 N, vec3 V, vec3 F0, fl
 }
 
 // Returns the radiance, for Spot lights
-float CalculateSpotLight(SpotLightData light, vec3 worldPos, vec3 N, vec3 V, vec3 F0, float metallic, float roughness, vec3 albedo)
+vec3 CalculateSpotLight(SpotLightData light, vec3 worldPos, vec3 N, vec3 V, vec3 F0, float metallic, float roughness, vec3 albedo)
 {
     vec3 L = normalize(light.Pos.xyz - worldPos);
     vec3 H = normalize(V + L);
@@ -613,7 +615,7 @@ float CalculateSpotLight(SpotLightData light, vec3 worldPos, vec3 N, vec3 V, vec
     float epsilon = (light.CutOff - light.OuterCutOff);
     float intensity = clamp((theta - light.OuterCutOff) / epsilon, 0.0, 1.0);
     float distance = length(light.Pos.xyz - worldPos);
-    float attenuation = 1.0 / (distance * distance);
+    float attenuation = LightRangeWindow(distance, light.Color.w) / (distance * distance);
     vec3 radiance = light.Color.xyz * intensity * attenuation;
 
     // cook-torrance brdf
@@ -648,11 +650,25 @@ vec3 GetPBRColorLit(vec3 albedo, float metallic, float roughness, float ao, vec3
     vec3 Lo = vec3(0.0);
 
     // calculate per-light radiance
-    for (int i = 0; i < LightCount; i++)
-        Lo += CalculateLight(Lights[i], worldPos, N, V, F0, metallic, roughness, albedo);
+    for (uint i = 0; i < DirectionalLightCount; i++)
+    {
+        vec3 radiance = CalculateLight(Lights[i], worldPos, N, V, F0, metallic, roughness, albedo);
+        if (i == 0u) // Only the first directional light has shadows
+            radiance *= GetDirectionalShadow(worldPos, N, normalize(-Lights[i].Pos.xyz), dot(ClusterViewDepth, vec4(worldPos, 1.0)));
+
+        Lo += radiance;
+    }
+
+    // Only the point and spot lights of the cluster of this fragment
+    uvec2 cluster = GetLightCluster(gl_FragCoord.xy, worldPos);
+    uint pointCount = cluster.y & 0xFFFFu;
+    uint spotCount = cluster.y >> 16;
+
+    for (uint i = 0; i < pointCount; i++)
+        Lo += CalculateLight(Lights[ClusterLightIndices[cluster.x + i]], worldPos, N, V, F0, metallic, roughness, albedo);
 
-    for (int i = 0; i < SpotLightCount; i++)
-        Lo += CalculateSpotLight(SpotLights[i], worldPos, N, V, F0, metallic, roughness, albedo);
+    for (uint i = 0; i < spotCount; i++)
+        Lo += CalculateSpotLight(SpotLights[ClusterLightIndices[cluster.x + pointCount + i]], worldPos, N, V, F0, metallic, roughness, albedo);
 
     // Ambient
     vec3 F = fresnelSchlickRoughness(max(dot(N, V), 0.0), F0, roughness);
@@ -2,6 +2,7 @@
 
 #include <string>
 #include <span>
+#include <functional>
 #include <unordered_map>
 #include <typeindex>
 
@@ -10,17 +11,62 @@
 
 namespace RexEngine
 {
+	class CommandStream;
+
 	class RenderApi
 	{
 	private:
 		static void Init();
+		static void NextFrame();
 
 		RE_STATIC_CONSTRUCTOR({
 			EngineEvents::OnEngineStart().Register<&RenderApi::Init>();
+			EngineEvents::OnPreUpdate().Register<&RenderApi::NextFrame>();
 		});
 
 	public:
 
+		// State cache
+		// The bindings and states set through the RenderApi are remembered, setting them to their current value does nothing
+		struct StateStats
+		{
+			size_t issued = 0; // State changes sent to the driver
+			size_t filtered = 0; // State changes skipped because the state was already set
+			size_t recorded = 0; // Calls written to a CommandStream instead of the driver
+			size_t flushes = 0; // Times a call that can't be recorded submitted the commands recorded before it
+		};
+
+		// Stats of the last frame
+		static StateStats GetLastStateStats();
+		// Must be called when the state was changed outside of the RenderApi (other context, external library, ...)
+		static void InvalidateStateCache();
+
+		// Command recording
+		// Between BeginRecording() and EndRecording(), the calls that set a state, bind, clear, draw or time are written to the stream
+		// The other calls (creations, allocations, reads of a value) submit the commands recorded before them, so they see the same state
+		// The state cache follows the recorded calls, so a stream must be submitted once, before the calls made after EndRecording()
+		static void BeginRecording(CommandStream& stream);
+		static void EndRecording();
+		// The commands are moved out of the stream, it's empty after
+		static void Submit(CommandStream& stream);
+
+		// Only the buffer uploads of the streams are submitted, to measure the recording without waiting on the driver
+		// The time queries must not be recorded in this mode, they are never replayed
+		inline static bool RecordOnly = false;
+
+		// Render thread
+		// Once started, a thread owns the context of the active window and the caller keeps working while it replays the submitted streams
+		// The calls of the caller outside of a recording are recorded too, they are sent with the next stream or call that can't be recorded
+		// A call that can't be recorded runs on the render thread after the work sent before it, the caller waits for it
+		// The RenderApi must then only be used by the thread that started it
+		static void StartRenderThread();
+		// Waits for the work sent to the render thread, the context comes back to the caller
+		static void StopRenderThread();
+		static bool IsRenderThreadRunning();
+		// For the code using the context outside of the RenderApi (ex : an ui renderer), runs on the calling thread if there is no render thread
+		static void RunOnRenderThread(const std::function<void()>& function); // Waits for the function
+		static void PostToRenderThread(std::function<void()> function); // Doesn't wait, the function must own the data it uses
+
 		// Shaders
 		typedef unsigned int ShaderID;
 		inline static constexpr ShaderID InvalidShaderID = 0;
@@ -39,6 +85,8 @@ namespace RexEngine
 								 Mat3, Mat4,
 								 Sampler2D, SamplerCube };
 		static std::unordered_map<std::string, std::tuple<int, UniformType>> GetShaderUniforms(ShaderID id);
+		// <block size, <name, <offset, type>>>, the members of a uniform block and their byte offset, size is 0 if the block does not exists
+		static std::tuple<size_t, std::unordered_map<std::string, std::tuple<int, UniformType>>> GetUniformBlockLayout(ShaderID id, const std::string& blockName);
 		static void SetUniformMatrix4(int location, const Matrix4& matrix);
 		static void SetUniformVector3(int location, const Vector3& vec);
 		static void SetUniformFloat(int location, float value);
@@ -49,7 +97,7 @@ namespace RexEngine
 		// Buffers
 		typedef unsigned int BufferID;
 		inline static constexpr BufferID InvalidBufferID = 0;
-		enum class BufferType { Vertex, Indice, Uniforms, ShaderStorage};
+		enum class BufferType { Vertex, Indice, Uniforms, ShaderStorage, Indirect };
 		enum class BufferMode { Static, Dynamic };
 
 		static BufferID MakeBuffer();
@@ -64,14 +112,39 @@ namespace RexEngine
 		}
 
 		static void SubBufferData(BufferID id, BufferType type, size_t offset, size_t size, const void* data);
-		static void BindBufferBase(BufferID id, int location);
+		// Copies size bytes on the GPU, the ranges must not overlap if from and to are the same buffer
+		// Recorded like SubBufferData(), the GPU runs it after the commands issued before without the cpu waiting
+		static void CopyBufferData(BufferID from, BufferID to, size_t fromOffset, size_t toOffset, size_t size);
+		// type can be Uniforms or ShaderStorage, they have separate binding points
+		static void BindBufferBase(BufferID id, int location, BufferType type = BufferType::Uniforms);
+		// Binds [offset, offset + size[ of the buffer, offset must be a multiple of GetBufferOffsetAlignment(type)
+		static void BindBufferRange(BufferID id, int location, BufferType type, size_t offset, size_t size);
+		static size_t GetBufferOffsetAlignment(BufferType type);
+
+		// Immutable storage, mapped for writing until the buffer is deleted (persistent and coherent)
+		// Returns the mapped pointer, the GPU must not be reading a range when it is written (see fences)
+		static uint8_t* MakePersistentBuffer(BufferID id, BufferType type, size_t length);
+
+		// Fences
+		typedef void* FenceID;
+		inline static constexpr FenceID InvalidFenceID = nullptr;
+
+		// Inserts a fence after all the commands issued so far
+		static FenceID MakeFence();
+		// Blocks until the GPU reached the fence
+		static void WaitFence(FenceID id);
+		static void DeleteFence(FenceID id);
 
 		// Vertex Attributes
 		typedef unsigned int VertexAttribID;
-		enum class VertexAttributeType { Float, Float2, Float3, Float4 };
+		// The normalized integer types are read as floats in [-1, 1] by the shaders, the half types as floats
+		enum class VertexAttributeType { Float, Float2, Float3, Float4, Half2, Half4, Short2Normalized, Short4Normalized, Byte4Normalized };
+		enum class IndexType { UInt16, UInt32 };
 
 		// <VertexAttributeType, int location>
 		static VertexAttribID MakeVertexAttributes(std::span<std::tuple<VertexAttributeType, int>> attributes, BufferID vertexBuffer, BufferID indices);
+		static size_t GetVertexAttributeSize(VertexAttributeType type); // In bytes
+		static size_t GetIndexSize(IndexType type) { return type == IndexType::UInt16 ? sizeof(uint16_t) : sizeof(uint32_t); }
 		static void DeleteVertexAttributes(VertexAttribID id);
 		static void BindVertexAttributes(VertexAttribID id);
 
@@ -89,7 +162,7 @@ namespace RexEngine
 
 
 		enum class TextureOption { WrapS, WrapT, WrapR, MinFilter, MagFilter };
-		enum class TextureOptionValue { Repeat, ClampToEdge, Linear, LinearMipmap };
+		enum class TextureOptionValue { Repeat, ClampToEdge, Linear, LinearMipmap, Nearest };
 
 		// Cannot be used with target == Texture2D_Multisample, use SetTextureDataMultisampled instead
 		static TextureID MakeTexture(TextureTarget target, PixelFormat gpuFormat, Vector2Int size, const void* data, PixelFormat dataFormat, PixelType dataType);
@@ -109,6 +182,15 @@ namespace RexEngine
 		static TextureID MakeCubemap();
 		static void SetCubemapFace(TextureID id, CubemapFace face, PixelFormat gpuFormat, Vector2Int size, const void* data, PixelFormat dataFormat, PixelType dataType);
 
+		// Bindless textures (GL_ARB_bindless_texture), sampled through a resident handle instead of a texture slot
+		typedef uint64_t TextureHandle;
+		inline static constexpr TextureHandle InvalidTextureHandle = 0;
+
+		static bool SupportsBindlessTextures();
+		// The texture parameters and storage can't be changed anymore once the texture has a handle
+		static TextureHandle MakeTextureHandleResident(TextureID id);
+		static void MakeTextureHandleNonResident(TextureHandle handle);
+
 		static int GetActiveTexture();
 		static void SetActiveTexture(int index);
 
@@ -119,13 +201,32 @@ namespace RexEngine
 
 		// Viewport
 		static void SetViewportSize(Vector2Int size);
+		// Renders into the rectangle of the target starting at position (lower left corner)
+		static void SetViewport(Vector2Int position, Vector2Int size);
 		static Vector2Int GetViewportSize();
 		static void ClearColorBit(); // TODO : Color
-		static void ClearDepthBit();
+		static void ClearDepthBit(); // Also enables the depth writes, the clear is masked by them
 
 		// Drawing
 		// Needs a shader and a VertexAttribute to be bound first
-		static void DrawElements(size_t count);
+		// firstIndex is the offset in the index buffer (in indices, not bytes), baseVertex is added to every index
+		static void DrawElements(size_t count, size_t firstIndex = 0, int baseVertex = 0, IndexType indexType = IndexType::UInt32);
+		// firstInstance is available in the vertex shader as gl_BaseInstance
+		static void DrawElementsInstanced(size_t count, size_t instanceCount, size_t firstInstance, size_t firstIndex = 0, int baseVertex = 0, IndexType indexType = IndexType::UInt32);
+
+		// Layout of the draws read by MultiDrawElementsIndirect
+		struct DrawIndirectCommand
+		{
+			uint32_t count;
+			uint32_t instanceCount;
+			uint32_t firstIndex;
+			int32_t baseVertex;
+			uint32_t baseInstance; // gl_BaseInstance of the draw
+		};
+
+		// drawCount DrawIndirectCommand read from the buffer bound as BufferType::Indirect, starting at offset (in bytes)
+		// Every draw uses the same index type
+		static void MultiDrawElementsIndirect(size_t drawCount, size_t offset, IndexType indexType = IndexType::UInt32);
 
 		// Culling
 		enum class CullingMode : unsigned char { Front /*Will show front faces only*/, Back /*Will show back faces only*/, Both /*Will show all faces*/ };
@@ -134,6 +235,22 @@ namespace RexEngine
 		// Depth test
 		enum class DepthFunction { Less, LessEqual, Greater, GreaterEqual };
 		static void SetDepthFunction(DepthFunction function);
+		static void SetDepthWrite(bool enabled);
+		// Window depths the [0, 1] range of the depth buffer is mapped to, SetDepthRange(1, 1) draws everything at the max depth
+		static void SetDepthRange(float zNear, float zFar);
+
+		// Queries
+		typedef unsigned int QueryID;
+		inline static constexpr QueryID InvalidQueryID = 0;
+
+		static QueryID MakeQuery();
+		static void DeleteQuery(QueryID id);
+		// Measures the GPU time of the commands between the begin and the end, can't be nested
+		static void BeginTimeQuery(QueryID id);
+		static void EndTimeQuery();
+		// The result is ready a few frames later, GetQueryResult() blocks until it is
+		static bool IsQueryResultAvailable(QueryID id);
+		static uint64_t GetQueryResult(QueryID id); // Nanoseconds for a time query
 	
 		// Render buffers
 		// sampleCount = -1 for no multisampling
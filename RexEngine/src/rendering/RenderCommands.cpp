@@ -1,90 +1,333 @@
 #include <REPch.h>
 #include "RenderCommands.h"
 #include "RenderQueue.h"
+#include "TextureManager.h"
+
+#include <bit>
 
 namespace RexEngine::Internal
 {
-	// Returns true if the values are not equal
-	template<typename T>
-	inline static bool CompareSmaller(T left, T right, bool& smaller)
-	{
-		if (left < right)
-		{
-			smaller = true;
-			return true;
-		}
-		else if (left > right)
-		{
-			smaller = false;
-			return true;
-		}
-
-		return false; // The values are equal
-	}
-
 	class RenderCommandsInit
 	{
 		RE_STATIC_CONSTRUCTOR({
+			RexEngine::RenderQueues::AddQueue<DepthPrepassRenderCommand>("DepthPrepass", -1000);
 			RexEngine::RenderQueues::AddQueue<OpaqueRenderCommand>("Opaque", 0);
+			RexEngine::RenderQueues::AddQueue<SkyboxRenderCommand>("Skybox", 500);
 			RexEngine::RenderQueues::AddQueue<TransparentRenderCommand>("Transparent", 1000);
 		})
 	};
+
+	// Used by the DepthPrepassRenderCommand
+	const std::string DepthOnlySource = R"(
+#pragma vertex
+
+#pragma using SceneData
+#pragma using ModelDataInstanced
+
+layout(location = POSITION) in vec3 aPos;
+
+void main()
+{
+	gl_Position = viewToScreen * worldToView * modelToWorld * vec4(aPos, 1.0);
+}
+
+#pragma fragment
+
+void main()
+{
+}
+)";
 }
 
 namespace RexEngine
 {
-	bool operator<(const OpaqueRenderCommand& left, const OpaqueRenderCommand& right)
+	void ModelInstances::Upload(std::span<const Matrix4> matrices)
+	{
+		if (!matrices.empty())
+			RingBuffer::PushArray(matrices, RenderApi::BufferType::ShaderStorage, Binding);
+	}
+
+	uint64_t RenderSortKey::MakeOpaque(const Material& material, const Mesh& mesh, uint32_t lod, float distanceToCamera)
 	{
 		// Sorting order from :
 		// https://computergraphics.stackexchange.com/questions/37/what-is-the-cost-of-changing-state/46#46
+		auto shader = material.GetShader();
+
+		const uint64_t priority = (uint8_t)((int)shader->Priority() + 128); // Priority is signed, -128 goes first
+		const uint64_t shaderId = shader->GetID() & 0xFFF;
+		const uint64_t materialId = material.GetSortId() & 0xFFFF;
+		const uint64_t meshId = mesh.GetID() & 0x3FFF;
+		const uint64_t lodId = lod & 0x3; // Mesh::MaxLods is 4
+
+		return (priority << 56) | (shaderId << 44) | (materialId << 28) | (meshId << 14) | (lodId << 12) | DepthBucket(distanceToCamera);
+	}
+
+	uint64_t RenderSortKey::MakeTransparent(float distanceToCamera)
+	{
+		// The bits of a positive float sort in the same order as the float, invert them to get the furthest first
+		const uint32_t bits = std::bit_cast<uint32_t>(std::max(distanceToCamera, 0.0f));
+		return (uint64_t)(~bits);
+	}
 
-		bool returnValue;
+	uint64_t RenderSortKey::MakeDepthPrepass(const Mesh& mesh, uint32_t lod, RenderApi::CullingMode cullingMode, float distanceToCamera)
+	{
+		const uint64_t cullingId = (uint64_t)cullingMode & 0x3;
+		const uint64_t meshId = mesh.GetID() & 0x3FFF;
+		const uint64_t lodId = lod & 0x3;
 
-		if (Internal::CompareSmaller<char>(left.material->GetShader()->Priority(), right.material->GetShader()->Priority(), returnValue))
-			return returnValue;
+		return (DepthBucket(distanceToCamera) << 52) | (cullingId << 50) | (meshId << 36) | (lodId << 34);
+	}
 
-		if (Internal::CompareSmaller<std::shared_ptr<Material>>(left.material, right.material, returnValue))
-			return returnValue;
+	uint64_t RenderSortKey::DepthBucket(float distanceToCamera)
+	{
+		const float bucket = std::log2(1.0f + std::max(distanceToCamera, 0.0f)) * 256.0f;
+		return (uint64_t)std::min(bucket, 4095.0f);
+	}
 
-		if (Internal::CompareSmaller<std::shared_ptr<Mesh>>(left.mesh, right.mesh, returnValue))
-			return returnValue;
+	OpaqueRenderCommand::OpaqueRenderCommand(Material* material, Mesh* mesh, const Matrix4& modelMatrix, Vector3 cameraPos, uint32_t lod)
+		: sortKey(0), material(RenderFrame::AddMaterial(material)), mesh(RenderFrame::AddMesh(mesh)), modelMatrix(RenderFrame::AddMatrix(modelMatrix)), lod(lod)
+	{
+		if (material && mesh && material->GetShader())
+			sortKey = RenderSortKey::MakeOpaque(*material, *mesh, lod, Vector3(cameraPos - modelMatrix.Position()).Magnitude());
+	}
 
-		return false; // Equal
+	bool operator<(const OpaqueRenderCommand& left, const OpaqueRenderCommand& right)
+	{
+		return left.sortKey < right.sortKey;
 	}
 
 	void OpaqueRenderCommand::Render(const OpaqueRenderCommand& last) const
 	{
-		if (material != last.material) // The material changed
-			material->Bind();
+		Material* currentMaterial = RenderFrame::GetMaterial(material);
+		Mesh* currentMesh = RenderFrame::GetMesh(mesh);
 
-		if (mesh != last.mesh) // The vertex data changed
-			mesh->Bind();
+		if (currentMaterial != RenderFrame::GetMaterial(last.material)) // The material changed
+			currentMaterial->Bind();
+
+		if (currentMesh != RenderFrame::GetMesh(last.mesh)) // The vertex data changed
+			currentMesh->Bind();
 
 		// Update the model data
-		ModelUniforms modelData{ modelMatrix };
-		UniformBlocks::GetBlock<ModelUniforms>("ModelData").SetData(modelData);
+		static const int modelDataLocation = UniformBlocks::GetLocation("ModelData");
+		RingBuffer::Push(ModelUniforms{ RenderFrame::GetMatrix(modelMatrix) }, RenderApi::BufferType::Uniforms, modelDataLocation);
+
+		currentMesh->Draw(lod);
+		RenderFrame::CountDraw(1, currentMesh->GetLod(lod).indexCount);
+	}
+
+	bool OpaqueRenderCommand::CanInstanceWith(const OpaqueRenderCommand& other) const
+	{
+		Material* currentMaterial = RenderFrame::GetMaterial(material);
+		return currentMaterial != nullptr
+			&& currentMaterial == RenderFrame::GetMaterial(other.material)
+			&& RenderFrame::GetMesh(mesh) == RenderFrame::GetMesh(other.mesh)
+			&& lod == other.lod
+			&& currentMaterial->GetShader()->SupportsInstancing();
+	}
+
+	void OpaqueRenderCommand::PrepareInstances(std::span<const OpaqueRenderCommand* const> sorted)
+	{
+		// The instance id of a command is its index in the sorted queue
+		static std::vector<Matrix4> matrices;
+		matrices.clear();
+		matrices.reserve(sorted.size());
+
+		// The materials are bound in this order, so the texture slots can be assigned knowing the next uses
+		TextureManager::BeginPlan();
+		Material* lastMaterial = nullptr;
+
+		bool anyInstanced = false;
+		for (auto command : sorted)
+		{
+			matrices.push_back(RenderFrame::GetMatrix(command->modelMatrix));
+
+			Material* commandMaterial = RenderFrame::GetMaterial(command->material);
+			anyInstanced |= commandMaterial && commandMaterial->GetShader()->SupportsInstancing();
+
+			if (commandMaterial && commandMaterial != lastMaterial)
+			{
+				TextureManager::PlanShader();
+				commandMaterial->PlanTextures();
+				lastMaterial = commandMaterial;
+			}
+		}
+
+		if (anyInstanced)
+			ModelInstances::Upload(matrices);
+	}
+
+	void OpaqueRenderCommand::RenderInstanced(const OpaqueRenderCommand& last, uint32_t firstInstance, uint32_t instanceCount) const
+	{
+		Material* currentMaterial = RenderFrame::GetMaterial(material);
+		if (!currentMaterial->GetShader()->SupportsInstancing())
+		{ // Uses ModelData, instanceCount is always 1 (see CanInstanceWith)
+			Render(last);
+			return;
+		}
 
-		RenderApi::DrawElements(mesh->GetIndexCount());
+		Mesh* currentMesh = RenderFrame::GetMesh(mesh);
+
+		if (currentMaterial != RenderFrame::GetMaterial(last.material)) // The material changed
+			currentMaterial->Bind();
+
+		if (currentMesh != RenderFrame::GetMesh(last.mesh)) // The vertex data changed
+			currentMesh->Bind();
+
+		currentMesh->DrawInstanced(lod, instanceCount, firstInstance);
+		RenderFrame::CountDraw(instanceCount, currentMesh->GetLod(lod).indexCount);
+	}
+
+	bool OpaqueRenderCommand::CanMultiDrawWith(const OpaqueRenderCommand& other) const
+	{
+		Material* currentMaterial = RenderFrame::GetMaterial(material);
+		return EnableMultiDraw
+			&& currentMaterial != nullptr
+			&& currentMaterial == RenderFrame::GetMaterial(other.material)
+			&& currentMaterial->GetShader()->SupportsInstancing()
+			&& RenderFrame::GetMesh(mesh)->GetLayout() == RenderFrame::GetMesh(other.mesh)->GetLayout();
+	}
+
+	void OpaqueRenderCommand::RenderMultiDraw(const OpaqueRenderCommand& last, std::span<const OpaqueRenderCommand* const> sorted, std::span<const InstanceRun> runs) const
+	{
+		Material* currentMaterial = RenderFrame::GetMaterial(material);
+		Mesh* currentMesh = RenderFrame::GetMesh(mesh);
+
+		if (currentMaterial != RenderFrame::GetMaterial(last.material)) // The material changed
+			currentMaterial->Bind();
+
+		// Every mesh of the runs shares these vertex attributes and index type
+		if (currentMesh != RenderFrame::GetMesh(last.mesh))
+			currentMesh->Bind();
+
+		// The draws are written in the RingBuffer, the base instance of a run is its index in the sorted commands like for RenderInstanced
+		auto allocation = RingBuffer::Allocate(runs.size() * sizeof(RenderApi::DrawIndirectCommand));
+		auto draws = reinterpret_cast<RenderApi::DrawIndirectCommand*>(allocation.data);
+
+		for (size_t i = 0; i < runs.size(); i++)
+		{
+			const auto& command = *sorted[runs[i].first];
+			Mesh* runMesh = RenderFrame::GetMesh(command.mesh);
+
+			draws[i] = runMesh->GetDrawCommand(command.lod, runs[i].count, runs[i].first);
+			RenderFrame::CountDraw(runs[i].count, draws[i].count, i == 0 ? 1 : 0);
+		}
+
+		RenderApi::BindBuffer(allocation.buffer, RenderApi::BufferType::Indirect);
+		RenderApi::MultiDrawElementsIndirect(runs.size(), allocation.offset, currentMesh->GetIndexType());
+	}
+
+	DepthPrepassRenderCommand::DepthPrepassRenderCommand(Mesh* mesh, const Matrix4& modelMatrix, Vector3 cameraPos, RenderApi::CullingMode cullingMode, uint32_t lod)
+		: sortKey(0), mesh(RenderFrame::AddMesh(mesh)), modelMatrix(RenderFrame::AddMatrix(modelMatrix)), lod(lod), cullingMode(cullingMode)
+	{
+		if (mesh)
+			sortKey = RenderSortKey::MakeDepthPrepass(*mesh, lod, cullingMode, Vector3(cameraPos - modelMatrix.Position()).Magnitude());
+	}
+
+	bool operator<(const DepthPrepassRenderCommand& left, const DepthPrepassRenderCommand& right)
+	{
+		return left.sortKey < right.sortKey;
+	}
+
+	void DepthPrepassRenderCommand::Render(const DepthPrepassRenderCommand& last) const
+	{
+		// The render queue uses RenderInstanced, this draws the command as the only instance
+		ModelInstances::Upload(std::span(&RenderFrame::GetMatrix(modelMatrix), 1));
+		RenderInstanced(last, 0, 1);
+	}
+
+	bool DepthPrepassRenderCommand::CanInstanceWith(const DepthPrepassRenderCommand& other) const
+	{
+		return RenderFrame::GetMesh(mesh) == RenderFrame::GetMesh(other.mesh)
+			&& lod == other.lod
+			&& cullingMode == other.cullingMode;
+	}
+
+	void DepthPrepassRenderCommand::PrepareInstances(std::span<const DepthPrepassRenderCommand* const> sorted)
+	{
+		static std::vector<Matrix4> matrices;
+		matrices.clear();
+		matrices.reserve(sorted.size());
+
+		for (auto command : sorted)
+			matrices.push_back(RenderFrame::GetMatrix(command->modelMatrix));
+
+		ModelInstances::Upload(matrices);
+	}
+
+	void DepthPrepassRenderCommand::RenderInstanced(const DepthPrepassRenderCommand& last, uint32_t firstInstance, uint32_t instanceCount) const
+	{
+		Mesh* currentMesh = RenderFrame::GetMesh(mesh);
+
+		if (last.mesh == RenderFrame::InvalidIndex) // First command of the queue
+		{
+			static NoDestroy<Shader> shader(Internal::DepthOnlySource);
+			shader->Bind();
+		}
+
+		RenderApi::SetCullingMode(cullingMode);
+
+		if (currentMesh != RenderFrame::GetMesh(last.mesh)) // The vertex data changed
+			currentMesh->Bind();
+
+		currentMesh->DrawInstanced(lod, instanceCount, firstInstance);
+		RenderFrame::CountDraw(instanceCount, currentMesh->GetLod(lod).indexCount);
+	}
+
+	SkyboxRenderCommand::SkyboxRenderCommand(Material* material, Mesh* mesh, const Matrix4& modelMatrix)
+		: material(RenderFrame::AddMaterial(material)), mesh(RenderFrame::AddMesh(mesh)), modelMatrix(RenderFrame::AddMatrix(modelMatrix))
+	{ }
+
+	void SkyboxRenderCommand::Render([[maybe_unused]] const SkyboxRenderCommand& last) const
+	{
+		Material* currentMaterial = RenderFrame::GetMaterial(material);
+		Mesh* currentMesh = RenderFrame::GetMesh(mesh);
+
+		currentMaterial->Bind();
+		currentMesh->Bind();
+
+		// Whatever the shader outputs, the cube is at the max depth : it only passes where no opaque object was drawn
+		RenderApi::SetDepthFunction(RenderApi::DepthFunction::LessEqual);
+		RenderApi::SetDepthWrite(false);
+		RenderApi::SetDepthRange(1.0f, 1.0f);
+
+		static const int modelDataLocation = UniformBlocks::GetLocation("ModelData");
+		RingBuffer::Push(ModelUniforms{ RenderFrame::GetMatrix(modelMatrix) }, RenderApi::BufferType::Uniforms, modelDataLocation);
+
+		currentMesh->Draw();
+		RenderFrame::CountDraw(1, currentMesh->GetIndexCount());
+
+		RenderApi::SetDepthRange(0.0f, 1.0f);
+		RenderApi::SetDepthWrite(true);
+	}
+
+	TransparentRenderCommand::TransparentRenderCommand(Material* material, Mesh* mesh, const Matrix4& modelMatrix, Vector3 cameraPos)
+		: sortKey(0), material(RenderFrame::AddMaterial(material)), mesh(RenderFrame::AddMesh(mesh)), modelMatrix(RenderFrame::AddMatrix(modelMatrix))
+	{
+		sortKey = RenderSortKey::MakeTransparent(Vector3(cameraPos - modelMatrix.Position()).Magnitude());
 	}
 
 	bool operator<(const TransparentRenderCommand& left, const TransparentRenderCommand& right)
 	{
 		// Sort based on distance from the camera (further away first)
-		return left.distanceToCamera > right.distanceToCamera;
+		return left.sortKey < right.sortKey;
 	}
 
 	void TransparentRenderCommand::Render(const TransparentRenderCommand& last) const
 	{
-		if (material != last.material) // The material changed
-			material->Bind();
+		Material* currentMaterial = RenderFrame::GetMaterial(material);
+		Mesh* currentMesh = RenderFrame::GetMesh(mesh);
+
+		if (currentMaterial != RenderFrame::GetMaterial(last.material)) // The material changed
+			currentMaterial->Bind();
 
-		if (mesh != last.mesh) // The vertex data changed
-			mesh->Bind();
+		if (currentMesh != RenderFrame::GetMesh(last.mesh)) // The vertex data changed
+			currentMesh->Bind();
 
 		// Update the model data
-		ModelUniforms modelData{ modelMatrix };
-		UniformBlocks::GetBlock<ModelUniforms>("ModelData").SetData(modelData);
+		static const int modelDataLocation = UniformBlocks::GetLocation("ModelData");
+		RingBuffer::Push(ModelUniforms{ RenderFrame::GetMatrix(modelMatrix) }, RenderApi::BufferType::Uniforms, modelDataLocation);
 
-		RenderApi::DrawElements(mesh->GetIndexCount());
+		currentMesh->Draw();
+		RenderFrame::CountDraw(1, currentMesh->GetIndexCount());
 	}
 }
\ No newline at end of file
@@ -5,6 +5,9 @@
 #include "Mesh.h"
 #include "Shader.h"
 #include "UniformBlock.h"
+#include "RenderFrame.h"
+#include "RingBuffer.h"
+#include "RenderQueue.h"
 
 // Some default rendercommands
 
@@ -21,46 +24,146 @@ namespace RexEngine
 		});
 	};
 
-	// Sorted by Material and mesh
-	struct OpaqueRenderCommand
+	// Model matrices of the instanced draws, read with gl_BaseInstance + gl_InstanceID
+	// Use #pragma using ModelDataInstanced instead of ModelData in a vertex shader to allow instancing
+	class ModelInstances
 	{
-		Matrix4 modelMatrix;
+	public:
+		inline static constexpr int Binding = 0; // Shader storage binding, separate from the uniform blocks
 
-		std::shared_ptr<Material> material;
-		std::shared_ptr<Mesh> mesh;
+		// Copies the matrices in the RingBuffer and binds them, the index in the span is the instance id
+		static void Upload(std::span<const Matrix4> matrices);
 
+	private:
+		RE_STATIC_CONSTRUCTOR({
+			Shader::RegisterParserUsing(Shader::InstancingUsing, std::format("layout (std430, binding = {}) readonly buffer ModelInstanceData{{ mat4 modelInstances[]; }};\n#define modelToWorld modelInstances[gl_BaseInstance + gl_InstanceID]", Binding));
+		});
+	};
 
-		OpaqueRenderCommand(std::shared_ptr<Material> material, std::shared_ptr<Mesh> mesh, Matrix4 modelMatrix)
-			: material(material), mesh(mesh), modelMatrix(modelMatrix)
-		{ }
+	// Packed 64 bits sort key, the highest bits are sorted first :
+	// [63-56] shader priority | [55-44] shader id | [43-28] material id | [27-14] mesh id | [13-12] lod | [11-0] depth bucket
+	// The ids are truncated, a collision only affects the grouping of the draws, not the correctness
+	class RenderSortKey
+	{
+	public:
+		static uint64_t MakeOpaque(const Material& material, const Mesh& mesh, uint32_t lod, float distanceToCamera);
+
+		// Further away first
+		static uint64_t MakeTransparent(float distanceToCamera);
+
+		// Closest first, then grouped by culling mode, mesh and lod for the instancing
+		// [63-52] depth bucket | [51-50] culling mode | [49-36] mesh id | [35-34] lod
+		static uint64_t MakeDepthPrepass(const Mesh& mesh, uint32_t lod, RenderApi::CullingMode cullingMode, float distanceToCamera);
+
+		// Log scale depth bucket, more precision close to the camera
+		static uint64_t DepthBucket(float distanceToCamera);
+	};
 
-		OpaqueRenderCommand() : OpaqueRenderCommand(nullptr, nullptr, Matrix4::Identity)
+	// Sorted by Material and mesh
+	// Only holds indices in the RenderFrame tables, no refcounting
+	struct OpaqueRenderCommand
+	{
+		uint64_t sortKey;
+		uint32_t material;
+		uint32_t mesh;
+		uint32_t modelMatrix;
+		uint32_t lod;
+
+		// The material and the mesh must stay alive until the queues are cleared
+		OpaqueRenderCommand(Material* material, Mesh* mesh, const Matrix4& modelMatrix, Vector3 cameraPos, uint32_t lod = 0);
+
+		OpaqueRenderCommand() : sortKey(0), material(RenderFrame::InvalidIndex), mesh(RenderFrame::InvalidIndex), modelMatrix(RenderFrame::InvalidIndex), lod(0)
 		{}
 
 		void Render(const OpaqueRenderCommand& last) const;
 
+		// Instancing, see InstancedRenderCommandType
+		bool CanInstanceWith(const OpaqueRenderCommand& other) const;
+		static void PrepareInstances(std::span<const OpaqueRenderCommand* const> sorted);
+		void RenderInstanced(const OpaqueRenderCommand& last, uint32_t firstInstance, uint32_t instanceCount) const;
+
+		// Multi draw, see MultiDrawRenderCommandType
+		// The runs with the same material and the same vertex layout are drawn with one RenderApi::MultiDrawElementsIndirect()
+		bool CanMultiDrawWith(const OpaqueRenderCommand& other) const;
+		void RenderMultiDraw(const OpaqueRenderCommand& last, std::span<const OpaqueRenderCommand* const> sorted, std::span<const InstanceRun> runs) const;
+
+		// Can be turned off to compare with one draw per run
+		inline static bool EnableMultiDraw = true;
+
+		uint64_t SortKey() const { return sortKey; }
+
 		friend bool operator<(const OpaqueRenderCommand& left, const OpaqueRenderCommand& right);
 	};
 
-	// Sorted by distance to the camera
-	struct TransparentRenderCommand
+	// Depth only draw of an opaque object, with a position only shader
+	// Sorted front to back, so the opaque pass that follows only shades the visible fragments
+	// Only holds indices in the RenderFrame tables, no refcounting
+	struct DepthPrepassRenderCommand
+	{
+		uint64_t sortKey;
+		uint32_t mesh;
+		uint32_t modelMatrix;
+		uint32_t lod;
+		RenderApi::CullingMode cullingMode; // Of the shader of the object
+
+		// The mesh must stay alive until the queues are cleared
+		DepthPrepassRenderCommand(Mesh* mesh, const Matrix4& modelMatrix, Vector3 cameraPos, RenderApi::CullingMode cullingMode, uint32_t lod = 0);
+
+		DepthPrepassRenderCommand() : sortKey(0), mesh(RenderFrame::InvalidIndex), modelMatrix(RenderFrame::InvalidIndex), lod(0), cullingMode(RenderApi::CullingMode::Front)
+		{}
+
+		void Render(const DepthPrepassRenderCommand& last) const;
+
+		// Instancing, see InstancedRenderCommandType
+		bool CanInstanceWith(const DepthPrepassRenderCommand& other) const;
+		static void PrepareInstances(std::span<const DepthPrepassRenderCommand* const> sorted);
+		void RenderInstanced(const DepthPrepassRenderCommand& last, uint32_t firstInstance, uint32_t instanceCount) const;
+
+		uint64_t SortKey() const { return sortKey; }
+
+		friend bool operator<(const DepthPrepassRenderCommand& left, const DepthPrepassRenderCommand& right);
+	};
+
+	// Drawn between the opaque and the transparent objects, at the max depth with LessEqual
+	// Only the pixels not covered by an opaque object run the skybox shader
+	// Only holds indices in the RenderFrame tables, no refcounting
+	struct SkyboxRenderCommand
 	{
-		Matrix4 modelMatrix;
+		uint32_t material;
+		uint32_t mesh;
+		uint32_t modelMatrix;
+
+		// The material and the mesh must stay alive until the queues are cleared
+		SkyboxRenderCommand(Material* material, Mesh* mesh, const Matrix4& modelMatrix);
+
+		SkyboxRenderCommand() : material(RenderFrame::InvalidIndex), mesh(RenderFrame::InvalidIndex), modelMatrix(RenderFrame::InvalidIndex)
+		{}
+
+		void Render(const SkyboxRenderCommand& last) const;
 
-		std::shared_ptr<Material> material;
-		std::shared_ptr<Mesh> mesh;
-		float distanceToCamera;
+		// There is one skybox, nothing to sort
+		friend bool operator<([[maybe_unused]] const SkyboxRenderCommand& left, [[maybe_unused]] const SkyboxRenderCommand& right) { return false; }
+	};
 
+	// Sorted by distance to the camera
+	// Only holds indices in the RenderFrame tables, no refcounting
+	struct TransparentRenderCommand
+	{
+		uint64_t sortKey;
+		uint32_t material;
+		uint32_t mesh;
+		uint32_t modelMatrix;
 
-		TransparentRenderCommand(std::shared_ptr<Material> material, std::shared_ptr<Mesh> mesh, Matrix4 modelMatrix, Vector3 cameraPos)
-			: material(material), mesh(mesh), modelMatrix(modelMatrix), distanceToCamera(Vector3(cameraPos - modelMatrix.Position()).Magnitude())
-		{ }
+		// The material and the mesh must stay alive until the queues are cleared
+		TransparentRenderCommand(Material* material, Mesh* mesh, const Matrix4& modelMatrix, Vector3 cameraPos);
 
-		TransparentRenderCommand() : TransparentRenderCommand(nullptr, nullptr, Matrix4::Identity, {0,0,0})
+		TransparentRenderCommand() : sortKey(0), material(RenderFrame::InvalidIndex), mesh(RenderFrame::InvalidIndex), modelMatrix(RenderFrame::InvalidIndex)
 		{}
 
 		void Render(const TransparentRenderCommand& last) const;
 
+		uint64_t SortKey() const { return sortKey; }
+
 		friend bool operator<(const TransparentRenderCommand& left, const TransparentRenderCommand& right);
 	};
 }
\ No newline at end of file
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "../utils/FrameArena.h"
+#include "../math/Matrix.h"
+
+namespace RexEngine
+{
+	class Material;
+	class Mesh;
+
+	// Per frame data referenced by the render commands
+	// The commands only store indices in these tables, so they stay small and trivially copyable
+	// Everything is reset by RenderQueues::ClearQueues()
+	class RenderFrame
+	{
+	public:
+		inline static constexpr uint32_t InvalidIndex = UINT32_MAX;
+
+		struct Stats
+		{
+			size_t bytesUsed = 0; // Bytes allocated from the frame arena
+			size_t heapBytesAllocated = 0; // Bytes the arena had to request from the heap
+			size_t bytesReserved = 0; // Total size of the frame arena
+			uint32_t drawCalls = 0; // Draw calls issued by the render queues
+			uint32_t instances = 0; // Objects drawn by these draw calls
+			uint64_t triangles = 0; // Triangles sent by these draw calls
+		};
+
+		// The Material and Mesh must stay alive until the queues are cleared
+		inline static uint32_t AddMaterial(Material* material) { return AddCached(GetData().materials, GetData().materialCache, material); }
+		inline static uint32_t AddMesh(Mesh* mesh) { return AddCached(GetData().meshes, GetData().meshCache, mesh); }
+		inline static uint32_t AddMatrix(const Matrix4& matrix) { return GetData().matrices.PushBack(matrix); }
+
+		inline static Material* GetMaterial(uint32_t index) { return index == InvalidIndex ? nullptr : GetData().materials[index]; }
+		inline static Mesh* GetMesh(uint32_t index) { return index == InvalidIndex ? nullptr : GetData().meshes[index]; }
+		inline static const Matrix4& GetMatrix(uint32_t index) { return GetData().matrices[index]; }
+
+		inline static FrameArena& Arena() { return GetData().arena; }
+
+		// Called by the render commands for the stats
+		// The draws of a multi draw after the first one count their instances and triangles, but not a draw call
+		inline static void CountDraw(uint32_t instances, size_t indexCount, uint32_t drawCalls = 1)
+		{
+			GetData().drawCalls += drawCalls;
+			GetData().instances += instances;
+			GetData().triangles += (uint64_t)instances * (indexCount / 3);
+		}
+
+		// Stats of the last frame (between the last 2 Reset() calls)
+		inline static Stats GetLastFrameStats() { return GetData().lastStats; }
+
+		// Called by RenderQueues::ClearQueues(), everything allocated in the arena becomes invalid
+		inline static void Reset()
+		{
+			auto& data = GetData();
+			data.lastStats = { data.arena.BytesUsed(), data.arena.HeapBytesAllocated(), data.arena.BytesReserved(), data.drawCalls, data.instances, data.triangles };
+			data.drawCalls = 0;
+			data.instances = 0;
+			data.triangles = 0;
+
+			data.materials.Clear();
+			data.meshes.Clear();
+			data.matrices.Clear();
+			data.materialCache.fill({});
+			data.meshCache.fill({});
+			data.arena.Reset();
+		}
+
+	private:
+		// Small direct mapped cache to avoid adding the same pointer many times, no allocations
+		template<typename T>
+		using PointerCache = std::array<std::pair<T*, uint32_t>, 64>;
+
+		template<typename T>
+		inline static uint32_t AddCached(ArenaList<T*>& table, PointerCache<T>& cache, T* ptr)
+		{
+			if (ptr == nullptr)
+				return InvalidIndex;
+
+			auto& entry = cache[(reinterpret_cast<uintptr_t>(ptr) >> 4) % cache.size()];
+			if (entry.first != ptr)
+				entry = { ptr, table.PushBack(ptr) };
+
+			return entry.second;
+		}
+
+		struct Data
+		{
+			FrameArena arena;
+			ArenaList<Material*> materials{ arena };
+			ArenaList<Mesh*> meshes{ arena };
+			ArenaList<Matrix4> matrices{ arena };
+
+			PointerCache<Material> materialCache{};
+			PointerCache<Mesh> meshCache{};
+
+			uint32_t drawCalls = 0;
+			uint32_t instances = 0;
+			uint64_t triangles = 0;
+			Stats lastStats;
+		};
+
+		// Function static to be usable from other static constructors (RenderQueues::AddQueue)
+		inline static Data& GetData()
+		{
+			static Data data;
+			return data;
+		}
+	};
+}
@@ -5,25 +5,66 @@
 #include <any>
 #include <concepts>
 #include <string>
+#include <span>
 
 #include "RenderApi.h"
 #include "Mesh.h"
 #include "Material.h"
+#include "RenderFrame.h"
+#include "../utils/RadixSort.h"
+#include "../utils/FrameArena.h"
 
 namespace RexEngine
 {
 	// Current RenderQueue priorities:
+	// DepthPrepass : -1000 (empty when ForwardRenderer::EnableDepthPrepass is off)
 	// Opaque : 0
+	// Skybox : 500
 	// Transparent : 1000
 	// Gizmos (Editor) : 10000
 
 	template<typename T>
 	concept RenderCommandType =
 		requires() { T{}; } // Default constructible
+		&& std::is_trivially_destructible_v<T> // Stored in the frame arena, the destructor is never called
 		&& requires(const T t1, const T t2) { {t1 < t2} -> std::convertible_to<bool>; } // Needs to be sorted
 		&& requires(const T t, const T& last) { t.Render(last); };  // Do the render call, the element rendered just before is passed as parameter
 																	// if this is the first element, T() will be passed
 
+	// Commands with a precomputed 64 bits key will be radix sorted on that key instead of using operator<
+	template<typename T>
+	concept HasSortKey = requires(const T t) { { t.SortKey() } -> std::convertible_to<uint64_t>; };
+
+	// Commands that can merge consecutive (sorted) elements in a single instanced draw call
+	// PrepareInstances is called once with all the commands in the sorted order, the index in that span is the instance id
+	// (it is also where the upcoming material binds can be planned, see TextureManager::BeginPlan)
+	// RenderInstanced replaces Render, with firstInstance the index of the first command of the run
+	template<typename T>
+	concept InstancedRenderCommandType = RenderCommandType<T>
+		&& requires(const T t, const T& other, std::span<const T* const> sorted, uint32_t n)
+		{
+			{ t.CanInstanceWith(other) } -> std::convertible_to<bool>;
+			T::PrepareInstances(sorted);
+			t.RenderInstanced(other, n, n); // last, firstInstance, instanceCount
+		};
+
+	// Consecutive commands drawn by a single instanced draw, see InstancedRenderCommandType
+	struct InstanceRun
+	{
+		uint32_t first; // Index in the sorted commands, also the first instance id
+		uint32_t count;
+	};
+
+	// Instanced commands that can merge consecutive runs in a single indirect multi draw, each run can use another mesh
+	// RenderMultiDraw is called on the first command of the first run instead of RenderInstanced, when there are at least 2 runs
+	template<typename T>
+	concept MultiDrawRenderCommandType = InstancedRenderCommandType<T>
+		&& requires(const T t, const T& other, std::span<const T* const> sorted, std::span<const InstanceRun> runs)
+		{
+			{ t.CanMultiDrawWith(other) } -> std::convertible_to<bool>;
+			t.RenderMultiDraw(other, sorted, runs); // last, sorted commands, runs
+		};
+
 	class RenderQueue
 	{
 	public:
@@ -45,7 +86,7 @@ namespace RexEngine
 		static RenderQueue MakeRenderQueue(int priority)
 		{
 			RenderQueue queue(priority);
-			queue.m_queue = std::vector<T>();
+			queue.m_queue = QueueData<T>(RenderFrame::Arena());
 			queue.m_render = std::bind(RenderQueue::RenderTemplate<T>, std::placeholders::_1);
 			queue.m_sort = std::bind(RenderQueue::SortTemplate<T>, std::placeholders::_1);
 			queue.m_clear = std::bind(RenderQueue::ClearTemplate<T>, std::placeholders::_1);
@@ -74,19 +115,19 @@ namespace RexEngine
 		template<RenderCommandType T, typename ...Args>
 		void AddCommand(Args&&... args)
 		{
-			GetData<T>().emplace_back(std::forward<Args>(args)...);
+			GetData<T>().EmplaceBack(std::forward<Args>(args)...);
 		}
 
 		template<RenderCommandType T>
-		std::vector<T>& GetData()
+		ArenaList<T>& GetData()
 		{
-			return std::any_cast<std::vector<T>&>(m_queue);
+			return std::any_cast<QueueData<T>&>(m_queue).commands;
 		}
 
 		template<RenderCommandType T>
-		const std::vector<T>& GetData() const
+		const ArenaList<T>& GetData() const
 		{
-			return std::any_cast<const std::vector<T>&>(m_queue);
+			return std::any_cast<const QueueData<T>&>(m_queue).commands;
 		}
 
 		friend bool operator<(const RenderQueue& lhs, const RenderQueue& rhs) { return lhs.m_priority < rhs.m_priority; }
@@ -97,31 +138,123 @@ namespace RexEngine
 			: m_priority(priority)
 		{ }
 
+		// The commands live in the frame arena, the other vectors keep their capacity between frames
+		template<RenderCommandType T>
+		struct QueueData
+		{
+			ArenaList<T> commands;
+			std::vector<uint32_t> order; // Indices of the commands, in the sorted order
+			mutable std::vector<const T*> sorted; // Used by RenderTemplate for the instancing
+			mutable std::vector<InstanceRun> runs;
+
+			std::vector<RadixSort::KeyIndex> keys;
+			std::vector<RadixSort::KeyIndex> scratch;
+
+			explicit QueueData(FrameArena& arena) : commands(arena) {}
+		};
+
 		template<RenderCommandType T>
 		static void RenderTemplate(const std::any& data)
 		{
-			auto& vec = std::any_cast<const std::vector<T>&>(data);
-			T first = T();
-			T& last = first;
-			for (auto& element : vec)
+			auto& queue = std::any_cast<const QueueData<T>&>(data);
+			const bool sorted = queue.order.size() == queue.commands.Size();
+
+			const T first = T();
+			const T* last = &first;
+
+			if constexpr (InstancedRenderCommandType<T>)
+			{
+				queue.sorted.clear();
+				for (size_t i = 0; i < queue.commands.Size(); i++)
+					queue.sorted.push_back(&queue.commands[sorted ? queue.order[i] : i]);
+
+				T::PrepareInstances(queue.sorted);
+
+				// The runs of commands that can be instanced together
+				queue.runs.clear();
+				for (size_t i = 0; i < queue.sorted.size();)
+				{
+					size_t end = i + 1;
+					while (end < queue.sorted.size() && queue.sorted[end]->CanInstanceWith(*queue.sorted[i]))
+						end++;
+
+					queue.runs.push_back({ static_cast<uint32_t>(i), static_cast<uint32_t>(end - i) });
+					i = end;
+				}
+
+				for (size_t i = 0; i < queue.runs.size();)
+				{
+					size_t end = i + 1;
+					if constexpr (MultiDrawRenderCommandType<T>)
+					{
+						const T& runHead = *queue.sorted[queue.runs[i].first];
+						while (end < queue.runs.size() && queue.sorted[queue.runs[end].first]->CanMultiDrawWith(runHead))
+							end++;
+					}
+
+					const auto& run = queue.runs[i];
+					if constexpr (MultiDrawRenderCommandType<T>)
+					{
+						if (end - i > 1)
+							queue.sorted[run.first]->RenderMultiDraw(*last, queue.sorted, std::span(queue.runs).subspan(i, end - i));
+						else
+							queue.sorted[run.first]->RenderInstanced(*last, run.first, run.count);
+					}
+					else
+						queue.sorted[run.first]->RenderInstanced(*last, run.first, run.count);
+
+					const auto& lastRun = queue.runs[end - 1];
+					last = queue.sorted[lastRun.first + lastRun.count - 1];
+					i = end;
+				}
+			}
+			else
 			{
-				element.Render(last);
-				last = element;
+				for (size_t i = 0; i < queue.commands.Size(); i++)
+				{
+					const T& element = queue.commands[sorted ? queue.order[i] : i];
+					element.Render(*last);
+					last = &element;
+				}
 			}
 		}
 
 		template<RenderCommandType T>
 		static void SortTemplate(std::any& data)
 		{
-			auto& vec = std::any_cast<std::vector<T>&>(data);
-			std::sort(vec.begin(), vec.end());
+			auto& queue = std::any_cast<QueueData<T>&>(data);
+			const size_t count = queue.commands.Size();
+
+			queue.order.clear();
+			queue.order.reserve(count);
+
+			if constexpr (HasSortKey<T>)
+			{
+				queue.keys.clear();
+				for (size_t i = 0; i < count; i++)
+					queue.keys.push_back({ queue.commands[i].SortKey(), static_cast<uint32_t>(i) });
+
+				RadixSort::Sort(queue.keys, queue.scratch);
+
+				// Only the indices are sorted, the commands never move
+				for (auto& key : queue.keys)
+					queue.order.push_back(key.index);
+			}
+			else
+			{
+				for (size_t i = 0; i < count; i++)
+					queue.order.push_back(static_cast<uint32_t>(i));
+
+				std::stable_sort(queue.order.begin(), queue.order.end(), [&queue](uint32_t a, uint32_t b) { return queue.commands[a] < queue.commands[b]; });
+			}
 		}
 
 		template<RenderCommandType T>
 		static void ClearTemplate(std::any& data)
 		{
-			auto& vec = std::any_cast<std::vector<T>&>(data);
-			vec.clear();
+			auto& queue = std::any_cast<QueueData<T>&>(data);
+			queue.commands.Clear();
+			queue.order.clear();
 		}
 
 	private:
@@ -158,25 +291,44 @@ namespace RexEngine
 
 		static void ExecuteQueues()
 		{
-			// Sort by priority
-			std::vector<RenderQueue*> queues;
-			for (auto& queue : GetQueueMap())
-				queues.push_back(&queue.second);
+			for (auto& name : GetQueueNames())
+				ExecuteQueue(name);
+		}
 
-			std::sort(queues.begin(), queues.end(), [](RenderQueue* a, RenderQueue* b) { return (*a) < (*b); });
+		// Sort and render a single queue, see ForwardRenderer::AddPasses
+		static void ExecuteQueue(const std::string& name)
+		{
+			auto& queues = GetQueueMap();
 
-			// Sort and Render
-			for (auto& queue : queues)
-			{
-				queue->Sort();
-				queue->Render();
-			}
+			RE_ASSERT(queues.contains(name), "No RenderQueue named {}", name);
+			auto& queue = queues[name];
+			queue.Sort();
+			queue.Render();
+		}
+
+		// Names of the queues, in the order they are rendered
+		static std::vector<std::string> GetQueueNames()
+		{
+			std::vector<std::pair<int, std::string>> queues;
+			for (auto& [name, queue] : GetQueueMap())
+				queues.push_back({ queue.GetPriority(), name });
+
+			std::sort(queues.begin(), queues.end());
+
+			std::vector<std::string> names;
+			for (auto& [priority, name] : queues)
+				names.push_back(name);
+
+			return names;
 		}
 
+		// Also resets the frame arena, the memory is kept for the next frame
 		static void ClearQueues()
 		{
 			for (auto& queue : GetQueueMap())
 				queue.second.Clear();
+
+			RenderFrame::Reset();
 		}
 
 	private:
@@ -0,0 +1,66 @@
+#include "REPch.h"
+#include "RingBuffer.h"
+
+namespace RexEngine
+{
+	RingBuffer::Allocation RingBuffer::Allocate(size_t size)
+	{
+		constexpr size_t DefaultFrameSize = 1024 * 1024;
+
+		if (s_buffer == RenderApi::InvalidBufferID)
+			Grow(std::max(DefaultFrameSize, size));
+
+		size_t start = (s_offset + s_alignment - 1) / s_alignment * s_alignment;
+		if (start + size > s_frameSize)
+		{
+			Grow(std::max(s_frameSize * 2, size));
+			start = 0;
+		}
+
+		s_offset = start + size;
+
+		const size_t offset = s_frame * s_frameSize + start;
+		return { s_data + offset, s_buffer, offset, size };
+	}
+
+	void RingBuffer::NextFrame()
+	{
+		if (s_buffer == RenderApi::InvalidBufferID)
+			return; // Nothing was allocated yet
+
+		s_fences[s_frame] = RenderApi::MakeFence();
+
+		// Wait until the GPU is done with the section of FramesInFlight frames ago
+		s_frame = (s_frame + 1) % FramesInFlight;
+		RenderApi::WaitFence(s_fences[s_frame]);
+		RenderApi::DeleteFence(s_fences[s_frame]);
+		s_fences[s_frame] = RenderApi::InvalidFenceID;
+		s_offset = 0;
+
+		// The old buffers are not used by the GPU after FramesInFlight frames
+		for (auto& retired : s_retired)
+		{
+			if (--retired.framesLeft == 0)
+				RenderApi::DeleteBuffer(retired.buffer);
+		}
+
+		std::erase_if(s_retired, [](auto& retired) { return retired.framesLeft == 0; });
+	}
+
+	void RingBuffer::Grow(size_t minFrameSize)
+	{
+		if (s_buffer != RenderApi::InvalidBufferID)
+		{
+			RE_LOG_WARN("RingBuffer is full, growing to {}KB per frame", minFrameSize / 1024);
+			s_retired.push_back({ s_buffer, FramesInFlight });
+		}
+
+		s_alignment = std::max(RenderApi::GetBufferOffsetAlignment(RenderApi::BufferType::Uniforms),
+							   RenderApi::GetBufferOffsetAlignment(RenderApi::BufferType::ShaderStorage));
+
+		s_frameSize = (minFrameSize + s_alignment - 1) / s_alignment * s_alignment; // Keep the sections aligned
+		s_buffer = RenderApi::MakeBuffer();
+		s_data = RenderApi::MakePersistentBuffer(s_buffer, RenderApi::BufferType::Uniforms, s_frameSize * FramesInFlight);
+		s_offset = 0;
+	}
+}
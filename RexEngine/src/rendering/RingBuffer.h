@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <span>
+#include <vector>
+#include <cstring>
+
+#include "RenderApi.h"
+#include "../core/EngineEvents.h"
+
+namespace RexEngine
+{
+	// Triple buffered, persistently mapped buffer for the data that changes every frame (per draw data, scene data, lights)
+	// The data is written linearly in the section of the current frame and bound with BindBufferRange
+	// A frame only waits if the GPU is still reading the section from FramesInFlight frames ago
+	class RingBuffer
+	{
+	public:
+		inline static constexpr size_t FramesInFlight = 3;
+
+		struct Allocation
+		{
+			uint8_t* data = nullptr;
+			RenderApi::BufferID buffer = RenderApi::InvalidBufferID;
+			size_t offset = 0;
+			size_t size = 0;
+		};
+
+		// The memory is only valid for the current frame
+		// Can be bound as a uniform block or as a shader storage block
+		static Allocation Allocate(size_t size);
+
+		static void Bind(const Allocation& allocation, RenderApi::BufferType type, int location)
+		{
+			RenderApi::BindBufferRange(allocation.buffer, location, type, allocation.offset, allocation.size);
+		}
+
+		// Copy data in the ring and bind it
+		template<typename T>
+		static Allocation Push(const T& data, RenderApi::BufferType type, int location)
+		{
+			auto allocation = Allocate(sizeof(T));
+			std::memcpy(allocation.data, &data, sizeof(T));
+			Bind(allocation, type, location);
+			return allocation;
+		}
+
+		template<typename T>
+		static Allocation PushArray(std::span<const T> data, RenderApi::BufferType type, int location)
+		{
+			auto allocation = Allocate(data.size_bytes());
+			std::memcpy(allocation.data, data.data(), data.size_bytes());
+			Bind(allocation, type, location);
+			return allocation;
+		}
+
+		// Bytes allocated in the current frame
+		static size_t BytesUsed() { return s_offset; }
+
+	private:
+		// Fence the current section and move to the next one
+		static void NextFrame();
+
+		// Replace the buffer with a bigger one, the old one is deleted when the GPU is done with it
+		static void Grow(size_t minFrameSize);
+
+		RE_STATIC_CONSTRUCTOR({
+			EngineEvents::OnPreUpdate().Register<&RingBuffer::NextFrame>();
+		});
+
+	private:
+		struct RetiredBuffer
+		{
+			RenderApi::BufferID buffer;
+			size_t framesLeft;
+		};
+
+		inline static RenderApi::BufferID s_buffer = RenderApi::InvalidBufferID;
+		inline static uint8_t* s_data = nullptr;
+		inline static size_t s_frameSize = 0; // Size of a section
+		inline static size_t s_alignment = 0;
+
+		inline static size_t s_frame = 0; // Current section
+		inline static size_t s_offset = 0; // Offset in the current section
+		inline static std::array<RenderApi::FenceID, FramesInFlight> s_fences{};
+
+		inline static std::vector<RetiredBuffer> s_retired;
+	};
+}
@@ -1,22 +1,41 @@
 #include "REPch.h"
 #include "Shader.h"
 
+#include "TextureManager.h"
+
 namespace {
+	// Replaced by the material block once all its uniforms are known
+	const std::string MaterialBlockMarker = "#pragma material";
+
 	void ReplaceIfFound(std::string& str, const std::string& find, const std::string& replace)
 	{
 		auto pos = str.find(find);
 		if (pos != std::string::npos)
 			str.replace(pos, find.size(), replace);
 	}
+
+	// The normals of the meshes are octahedral encoded in 2 normalized shorts (see Mesh)
+	// A vec3 declared at the NORMAL location reads the encoded vec2 and decodes it
+	const std::regex NormalInputMatcher(R"(in\s+vec3\s+(\w+)\s*;)");
+
+	const std::string DecodeOctahedralNormal = R"(vec3 DecodeOctahedralNormal(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+})";
 }
 
 namespace RexEngine
 {
 	Shader::Shader(std::istream& data, RenderApi::CullingMode cullingMode, char priority, RenderApi::DepthFunction depth)
-		: m_id(RenderApi::InvalidShaderID), m_cullingMode(cullingMode), m_priority(priority), m_depthFunction(depth)
+		: m_id(RenderApi::InvalidShaderID), m_cullingMode(cullingMode), m_priority(priority), m_depthFunction(depth), m_supportsInstancing(false),
+		  m_materialBlockSize(0), m_uniqueId(s_nextUniqueId++)
 	{
 		// Parse the data to extract the shaders
-		auto [vertexSource, fragmentSource, attributes] = ParseShaders(data);
+		auto [vertexSource, fragmentSource, attributes, usings] = ParseShaders(data);
+		m_supportsInstancing = usings.contains(InstancingUsing);
 
 		auto vertex = RenderApi::CompileShader(vertexSource, RenderApi::ShaderType::Vertex);
 		auto fragment = RenderApi::CompileShader(fragmentSource, RenderApi::ShaderType::Fragment);
@@ -39,6 +58,19 @@ namespace RexEngine
 				Uniform uniform{ std::get<0>(uniformData), std::get<1>(uniformData), attribs };
 				m_uniforms[name] = uniform;
 			}
+
+			// The uniforms of the material block
+			auto [blockSize, members] = RenderApi::GetUniformBlockLayout(m_id, MaterialBlockName);
+			m_materialBlockSize = blockSize;
+			for (auto& [name, memberData] : members)
+			{
+				decltype(Uniform::Attributes) attribs;
+				if (attributes.contains(name))
+					attribs = attributes[name];
+
+				Uniform uniform{ -1, std::get<1>(memberData), attribs, std::get<0>(memberData) };
+				m_uniforms[name] = uniform;
+			}
 		}
 	}
 
@@ -73,7 +105,18 @@ namespace RexEngine
 	void Shader::Bind() const
 	{
 		RenderApi::SetCullingMode(m_cullingMode);
-		RenderApi::SetDepthFunction(m_depthFunction);
+
+		if (s_depthPrepassed && UsesDepthPrepass())
+		{
+			RenderApi::SetDepthFunction(RenderApi::DepthFunction::LessEqual);
+			RenderApi::SetDepthWrite(false);
+		}
+		else
+		{
+			RenderApi::SetDepthFunction(m_depthFunction);
+			RenderApi::SetDepthWrite(true);
+		}
+
 		RenderApi::BindShader(m_id);
 	}
 
@@ -81,6 +124,7 @@ namespace RexEngine
 	{
 		RenderApi::SetCullingMode(RenderApi::CullingMode::Front);
 		RenderApi::SetDepthFunction(RenderApi::DepthFunction::Less);
+		RenderApi::SetDepthWrite(true);
 		RenderApi::BindShader(RenderApi::InvalidShaderID);
 	}
 
@@ -118,11 +162,19 @@ namespace RexEngine
 		s_parserUsings.insert({name, replaceWith});
 	}
 
-	std::tuple<std::string, std::string, std::unordered_map<std::string, std::unordered_map<std::string, std::any>>> Shader::ParseShaders(std::istream& fromStream)
+	std::tuple<std::string, std::string, std::unordered_map<std::string, std::unordered_map<std::string, std::any>>, std::unordered_set<std::string>> Shader::ParseShaders(std::istream& fromStream)
 	{
 		std::ostringstream vertexStream;
 		std::ostringstream fragmentStream;
 		std::unordered_map<std::string, std::unordered_map<std::string, std::any>> attributes;
+		std::unordered_set<std::string> usings;
+
+		// Material uniforms, moved to the material block
+		std::ostringstream materialMembers;
+		std::unordered_set<std::string> declaredMembers;
+		bool hasBindlessSamplers = false;
+		const bool bindless = TextureManager::GetResidency() == TextureManager::Residency::Bindless;
+		bool inMaterialBlock[2] = { false, false }; // Vertex, Fragment
 
 		std::string version = "#version 460 core"; // default version if not specified
 
@@ -143,6 +195,11 @@ namespace RexEngine
 					writingTo = &vertexStream;
 				else if (arguments[1] == "fragment") // Start of the fragment shader
 					writingTo = &fragmentStream;
+				else if (arguments[1] == "material") // The following uniforms go in the material block, declared here
+				{
+					inMaterialBlock[writingTo == &fragmentStream] = true;
+					(*writingTo) << MaterialBlockMarker << std::endl;
+				}
 				else if (arguments[1] == "version")
 				{
 					ReplaceIfFound(line, "#pragma ", "#"); // Convert #pragma version ... ... to #version ... ...
@@ -156,6 +213,8 @@ namespace RexEngine
 					}
 					else
 					{
+						usings.insert(arguments[2]);
+
 						std::string usingLine;
 						std::istringstream usingStream(s_parserUsings[arguments[2]]);
 
@@ -171,20 +230,63 @@ namespace RexEngine
 			}
 
 			ParseLine(line, attributes);
+
+			std::smatch sm;
+			const bool materialSection = inMaterialBlock[writingTo == &fragmentStream];
+			const bool isMaterialUniform = materialSection && std::regex_match(line, sm, s_materialUniformMatcher);
+			const bool isMaterialSampler = materialSection && !isMaterialUniform && bindless && std::regex_match(line, sm, s_materialSamplerMatcher);
+			if (isMaterialUniform || isMaterialSampler)
+			{
+				hasBindlessSamplers |= isMaterialSampler;
+
+				// Declared once, even if the uniform is in both shaders
+				const std::string name = sm[2].str();
+				if (!declaredMembers.contains(name))
+				{
+					declaredMembers.insert(name);
+					materialMembers << sm[1].str() << ' ' << name << "; ";
+				}
+				continue;
+			}
+
 			(*writingTo) << line << std::endl; // Save the line to the appropriate shader
 		}
 
 		// Append the version at the start of each shader
-		std::string vertex = version + '\n' + vertexStream.str();
+		// The positions are invariant : the opaque pass tests LessEqual against the depth of the prepass, made by other programs
+		std::string vertex = version + '\n' + "invariant gl_Position;\n" + vertexStream.str();
 		std::string fragment = version + '\n' + fragmentStream.str();
 
-		return std::make_tuple(vertex, fragment, attributes);
+		// The block is the same in both shaders, so they share it when linked
+		std::string materialBlock;
+		if (!declaredMembers.empty())
+			materialBlock = std::format("layout (std140, binding = {}) uniform {}{{ {}}};", GetMaterialBlockBinding(), MaterialBlockName, materialMembers.str());
+
+		// The samplers in the block are 64 bits handles
+		if (hasBindlessSamplers)
+		{
+			vertex.insert(version.size() + 1, "#extension GL_ARB_bindless_texture : require\n");
+			fragment.insert(version.size() + 1, "#extension GL_ARB_bindless_texture : require\n");
+		}
+
+		ReplaceIfFound(vertex, MaterialBlockMarker, materialBlock);
+		ReplaceIfFound(fragment, MaterialBlockMarker, materialBlock);
+
+		return std::make_tuple(vertex, fragment, attributes, usings);
 	}
 
 	void Shader::ParseLine(std::string& line, std::unordered_map<std::string, std::unordered_map<std::string, std::any>>& attributes)
 	{
 		if (line.find("location") != std::string::npos) // vertex attribute location
 		{
+			if (std::smatch sm; line.find("NORMAL") != std::string::npos && std::regex_search(line, sm, NormalInputMatcher))
+			{
+				const std::string name = sm[1].str();
+				line = std::format("layout(location = {}) in vec2 {}Octahedral;\n{}\n#define {} DecodeOctahedralNormal({}Octahedral)",
+					NormalLocation, name, DecodeOctahedralNormal, name, name);
+				return;
+			}
+
 			ReplaceIfFound(line, "POSITION", std::to_string(PositionLocation));
 			ReplaceIfFound(line, "NORMAL", std::to_string(NormalLocation));
 			ReplaceIfFound(line, "TEXCOORDS", std::to_string(UVLocation));
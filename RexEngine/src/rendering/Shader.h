@@ -5,8 +5,10 @@
 #include <ranges>
 #include <any>
 #include <regex>
+#include <unordered_set>
 
 #include "RenderApi.h"
+#include "UniformBlock.h"
 //#include "../core/Serialization.h"
 
 namespace RexEngine
@@ -16,6 +18,7 @@ namespace RexEngine
 	// 2 : Model data (renderQueue)
 	// 3 : Lights (Point and Directional)
 	// 4 : Spot Lights
+	// Material data : the uniforms after #pragma material (see Shader::MaterialBlockName)
 
 	template<typename T>
 	concept UniformAttribute = requires(const std::string& args)
@@ -29,6 +32,8 @@ namespace RexEngine
 		RenderApi::UniformType Type = RenderApi::UniformType::Float;
 
 		std::unordered_map<std::string, std::any> Attributes;
+
+		int Offset = -1; // Byte offset in the material block, -1 if the uniform is not in it
 	};
 
 	class Shader
@@ -39,6 +44,14 @@ namespace RexEngine
 		inline static constexpr int NormalLocation = 1;
 		inline static constexpr int UVLocation = 2;
 
+		// Shaders using this #pragma using (instead of ModelData) can be drawn with instancing
+		inline static const std::string InstancingUsing = "ModelDataInstanced";
+
+		// The float, vector, int, bool and matrix uniforms declared after #pragma material are packed in a std140 block with this name
+		// With the bindless texture residency, the sampler2D and samplerCube uniforms are in the block too
+		// The block is declared where the #pragma material is, every stage using the material uniforms needs one
+		inline static const std::string MaterialBlockName = "MaterialData";
+
 	public:
 		Shader(std::istream& data, RenderApi::CullingMode cullingMode = RenderApi::CullingMode::Front, char priority = 0, RenderApi::DepthFunction depth = RenderApi::DepthFunction::Less);
 		Shader(const std::string& data, RenderApi::CullingMode cullingMode = RenderApi::CullingMode::Front, char priority = 0, RenderApi::DepthFunction depth = RenderApi::DepthFunction::Less);
@@ -59,13 +72,36 @@ namespace RexEngine
 		auto Priority() const { return m_priority; }
 		auto DepthFunction() const { return m_depthFunction; }
 
-		// Will also set the culling mode
+		// True if the vertex shader reads its model matrix from #pragma using ModelDataInstanced
+		bool SupportsInstancing() const { return m_supportsInstancing; }
+
+		// The vertex shader of these shaders only transforms the positions by the model matrix,
+		// so the depth pre-pass (see ForwardRenderer::EnableDepthPrepass) gives the same depth
+		bool UsesDepthPrepass() const { return m_supportsInstancing && m_depthFunction == RenderApi::DepthFunction::Less; }
+
+		// Set while drawing over the depth pre-pass, the shaders using it then test with LessEqual
+		// instead of Less and don't write the depth again
+		static void SetDepthPrepassed(bool prepassed) { s_depthPrepassed = prepassed; }
+
+		// Size of the material block in bytes, 0 if the shader has none
+		size_t GetMaterialBlockSize() const { return m_materialBlockSize; }
+		static int GetMaterialBlockBinding()
+		{
+			static const int binding = UniformBlocks::GetLocation(MaterialBlockName);
+			return binding;
+		}
+
+		// Unique id of this shader, a reloaded shader gets a new one
+		uint32_t GetUniqueId() const { return m_uniqueId; }
+
+		// Will also set the culling mode and the depth test
 		void Bind() const;
 		// Will also set the culling mode to Front
 		static void UnBind();
 
 		bool HasUniform(const std::string& name) { return m_uniforms.contains(name); }
 
+		// Only for the uniforms outside of the material block, the block is set by the Material
 		void SetUniformMatrix4(const std::string& name, const Matrix4& matrix);
 		void SetUniformVector3(const std::string& name, const Vector3& vec);
 		void SetUniformFloat(const std::string& name, float value);
@@ -86,6 +122,13 @@ namespace RexEngine
 			return (RenderApi::UniformType)-1;
 		}
 
+		// nullptr if the uniform does not exists
+		const Uniform* GetUniformInfo(const std::string& name) const
+		{
+			auto it = m_uniforms.find(name);
+			return it != m_uniforms.end() ? &it->second : nullptr;
+		}
+
 		auto GetUniformAttributes(const std::string& name) 
 		{
 			if (m_uniforms.contains(name))
@@ -133,7 +176,15 @@ namespace RexEngine
 
 	private:
 
-		static std::tuple<std::string, std::string, std::unordered_map<std::string, std::unordered_map<std::string, std::any>>> ParseShaders(std::istream& data);
+		// Tag type of the material block, its layout comes from the shader
+		struct MaterialDataUniforms {};
+
+		RE_STATIC_CONSTRUCTOR({
+			UniformBlocks::ReserveBlock<MaterialDataUniforms>("MaterialData");
+		})
+
+		// vertex source, fragment source, <uniform name, attributes>, names of the #pragma using found
+		static std::tuple<std::string, std::string, std::unordered_map<std::string, std::unordered_map<std::string, std::any>>, std::unordered_set<std::string>> ParseShaders(std::istream& data);
 
 		//															uniform name, attribute
 		static void ParseLine(std::string& line, std::unordered_map<std::string, std::unordered_map<std::string, std::any>>& attributes);
@@ -144,6 +195,9 @@ namespace RexEngine
 		RenderApi::CullingMode m_cullingMode;
 		char m_priority;
 		RenderApi::DepthFunction m_depthFunction;
+		bool m_supportsInstancing;
+		size_t m_materialBlockSize;
+		uint32_t m_uniqueId;
 
 		std::unordered_map<std::string, Uniform> m_uniforms;
 		
@@ -152,7 +206,13 @@ namespace RexEngine
 
 		inline static std::unordered_map<std::string, std::function<std::any(const std::string&)>> s_parserAttributes;
 
+		inline static bool s_depthPrepassed = false;
+
 		inline static const std::regex s_attributeMatcher = std::regex(R"(\[.*?\])");
+		inline static const std::regex s_materialUniformMatcher = std::regex(R"(^\s*uniform\s+(float|vec[234]|int|ivec[234]|uint|bool|mat[34])\s+(\w+)\s*;\s*(//.*)?$)");
+		inline static const std::regex s_materialSamplerMatcher = std::regex(R"(^\s*uniform\s+(sampler2D|samplerCube)\s+(\w+)\s*;\s*(//.*)?$)"); // Only with bindless textures
+
+		inline static uint32_t s_nextUniqueId = 0;
 	};
 
 }
\ No newline at end of file
@@ -0,0 +1,145 @@
+#include "REPch.h"
+#include "ShadowCascades.h"
+
+namespace RexEngine
+{
+	namespace
+	{
+		Vector3 TransformPoint(const Matrix4& matrix, const Vector3& p)
+		{
+			return Vector3(
+				matrix[0][0] * p.x + matrix[1][0] * p.y + matrix[2][0] * p.z + matrix[3][0],
+				matrix[0][1] * p.x + matrix[1][1] * p.y + matrix[2][1] * p.z + matrix[3][1],
+				matrix[0][2] * p.x + matrix[1][2] * p.y + matrix[2][2] * p.z + matrix[3][2]);
+		}
+
+		float Dot(const Vector3& a, const Vector3& b)
+		{
+			return a.x * b.x + a.y * b.y + a.z * b.z;
+		}
+
+		Vector3 LightUp(const Vector3& lightDirection)
+		{
+			// The up vector can't be parallel to the direction
+			return std::abs(lightDirection.y) > 0.99f ? Vector3(1, 0, 0) : Vector3(0, 1, 0);
+		}
+	}
+
+	std::array<float, ShadowCascades::MaxCascades> ShadowCascades::ComputeSplits(uint32_t count, float zNear, float farDistance, float lambda)
+	{
+		std::array<float, MaxCascades> splits;
+		splits.fill(farDistance);
+
+		zNear = std::max(zNear, 1e-3f);
+		for (uint32_t i = 1; i < count && i < MaxCascades; i++)
+		{
+			const float ratio = (float)i / count;
+			const float logSplit = zNear * std::pow(farDistance / zNear, ratio);
+			const float uniformSplit = zNear + (farDistance - zNear) * ratio;
+			splits[i - 1] = lambda * logSplit + (1.0f - lambda) * uniformSplit;
+		}
+
+		return splits;
+	}
+
+	BoundingSphere ShadowCascades::FrustumSliceSphere(const Vector3& cameraPos, const Vector3& forward, float tanX, float tanY, float sliceNear, float sliceFar)
+	{
+		// The corners of the slice are at a distance of depth * sqrt(tanX^2 + tanY^2) from the forward axis
+		// The center is at the same distance from the near and the far corners, or on the far plane when the slice is wide
+		const float sqrTan = tanX * tanX + tanY * tanY;
+		const float centerDepth = std::min((sliceFar + sliceNear) * (1.0f + sqrTan) * 0.5f, sliceFar);
+		const float radius = std::sqrt((sliceFar - centerDepth) * (sliceFar - centerDepth) + sqrTan * sliceFar * sliceFar);
+
+		return { Vector3(cameraPos + forward * centerDepth), radius };
+	}
+
+	bool ShadowCascades::IsScheduled(uint32_t cascade, uint64_t frame)
+	{
+		switch (cascade)
+		{
+		case 0:
+			return true;
+		case 1:
+			return frame % 2 == 1;
+		case 2:
+			return frame % 4 == 2;
+		default:
+			return frame % 8 == 4;
+		}
+	}
+
+	size_t ShadowCascades::CullCasters(const Cascade& cascade, const BoxList& boxes, std::vector<uint8_t>& visible)
+	{
+		return Frustum(cascade.viewProjection).CullBoxes(boxes, visible);
+	}
+
+	uint32_t ShadowCascades::Fit(const Vector3& cameraPos, const Vector3& forward, float fov, float aspect, float zNear, float zFar,
+		const Vector3& lightDirection, const Settings& settings)
+	{
+		const uint32_t count = std::clamp(settings.count, 1u, MaxCascades);
+
+		// The snapping of every cascade depends on the resolution
+		if (count != m_count || settings.resolution != m_resolution)
+		{
+			for (auto& cascade : m_cascades)
+				cascade.valid = false;
+
+			m_count = count;
+			m_resolution = settings.resolution;
+		}
+
+		const auto splits = ComputeSplits(count, zNear, std::min(settings.maxDistance, zFar), settings.splitLambda);
+		const float tanY = std::tan(glm::radians(fov) * 0.5f);
+		const float tanX = tanY * aspect;
+
+		uint32_t refitted = 0;
+		float sliceNear = zNear;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			auto& cascade = m_cascades[i];
+			const BoundingSphere slice = FrustumSliceSphere(cameraPos, forward, tanX, tanY, sliceNear, splits[i]);
+
+			const bool lightChanged = Dot(cascade.lightDirection, lightDirection) < 0.99999f;
+			const bool outside = Vector3(slice.center - cascade.center).Magnitude() + slice.radius > cascade.radius;
+			const bool tooLarge = slice.radius * (1.0f + settings.margin) < cascade.radius * 0.75f; // The fov was reduced, the texels would be wasted
+
+			if (!cascade.valid || lightChanged || outside || tooLarge)
+			{
+				FitCascade(cascade, slice, lightDirection, settings);
+				refitted |= 1u << i;
+			}
+
+			cascade.splitFar = splits[i];
+			sliceNear = splits[i];
+		}
+
+		return refitted;
+	}
+
+	void ShadowCascades::FitCascade(Cascade& cascade, const BoundingSphere& slice, const Vector3& lightDirection, const Settings& settings)
+	{
+		const float radius = slice.radius * (1.0f + settings.margin);
+		const Vector3 up = LightUp(lightDirection);
+
+		// Snap the center to the texels in light space, the refits don't move the shadow edges by a fraction of texel
+		const Matrix4 lightRotation = Matrix4::MakeLookAt(Vector3(0, 0, 0), lightDirection, up);
+		const float texel = 2.0f * radius / std::max(settings.resolution, 1u);
+
+		Vector3 lightCenter = TransformPoint(lightRotation, slice.center);
+		lightCenter.x = std::floor(lightCenter.x / texel) * texel;
+		lightCenter.y = std::floor(lightCenter.y / texel) * texel;
+		const Vector3 center = TransformPoint(lightRotation.Inversed(), lightCenter);
+
+		// The near plane is depthExtent in front of the sphere, for the casters outside of the view
+		const float distance = radius + settings.depthExtent;
+		const Vector3 eye = Vector3(center - lightDirection * distance);
+		const Matrix4 view = Matrix4::MakeLookAt(eye, center, up);
+		const Matrix4 projection = Matrix4::MakeOrthographic(-radius, radius, -radius, radius, 0.0f, distance + radius);
+
+		cascade.viewProjection = projection * view;
+		cascade.center = center;
+		cascade.radius = radius;
+		cascade.lightDirection = lightDirection;
+		cascade.valid = true;
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+
+#include "../math/Vectors.h"
+#include "../math/Matrix.h"
+#include "../math/Bounds.h"
+#include "../math/Frustum.h"
+
+namespace RexEngine
+{
+	// Fits the orthographic projections of the cascades of a directional light around the view of a camera
+	// Each cascade covers a bounding sphere of a slice of the view frustum, with a margin
+	// A cascade is only refitted when its slice leaves the covered sphere, so the cached shadow layers stay valid while the camera moves a bit
+	// Only uses the cpu, see ShadowMaps for the rendering
+	class ShadowCascades
+	{
+	public:
+		inline static constexpr uint32_t MaxCascades = 4;
+
+		struct Settings
+		{
+			uint32_t count; // Cascades used, up to MaxCascades
+			float splitLambda; // 0 for uniform splits, 1 for logarithmic splits
+			float maxDistance; // Distance from the camera where the last cascade ends, clamped to zFar
+			float margin; // Extra radius around the slices, in percent of the radius of the slice
+			float depthExtent; // Distance behind the covered sphere where the casters are still rendered
+			uint32_t resolution; // Size of the shadow map of a cascade, the centers are snapped to its texels
+		};
+
+		struct Cascade
+		{
+			Matrix4 viewProjection = Matrix4::Identity; // World to the clip space of the light
+			Vector3 center = Vector3(0, 0, 0); // Of the covered sphere
+			float radius = 0.0f;
+			float splitFar = 0.0f; // View depth where the cascade ends
+			Vector3 lightDirection = Vector3(0, 0, 0);
+			bool valid = false;
+		};
+
+		// View depth where each cascade ends, blend of the uniform and logarithmic distributions
+		static std::array<float, MaxCascades> ComputeSplits(uint32_t count, float zNear, float farDistance, float lambda);
+
+		// Smallest sphere around the part of a symmetric view frustum between two view depths
+		// tanX and tanY are the tangents of the half fov, the center is on the forward axis from the camera
+		static BoundingSphere FrustumSliceSphere(const Vector3& cameraPos, const Vector3& forward, float tanX, float tanY, float sliceNear, float sliceFar);
+
+		// Cascade 0 every frame, 1 every other frame, 2 every 4 frames and 3 every 8 frames, never more than 2 cascades in a frame
+		static bool IsScheduled(uint32_t cascade, uint64_t frame);
+
+		// Fills visible with 1 for the boxes touching the volume of the cascade, returns the number of visible boxes
+		static size_t CullCasters(const Cascade& cascade, const BoxList& boxes, std::vector<uint8_t>& visible);
+
+		// Returns a mask of the cascades that were refitted, their shadow maps have to be rendered again
+		// fov in degrees, aspect is x/y, lightDirection is the direction the light travels
+		uint32_t Fit(const Vector3& cameraPos, const Vector3& forward, float fov, float aspect, float zNear, float zFar,
+			const Vector3& lightDirection, const Settings& settings);
+
+		uint32_t Count() const { return m_count; }
+		const Cascade& operator[](size_t index) const { return m_cascades[index]; }
+
+	private:
+		void FitCascade(Cascade& cascade, const BoundingSphere& slice, const Vector3& lightDirection, const Settings& settings);
+
+	private:
+		std::array<Cascade, MaxCascades> m_cascades;
+		uint32_t m_count = 0;
+		uint32_t m_resolution = 0;
+	};
+}
@@ -0,0 +1,366 @@
+#include <REPch.h>
+#include "ShadowMaps.h"
+
+#include <bit>
+
+#include "FrameBuffer.h"
+#include "RingBuffer.h"
+#include "RenderFrame.h"
+#include "RenderCommands.h"
+#include "TextureManager.h"
+#include "../utils/NoDestroy.h"
+#include "../utils/TupleHash.h"
+
+namespace RexEngine::Internal
+{
+	// Depth of the casters seen from the light, the cascades are rendered with every face so the thin objects cast shadows
+	const std::string ShadowCasterSource = R"(
+#pragma vertex
+
+#pragma using ModelDataInstanced
+
+layout(location = POSITION) in vec3 aPos;
+
+uniform mat4 lightViewProjection;
+
+void main()
+{
+	gl_Position = lightViewProjection * modelToWorld * vec4(aPos, 1.0);
+}
+
+#pragma fragment
+
+void main()
+{
+}
+)";
+
+	struct ShadowCaster
+	{
+		Mesh* mesh;
+		Matrix4 transform;
+		bool isStatic;
+	};
+
+	// Shadow maps of a view, found from its ForwardRenderer::ViewID
+	struct ShadowView
+	{
+		ShadowCascades cascades;
+		uint32_t resolution = 0;
+
+		std::unique_ptr<Texture> atlas; // Sampled by the shaders, the cached layer with the dynamic casters over it
+		std::array<std::unique_ptr<Texture>, ShadowCascades::MaxCascades> staticLayers;
+		std::array<size_t, ShadowCascades::MaxCascades> staticHashes = {}; // Of the static casters in each cached layer
+		uint32_t validStaticLayers = 0; // Mask of the cascades
+
+		// Set by ShadowMaps::Prepare() for ShadowMaps::Render()
+		uint32_t renderMask = 0; // Cascades updated this frame
+		uint32_t staticMask = 0; // Cascades whose cached layer is rendered again
+		std::array<std::vector<ShadowCaster>, ShadowCascades::MaxCascades> staticCasters;
+		std::array<std::vector<ShadowCaster>, ShadowCascades::MaxCascades> dynamicCasters;
+
+		uint64_t lastUsedFrame = 0;
+	};
+
+	// A view not rendered for this many frames is deleted (ex : a closed panel)
+	constexpr uint64_t MaxUnusedShadowFrames = 60;
+
+	NoDestroy<std::unordered_map<uint32_t, ShadowView>> s_shadowViews; // By view, the cameras of the editor views are made again every frame
+	ShadowView* s_preparedShadowView = nullptr;
+	uint64_t s_shadowFrame = 0;
+
+	std::unique_ptr<Texture> MakeShadowTexture(int size)
+	{
+		auto texture = std::make_unique<Texture>(RenderApi::PixelFormat::Depth, Vector2Int(size, size));
+		texture->SetOption(RenderApi::TextureOption::WrapS, RenderApi::TextureOptionValue::ClampToEdge);
+		texture->SetOption(RenderApi::TextureOption::WrapT, RenderApi::TextureOptionValue::ClampToEdge);
+		texture->SetOption(RenderApi::TextureOption::MinFilter, RenderApi::TextureOptionValue::Nearest);
+		texture->SetOption(RenderApi::TextureOption::MagFilter, RenderApi::TextureOptionValue::Nearest);
+		return texture;
+	}
+
+	// The casters are sorted by mesh, each mesh is a single instanced draw
+	void DrawShadowCasters(Shader& shader, const std::vector<ShadowCaster>& casters, const Matrix4& viewProjection, uint32_t cascade)
+	{
+		if (casters.empty())
+			return;
+
+		static std::vector<Matrix4> matrices;
+		matrices.clear();
+		for (auto& caster : casters)
+			matrices.push_back(caster.transform);
+
+		ModelInstances::Upload(matrices);
+		shader.SetUniformMatrix4("lightViewProjection", viewProjection);
+
+		for (size_t first = 0; first < casters.size();)
+		{
+			Mesh* mesh = casters[first].mesh;
+			size_t last = first + 1;
+			while (last < casters.size() && casters[last].mesh == mesh)
+				last++;
+
+			// The texels of the far cascades are larger, their simplified lods are enough
+			const size_t lod = std::min<size_t>(cascade, mesh->GetLodCount() - 1);
+			mesh->Bind();
+			mesh->DrawInstanced(lod, last - first, first);
+			RenderFrame::CountDraw(static_cast<uint32_t>(last - first), mesh->GetLod(lod).indexCount);
+
+			first = last;
+		}
+	}
+}
+
+namespace RexEngine
+{
+	void ShadowMaps::Prepare(Asset<Scene> scene, uint32_t viewID, const CameraComponent& camera, const Vector3& cameraPos, const Vector3& forward, float aspect, std::optional<Vector3> lightDirection)
+	{
+		static const int shadowDataLocation = UniformBlocks::GetLocation("ShadowData");
+		Internal::s_preparedShadowView = nullptr;
+
+		ShadowDataUniforms uniforms{};
+		if (!Enabled || !lightDirection)
+		{
+			RingBuffer::Push(uniforms, RenderApi::BufferType::Uniforms, shadowDataLocation);
+			return;
+		}
+
+		auto& view = (*Internal::s_shadowViews)[viewID];
+		view.lastUsedFrame = Internal::s_shadowFrame;
+
+		if (view.resolution != Resolution || !view.atlas)
+		{
+			view.resolution = Resolution;
+			view.atlas = Internal::MakeShadowTexture(Resolution * 2);
+			for (auto& layer : view.staticLayers)
+				layer = Internal::MakeShadowTexture(Resolution);
+
+			view.validStaticLayers = 0;
+		}
+
+		const ShadowCascades::Settings settings{ CascadeCount, SplitLambda, MaxDistance, Margin, DepthExtent, Resolution };
+		const uint32_t refitted = view.cascades.Fit(cameraPos, forward, camera.fov, aspect, camera.zNear, camera.zFar, *lightDirection, settings);
+		view.validStaticLayers &= ~refitted;
+		s_stats.refits += static_cast<uint32_t>(std::popcount(refitted));
+
+		// A refitted cascade can't wait for its turn, the atlas was rendered with its old projection
+		view.renderMask = refitted;
+		view.staticMask = 0;
+		for (uint32_t i = 0; i < view.cascades.Count(); i++)
+		{
+			if (ShadowCascades::IsScheduled(i, Internal::s_shadowFrame))
+				view.renderMask |= 1u << i;
+		}
+
+		// Casters of the updated cascades, from the spatial index then tested 4 at a time like the camera
+		static std::vector<Internal::ShadowCaster> candidates;
+		static BoxList boxes;
+		static std::vector<uint8_t> visible;
+
+		for (uint32_t i = 0; i < view.cascades.Count(); i++)
+		{
+			if (!(view.renderMask & (1u << i)))
+				continue;
+
+			const auto& cascade = view.cascades[i];
+			candidates.clear();
+			boxes.Clear();
+
+			scene->QueryFrustum(Frustum(cascade.viewProjection), [](Entity e) {
+				// Same objects as the depth pre-pass, the others (grid, billboards) don't write a regular depth
+				auto& c = e.GetComponent<MeshRendererComponent>();
+				if (!c.material || !c.mesh || !c.material->GetShader() || !c.material->GetShader()->UsesDepthPrepass())
+					return;
+
+				const bool isStatic = e.HasComponent<StaticComponent>();
+				if (isStatic && !e.GetComponent<StaticComponent>().castShadows)
+					return;
+
+				auto& proxy = e.GetComponent<SpatialProxyComponent>();
+				candidates.push_back({ c.mesh.Get(), proxy.globalTransform, isStatic });
+				boxes.Add(proxy.bounds);
+			});
+
+			ShadowCascades::CullCasters(cascade, boxes, visible);
+
+			auto& staticCasters = view.staticCasters[i];
+			auto& dynamicCasters = view.dynamicCasters[i];
+			staticCasters.clear();
+			dynamicCasters.clear();
+
+			// The order of the spatial index changes, so the hashes of the static casters are summed
+			size_t staticHash = 0;
+			for (size_t j = 0; j < candidates.size(); j++)
+			{
+				if (!visible[j])
+					continue;
+
+				auto& caster = candidates[j];
+				if (caster.isStatic)
+				{
+					size_t hash = std::hash<const Mesh*>()(caster.mesh);
+					std::hash_combine(hash, std::string_view(reinterpret_cast<const char*>(&caster.transform), sizeof(Matrix4)));
+					staticHash += hash;
+					staticCasters.push_back(caster);
+				}
+				else
+					dynamicCasters.push_back(caster);
+			}
+
+			if (!(view.validStaticLayers & (1u << i)) || staticHash != view.staticHashes[i])
+			{
+				view.staticMask |= 1u << i;
+				view.staticHashes[i] = staticHash;
+
+				auto byMesh = [](const Internal::ShadowCaster& a, const Internal::ShadowCaster& b) { return a.mesh < b.mesh; };
+				std::sort(staticCasters.begin(), staticCasters.end(), byMesh);
+			}
+
+			std::sort(dynamicCasters.begin(), dynamicCasters.end(), [](const Internal::ShadowCaster& a, const Internal::ShadowCaster& b) { return a.mesh < b.mesh; });
+		}
+
+		// From the [-1, 1] clip space of the cascades to the [0, 1] coordinates of their shadow map
+		const Matrix4 toTexture = Matrix4::MakeTransform(Vector3(0.5f, 0.5f, 0.5f), Quaternion::Identity(), Vector3(0.5f, 0.5f, 0.5f));
+		for (uint32_t i = 0; i < view.cascades.Count(); i++)
+		{
+			uniforms.cascadeMatrices[i] = toTexture * view.cascades[i].viewProjection;
+			uniforms.cascadeSplits[i] = view.cascades[i].splitFar;
+		}
+
+		uniforms.params[0] = static_cast<float>(view.cascades.Count());
+		uniforms.params[1] = 1.0f / (Resolution * 2);
+		uniforms.params[2] = DepthBias;
+		RingBuffer::Push(uniforms, RenderApi::BufferType::Uniforms, shadowDataLocation);
+
+		Internal::s_preparedShadowView = &view;
+	}
+
+	const Texture* ShadowMaps::GetPreparedAtlas()
+	{
+		return Internal::s_preparedShadowView ? Internal::s_preparedShadowView->atlas.get() : nullptr;
+	}
+
+	void ShadowMaps::Render()
+	{
+		auto* view = Internal::s_preparedShadowView;
+		if (!view)
+			return;
+
+		static NoDestroy<FrameBuffer> layerBuffer;
+		static NoDestroy<FrameBuffer> atlasBuffer;
+		static NoDestroy<Shader> shader(Internal::ShadowCasterSource, RenderApi::CullingMode::Both);
+
+		const int resolution = static_cast<int>(view->resolution);
+		const Vector2Int size(resolution, resolution);
+		atlasBuffer->BindTexture(*view->atlas, RenderApi::FrameBufferTextureType::Depth);
+
+		for (uint32_t i = 0; i < view->cascades.Count(); i++)
+		{
+			if (!(view->renderMask & (1u << i)))
+				continue;
+
+			const Matrix4& viewProjection = view->cascades[i].viewProjection;
+			layerBuffer->BindTexture(*view->staticLayers[i], RenderApi::FrameBufferTextureType::Depth);
+
+			if (view->staticMask & (1u << i))
+			{
+				layerBuffer->Bind();
+				RenderApi::SetViewportSize(size);
+				RenderApi::ClearDepthBit();
+				Internal::DrawShadowCasters(*shader, view->staticCasters[i], viewProjection, i);
+
+				s_stats.staticLayersRendered++;
+				s_stats.staticCasters += static_cast<uint32_t>(view->staticCasters[i].size());
+			}
+
+			// Start from the cached layer, in the quadrant of the cascade
+			const Vector2Int offset((i & 1) * resolution, (i >> 1) * resolution);
+			layerBuffer->Bind(FramBufferTarget::Read);
+			atlasBuffer->Bind(FramBufferTarget::Draw);
+			RenderApi::BlitFrameBuffer({ 0, 0 }, size, offset, Vector2Int(offset + size), RenderApi::FrameBufferTextureType::Depth);
+
+			atlasBuffer->Bind();
+			RenderApi::SetViewport(offset, size);
+			Internal::DrawShadowCasters(*shader, view->dynamicCasters[i], viewProjection, i);
+
+			s_stats.cascadesRendered++;
+			s_stats.dynamicCasters += static_cast<uint32_t>(view->dynamicCasters[i].size());
+		}
+
+		view->validStaticLayers |= view->staticMask;
+		view->renderMask = 0;
+		view->staticMask = 0;
+		Shader::UnBind();
+
+		RenderApi::SetActiveTexture(GetAtlasSlot());
+		view->atlas->Bind();
+		RenderApi::SetActiveTexture(0);
+	}
+
+	std::string ShadowMaps::GetShaderCode()
+	{
+		static const int shadowDataLocation = UniformBlocks::GetLocation("ShadowData");
+
+		return std::format(R"(
+layout (std140, binding = {}) uniform ShadowData {{ mat4 ShadowCascadeMatrices[{}]; vec4 ShadowCascadeSplits; vec4 ShadowParams; }};
+[Hide]layout(binding = {}) uniform sampler2D ShadowAtlas;
+
+// 0 in the shadow of the first directional light, 1 when lit, the cascade is picked from the view depth
+float GetDirectionalShadow(vec3 worldPos, vec3 normal, vec3 lightDir, float viewDepth)
+{{
+    uint count = uint(ShadowParams.x);
+    uint cascade = 0u;
+    while (cascade < count && viewDepth > ShadowCascadeSplits[cascade])
+        cascade++;
+
+    if (cascade >= count)
+        return 1.0;
+
+    vec3 coords = (ShadowCascadeMatrices[cascade] * vec4(worldPos, 1.0)).xyz;
+    if (coords.z > 1.0)
+        return 1.0;
+
+    // Larger bias on the surfaces at a grazing angle with the light
+    float bias = ShadowParams.z * (1.0 + 4.0 * (1.0 - clamp(dot(normal, lightDir), 0.0, 1.0)));
+
+    // 3x3 pcf, the samples stay in the quadrant of the cascade in the atlas
+    vec2 quadrant = vec2(float(cascade & 1u), float(cascade >> 1u)) * 0.5;
+    float texel = ShadowParams.y;
+    float lit = 0.0;
+    for (int x = -1; x <= 1; x++)
+    {{
+        for (int y = -1; y <= 1; y++)
+        {{
+            vec2 uv = clamp(coords.xy * 0.5 + vec2(x, y) * texel, vec2(texel * 0.5), vec2(0.5 - texel * 0.5)) + quadrant;
+            lit += coords.z - bias > texture(ShadowAtlas, uv).r ? 0.0 : 1.0;
+        }}
+    }}
+
+    return lit / 9.0;
+}}
+)", shadowDataLocation, ShadowCascades::MaxCascades, GetAtlasSlot());
+	}
+
+	int ShadowMaps::GetAtlasSlot()
+	{
+		// Reserved on the first use, after the TextureManager is initialized
+		static const int slot = TextureManager::ReserveSlot();
+		return slot;
+	}
+
+	void ShadowMaps::NextFrame()
+	{
+		std::erase_if(*Internal::s_shadowViews, [](const auto& view) { return view.second.lastUsedFrame + Internal::MaxUnusedShadowFrames < Internal::s_shadowFrame; });
+		Internal::s_preparedShadowView = nullptr;
+
+		s_lastStats = s_stats;
+		s_stats = Stats{};
+		Internal::s_shadowFrame++;
+	}
+
+	void ShadowMaps::OnClose()
+	{
+		Internal::s_shadowViews->clear();
+		Internal::s_preparedShadowView = nullptr;
+	}
+}
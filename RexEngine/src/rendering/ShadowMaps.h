@@ -0,0 +1,85 @@
+#pragma once
+
+#include <string>
+#include <optional>
+#include <cstdint>
+
+#include "ShadowCascades.h"
+#include "Texture.h"
+#include "UniformBlock.h"
+#include "Shader.h"
+#include "../scene/Scene.h"
+#include "../scene/Components.h"
+#include "../core/EngineEvents.h"
+#include "../utils/StaticConstructor.h"
+
+namespace RexEngine
+{
+	// Cascaded shadow maps of the first DirectionalLightComponent
+	// The cascades of a view are packed in a depth atlas (2x2 cascades), sampled by GetDirectionalShadow() in the PBR shader using
+	// Each cascade has a cached layer with the casters having a StaticComponent, only rendered again when the cascade is refitted
+	// or when the static casters in it changed. The other casters are drawn every time the cascade is updated, over a copy of the cached layer
+	// The far cascades are updated less often (see ShadowCascades::IsScheduled)
+	class ShadowMaps
+	{
+	public:
+		inline static bool Enabled = true;
+		inline static uint32_t Resolution = 1024; // Of a cascade, the atlas is twice as large
+		inline static uint32_t CascadeCount = 4;
+		inline static float SplitLambda = 0.75f;
+		inline static float MaxDistance = 150.0f;
+		inline static float Margin = 0.2f;
+		inline static float DepthExtent = 100.0f;
+		inline static float DepthBias = 0.0015f; // In the [0, 1] depth of the cascade, scaled up on the surfaces facing away from the light
+
+		// Uniform block sent to the shaders, the matrices go from the world to the [0, 1] coordinates of each cascade
+		struct ShadowDataUniforms
+		{
+			Matrix4 cascadeMatrices[ShadowCascades::MaxCascades];
+			float cascadeSplits[ShadowCascades::MaxCascades]; // View depth where each cascade ends
+			float params[4]; // Cascade count (0 when there are no shadows), size of a texel of the atlas, depth bias, 0
+		};
+
+		struct Stats
+		{
+			uint32_t cascadesRendered; // Cascades updated, for every view
+			uint32_t staticLayersRendered; // Cached layers rendered again
+			uint32_t refits; // Cascades refitted because the view left them
+			uint32_t staticCasters; // Drawn in the cached layers
+			uint32_t dynamicCasters; // Drawn over the cached layers
+		};
+
+		// Fits the cascades of the view of the camera and finds the casters, then sends the ShadowData uniforms
+		// The cached shadow maps are kept under view, see ForwardRenderer::ViewID
+		// lightDirection is the forward axis of the first directional light, if there is one
+		// Called by ForwardRenderer::RenderScene(), the shadow maps are then rendered by Render() from the frame graph
+		static void Prepare(Asset<Scene> scene, uint32_t view, const CameraComponent& camera, const Vector3& cameraPos, const Vector3& forward, float aspect, std::optional<Vector3> lightDirection);
+
+		// Atlas of the last prepared view, nullptr when it has no shadows
+		static const Texture* GetPreparedAtlas();
+
+		// Updates the scheduled cascades of the last prepared view into its atlas and binds the atlas
+		static void Render();
+
+		// Declarations of the ShadowData block, the atlas and GetDirectionalShadow(), added to the PBR shader using
+		static std::string GetShaderCode();
+
+		static Stats GetLastStats() { return s_lastStats; }
+
+	private:
+		static int GetAtlasSlot();
+
+		static void NextFrame();
+		static void OnClose();
+
+		RE_STATIC_CONSTRUCTOR({
+			UniformBlocks::ReserveBlock<ShadowDataUniforms>("ShadowData");
+			EngineEvents::OnPreUpdate().Register<&ShadowMaps::NextFrame>();
+			EngineEvents::OnEngineStop().Register<&ShadowMaps::OnClose>();
+		});
+
+	private:
+		inline static Stats s_stats;
+		inline static Stats s_lastStats;
+	};
+}
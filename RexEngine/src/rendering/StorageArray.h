@@ -0,0 +1,138 @@
+#pragma once
+
+#include <vector>
+#include <cstring>
+#include <cstdint>
+
+#include "RenderApi.h"
+#include "RingBuffer.h"
+
+namespace RexEngine
+{
+	// Array of T kept on the CPU and mirrored in a shader storage buffer
+	// Layout of the buffer : uint count, uint extra, 8 bytes of padding, then the array (std430)
+	// Only the entries that changed since the last Upload() are sent to the GPU
+	// They are written in the RingBuffer and copied on the GPU, a glBufferSubData could wait for the frames still reading the buffer
+	template<typename T>
+	class StorageArray
+	{
+	public:
+		inline static constexpr size_t HeaderSize = sizeof(uint32_t) * 4;
+
+		StorageArray() = default;
+		StorageArray(const StorageArray&) = delete;
+
+		~StorageArray()
+		{
+			if (m_buffer != RenderApi::InvalidBufferID)
+				RenderApi::DeleteBuffer(m_buffer);
+		}
+
+		size_t Size() const { return m_data.size(); }
+		const T& operator[](size_t index) const { return m_data[index]; }
+
+		// Drop the entries after count
+		void Truncate(size_t count)
+		{
+			if (count >= m_data.size())
+				return;
+
+			m_data.erase(m_data.begin() + count, m_data.end());
+			m_headerDirty = true;
+		}
+
+		// index can be Size() to add an entry, only marks the entry dirty if the bytes changed
+		void Set(size_t index, const T& value)
+		{
+			if (index == m_data.size())
+			{
+				m_data.push_back(value);
+				m_headerDirty = true;
+			}
+			else if (std::memcmp(&m_data[index], &value, sizeof(T)) == 0)
+				return;
+			else
+				m_data[index] = value;
+
+			MarkDirty(index, index + 1);
+		}
+
+		// Second value of the header
+		void SetExtra(uint32_t extra)
+		{
+			if (extra == m_extra)
+				return;
+
+			m_extra = extra;
+			m_headerDirty = true;
+		}
+
+		// Send the changes to the GPU and bind the buffer, returns the number of bytes uploaded
+		size_t Upload(int binding)
+		{
+			size_t uploaded = 0;
+
+			// Grow geometrically, everything is uploaded again in the new buffer
+			if (m_buffer == RenderApi::InvalidBufferID || m_data.size() > m_capacity)
+			{
+				m_capacity = std::max<size_t>({ m_capacity * 2, m_data.size(), 16 });
+
+				if (m_buffer == RenderApi::InvalidBufferID)
+					m_buffer = RenderApi::MakeBuffer();
+
+				RenderApi::SetBufferData(m_buffer, RenderApi::BufferType::ShaderStorage, RenderApi::BufferMode::Dynamic, nullptr, HeaderSize + m_capacity * sizeof(T));
+				m_headerDirty = true;
+				m_dirtyBegin = 0;
+				m_dirtyEnd = m_data.size();
+			}
+
+			if (m_headerDirty)
+			{
+				const uint32_t header[4] = { static_cast<uint32_t>(m_data.size()), m_extra, 0, 0 };
+				Write(0, HeaderSize, header);
+				uploaded += HeaderSize;
+				m_headerDirty = false;
+			}
+
+			m_dirtyEnd = std::min(m_dirtyEnd, m_data.size());
+			if (m_dirtyBegin < m_dirtyEnd)
+			{
+				const size_t size = (m_dirtyEnd - m_dirtyBegin) * sizeof(T);
+				Write(HeaderSize + m_dirtyBegin * sizeof(T), size, &m_data[m_dirtyBegin]);
+				uploaded += size;
+			}
+
+			m_dirtyBegin = SIZE_MAX;
+			m_dirtyEnd = 0;
+
+			RenderApi::BindBufferBase(m_buffer, binding, RenderApi::BufferType::ShaderStorage);
+			return uploaded;
+		}
+
+	private:
+		void Write(size_t offset, size_t size, const void* data)
+		{
+			auto staging = RingBuffer::Allocate(size);
+			std::memcpy(staging.data, data, size);
+			RenderApi::CopyBufferData(staging.buffer, m_buffer, staging.offset, offset, size);
+		}
+
+		// The changes are uploaded as a single range
+		void MarkDirty(size_t begin, size_t end)
+		{
+			m_dirtyBegin = std::min(m_dirtyBegin, begin);
+			m_dirtyEnd = std::max(m_dirtyEnd, end);
+		}
+
+	private:
+		std::vector<T> m_data;
+		uint32_t m_extra = 0;
+
+		RenderApi::BufferID m_buffer = RenderApi::InvalidBufferID;
+		size_t m_capacity = 0;
+
+		size_t m_dirtyBegin = SIZE_MAX;
+		size_t m_dirtyEnd = 0;
+		bool m_headerDirty = true;
+	};
+}
@@ -60,6 +60,7 @@ namespace RexEngine
 
 	Texture::~Texture()
 	{
+		RenderApi::MakeTextureHandleNonResident(m_handle);
 		RenderApi::DeleteTexture(m_id);
 	}
 
@@ -112,12 +113,14 @@ namespace RexEngine
 
 	void Texture::SetData(Vector2Int newSize, const void* data, RenderApi::PixelFormat dataFormat, RenderApi::PixelType dataType)
 	{
+		RE_ASSERT(m_handle == RenderApi::InvalidTextureHandle, "Cannot change a texture that has a bindless handle");
 		m_size = newSize;
 		RenderApi::SetTextureData(m_id, m_target, m_gpuFormat, newSize, data, dataFormat, dataType);
 	}
 
 	void Texture::SetOption(RenderApi::TextureOption option, RenderApi::TextureOptionValue value)
 	{
+		RE_ASSERT(m_handle == RenderApi::InvalidTextureHandle, "Cannot change a texture that has a bindless handle");
 		RenderApi::SetTextureOption(m_id, m_target, option, value);
 	}
 
@@ -126,6 +129,14 @@ namespace RexEngine
 		return RenderApi::GetTextureOption(m_id, m_target, option);
 	}
 
+	RenderApi::TextureHandle Texture::GetHandle() const
+	{
+		if (m_handle == RenderApi::InvalidTextureHandle)
+			m_handle = RenderApi::MakeTextureHandleResident(m_id);
+
+		return m_handle;
+	}
+
 	void Texture::Bind() const
 	{
 		RenderApi::BindTexture(m_id, m_target);
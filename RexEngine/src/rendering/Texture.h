@@ -15,8 +15,10 @@ namespace RexEngine
 		Texture(RenderApi::PixelFormat gpuFormat, Vector2Int size, const void* data, RenderApi::PixelFormat dataFormat, RenderApi::PixelType dataType, bool flipY, bool hdr);
 
 	public:
-		// Creates an empty texture
-		Texture(RenderApi::PixelFormat gpuFormat, Vector2Int size) : Texture(gpuFormat, size, nullptr, RenderApi::PixelFormat::RGB, RenderApi::PixelType::UByte, false, false) {}
+		// Creates an empty texture, a Depth texture can be attached to the depth of a framebuffer and sampled
+		Texture(RenderApi::PixelFormat gpuFormat, Vector2Int size) : Texture(gpuFormat, size, nullptr,
+			gpuFormat == RenderApi::PixelFormat::Depth ? RenderApi::PixelFormat::Depth : RenderApi::PixelFormat::RGB,
+			gpuFormat == RenderApi::PixelFormat::Depth ? RenderApi::PixelType::Float : RenderApi::PixelType::UByte, false, false) {}
 		~Texture();
 
 		Texture(const Texture&) = delete;
@@ -43,6 +45,9 @@ namespace RexEngine
 		RenderApi::TextureID GetId() const { return m_id; }
 		RenderApi::PixelFormat GetFormat() const { return m_gpuFormat; }
 
+		// Bindless handle, made resident on the first call. The texture can't be changed anymore after that
+		RenderApi::TextureHandle GetHandle() const;
+
 		void SetOption(RenderApi::TextureOption option, RenderApi::TextureOptionValue value);
 		RenderApi::TextureOptionValue GetOption(RenderApi::TextureOption option) const;
 
@@ -134,6 +139,7 @@ namespace RexEngine
 	private:
 		Vector2Int m_size;
 		RenderApi::TextureID m_id;
+		mutable RenderApi::TextureHandle m_handle = RenderApi::InvalidTextureHandle;
 		RenderApi::TextureTarget m_target; // Cache the target for SetOption()
 		RenderApi::PixelFormat m_gpuFormat; // Cached for SetData()
 		bool m_flipYOnLoad;
@@ -3,6 +3,7 @@
 #include <vector>
 #include <memory>
 #include <unordered_map>
+#include <limits>
 
 #include "../core/Log.h"
 #include "../core/EngineEvents.h"
@@ -16,6 +17,27 @@ namespace RexEngine
 	{
 	public:
 
+		// How the material textures are given to the shaders
+		enum class Residency
+		{
+			Slots, // Bound to a texture slot when the material is bound, see GetTextureSlot()
+			Bindless // The samplers of the material block are resident handles, the material textures are never bound
+		};
+
+		// Must be set before the engine starts, Bindless falls back to Slots if the driver doesn't support it
+		inline static Residency PreferredResidency = Residency::Bindless;
+
+		inline static Residency GetResidency() { return s_residency; }
+
+		struct Stats
+		{
+			size_t requests; // GetTextureSlot() calls
+			size_t rebinds; // Requests where the texture was not in a slot
+		};
+
+		// Stats of the last frame
+		inline static Stats GetLastStats() { return s_lastStats; }
+
 		// Call this once before the first GetTextureSlot() call for each shader
 		inline static void StartShader()
 		{
@@ -23,6 +45,38 @@ namespace RexEngine
 			{
 				slot.usedThisShader = false;
 			}
+
+			s_shaderCount++;
+			s_shaderStep++;
+		}
+
+		// Planning : list the textures the next shaders will request, in the order they will be requested
+		// When a slot has to be replaced, the one holding the texture needed the furthest in the future is picked
+		// The textures requested without a plan are replaced based on how often and how recently they were used
+		inline static void BeginPlan()
+		{
+			// The textures missing from the last plan are dropped, the others keep their steps capacity
+			std::erase_if(s_plannedUses, [](const auto& entry) { return entry.second.steps.empty(); });
+			for (auto& [texture, uses] : s_plannedUses)
+			{
+				uses.steps.clear();
+				uses.next = 0;
+			}
+
+			s_planStep = 0;
+			s_shaderStep = 0;
+		}
+
+		// Call before the textures of each planned shader
+		inline static void PlanShader()
+		{
+			s_planStep++;
+		}
+
+		inline static void PlanTexture(RenderApi::TextureID texture)
+		{
+			if (texture)
+				s_plannedUses[texture].steps.push_back(s_planStep);
 		}
 
 		// Returns the id of the slot that was reserved or -1 if not slots are left
@@ -30,12 +84,12 @@ namespace RexEngine
 		inline static int ReserveSlot()
 		{
 			// Start reserving from the last slot
-			for (auto i = s_slots.size() - 1; i >= 0; i--)
+			for (int i = static_cast<int>(s_slots.size()) - 1; i >= 0; i--)
 			{
 				if (!s_slots[i].reserved) // Find a non-reserved slot
 				{
 					s_slots[i].reserved = true;
-					return static_cast<int>(i);
+					return i;
 				}
 			}
 
@@ -50,40 +104,135 @@ namespace RexEngine
 			if (!texture)
 				return 0;
 
+			s_stats.requests++;
+			ConsumePlannedUse(texture);
+
 			// Check if this texture is already bound to a slot
 			if (auto slot = s_textureSlot.find(texture); slot != s_textureSlot.end())
 			{
-				s_slots[slot->second].usedThisShader = true;
+				UseSlot(slot->second);
 				return slot->second;
 			}
 
-			// Find a not used slot to use
-			// TODO : a smarter way to find the slot based on usage
-			for (int i = 0; i < s_slots.size(); i++)
+			const int i = FindSlotToReplace();
+			if (i == -1)
 			{
-				if (s_slots[i].usedThisShader == false && s_slots[i].reserved == false)
-				{
-					// Remove the old
-					s_textureSlot.erase(s_slots[i].texture);
+				RE_LOG_ERROR("Not enough texture slots !");
+				return 0;
+			}
 
-					// Add the new
-					s_textureSlot.insert({texture, i});
-					s_slots[i].texture = texture;
-					s_slots[i].usedThisShader = true;
+			// Remove the old
+			s_textureSlot.erase(s_slots[i].texture);
 
-					// Set the slot as active
-					RenderApi::SetActiveTexture(i);
-					RenderApi::BindTexture(texture, target);
-					return i;
-				}
+			// Add the new
+			s_textureSlot.insert({texture, i});
+			s_slots[i].texture = texture;
+			s_slots[i].frequency = 0.0f;
+			UseSlot(i);
+
+			// Set the slot as active
+			RenderApi::SetActiveTexture(i);
+			RenderApi::BindTexture(texture, target);
+			s_stats.rebinds++;
+			return i;
+		}
+
+		// Resident handle of a 1x1 black texture, for the samplers of the material block without a texture
+		inline static RenderApi::TextureHandle GetFallbackHandle(RenderApi::TextureTarget target)
+		{
+			const bool cubemap = target == RenderApi::TextureTarget::Cubemap;
+			auto& handle = s_fallbackHandles[cubemap ? 1 : 0];
+			if (handle != RenderApi::InvalidTextureHandle)
+				return handle;
+
+			// Never deleted, used until the app closes
+			const uint8_t black[3] = { 0, 0, 0 };
+			RenderApi::TextureID id;
+			if (cubemap)
+			{
+				id = RenderApi::MakeCubemap();
+				for (int face = 0; face < 6; face++)
+					RenderApi::SetCubemapFace(id, (RenderApi::CubemapFace)face, RenderApi::PixelFormat::RGB, { 1, 1 }, black, RenderApi::PixelFormat::RGB, RenderApi::PixelType::UByte);
 			}
+			else
+			{
+				id = RenderApi::MakeTexture(target, RenderApi::PixelFormat::RGB, { 1, 1 }, black, RenderApi::PixelFormat::RGB, RenderApi::PixelType::UByte);
+			}
+
+			// No mipmaps, the texture must not use them to be complete
+			RenderApi::SetTextureOption(id, target, RenderApi::TextureOption::MinFilter, RenderApi::TextureOptionValue::Linear);
 
-			// No slot left
-			RE_LOG_ERROR("Not enough texture slots !");
-			return 0;
+			handle = RenderApi::MakeTextureHandleResident(id);
+			return handle;
 		}
 
 	private:
+		inline static void UseSlot(int i)
+		{
+			auto& slot = s_slots[i];
+			slot.usedThisShader = true;
+			slot.lastUse = s_shaderCount;
+			slot.frequency += 1.0f;
+		}
+
+		// Only the planned uses up to the current shader are consumed, a request the plan doesn't have (another queue) leaves it as it is
+		inline static void ConsumePlannedUse(RenderApi::TextureID texture)
+		{
+			auto uses = s_plannedUses.find(texture);
+			if (uses == s_plannedUses.end())
+				return;
+
+			auto& [steps, next] = uses->second;
+			while (next < steps.size() && steps[next] <= s_shaderStep)
+				next++;
+		}
+
+		// Step of the next planned use of the texture, NoPlannedUse if it is not planned anymore
+		inline static uint32_t NextPlannedUse(RenderApi::TextureID texture)
+		{
+			if (auto uses = s_plannedUses.find(texture); uses != s_plannedUses.end() && uses->second.next < uses->second.steps.size())
+				return uses->second.steps[uses->second.next];
+
+			return NoPlannedUse;
+		}
+
+		// The slot not used by the current shader holding the texture needed the furthest in the plan
+		// Ties (usually textures that are not planned) go to the slot with the lowest frequency / age
+		inline static int FindSlotToReplace()
+		{
+			int best = -1;
+			uint32_t bestNextUse = 0;
+			float bestScore = 0.0f;
+
+			for (int i = 0; i < static_cast<int>(s_slots.size()); i++)
+			{
+				const auto& slot = s_slots[i];
+				if (slot.usedThisShader || slot.reserved)
+					continue;
+
+				const uint32_t nextUse = slot.texture ? NextPlannedUse(slot.texture) : NoPlannedUse;
+				const float score = slot.texture ? slot.frequency / (1.0f + static_cast<float>(s_shaderCount - slot.lastUse)) : 0.0f;
+
+				if (best == -1 || nextUse > bestNextUse || (nextUse == bestNextUse && score < bestScore))
+				{
+					best = i;
+					bestNextUse = nextUse;
+					bestScore = score;
+				}
+			}
+
+			return best;
+		}
+
+		inline static void NextFrame()
+		{
+			s_lastStats = s_stats;
+			s_stats = Stats{};
+
+			// The frequency is halved every frame, the old uses matter less
+			for (auto& slot : s_slots)
+				slot.frequency *= 0.5f;
+		}
 
 		inline static void Init()
 		{
@@ -95,21 +244,48 @@ namespace RexEngine
 			{
 				s_slots.push_back(Slot());
 			}
+
+			if (PreferredResidency == Residency::Bindless && RenderApi::SupportsBindlessTextures())
+				s_residency = Residency::Bindless;
+			else
+				s_residency = Residency::Slots;
 		}
 
 		RE_STATIC_CONSTRUCTOR({
 			EngineEvents::OnEngineStart().Register<&TextureManager::Init>();
+			EngineEvents::OnPreUpdate().Register<&TextureManager::NextFrame>();
 		});
 
 	private:
 		struct Slot
 		{
-			RenderApi::TextureID texture;
+			RenderApi::TextureID texture = RenderApi::InvalidTextureID;
 			bool usedThisShader = false; // is this texture used by the current shader (if true dont replace it)
 			bool reserved = false; // Is this slot reserved (ex : PBR)
+			uint64_t lastUse = 0; // Value of s_shaderCount when the texture was last requested
+			float frequency = 0.0f; // Number of requests, decays every frame
+		};
+
+		// Steps of the plan where a texture is requested, next is the first one not requested yet
+		struct PlannedUses
+		{
+			std::vector<uint32_t> steps;
+			size_t next = 0;
 		};
 
+		inline static constexpr uint32_t NoPlannedUse = std::numeric_limits<uint32_t>::max();
+
+		inline static Residency s_residency = Residency::Slots;
+		inline static RenderApi::TextureHandle s_fallbackHandles[2] = { RenderApi::InvalidTextureHandle, RenderApi::InvalidTextureHandle }; // Texture2D, Cubemap
 		inline static std::vector<Slot> s_slots;
 		inline static std::unordered_map<RenderApi::TextureID, int> s_textureSlot;
+
+		inline static uint64_t s_shaderCount = 0;
+		inline static std::unordered_map<RenderApi::TextureID, PlannedUses> s_plannedUses;
+		inline static uint32_t s_planStep = 0;
+		inline static uint32_t s_shaderStep = 0; // StartShader() calls since BeginPlan(), the step of the plan being drawn
+
+		inline static Stats s_stats;
+		inline static Stats s_lastStats;
 	};
 }
\ No newline at end of file
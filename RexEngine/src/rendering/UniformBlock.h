@@ -49,6 +49,13 @@ namespace RexEngine
 		}
 
 
+		// Binding point of the block, without creating its GPU buffer (for blocks bound from the RingBuffer)
+		static int GetLocation(const std::string& name)
+		{
+			RE_ASSERT(s_blocks.contains(name), "No uniform named {}", name);
+			return s_blocks.at(name).GetLocation();
+		}
+
 		template<typename T>
 		static UniformBlock& GetBlock(const std::string& name)
 		{
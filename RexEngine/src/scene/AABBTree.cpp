@@ -0,0 +1,285 @@
+#include "REPch.h"
+#include "AABBTree.h"
+
+namespace RexEngine
+{
+	AABBTree::AABBTree(float margin)
+		: m_root(NullNode), m_freeList(NullNode), m_proxyCount(0), m_margin(margin)
+	{ }
+
+	int32_t AABBTree::Insert(const BoundingBox& box, uint32_t data)
+	{
+		const int32_t proxy = AllocateNode();
+		m_nodes[proxy].box = box.Expanded(m_margin);
+		m_nodes[proxy].data = data;
+		m_nodes[proxy].height = 0;
+
+		InsertLeaf(proxy);
+		m_proxyCount++;
+		return proxy;
+	}
+
+	void AABBTree::Remove(int32_t proxy)
+	{
+		RE_ASSERT(proxy >= 0 && proxy < (int32_t)m_nodes.size() && m_nodes[proxy].IsLeaf(), "Invalid AABBTree proxy : {}", proxy);
+
+		RemoveLeaf(proxy);
+		FreeNode(proxy);
+		m_proxyCount--;
+	}
+
+	bool AABBTree::Move(int32_t proxy, const BoundingBox& box)
+	{
+		RE_ASSERT(proxy >= 0 && proxy < (int32_t)m_nodes.size() && m_nodes[proxy].IsLeaf(), "Invalid AABBTree proxy : {}", proxy);
+
+		const BoundingBox fatBox = box.Expanded(m_margin);
+		auto& node = m_nodes[proxy];
+
+		// Still inside the fat box and the fat box is not too big (the object did not shrink a lot)
+		if (node.box.Contains(box) && fatBox.Expanded(4.0f * m_margin).Contains(node.box))
+			return false;
+
+		RemoveLeaf(proxy);
+		m_nodes[proxy].box = fatBox;
+		InsertLeaf(proxy);
+		return true;
+	}
+
+	int32_t AABBTree::AllocateNode()
+	{
+		if (m_freeList == NullNode)
+		{
+			m_nodes.push_back({});
+			m_freeList = (int32_t)m_nodes.size() - 1;
+			m_nodes[m_freeList].parent = NullNode;
+		}
+
+		const int32_t node = m_freeList;
+		m_freeList = m_nodes[node].parent;
+
+		m_nodes[node].parent = NullNode;
+		m_nodes[node].left = NullNode;
+		m_nodes[node].right = NullNode;
+		m_nodes[node].height = 0;
+		m_nodes[node].data = 0;
+		return node;
+	}
+
+	void AABBTree::FreeNode(int32_t node)
+	{
+		m_nodes[node].parent = m_freeList;
+		m_nodes[node].height = -1;
+		m_freeList = node;
+	}
+
+	void AABBTree::InsertLeaf(int32_t leaf)
+	{
+		if (m_root == NullNode)
+		{
+			m_root = leaf;
+			m_nodes[leaf].parent = NullNode;
+			return;
+		}
+
+		// Find the best sibling, going down the cheapest side
+		const BoundingBox leafBox = m_nodes[leaf].box;
+		int32_t index = m_root;
+		while (!m_nodes[index].IsLeaf())
+		{
+			const Node& node = m_nodes[index];
+
+			const float area = node.box.SurfaceArea();
+			const float combinedArea = BoundingBox::Merge(node.box, leafBox).SurfaceArea();
+
+			// Cost of making a new parent for this node and the leaf
+			const float cost = 2.0f * combinedArea;
+
+			// Minimum cost of pushing the leaf further down the tree
+			const float inheritanceCost = 2.0f * (combinedArea - area);
+
+			auto childCost = [&](int32_t child) {
+				const BoundingBox merged = BoundingBox::Merge(leafBox, m_nodes[child].box);
+				if (m_nodes[child].IsLeaf())
+					return merged.SurfaceArea() + inheritanceCost;
+				return merged.SurfaceArea() - m_nodes[child].box.SurfaceArea() + inheritanceCost;
+			};
+
+			const float leftCost = childCost(node.left);
+			const float rightCost = childCost(node.right);
+
+			if (cost < leftCost && cost < rightCost)
+				break;
+
+			index = leftCost < rightCost ? node.left : node.right;
+		}
+
+		const int32_t sibling = index;
+
+		// Make a new parent for the leaf and its sibling
+		const int32_t oldParent = m_nodes[sibling].parent;
+		const int32_t newParent = AllocateNode();
+		m_nodes[newParent].parent = oldParent;
+		m_nodes[newParent].box = BoundingBox::Merge(leafBox, m_nodes[sibling].box);
+		m_nodes[newParent].height = m_nodes[sibling].height + 1;
+		m_nodes[newParent].left = sibling;
+		m_nodes[newParent].right = leaf;
+		m_nodes[sibling].parent = newParent;
+		m_nodes[leaf].parent = newParent;
+
+		if (oldParent == NullNode)
+			m_root = newParent;
+		else if (m_nodes[oldParent].left == sibling)
+			m_nodes[oldParent].left = newParent;
+		else
+			m_nodes[oldParent].right = newParent;
+
+		FixUpwards(m_nodes[leaf].parent);
+	}
+
+	void AABBTree::RemoveLeaf(int32_t leaf)
+	{
+		if (leaf == m_root)
+		{
+			m_root = NullNode;
+			return;
+		}
+
+		const int32_t parent = m_nodes[leaf].parent;
+		const int32_t grandParent = m_nodes[parent].parent;
+		const int32_t sibling = m_nodes[parent].left == leaf ? m_nodes[parent].right : m_nodes[parent].left;
+
+		// The sibling takes the place of the parent
+		if (grandParent == NullNode)
+		{
+			m_root = sibling;
+			m_nodes[sibling].parent = NullNode;
+			FreeNode(parent);
+			return;
+		}
+
+		if (m_nodes[grandParent].left == parent)
+			m_nodes[grandParent].left = sibling;
+		else
+			m_nodes[grandParent].right = sibling;
+
+		m_nodes[sibling].parent = grandParent;
+		FreeNode(parent);
+
+		FixUpwards(grandParent);
+	}
+
+	void AABBTree::FixUpwards(int32_t node)
+	{
+		while (node != NullNode)
+		{
+			node = Balance(node);
+
+			Node& current = m_nodes[node];
+			const Node& left = m_nodes[current.left];
+			const Node& right = m_nodes[current.right];
+
+			current.height = 1 + std::max(left.height, right.height);
+			current.box = BoundingBox::Merge(left.box, right.box);
+
+			node = current.parent;
+		}
+	}
+
+	int32_t AABBTree::Balance(int32_t iA)
+	{
+		Node& A = m_nodes[iA];
+		if (A.IsLeaf() || A.height < 2)
+			return iA;
+
+		const int32_t iB = A.left;
+		const int32_t iC = A.right;
+		Node& B = m_nodes[iB];
+		Node& C = m_nodes[iC];
+
+		// Replace the link to A in the parent of A by the node going up
+		auto replaceInParent = [this, &A, iA](int32_t with) {
+			if (A.parent == NullNode)
+				m_root = with;
+			else if (m_nodes[A.parent].left == iA)
+				m_nodes[A.parent].left = with;
+			else
+				m_nodes[A.parent].right = with;
+		};
+
+		const int32_t balance = C.height - B.height;
+
+		if (balance > 1)
+		{ // Rotate C up
+			const int32_t iF = C.left;
+			const int32_t iG = C.right;
+			Node& F = m_nodes[iF];
+			Node& G = m_nodes[iG];
+
+			C.left = iA;
+			C.parent = A.parent;
+			replaceInParent(iC);
+			A.parent = iC;
+
+			if (F.height > G.height)
+			{
+				C.right = iF;
+				A.right = iG;
+				G.parent = iA;
+				A.box = BoundingBox::Merge(B.box, G.box);
+				C.box = BoundingBox::Merge(A.box, F.box);
+				A.height = 1 + std::max(B.height, G.height);
+				C.height = 1 + std::max(A.height, F.height);
+			}
+			else
+			{
+				C.right = iG;
+				A.right = iF;
+				F.parent = iA;
+				A.box = BoundingBox::Merge(B.box, F.box);
+				C.box = BoundingBox::Merge(A.box, G.box);
+				A.height = 1 + std::max(B.height, F.height);
+				C.height = 1 + std::max(A.height, G.height);
+			}
+
+			return iC;
+		}
+
+		if (balance < -1)
+		{ // Rotate B up
+			const int32_t iD = B.left;
+			const int32_t iE = B.right;
+			Node& D = m_nodes[iD];
+			Node& E = m_nodes[iE];
+
+			B.left = iA;
+			B.parent = A.parent;
+			replaceInParent(iB);
+			A.parent = iB;
+
+			if (D.height > E.height)
+			{
+				B.right = iD;
+				A.left = iE;
+				E.parent = iA;
+				A.box = BoundingBox::Merge(C.box, E.box);
+				B.box = BoundingBox::Merge(A.box, D.box);
+				A.height = 1 + std::max(C.height, E.height);
+				B.height = 1 + std::max(A.height, D.height);
+			}
+			else
+			{
+				B.right = iE;
+				A.left = iD;
+				D.parent = iA;
+				A.box = BoundingBox::Merge(C.box, D.box);
+				B.box = BoundingBox::Merge(A.box, E.box);
+				A.height = 1 + std::max(C.height, D.height);
+				B.height = 1 + std::max(A.height, E.height);
+			}
+
+			return iB;
+		}
+
+		return iA;
+	}
+}
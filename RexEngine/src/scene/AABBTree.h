@@ -0,0 +1,139 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "../math/Bounds.h"
+#include "../math/Frustum.h"
+
+namespace RexEngine
+{
+	// Dynamic bounding volume hierarchy (incremental insert/remove/move)
+	// The leaves store a fat box (the box + a margin) so small movements do not touch the tree
+	// Inserts pick the sibling with the lowest surface area cost, and the tree is kept balanced with rotations
+	// Based on the b2DynamicTree from Box2D
+	class AABBTree
+	{
+	public:
+		inline static constexpr int32_t NullNode = -1;
+
+		explicit AABBTree(float margin = 0.1f);
+
+		// Returns the id of the proxy, data is given back by the queries
+		int32_t Insert(const BoundingBox& box, uint32_t data);
+		void Remove(int32_t proxy);
+
+		// Returns true if the proxy had to be reinserted (it left its fat box)
+		bool Move(int32_t proxy, const BoundingBox& box);
+
+		uint32_t GetData(int32_t proxy) const { return m_nodes[proxy].data; }
+		const BoundingBox& GetFatBounds(int32_t proxy) const { return m_nodes[proxy].box; }
+
+		size_t ProxyCount() const { return m_proxyCount; }
+		int32_t Height() const { return m_root == NullNode ? 0 : m_nodes[m_root].height; }
+
+		// callback(uint32_t data) is called for every proxy whose fat box passes the test
+		template<typename F>
+		void Query(const BoundingBox& box, F&& callback) const
+		{
+			Traverse([&box](const BoundingBox& node) { return node.Intersects(box); },
+				[&callback](const Node& leaf) { callback(leaf.data); return true; });
+		}
+
+		template<typename F>
+		void QueryFrustum(const Frustum& frustum, F&& callback) const
+		{
+			Traverse([&frustum](const BoundingBox& node) { return frustum.Intersects(node); },
+				[&callback](const Node& leaf) { callback(leaf.data); return true; });
+		}
+
+		template<typename F>
+		void QuerySphere(const BoundingSphere& sphere, F&& callback) const
+		{
+			Traverse([&sphere](const BoundingBox& node) { return sphere.Intersects(node); },
+				[&callback](const Node& leaf) { callback(leaf.data); return true; });
+		}
+
+		// float callback(uint32_t data, float distance) is called for each proxy hit by the ray, in no particular order
+		// The callback returns the new max distance : return distance to only look for closer hits,
+		// maxDistance to get all the hits, or 0 to stop
+		template<typename F>
+		void RayCast(const Vector3& origin, const Vector3& direction, float maxDistance, F&& callback) const
+		{
+			const Vector3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+			Traverse([&](const BoundingBox& node) {
+					float distance;
+					return node.IntersectsRay(origin, inverseDirection, maxDistance, distance);
+				},
+				[&](const Node& leaf) {
+					float distance = 0.0f;
+					leaf.box.IntersectsRay(origin, inverseDirection, maxDistance, distance);
+					maxDistance = callback(leaf.data, distance);
+					return maxDistance > 0.0f;
+				});
+		}
+
+	private:
+		struct Node
+		{
+			BoundingBox box;
+			int32_t parent; // Next free node when in the free list
+			int32_t left;
+			int32_t right;
+			int32_t height; // Leaf = 0, free = -1
+			uint32_t data;
+
+			bool IsLeaf() const { return left == NullNode; }
+		};
+
+		// test(box) decides if a node is visited, onLeaf(node) returns false to stop
+		template<typename Test, typename OnLeaf>
+		void Traverse(Test&& test, OnLeaf&& onLeaf) const
+		{
+			if (m_root == NullNode)
+				return;
+
+			int32_t stack[64]; // The tree is balanced, the height stays far below 64
+			int count = 0;
+			stack[count++] = m_root;
+
+			while (count > 0)
+			{
+				const Node& node = m_nodes[stack[--count]];
+				if (!test(node.box))
+					continue;
+
+				if (node.IsLeaf())
+				{
+					if (!onLeaf(node))
+						return;
+				}
+				else
+				{
+					stack[count++] = node.left;
+					stack[count++] = node.right;
+				}
+			}
+		}
+
+		int32_t AllocateNode();
+		void FreeNode(int32_t node);
+
+		void InsertLeaf(int32_t leaf);
+		void RemoveLeaf(int32_t leaf);
+
+		// Rotates the subtree if it is unbalanced, returns the new root of the subtree
+		int32_t Balance(int32_t node);
+
+		// Recompute the boxes and heights up to the root, balancing along the way
+		void FixUpwards(int32_t node);
+
+	private:
+		std::vector<Node> m_nodes;
+		int32_t m_root;
+		int32_t m_freeList;
+		size_t m_proxyCount;
+		float m_margin;
+	};
+}
@@ -2,6 +2,7 @@
 
 #include <memory>
 #include <ranges>
+#include <array>
 
 #include "../rendering/Material.h"
 #include "../rendering/Mesh.h"
@@ -44,6 +45,32 @@ namespace RexEngine
 	};
 	RE_REGISTER_COMPONENT(MeshRendererComponent, "MeshRenderer")
 
+	// Hides the objects behind it when the occlusion culling is enabled
+	struct OccluderComponent
+	{
+		Asset<Mesh> mesh; // Simplified mesh to rasterize, uses the mesh of the MeshRenderer if not set
+
+		template<typename Archive>
+		void serialize(Archive& archive)
+		{
+			archive(KEEP_NAME(mesh));
+		}
+	};
+	RE_REGISTER_COMPONENT(OccluderComponent, "Occluder")
+
+	// The object never moves, its shadow is rendered once in the cached layer of the shadow maps (see ShadowMaps)
+	struct StaticComponent
+	{
+		bool castShadows = true;
+
+		template<typename Archive>
+		void serialize(Archive& archive)
+		{
+			archive(KEEP_NAME(castShadows));
+		}
+	};
+	RE_REGISTER_COMPONENT(StaticComponent, "Static")
+
 	struct TransformComponent
 	{
 		Vector3 position = Vector3(0,0,0);
@@ -95,6 +122,41 @@ namespace RexEngine
 	};
 	RE_REGISTER_COMPONENT(TransformComponent, "Transform")
 
+	// Added by the scene to the entities in the spatial index, not serialized
+	// Holds the state computed by the last Scene::UpdateSpatialIndex()
+	struct SpatialProxyComponent
+	{
+		int32_t proxy = AABBTree::NullNode;
+		Matrix4 globalTransform;
+		BoundingBox bounds; // World space
+	};
+
+	// Added by the renderer to the light entities, not serialized
+	// The world position and direction of the light, only computed again when the transform of the light or of a parent changed
+	struct LightProxyComponent
+	{
+		inline static constexpr uint32_t MaxTrackedDepth = 4; // The lights under more parents are computed every frame
+
+		// Local transform of the light then of each parent, as of the last computation
+		struct LocalTransform
+		{
+			Vector3 position;
+			Vector3 scale;
+			Quaternion rotation;
+			Entity parent;
+		};
+
+		std::array<LocalTransform, MaxTrackedDepth> transforms;
+		uint32_t depth = 0; // Used entries in transforms, 0 before the first computation
+
+		Vector3 position;
+		Vector3 direction;
+
+		// Range of the last color, see ForwardRenderer::LightRange()
+		Color color;
+		float range = 0.0f;
+	};
+
 	struct CameraComponent
 	{
 		float fov = 70.0f;
@@ -11,6 +11,7 @@ namespace RexEngine
 	{
 		m_registry.on_construct<Guid>().connect<&Scene::OnGuidAdded>(m_guid);
 		m_registry.on_destroy<Guid>().connect<&Scene::OnGuidRemoved>();
+		m_registry.on_destroy<SpatialProxyComponent>().connect<&Scene::OnSpatialProxyRemoved>(*this);
 		s_validRegistries.insert(&m_registry);
 	}
 
@@ -54,6 +55,61 @@ namespace RexEngine
         m_registry.destroy(e.m_handle);
     }
 
+	void Scene::UpdateSpatialIndex()
+	{
+		// Entities that lost their mesh renderer
+		auto removedView = m_registry.view<SpatialProxyComponent>(entt::exclude<MeshRendererComponent>);
+		std::vector<entt::entity> removed(removedView.begin(), removedView.end());
+		m_registry.remove<SpatialProxyComponent>(removed.begin(), removed.end());
+
+		for (auto&& [handle, renderer, transform] : m_registry.view<MeshRendererComponent, TransformComponent>().each())
+		{
+			if (!renderer.mesh)
+			{
+				m_registry.remove<SpatialProxyComponent>(handle);
+				continue;
+			}
+
+			const Matrix4 globalTransform = transform.GetGlobalTransform();
+			const BoundingBox bounds = renderer.mesh->GetBounds().Transformed(globalTransform);
+
+			if (auto proxy = m_registry.try_get<SpatialProxyComponent>(handle))
+			{
+				m_spatialIndex.Move(proxy->proxy, bounds); // Only touches the tree if the bounds left the fat box
+				proxy->globalTransform = globalTransform;
+				proxy->bounds = bounds;
+			}
+			else
+			{
+				const int32_t proxyId = m_spatialIndex.Insert(bounds, static_cast<uint32_t>(handle));
+				m_registry.emplace<SpatialProxyComponent>(handle, proxyId, globalTransform, bounds);
+			}
+		}
+	}
+
+	std::pair<Entity, float> Scene::RayCastBounds(const Vector3& origin, const Vector3& direction, float maxDistance)
+	{
+		const Vector3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+		std::pair<Entity, float> closest{ Entity(), maxDistance };
+
+		m_spatialIndex.RayCast(origin, direction, maxDistance, [&](uint32_t data, [[maybe_unused]] float fatDistance) {
+			// The tree tests the fat boxes, test the real bounds
+			const auto handle = static_cast<entt::entity>(data);
+			float distance;
+			if (m_registry.get<SpatialProxyComponent>(handle).bounds.IntersectsRay(origin, inverseDirection, closest.second, distance))
+				closest = { Entity(&m_registry, handle), distance };
+
+			return closest.second;
+		});
+
+		return closest;
+	}
+
+	void Scene::OnSpatialProxyRemoved(entt::registry& registry, entt::entity handle)
+	{
+		m_spatialIndex.Remove(registry.get<SpatialProxyComponent>(handle).proxy);
+	}
+
     void Scene::SerializeJson(std::ostream& output) const
     {
         JsonSerializer archive(output);
@@ -6,6 +6,7 @@
 #include <entt/entity/registry.hpp>
 
 #include "Entity.h"
+#include "AABBTree.h"
 #include "../core/Serialization.h"
 #include "../assets/AssetManager.h"
 
@@ -50,6 +51,30 @@ namespace RexEngine
 			return result;
 		}
 
+		// Spatial index of the entities with a MeshRendererComponent (world space bounds)
+		// Synced with the transforms and mesh renderers, call it before querying (once per frame)
+		void UpdateSpatialIndex();
+
+		// callback(Entity) for each entity whose bounds may be inside the frustum
+		template<typename F>
+		void QueryFrustum(const Frustum& frustum, F&& callback)
+		{
+			m_spatialIndex.QueryFrustum(frustum, [this, &callback](uint32_t handle) { callback(Entity(&m_registry, static_cast<entt::entity>(handle))); });
+		}
+
+		// callback(Entity) for each entity whose bounds may intersect the sphere
+		template<typename F>
+		void QuerySphere(const BoundingSphere& sphere, F&& callback)
+		{
+			m_spatialIndex.QuerySphere(sphere, [this, &callback](uint32_t handle) { callback(Entity(&m_registry, static_cast<entt::entity>(handle))); });
+		}
+
+		// Closest entity whose world bounds are hit by the ray, and the distance along the ray
+		// Returns a null Entity if nothing was hit
+		std::pair<Entity, float> RayCastBounds(const Vector3& origin, const Vector3& direction, float maxDistance);
+
+		const AABBTree& GetSpatialIndex() const { return m_spatialIndex; }
+
 		Guid GetGuid() const { return m_guid; }
 
 
@@ -105,6 +130,9 @@ namespace RexEngine
 			s_entities.erase(registry.get<Guid>(handle));
 		}
 
+		// Remove the entity from the spatial index
+		void OnSpatialProxyRemoved(entt::registry& registry, entt::entity handle);
+
 		inline static void OnStop()
 		{
 			// Unload the current scene
@@ -142,6 +170,7 @@ namespace RexEngine
 	private:
 		entt::registry m_registry;
 		Guid m_guid;
+		AABBTree m_spatialIndex;
 
 		inline static Asset<Scene> s_currentScene;
 		// <entity guid, <scene guid, entity handle>>
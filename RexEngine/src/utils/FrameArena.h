@@ -0,0 +1,147 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <algorithm>
+
+namespace RexEngine
+{
+	// Linear allocator, memory is only given back all at once with Reset()
+	// The blocks are kept between resets, so a steady state frame does not touch the heap
+	// Destructors are never called, only use it for trivially destructible types
+	class FrameArena
+	{
+	public:
+		explicit FrameArena(size_t blockSize = 64 * 1024)
+			: m_blockSize(blockSize), m_block(0), m_offset(0), m_used(0), m_heapAllocated(0)
+		{ }
+
+		FrameArena(const FrameArena&) = delete;
+		FrameArena& operator=(const FrameArena&) = delete;
+
+		void* Allocate(size_t size, size_t alignment)
+		{
+			while (true)
+			{
+				if (m_block < m_blocks.size())
+				{
+					auto& block = m_blocks[m_block];
+					const size_t start = (m_offset + alignment - 1) & ~(alignment - 1);
+
+					if (start + size <= block.size)
+					{
+						m_offset = start + size;
+						m_used += size;
+						return block.data.get() + start;
+					}
+
+					// Does not fit, go to the next block
+					m_block++;
+					m_offset = 0;
+					continue;
+				}
+
+				// No block left, make a new one (big enough for this allocation)
+				const size_t blockSize = std::max(m_blockSize, size + alignment);
+				m_blocks.push_back({ std::make_unique<std::byte[]>(blockSize), blockSize });
+				m_heapAllocated += blockSize;
+			}
+		}
+
+		template<typename T>
+		T* Allocate(size_t count = 1) requires std::is_trivially_destructible_v<T>
+		{
+			return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+		}
+
+		// Everything allocated before this call becomes invalid
+		void Reset()
+		{
+			m_block = 0;
+			m_offset = 0;
+			m_used = 0;
+			m_heapAllocated = 0;
+		}
+
+		// Bytes handed out since the last Reset()
+		size_t BytesUsed() const { return m_used; }
+
+		// Bytes requested from the heap since the last Reset(), should be 0 once the arena is warm
+		size_t HeapBytesAllocated() const { return m_heapAllocated; }
+
+		// Total size of all the blocks owned by the arena
+		size_t BytesReserved() const
+		{
+			size_t total = 0;
+			for (auto& block : m_blocks)
+				total += block.size;
+			return total;
+		}
+
+	private:
+		struct Block
+		{
+			std::unique_ptr<std::byte[]> data;
+			size_t size;
+		};
+
+		std::vector<Block> m_blocks;
+		size_t m_blockSize;
+
+		size_t m_block; // Current block
+		size_t m_offset; // Offset in the current block
+		size_t m_used;
+		size_t m_heapAllocated;
+	};
+
+	// Index addressable list allocated in a FrameArena, in chunks so the elements never move
+	// Clear() must be called when the arena is reset
+	template<typename T> requires std::is_trivially_destructible_v<T>
+	class ArenaList
+	{
+	public:
+		static constexpr size_t ChunkSize = 256; // Elements per chunk
+
+		explicit ArenaList(FrameArena& arena)
+			: m_arena(&arena), m_size(0)
+		{ }
+
+		template<typename ...Args>
+		T& EmplaceBack(Args&&... args)
+		{
+			if (m_size == m_chunks.size() * ChunkSize)
+				m_chunks.push_back(m_arena->Allocate<T>(ChunkSize));
+
+			T* element = new (&m_chunks[m_size / ChunkSize][m_size % ChunkSize]) T(std::forward<Args>(args)...);
+			m_size++;
+			return *element;
+		}
+
+		// Returns the index of the new element
+		uint32_t PushBack(const T& value)
+		{
+			EmplaceBack(value);
+			return static_cast<uint32_t>(m_size - 1);
+		}
+
+		T& operator[](size_t index) { return m_chunks[index / ChunkSize][index % ChunkSize]; }
+		const T& operator[](size_t index) const { return m_chunks[index / ChunkSize][index % ChunkSize]; }
+
+		size_t Size() const { return m_size; }
+
+		void Clear()
+		{
+			m_chunks.clear(); // The memory belongs to the arena, the capacity of m_chunks is kept
+			m_size = 0;
+		}
+
+	private:
+		FrameArena* m_arena;
+		std::vector<T*> m_chunks;
+		size_t m_size;
+	};
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+namespace RexEngine::RadixSort
+{
+	// A sort key and the index of the element it was generated from
+	struct KeyIndex
+	{
+		uint64_t key;
+		uint32_t index;
+	};
+
+	// Stable LSD radix sort on the keys, 8 bits per pass
+	// scratch is only used as temporary storage, pass the same vector every frame to avoid allocations
+	// Passes where every key has the same byte are skipped (common with packed keys where the high bits rarely change)
+	inline void Sort(std::vector<KeyIndex>& data, std::vector<KeyIndex>& scratch)
+	{
+		constexpr size_t Passes = sizeof(uint64_t);
+		constexpr size_t Buckets = 256;
+
+		if (data.size() <= 1)
+			return;
+
+		scratch.resize(data.size());
+
+		// Build the histograms of all the passes in a single read of the data
+		std::array<std::array<size_t, Buckets>, Passes> counts{};
+		for (auto& element : data)
+		{
+			for (size_t pass = 0; pass < Passes; pass++)
+				counts[pass][(element.key >> (pass * 8)) & 0xFF]++;
+		}
+
+		KeyIndex* from = data.data();
+		KeyIndex* to = scratch.data();
+
+		for (size_t pass = 0; pass < Passes; pass++)
+		{
+			auto& count = counts[pass];
+
+			// All the keys have the same byte, this pass would not change the order
+			if (count[(from[0].key >> (pass * 8)) & 0xFF] == data.size())
+				continue;
+
+			// Prefix sum, count becomes the start offset of each bucket
+			size_t offset = 0;
+			for (auto& c : count)
+			{
+				size_t bucketSize = c;
+				c = offset;
+				offset += bucketSize;
+			}
+
+			for (size_t i = 0; i < data.size(); i++)
+				to[count[(from[i].key >> (pass * 8)) & 0xFF]++] = from[i];
+
+			std::swap(from, to);
+		}
+
+		// The result ended up in the scratch buffer
+		if (from != data.data())
+			data.swap(scratch);
+	}
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <map>
+#include <optional>
+#include <algorithm>
+#include <cstddef>
+
+namespace RexEngine
+{
+	// Free list suballocator of ranges in a buffer, the units are up to the user (bytes, vertices, indices, ...)
+	// Best fit in the free ranges, the freed ranges are merged with their free neighbours
+	// Only the free ranges are stored, the user keeps the offset and size of its allocations
+	class RangeAllocator
+	{
+	public:
+		RangeAllocator() : RangeAllocator(0) {}
+
+		explicit RangeAllocator(size_t capacity)
+			: m_capacity(0), m_freeSize(0)
+		{
+			Grow(capacity);
+		}
+
+		// Returns the offset of the range, nothing if no free range is large enough
+		std::optional<size_t> Allocate(size_t size)
+		{
+			if (size == 0)
+				return 0;
+
+			auto best = m_free.end();
+			for (auto it = m_free.begin(); it != m_free.end(); it++)
+			{
+				if (it->second >= size && (best == m_free.end() || it->second < best->second))
+					best = it;
+			}
+
+			if (best == m_free.end())
+				return {};
+
+			const size_t offset = best->first;
+			const size_t left = best->second - size;
+			m_free.erase(best);
+			if (left > 0)
+				m_free.emplace(offset + size, left);
+
+			m_freeSize -= size;
+			return offset;
+		}
+
+		void Free(size_t offset, size_t size)
+		{
+			if (size == 0)
+				return;
+
+			m_freeSize += size;
+			auto next = m_free.lower_bound(offset);
+
+			// Merge with the free range after
+			if (next != m_free.end() && next->first == offset + size)
+			{
+				size += next->second;
+				next = m_free.erase(next);
+			}
+
+			// Merge with the free range before
+			if (next != m_free.begin())
+			{
+				auto previous = std::prev(next);
+				if (previous->first + previous->second == offset)
+				{
+					previous->second += size;
+					return;
+				}
+			}
+
+			m_free.emplace(offset, size);
+		}
+
+		// Adds a free range at the end
+		void Grow(size_t capacity)
+		{
+			if (capacity <= m_capacity)
+				return;
+
+			Free(m_capacity, capacity - m_capacity);
+			m_capacity = capacity;
+		}
+
+		// Everything is free, used by the compaction that allocates the live ranges again
+		void Reset()
+		{
+			m_free.clear();
+			if (m_capacity > 0)
+				m_free.emplace(0, m_capacity);
+			m_freeSize = m_capacity;
+		}
+
+		size_t Capacity() const { return m_capacity; }
+		size_t FreeSize() const { return m_freeSize; }
+		size_t UsedSize() const { return m_capacity - m_freeSize; }
+		size_t FreeRangeCount() const { return m_free.size(); }
+
+		size_t LargestFreeRange() const
+		{
+			size_t largest = 0;
+			for (auto& [offset, size] : m_free)
+				largest = std::max(largest, size);
+			return largest;
+		}
+
+		// 0 when the free space is a single range, close to 1 when it is split in many small ranges
+		float Fragmentation() const
+		{
+			return m_freeSize == 0 ? 0.0f : 1.0f - (float)LargestFreeRange() / m_freeSize;
+		}
+
+	private:
+		std::map<size_t, size_t> m_free; // <offset, size>, sorted by offset
+		size_t m_capacity;
+		size_t m_freeSize;
+	};
+}
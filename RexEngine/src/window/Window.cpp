@@ -2,6 +2,7 @@
 #include "Window.h"
 
 #include <core/Libs.h>
+#include <rendering/RenderApi.h>
 #include <stb/stb_image.h>
 
 namespace RexEngine
@@ -46,12 +47,20 @@ namespace RexEngine
 	void Window::MakeActive()
 	{
 		s_activeWindow = this;
-		glfwMakeContextCurrent(m_window);
+
+		// The context belongs to the render thread, a context made current on this thread (ex : by imgui) is released
+		if (RenderApi::IsRenderThreadRunning())
+			glfwMakeContextCurrent(nullptr);
+		RenderApi::PostToRenderThread([window = m_window] { glfwMakeContextCurrent(window); });
+
+		// The cached state might be from another context
+		RenderApi::InvalidateStateCache();
 	}
 
 	void Window::SwapBuffers()
 	{
-		glfwSwapBuffers(m_window);
+		// The caller doesn't wait for the frame to be presented
+		RenderApi::PostToRenderThread([window = m_window] { glfwSwapBuffers(window); });
 	}
 
 	void Window::SetResizeCallback(std::function<void(Vector2Int)> callback)
@@ -76,7 +85,7 @@ namespace RexEngine
 
 	void Window::SetVSync(bool state)
 	{
-		glfwSwapInterval(state ? 1 : 0);
+		RenderApi::PostToRenderThread([state] { glfwSwapInterval(state ? 1 : 0); });
 	}
 
 	// Private
@@ -0,0 +1,208 @@
+#include <REPch.h>
+
+#include <random>
+#include <set>
+
+#include "Test.h"
+#include "scene/AABBTree.h"
+
+using namespace RexEngine;
+
+namespace
+{
+	struct Objects
+	{
+		std::vector<BoundingBox> boxes;
+		std::vector<int32_t> proxies;
+		std::vector<bool> alive;
+	};
+
+	BoundingBox BoxAt(const Vector3& center, float extent)
+	{
+		return { center - Vector3(extent, extent, extent), center + Vector3(extent, extent, extent) };
+	}
+
+	// Objects in a cube of the given size, the data of a proxy is its index
+	Objects MakeObjects(AABBTree& tree, size_t count, float size, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> position(-size, size);
+		std::uniform_real_distribution<float> extent(0.1f, 1.0f);
+
+		Objects objects;
+		for (size_t i = 0; i < count; i++)
+		{
+			objects.boxes.push_back(BoxAt(Vector3(position(random), position(random), position(random)), extent(random)));
+			objects.proxies.push_back(tree.Insert(objects.boxes.back(), (uint32_t)i));
+			objects.alive.push_back(true);
+		}
+		return objects;
+	}
+
+	// The proxies whose fat box passes the test, found without the tree
+	template<typename Test>
+	std::set<uint32_t> BruteForce(const AABBTree& tree, const Objects& objects, Test&& test)
+	{
+		std::set<uint32_t> result;
+		for (size_t i = 0; i < objects.proxies.size(); i++)
+		{
+			if (objects.alive[i] && test(tree.GetFatBounds(objects.proxies[i])))
+				result.insert((uint32_t)i);
+		}
+		return result;
+	}
+}
+
+RE_TEST(AABBTreeQueriesMatchBruteForce)
+{
+	std::mt19937 random(2);
+	AABBTree tree;
+	Objects objects = MakeObjects(tree, 2000, 50.0f, random);
+
+	// Move some of them, remove others
+	std::uniform_real_distribution<float> step(-3.0f, 3.0f);
+	for (size_t i = 0; i < objects.boxes.size(); i++)
+	{
+		if (i % 7 == 0)
+		{
+			tree.Remove(objects.proxies[i]);
+			objects.alive[i] = false;
+		}
+		else if (i % 2 == 0)
+		{
+			const Vector3 offset(step(random), step(random), step(random));
+			objects.boxes[i] = { objects.boxes[i].min + offset, objects.boxes[i].max + offset };
+			tree.Move(objects.proxies[i], objects.boxes[i]);
+		}
+	}
+	RE_CHECK(tree.ProxyCount() == 2000 - 286);
+
+	std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+	int wrong = 0;
+	for (int i = 0; i < 50; i++)
+	{
+		const BoundingBox box = BoxAt(Vector3(position(random), position(random), position(random)), 8.0f);
+		std::set<uint32_t> found;
+		tree.Query(box, [&](uint32_t data) { found.insert(data); });
+		if (found != BruteForce(tree, objects, [&](const BoundingBox& b) { return b.Intersects(box); }))
+			wrong++;
+
+		const BoundingSphere sphere = { Vector3(position(random), position(random), position(random)), 10.0f };
+		found.clear();
+		tree.QuerySphere(sphere, [&](uint32_t data) { found.insert(data); });
+		if (found != BruteForce(tree, objects, [&](const BoundingBox& b) { return sphere.Intersects(b); }))
+			wrong++;
+
+		const Vector3 eye(position(random), position(random), position(random));
+		const Frustum frustum(Matrix4::MakePerspective(60.0f, 1.5f, 0.1f, 40.0f) * Matrix4::MakeLookAt(eye, Vector3(0, 0, 0), Vector3(0, 1, 0)));
+		found.clear();
+		tree.QueryFrustum(frustum, [&](uint32_t data) { found.insert(data); });
+		if (found != BruteForce(tree, objects, [&](const BoundingBox& b) { return frustum.Intersects(b); }))
+			wrong++;
+	}
+	RE_CHECK(wrong == 0);
+}
+
+RE_TEST(AABBTreeFatBoxes)
+{
+	AABBTree tree(0.5f);
+	const int32_t proxy = tree.Insert(BoxAt(Vector3(0, 0, 0), 1.0f), 7);
+	RE_CHECK(tree.GetData(proxy) == 7);
+	RE_CHECK(tree.GetFatBounds(proxy).Contains(BoxAt(Vector3(0, 0, 0), 1.4f)));
+
+	// Still in the fat box, the tree doesn't change
+	RE_CHECK(!tree.Move(proxy, BoxAt(Vector3(0.3f, 0, 0), 1.0f)));
+	RE_CHECK(tree.Move(proxy, BoxAt(Vector3(5.0f, 0, 0), 1.0f)));
+	RE_CHECK(tree.GetFatBounds(proxy).Contains(BoxAt(Vector3(5.0f, 0, 0), 1.0f)));
+
+	tree.Remove(proxy);
+	RE_CHECK(tree.ProxyCount() == 0 && tree.Height() == 0);
+}
+
+RE_TEST(AABBTreeStaysBalanced)
+{
+	// Sorted inserts are the worst case for a tree without rotations
+	AABBTree tree;
+	for (int i = 0; i < 4096; i++)
+		tree.Insert(BoxAt(Vector3((float)i * 3.0f, 0, 0), 1.0f), (uint32_t)i);
+
+	RE_CHECK(tree.Height() <= 24);
+}
+
+RE_TEST(AABBTreeRayCastFindsTheClosestHit)
+{
+	std::mt19937 random(4);
+	AABBTree tree(0.0f);
+	Objects objects = MakeObjects(tree, 1000, 30.0f, random);
+
+	std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+	int wrong = 0;
+	for (int i = 0; i < 100; i++)
+	{
+		const Vector3 origin(0, 0, 0);
+		const Vector3 dir = Vector3(glm::normalize(glm::vec3(direction(random), direction(random), direction(random))));
+		const Vector3 inverse(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+
+		float closest = 100.0f;
+		tree.RayCast(origin, dir, 100.0f, [&](uint32_t, float distance) { closest = std::min(closest, distance); return closest; });
+
+		float expected = 100.0f;
+		for (auto& box : objects.boxes)
+		{
+			float distance = 0.0f;
+			if (box.IntersectsRay(origin, inverse, 100.0f, distance))
+				expected = std::min(expected, distance);
+		}
+
+		if (std::abs(closest - expected) > 1e-4f)
+			wrong++;
+	}
+	RE_CHECK(wrong == 0);
+}
+
+RE_BENCHMARK(AABBTreeBenchmark)
+{
+	// 100k objects moving every frame, then the queries of a frame : culling, picking and proximity
+	constexpr size_t Count = 100000;
+	std::mt19937 random(6);
+	AABBTree tree;
+	Objects objects = MakeObjects(tree, Count, 500.0f, random);
+
+	std::vector<Vector3> velocities;
+	std::uniform_real_distribution<float> speed(-0.05f, 0.05f); // Per frame
+	for (size_t i = 0; i < Count; i++)
+		velocities.push_back(Vector3(speed(random), speed(random), speed(random)));
+
+	size_t reinserted = 0;
+	size_t frames = 0;
+	const double moveTime = Tests::Measure([&] {
+		frames++;
+		for (size_t i = 0; i < Count; i++)
+		{
+			objects.boxes[i] = { objects.boxes[i].min + velocities[i], objects.boxes[i].max + velocities[i] };
+			reinserted += tree.Move(objects.proxies[i], objects.boxes[i]) ? 1 : 0;
+		}
+	});
+
+	const Frustum frustum(Matrix4::MakePerspective(60.0f, 1.5f, 0.1f, 300.0f) * Matrix4::MakeLookAt(Vector3(0, 0, -500), Vector3(0, 0, 0), Vector3(0, 1, 0)));
+	const BoundingSphere sphere = { Vector3(10, 20, 30), 25.0f };
+
+	size_t visible = 0;
+	const double treeTime = Tests::Measure([&] {
+		visible = 0;
+		tree.QueryFrustum(frustum, [&](uint32_t) { visible++; });
+		tree.QuerySphere(sphere, [&](uint32_t) { visible++; });
+	});
+
+	size_t linearVisible = 0;
+	const double linearTime = Tests::Measure([&] {
+		linearVisible = 0;
+		for (auto& box : objects.boxes)
+		{
+			linearVisible += frustum.Intersects(box) ? 1 : 0;
+			linearVisible += sphere.Intersects(box) ? 1 : 0;
+		}
+	});
+
+	std::printf("    moving %zu objects : %.3f ms, %zu reinserted per frame, height %d\n", Count, moveTime, reinserted / frames, tree.Height());
+	std::printf("    frustum + sphere query : tree %.3f ms (%zu found), linear scan %.3f ms (%zu found)\n", treeTime, visible, linearTime, linearVisible);
+}
@@ -0,0 +1,58 @@
+#include <REPch.h>
+
+#include <string_view>
+
+#include "Test.h"
+
+using namespace RexEngine;
+
+namespace
+{
+	void OnLog(Log::LogType type, const std::string& msg, uint_least32_t line, const std::string&, const std::string& file)
+	{
+		if (type == Log::LogType::Error || type == Log::LogType::Assert)
+		{
+			std::printf("    %s(%u) : %s\n", file.c_str(), (unsigned)line, msg.c_str());
+			Tests::Failures()++;
+		}
+	}
+}
+
+// Usage : RexTests [--bench] [filter]
+// --bench also runs the benchmarks, the filter only runs the tests whose name contains it
+int main(int argc, char** argv)
+{
+	bool benchmarks = false;
+	std::string_view filter;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::string_view(argv[i]) == "--bench")
+			benchmarks = true;
+		else
+			filter = argv[i];
+	}
+
+	Log::LogEvent().Register<&OnLog>();
+
+	int run = 0;
+	int failed = 0;
+	for (auto& test : Tests::Registry())
+	{
+		if ((test.benchmark && !benchmarks) || std::string_view(test.name).find(filter) == std::string_view::npos)
+			continue;
+
+		std::printf("%s\n", test.name);
+		Tests::Failures() = 0;
+		test.function();
+		run++;
+
+		if (Tests::Failures() > 0)
+		{
+			std::printf("    FAILED\n");
+			failed++;
+		}
+	}
+
+	std::printf("%d/%d passed\n", run - failed, run);
+	return failed;
+}
@@ -0,0 +1,200 @@
+#include <REPch.h>
+
+#include <fstream>
+
+#include "Test.h"
+#include "rendering/MeshSimplifier.h"
+#include "rendering/MeshOptimizer.h"
+#include "rendering/ObjParser.h"
+#include "math/Bounds.h"
+
+using namespace RexEngine;
+
+namespace
+{
+	struct TestMesh
+	{
+		std::vector<Vector3> positions;
+		std::vector<unsigned int> indices;
+	};
+
+	// Flat grid of size x size quads in the xy plane
+	TestMesh MakeGrid(int size)
+	{
+		TestMesh mesh;
+		for (int y = 0; y <= size; y++)
+		{
+			for (int x = 0; x <= size; x++)
+				mesh.positions.push_back(Vector3((float)x, (float)y, 0.0f));
+		}
+
+		for (int y = 0; y < size; y++)
+		{
+			for (int x = 0; x < size; x++)
+			{
+				const unsigned int a = (unsigned int)(y * (size + 1) + x);
+				const unsigned int c = a + (unsigned int)size + 1;
+				mesh.indices.insert(mesh.indices.end(), { a, a + 1, c, a + 1, c + 1, c });
+			}
+		}
+		return mesh;
+	}
+
+	// Closed uv sphere of radius 1, the poles and the seam are welded
+	TestMesh MakeSphere(int rings, int segments)
+	{
+		TestMesh mesh;
+		mesh.positions.push_back(Vector3(0, 1, 0));
+		for (int r = 1; r < rings; r++)
+		{
+			const float phi = glm::pi<float>() * (float)r / (float)rings;
+			for (int s = 0; s < segments; s++)
+			{
+				const float theta = glm::two_pi<float>() * (float)s / (float)segments;
+				mesh.positions.push_back(Vector3(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta)));
+			}
+		}
+		mesh.positions.push_back(Vector3(0, -1, 0));
+
+		const auto vertex = [&](int r, int s) { return (unsigned int)(1 + (r - 1) * segments + (s % segments)); };
+		const unsigned int south = (unsigned int)mesh.positions.size() - 1;
+		for (int s = 0; s < segments; s++)
+		{
+			mesh.indices.insert(mesh.indices.end(), { 0u, vertex(1, s + 1), vertex(1, s) });
+			mesh.indices.insert(mesh.indices.end(), { south, vertex(rings - 1, s), vertex(rings - 1, s + 1) });
+			for (int r = 1; r + 1 < rings; r++)
+			{
+				mesh.indices.insert(mesh.indices.end(), { vertex(r, s), vertex(r, s + 1), vertex(r + 1, s) });
+				mesh.indices.insert(mesh.indices.end(), { vertex(r, s + 1), vertex(r + 1, s + 1), vertex(r + 1, s) });
+			}
+		}
+		return mesh;
+	}
+
+	// Signed area in the xy plane
+	float Area(const TestMesh& mesh, const std::vector<unsigned int>& indices)
+	{
+		float area = 0.0f;
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			const Vector3& a = mesh.positions[indices[i]];
+			const Vector3& b = mesh.positions[indices[i + 1]];
+			const Vector3& c = mesh.positions[indices[i + 2]];
+			area += ((b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x)) * 0.5f;
+		}
+		return area;
+	}
+
+	bool IndicesInRange(const std::vector<unsigned int>& indices, size_t vertexCount)
+	{
+		return indices.size() % 3 == 0 && std::all_of(indices.begin(), indices.end(), [&](unsigned int index) { return index < vertexCount; });
+	}
+}
+
+RE_TEST(MeshSimplifierCollapsesFlatAreas)
+{
+	// No error on a plane, only the borders limit the reduction
+	const TestMesh grid = MakeGrid(32);
+	const auto result = MeshSimplifier::Simplify(grid.positions, grid.indices, 0, 1e-4f);
+
+	RE_CHECK(IndicesInRange(result.indices, grid.positions.size()));
+	RE_CHECK(result.indices.size() < grid.indices.size() / 4);
+	RE_CHECK(result.error < 1e-4f);
+
+	// The borders don't move and no triangle flips, so the area stays the same
+	RE_CHECK_NEAR(Area(grid, result.indices), 32.0f * 32.0f, 1e-2f);
+}
+
+RE_TEST(MeshSimplifierStopsAtTheTarget)
+{
+	const TestMesh sphere = MakeSphere(32, 64);
+	const size_t target = sphere.indices.size() / 4 / 3 * 3;
+	const auto result = MeshSimplifier::Simplify(sphere.positions, sphere.indices, target, 1.0f);
+
+	RE_CHECK(IndicesInRange(result.indices, sphere.positions.size()));
+	RE_CHECK(result.indices.size() <= target);
+	RE_CHECK(result.indices.size() >= target - 6); // A collapse removes 2 triangles
+	RE_CHECK(result.error > 0.0f && result.error < 0.1f);
+}
+
+RE_TEST(MeshSimplifierRespectsTheMaxError)
+{
+	const TestMesh sphere = MakeSphere(32, 64);
+	for (float maxError : { 0.0f, 1e-3f, 1e-2f })
+	{
+		const auto result = MeshSimplifier::Simplify(sphere.positions, sphere.indices, 0, maxError);
+		RE_CHECK(IndicesInRange(result.indices, sphere.positions.size()));
+		RE_CHECK(result.error <= maxError);
+		RE_CHECK(!result.indices.empty());
+	}
+
+	// Nothing can be removed from a sphere without error
+	const auto exact = MeshSimplifier::Simplify(sphere.positions, sphere.indices, 0, 0.0f);
+	RE_CHECK(exact.indices.size() == sphere.indices.size());
+}
+
+RE_BENCHMARK(MeshLodBenchmark)
+{
+	// Same chain as Mesh::GenerateLods() on the test project meshes, run from the root of the repository
+	// Then the triangles drawn for objects spread from a screen size of 1 down to 0.01, with and without the lods
+	for (const char* path : { "RexEditor/Projects/TestProject/Assets/Dino/Dino.obj", "RexEditor/Projects/TestProject/Assets/Sphere/Sphere.obj" })
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+		{
+			std::printf("    %s not found, skipped\n", path);
+			continue;
+		}
+
+		const std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		const auto obj = ObjParser::Parse(text);
+
+		BoundingBox bounds = { obj.positions[0], obj.positions[0] };
+		for (auto& position : obj.positions)
+		{
+			bounds.min = Vector3(std::min(bounds.min.x, position.x), std::min(bounds.min.y, position.y), std::min(bounds.min.z, position.z));
+			bounds.max = Vector3(std::max(bounds.max.x, position.x), std::max(bounds.max.y, position.y), std::max(bounds.max.z, position.z));
+		}
+
+		std::vector<size_t> triangles = { obj.indices.size() / 3 };
+		std::vector<float> screenSizes = { 1.0f };
+		float maxError = 0.01f * bounds.Extents().Magnitude();
+		float screenSize = 0.5f;
+		std::vector<unsigned int> previous = obj.indices;
+
+		double time = 0.0;
+		while (triangles.size() < 4 && previous.size() >= 3 * 64)
+		{
+			MeshSimplifier::Result simplified;
+			time += Tests::Measure([&] { simplified = MeshSimplifier::Simplify(obj.positions, previous, previous.size() / 6 * 3, maxError); }, 0.0);
+			if (simplified.indices.empty() || (float)simplified.indices.size() > (float)previous.size() * 0.75f)
+				break;
+
+			MeshOptimizer::OptimizeVertexCache(simplified.indices, obj.positions.size());
+			triangles.push_back(simplified.indices.size() / 3);
+			screenSizes.push_back(screenSize);
+
+			previous = std::move(simplified.indices);
+			maxError *= 2.0f;
+			screenSize *= 0.5f;
+		}
+
+		size_t full = 0;
+		size_t withLods = 0;
+		for (int i = 0; i < 1000; i++)
+		{
+			const float size = std::pow(0.01f, (float)i / 1000.0f);
+			size_t lod = 0;
+			while (lod + 1 < screenSizes.size() && size < screenSizes[lod + 1])
+				lod++;
+
+			full += triangles[0];
+			withLods += triangles[lod];
+		}
+
+		std::printf("    %s : %zu lods in %.1f ms,", path, triangles.size(), time);
+		for (auto count : triangles)
+			std::printf(" %zu", count);
+		std::printf(" triangles, %.1f%% of the triangles drawn\n", 100.0 * (double)withLods / (double)full);
+	}
+}
@@ -0,0 +1,325 @@
+#include <REPch.h>
+
+#include <cstdarg>
+#include <random>
+
+#include "Test.h"
+#include "rendering/ObjParser.h"
+#include "utils/TupleHash.h"
+
+using namespace RexEngine;
+
+namespace
+{
+	void Append(std::string& text, const char* format, ...)
+	{
+		char line[256];
+		va_list args;
+		va_start(args, format);
+		const int size = std::vsnprintf(line, sizeof(line), format, args);
+		va_end(args);
+		text.append(line, (size_t)std::max(size, 0));
+	}
+
+	bool Equal(const Vector3& a, const Vector3& b) { return std::abs(a.x - b.x) < 1e-5f && std::abs(a.y - b.y) < 1e-5f && std::abs(a.z - b.z) < 1e-5f; }
+	bool Equal(const Vector2& a, const Vector2& b) { return std::abs(a.x - b.x) < 1e-5f && std::abs(a.y - b.y) < 1e-5f; }
+
+	// Checks what the users of the result rely on, whatever the input
+	bool IsConsistent(const ObjParser::Result& result)
+	{
+		if (result.indices.size() % 3 != 0)
+			return false;
+		if (!result.normals.empty() && result.normals.size() != result.positions.size())
+			return false;
+		if (!result.uvs.empty() && result.uvs.size() != result.positions.size())
+			return false;
+
+		return std::all_of(result.indices.begin(), result.indices.end(), [&](unsigned int index) { return index < result.positions.size(); });
+	}
+
+	// Grid of size x size quads in the xy plane, the uvs are the positions divided by the size
+	// Half of the quads are written as polygons, the other half as 2 triangles with relative indices
+	std::string MakeGrid(int size, size_t& triangles)
+	{
+		std::string text;
+		text.reserve((size_t)size * size * 80);
+		text += "# Grid\r\no grid\r\n";
+
+		for (int y = 0; y <= size; y++)
+		{
+			for (int x = 0; x <= size; x++)
+			{
+				Append(text, "v %d %d 0\n", x, y);
+				Append(text, "vt %g %g\n", (double)x / size, (double)y / size);
+			}
+		}
+		text += "vn 0 0 2\n";
+
+		triangles = 0;
+		const int vertices = (size + 1) * (size + 1);
+		for (int y = 0; y < size; y++)
+		{
+			for (int x = 0; x < size; x++)
+			{
+				const int a = y * (size + 1) + x + 1;
+				const int b = a + 1;
+				const int c = a + size + 1;
+				const int d = c + 1;
+				if ((x + y) % 2 == 0)
+					Append(text, "f %d/%d/1 %d/%d/1 %d/%d/1 %d/%d/1\n", a, a, b, b, d, d, c, c);
+				else
+				{
+					const int r = -vertices - 1; // a - r - 1 is the relative index
+					Append(text, "f %d/%d/-1 %d/%d/-1 %d/%d/-1\n", a + r, a + r, b + r, b + r, c + r, c + r);
+					Append(text, "f %d/%d/-1 %d/%d/-1 %d/%d/-1\n", b + r, b + r, d + r, d + r, c + r, c + r);
+				}
+				triangles += 2;
+			}
+		}
+
+		return text;
+	}
+
+	// The parser used before ObjParser, for the benchmark
+	size_t ParseLineByLine(const std::string& text)
+	{
+		std::vector<Vector3> vertices;
+		std::vector<Vector3> normals = { Vector3(0, 0, 0) };
+		std::vector<Vector2> uvs = { Vector2(0, 0) };
+		std::vector<std::tuple<int, int, int>> faces;
+
+		std::istringstream data(text);
+		std::string line;
+		while (std::getline(data, line))
+		{
+			if (line.empty())
+				continue;
+
+			auto args = StringHelper::Split(line, ' ');
+			if (args[0] == "v")
+				vertices.push_back(Vector3(std::stof(args[1]), std::stof(args[2]), std::stof(args[3])));
+			else if (args[0] == "vn")
+				normals.push_back(Vector3(std::stof(args[1]), std::stof(args[2]), std::stof(args[3])).Normalized());
+			else if (args[0] == "vt")
+				uvs.push_back(Vector2(std::stof(args[1]), std::stof(args[2])));
+			else if (args[0] == "f")
+			{
+				for (int i = 0; i < 3; i++)
+				{
+					auto components = StringHelper::Split(args[i + 1], '/');
+					faces.push_back({ std::stoi(components[0]) - 1, std::stoi(components[2]), std::stoi(components[1]) });
+				}
+			}
+		}
+
+		std::unordered_map<std::tuple<int, int, int>, size_t> vertexIndex;
+		std::vector<unsigned int> indices;
+		for (auto& face : faces)
+		{
+			auto index = vertexIndex.find(face);
+			if (index != vertexIndex.end())
+				indices.push_back((unsigned int)index->second);
+			else
+			{
+				indices.push_back((unsigned int)vertexIndex.size());
+				vertexIndex.insert({ face, vertexIndex.size() });
+			}
+		}
+
+		return indices.size() / 3;
+	}
+}
+
+RE_TEST(ObjParserReadsAllAttributes)
+{
+	const auto result = ObjParser::Parse(
+		"v 0 0 0\n"
+		"v 1.5 0 -2\n"
+		"v 0 +1 1e1\n"
+		"vt 0.5 1\n"
+		"vt 0.25\n"
+		"vn 0 0 3\n"
+		"f 1/1/1 2/2/1 3/1/1\n");
+
+	RE_CHECK(result.malformedLines == 0 && result.invalidTriangles == 0);
+	RE_CHECK(result.positions.size() == 3 && result.uvs.size() == 3 && result.normals.size() == 3);
+	RE_CHECK(result.indices == std::vector<unsigned int>({ 0, 1, 2 }));
+	RE_CHECK(Equal(result.positions[1], Vector3(1.5f, 0, -2)));
+	RE_CHECK(Equal(result.positions[2], Vector3(0, 1, 10)));
+	RE_CHECK(Equal(result.uvs[0], Vector2(0.5f, 1)));
+	RE_CHECK(Equal(result.uvs[1], Vector2(0.25f, 0))); // The v coordinate is optional
+	RE_CHECK(Equal(result.normals[0], Vector3(0, 0, 1))); // Normalized
+}
+
+RE_TEST(ObjParserMergesVertices)
+{
+	// A quad as 2 triangles shares 2 vertices, the same position with another uv is another vertex
+	const auto result = ObjParser::Parse(
+		"v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+		"vt 0 0\nvt 1 1\n"
+		"f 1/1 2/1 3/1\n"
+		"f 1/1 3/1 4/1\n"
+		"f 1/2 2/1 3/1\n");
+
+	RE_CHECK(result.positions.size() == 5);
+	RE_CHECK(result.indices.size() == 9);
+	RE_CHECK(result.indices[3] == result.indices[0] && result.indices[4] == result.indices[2]);
+	RE_CHECK(result.indices[6] != result.indices[0]);
+	RE_CHECK(result.normals.empty());
+}
+
+RE_TEST(ObjParserTriangulatesPolygons)
+{
+	// Fan from the first corner, the negative indices count from the last vertex read
+	const auto result = ObjParser::Parse(
+		"v 0 0 0\nv 1 0 0\nv 2 1 0\nv 1 2 0\nv 0 1 0\n"
+		"f -5 -4 -3 -2 -1\n");
+
+	RE_CHECK(result.invalidTriangles == 0);
+	RE_CHECK(result.indices == std::vector<unsigned int>({ 0, 1, 2, 0, 2, 3, 0, 3, 4 }));
+}
+
+RE_TEST(ObjParserIgnoresOtherLines)
+{
+	// No line end at the end of the file, windows line ends, blank lines, comments and unsupported statements
+	const auto result = ObjParser::Parse(
+		"# comment\r\n"
+		"mtllib a.mtl\r\n"
+		"\r\n"
+		"o object\r\n"
+		"g group\r\n"
+		"usemtl material\r\n"
+		"s off\r\n"
+		"v 0 0 0 1\r\n" // w is ignored
+		"v 1 0 0 # comment\r\n"
+		"  v 0 1 0\r\n"
+		"f 1 2 3");
+
+	RE_CHECK(result.malformedLines == 0);
+	RE_CHECK(result.positions.size() == 3 && result.indices.size() == 3);
+}
+
+RE_TEST(ObjParserSkipsMalformedLines)
+{
+	const auto result = ObjParser::Parse(
+		"v 0 0 0\nv 1 0 0\nv 0 1 0\n"
+		"v 1 x 2\n" // Not a number
+		"v 1 2\n" // Missing a coordinate
+		"vn\n"
+		"f 1 2\n" // Not enough corners
+		"f 1/ 2 3\n" // Missing uv index
+		"f 0 1 2\n" // Indices start at 1
+		"f 1 2 3x\n"
+		"f 1 2 3\n"
+		"f 1 2 4\n" // Out of range
+		"f 1/1 2 3\n" // No uv in the file
+		"f -9 1 2\n");
+
+	RE_CHECK(result.malformedLines == 7);
+	RE_CHECK(result.invalidTriangles == 3);
+	RE_CHECK(result.positions.size() == 3 && result.indices.size() == 3);
+}
+
+RE_TEST(ObjParserHandlesEmptyInput)
+{
+	for (const char* text : { "", "\n", "f 1 2 3\n", "v 1 2 3\n" })
+	{
+		const auto result = ObjParser::Parse(text);
+		RE_CHECK(result.indices.empty() && result.positions.empty());
+	}
+}
+
+RE_TEST(ObjParserChunksAgreeWithTheGrid)
+{
+	// Large enough to be cut in many chunks, the relative indices point to the previous chunks
+	constexpr int Size = 300;
+	size_t triangles = 0;
+	const std::string text = MakeGrid(Size, triangles);
+	const auto result = ObjParser::Parse(text);
+
+	RE_CHECK(result.malformedLines == 0 && result.invalidTriangles == 0);
+	RE_CHECK(result.indices.size() == triangles * 3);
+	RE_CHECK(result.positions.size() == (size_t)(Size + 1) * (Size + 1));
+	RE_CHECK(IsConsistent(result));
+
+	// The uv of every vertex matches its position, each triangle has the area of half a quad
+	size_t wrong = 0;
+	for (size_t i = 0; i < result.positions.size(); i++)
+	{
+		if (!Equal(result.uvs[i], Vector2(result.positions[i].x / Size, result.positions[i].y / Size)) || !Equal(result.normals[i], Vector3(0, 0, 1)))
+			wrong++;
+	}
+	for (size_t i = 0; i < result.indices.size(); i += 3)
+	{
+		const Vector3& a = result.positions[result.indices[i]];
+		const Vector3& b = result.positions[result.indices[i + 1]];
+		const Vector3& c = result.positions[result.indices[i + 2]];
+		const float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+		if (std::abs(area - 1.0f) > 1e-5f)
+			wrong++;
+	}
+	RE_CHECK(wrong == 0);
+}
+
+RE_TEST(ObjParserFuzz)
+{
+	// Mutations of a valid file, then random bytes : the result must stay usable
+	size_t triangles = 0;
+	std::string valid = MakeGrid(40, triangles).substr(0, 20000);
+	valid += "\nf -1/-1/-1 1//1 2/2\nf 1/ 2/ 3/\nvt\nv\nf\nf 1/1/1/1 2 3\nf 2147483647 -2147483648 1\n";
+
+	std::mt19937 random(5);
+	const char characters[] = "vtnf/-+0123456789.eE \t\r\n#";
+	int inconsistent = 0;
+	for (int i = 0; i < 3000; i++)
+	{
+		std::string text = valid;
+		const int mutations = (int)(random() % 50);
+		for (int j = 0; j < mutations; j++)
+		{
+			const size_t position = random() % text.size();
+			switch (random() % 3)
+			{
+			case 0:
+				text[position] = characters[random() % (sizeof(characters) - 1)];
+				break;
+			case 1:
+				text.erase(position, random() % 8);
+				break;
+			default:
+				text.insert(position, 1, characters[random() % (sizeof(characters) - 1)]);
+				break;
+			}
+		}
+
+		if (!IsConsistent(ObjParser::Parse(text)))
+			inconsistent++;
+	}
+
+	for (int i = 0; i < 500; i++)
+	{
+		std::string text(random() % 400, ' ');
+		for (auto& c : text)
+			c = (char)(random() % 256);
+
+		if (!IsConsistent(ObjParser::Parse(text)))
+			inconsistent++;
+	}
+
+	RE_CHECK(inconsistent == 0);
+}
+
+RE_BENCHMARK(ObjParserBenchmark)
+{
+	// About 1M triangles
+	size_t triangles = 0;
+	const std::string text = MakeGrid(708, triangles);
+
+	size_t parsed = 0;
+	const double time = Tests::Measure([&] { parsed = ObjParser::Parse(text).indices.size() / 3; });
+	const double lineByLineTime = Tests::Measure([&] { ParseLineByLine(text); }, 0.0);
+
+	RE_CHECK(parsed == triangles);
+	std::printf("    %.1f MB, %zu triangles : %.1f ms, line by line %.1f ms (x%.1f)\n",
+		(double)text.size() / (1024 * 1024), parsed, time, lineByLineTime, lineByLineTime / time);
+}
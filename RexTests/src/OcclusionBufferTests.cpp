@@ -0,0 +1,253 @@
+#include <REPch.h>
+
+#include <random>
+
+#include "Test.h"
+#include "rendering/OcclusionBuffer.h"
+
+using namespace RexEngine;
+
+// With an identity matrix the positions are already in clip space, the depth is z * 0.5 + 0.5
+namespace
+{
+	std::span<const uint8_t> AsBytes(const std::vector<Vector3>& positions)
+	{
+		return { reinterpret_cast<const uint8_t*>(positions.data()), positions.size() * sizeof(Vector3) };
+	}
+
+	// Rectangle in clip space, the depth goes from zLeft to zRight along x
+	void AddQuad(OcclusionBuffer& buffer, const Matrix4& matrix, float x0, float y0, float x1, float y1, float zLeft, float zRight)
+	{
+		const std::vector<Vector3> positions = { Vector3(x0, y0, zLeft), Vector3(x1, y0, zRight), Vector3(x1, y1, zRight), Vector3(x0, y1, zLeft) };
+		const std::vector<unsigned int> indices = { 0, 1, 2, 0, 2, 3 };
+		buffer.AddOccluder(matrix, AsBytes(positions), sizeof(Vector3), indices);
+	}
+
+	BoundingBox Box(float x0, float y0, float z0, float x1, float y1, float z1)
+	{
+		return { Vector3(x0, y0, z0), Vector3(x1, y1, z1) };
+	}
+
+	// Clip space x of the center of a pixel
+	float PixelCenter(int x, int width)
+	{
+		return ((float)x + 0.5f) / (float)width * 2.0f - 1.0f;
+	}
+}
+
+RE_TEST(OcclusionBufferStartsEmpty)
+{
+	OcclusionBuffer buffer(64, 32);
+	RE_CHECK(buffer.GetWidth() == 64 && buffer.GetHeight() == 32);
+
+	bool cleared = true;
+	for (int y = 0; y < buffer.GetHeight(); y++)
+	{
+		for (int x = 0; x < buffer.GetWidth(); x++)
+			cleared &= buffer.GetDepth(x, y) == 1.0f;
+	}
+	RE_CHECK(cleared);
+
+	buffer.Rasterize();
+	RE_CHECK(buffer.IsVisible(Box(-0.1f, -0.1f, 0.9f, 0.1f, 0.1f, 0.95f), Matrix4::Identity));
+}
+
+RE_TEST(OcclusionBufferRasterizesPixelCenters)
+{
+	OcclusionBuffer buffer(64, 32);
+	AddQuad(buffer, Matrix4::Identity, -0.5f, -0.5f, 0.5f, 0.5f, 0.0f, 0.0f);
+	RE_CHECK(buffer.GetTriangleCount() == 2);
+	buffer.Rasterize();
+
+	// x in [16, 48[ and y in [8, 24[ have their center inside
+	int wrong = 0;
+	for (int y = 0; y < buffer.GetHeight(); y++)
+	{
+		for (int x = 0; x < buffer.GetWidth(); x++)
+		{
+			const bool inside = x >= 16 && x < 48 && y >= 8 && y < 24;
+			if (buffer.GetDepth(x, y) != (inside ? 0.5f : 1.0f))
+				wrong++;
+		}
+	}
+	RE_CHECK(wrong == 0);
+}
+
+RE_TEST(OcclusionBufferInterpolatesDepth)
+{
+	// Full screen, the depth goes from 0.25 to 0.75
+	OcclusionBuffer buffer(64, 32);
+	AddQuad(buffer, Matrix4::Identity, -1.0f, -1.0f, 1.0f, 1.0f, -0.5f, 0.5f);
+	buffer.Rasterize();
+
+	float maxError = 0.0f;
+	for (int y = 0; y < buffer.GetHeight(); y++)
+	{
+		for (int x = 0; x < buffer.GetWidth(); x++)
+		{
+			const float expected = PixelCenter(x, buffer.GetWidth()) * 0.25f + 0.5f;
+			maxError = std::max(maxError, std::abs(buffer.GetDepth(x, y) - expected));
+		}
+	}
+	RE_CHECK(maxError < 1e-4f);
+}
+
+RE_TEST(OcclusionBufferKeepsTheClosestDepth)
+{
+	OcclusionBuffer buffer(64, 32);
+	AddQuad(buffer, Matrix4::Identity, -1.0f, -1.0f, 0.5f, 1.0f, 0.0f, 0.0f);
+	AddQuad(buffer, Matrix4::Identity, -0.5f, -1.0f, 1.0f, 1.0f, -0.5f, -0.5f);
+	buffer.Rasterize();
+
+	RE_CHECK(buffer.GetDepth(4, 16) == 0.5f); // First quad only
+	RE_CHECK(buffer.GetDepth(32, 16) == 0.25f); // Both
+	RE_CHECK(buffer.GetDepth(60, 16) == 0.25f); // Second quad only
+
+	// Clear() removes the occluders
+	buffer.Clear();
+	RE_CHECK(buffer.GetTriangleCount() == 0);
+	buffer.Rasterize();
+	RE_CHECK(buffer.GetDepth(32, 16) == 1.0f);
+}
+
+RE_TEST(OcclusionBufferSkipsTrianglesCrossingTheNearPlane)
+{
+	// w = z, like a perspective projection
+	Matrix4 matrix = Matrix4::Identity;
+	matrix[2][3] = 1.0f;
+	matrix[3][3] = 0.0f;
+
+	OcclusionBuffer buffer(64, 32);
+	AddQuad(buffer, matrix, -1.0f, -1.0f, 1.0f, 1.0f, -1.0f, 1.0f);
+	RE_CHECK(buffer.GetTriangleCount() == 0);
+
+	AddQuad(buffer, matrix, -1.0f, -1.0f, 1.0f, 1.0f, 2.0f, 2.0f);
+	RE_CHECK(buffer.GetTriangleCount() == 2);
+
+	// Boxes crossing the near plane are always visible
+	buffer.Rasterize();
+	RE_CHECK(buffer.IsVisible(Box(-0.1f, -0.1f, -1.0f, 0.1f, 0.1f, 5.0f), matrix));
+}
+
+RE_TEST(OcclusionBufferCullsHiddenBoxes)
+{
+	OcclusionBuffer buffer(64, 32);
+	AddQuad(buffer, Matrix4::Identity, -0.5f, -0.5f, 0.5f, 0.5f, 0.0f, 0.0f);
+	buffer.Rasterize();
+
+	RE_CHECK(!buffer.IsVisible(Box(-0.2f, -0.2f, 0.2f, 0.2f, 0.2f, 0.4f), Matrix4::Identity)); // Behind
+	RE_CHECK(buffer.IsVisible(Box(-0.2f, -0.2f, -0.4f, 0.2f, 0.2f, -0.2f), Matrix4::Identity)); // In front
+	RE_CHECK(buffer.IsVisible(Box(-0.2f, -0.2f, -0.2f, 0.2f, 0.2f, 0.2f), Matrix4::Identity)); // Through the occluder
+	RE_CHECK(buffer.IsVisible(Box(0.3f, -0.2f, 0.2f, 0.8f, 0.2f, 0.4f), Matrix4::Identity)); // Partly outside of the occluder
+	RE_CHECK(buffer.IsVisible(Box(2.0f, 2.0f, 0.2f, 3.0f, 3.0f, 0.4f), Matrix4::Identity)); // Off screen
+
+	// A large box is tested on the coarse levels
+	buffer.Clear();
+	AddQuad(buffer, Matrix4::Identity, -1.0f, -1.0f, 1.0f, 1.0f, 0.0f, 0.0f);
+	buffer.Rasterize();
+	RE_CHECK(!buffer.IsVisible(Box(-0.9f, -0.9f, 0.2f, 0.9f, 0.9f, 0.4f), Matrix4::Identity));
+}
+
+RE_TEST(OcclusionBufferHierarchyIsConservative)
+{
+	// A box is only hidden if every pixel of its screen rectangle is in front of it
+	// The size isn't a power of 2 so the levels have odd sizes
+	OcclusionBuffer buffer(68, 36);
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> position(-1.2f, 1.2f);
+	std::uniform_real_distribution<float> depth(-0.9f, 0.9f);
+	std::uniform_real_distribution<float> size(0.01f, 0.5f);
+
+	for (int i = 0; i < 40; i++)
+	{
+		const std::vector<Vector3> positions = {
+			Vector3(position(random), position(random), depth(random)),
+			Vector3(position(random), position(random), depth(random)),
+			Vector3(position(random), position(random), depth(random)) };
+		const std::vector<unsigned int> indices = { 0, 1, 2 };
+		buffer.AddOccluder(Matrix4::Identity, AsBytes(positions), sizeof(Vector3), indices);
+	}
+	buffer.Rasterize();
+
+	int hidden = 0;
+	int wrong = 0;
+	for (int i = 0; i < 5000; i++)
+	{
+		const Vector3 min(position(random), position(random), depth(random));
+		const Vector3 max(min.x + size(random), min.y + size(random), min.z + size(random));
+		if (buffer.IsVisible({ min, max }, Matrix4::Identity))
+			continue;
+
+		hidden++;
+		const float boxDepth = min.z * 0.5f + 0.5f;
+		const int x0 = std::max(0, (int)std::floor((min.x * 0.5f + 0.5f) * (float)buffer.GetWidth()));
+		const int x1 = std::min(buffer.GetWidth() - 1, (int)std::floor((max.x * 0.5f + 0.5f) * (float)buffer.GetWidth()));
+		const int y0 = std::max(0, (int)std::floor((min.y * 0.5f + 0.5f) * (float)buffer.GetHeight()));
+		const int y1 = std::min(buffer.GetHeight() - 1, (int)std::floor((max.y * 0.5f + 0.5f) * (float)buffer.GetHeight()));
+
+		for (int y = y0; y <= y1; y++)
+		{
+			for (int x = x0; x <= x1; x++)
+			{
+				if (buffer.GetDepth(x, y) >= boxDepth)
+					wrong++;
+			}
+		}
+	}
+
+	RE_CHECK(wrong == 0);
+	RE_CHECK(hidden > 0); // The test would pass with a buffer that never culls
+}
+
+RE_BENCHMARK(OcclusionBufferBenchmark)
+{
+	// Grids of 32x32 quads in front of a perspective camera, then boxes behind them
+	constexpr int GridSize = 32;
+	std::vector<Vector3> positions;
+	std::vector<unsigned int> indices;
+	for (int y = 0; y <= GridSize; y++)
+	{
+		for (int x = 0; x <= GridSize; x++)
+			positions.push_back(Vector3((float)x / GridSize - 0.5f, (float)y / GridSize - 0.5f, 0.0f));
+	}
+	for (int y = 0; y < GridSize; y++)
+	{
+		for (int x = 0; x < GridSize; x++)
+		{
+			const unsigned int a = (unsigned int)(y * (GridSize + 1) + x);
+			indices.insert(indices.end(), { a, a + 1, a + GridSize + 1, a + 1, a + GridSize + 2, a + GridSize + 1 });
+		}
+	}
+
+	const Matrix4 viewProjection = Matrix4::MakePerspective(60.0f, 2.0f, 0.1f, 100.0f) * Matrix4::MakeLookAt(Vector3(0, 0, 0), Vector3(0, 0, 1), Vector3(0, 1, 0));
+	std::vector<Matrix4> occluders;
+	std::mt19937 random(3);
+	std::uniform_real_distribution<float> offset(-4.0f, 4.0f);
+	for (int i = 0; i < 100; i++)
+		occluders.push_back(viewProjection * Matrix4::MakeTransform(Vector3(offset(random), offset(random) * 0.5f, 5.0f + offset(random) + 4.0f), Quaternion::Identity(), Vector3(2, 2, 2)));
+
+	std::vector<BoundingBox> boxes;
+	for (int i = 0; i < 10000; i++)
+	{
+		const Vector3 center(offset(random) * 2.0f, offset(random), 15.0f + offset(random) * 2.0f);
+		boxes.push_back({ center - Vector3(0.5f, 0.5f, 0.5f), center + Vector3(0.5f, 0.5f, 0.5f) });
+	}
+
+	OcclusionBuffer buffer;
+	const double rasterize = Tests::Measure([&] {
+		buffer.Clear();
+		for (auto& occluder : occluders)
+			buffer.AddOccluder(occluder, AsBytes(positions), sizeof(Vector3), indices);
+		buffer.Rasterize();
+	});
+
+	size_t visible = 0;
+	const double test = Tests::Measure([&] {
+		visible = 0;
+		for (auto& box : boxes)
+			visible += buffer.IsVisible(box, viewProjection) ? 1 : 0;
+	});
+
+	std::printf("    %zu triangles rasterized in %.3f ms\n", buffer.GetTriangleCount(), rasterize);
+	std::printf("    %zu boxes tested in %.3f ms, %zu visible\n", boxes.size(), test, visible);
+}
@@ -0,0 +1,133 @@
+#include <REPch.h>
+
+#include <random>
+#include <memory>
+
+#include "Test.h"
+#include "utils/RadixSort.h"
+
+using namespace RexEngine;
+
+namespace
+{
+	std::vector<RadixSort::KeyIndex> RandomKeys(size_t count, uint64_t mask, uint32_t seed)
+	{
+		std::mt19937_64 random(seed);
+		std::vector<RadixSort::KeyIndex> keys(count);
+		for (size_t i = 0; i < count; i++)
+			keys[i] = { random() & mask, (uint32_t)i };
+		return keys;
+	}
+
+	bool SameOrder(const std::vector<RadixSort::KeyIndex>& a, const std::vector<RadixSort::KeyIndex>& b)
+	{
+		return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](auto& x, auto& y) { return x.key == y.key && x.index == y.index; });
+	}
+
+	// What the opaque commands were sorted with before the packed keys : the shader priority through the material, then the material and the mesh
+	struct OldShader { char priority; };
+	struct OldMaterial { std::shared_ptr<OldShader> shader; };
+	struct OldMesh { int id; };
+	struct OldCommand
+	{
+		std::shared_ptr<OldMaterial> material;
+		std::shared_ptr<OldMesh> mesh;
+		float distanceToCamera;
+	};
+
+	bool operator<(const OldCommand& left, const OldCommand& right)
+	{
+		if (left.material->shader->priority != right.material->shader->priority)
+			return left.material->shader->priority < right.material->shader->priority;
+		if (left.material != right.material)
+			return left.material < right.material;
+		if (left.mesh != right.mesh)
+			return left.mesh < right.mesh;
+		return false;
+	}
+}
+
+RE_TEST(RadixSortMatchesStableSort)
+{
+	// Full keys, then keys where most bytes are the same so passes are skipped
+	for (uint64_t mask : { ~0ull, 0xFF00F000ull, 0x3ull })
+	{
+		for (size_t count : { 0, 1, 2, 7, 1000, 50000 })
+		{
+			auto keys = RandomKeys(count, mask, 11);
+			auto expected = keys;
+			std::stable_sort(expected.begin(), expected.end(), [](auto& a, auto& b) { return a.key < b.key; });
+
+			std::vector<RadixSort::KeyIndex> scratch;
+			RadixSort::Sort(keys, scratch);
+			RE_CHECK(SameOrder(keys, expected));
+		}
+	}
+}
+
+RE_TEST(RadixSortReusesTheScratch)
+{
+	std::vector<RadixSort::KeyIndex> scratch;
+	for (uint32_t frame = 0; frame < 4; frame++)
+	{
+		auto keys = RandomKeys(1000 + frame * 10, ~0ull, frame);
+		RadixSort::Sort(keys, scratch);
+		RE_CHECK(std::is_sorted(keys.begin(), keys.end(), [](auto& a, auto& b) { return a.key < b.key; }));
+		RE_CHECK(keys.size() == 1000 + frame * 10);
+	}
+}
+
+RE_BENCHMARK(RenderQueueSortBenchmark)
+{
+	// 8 shaders, 200 materials and 50 meshes, like a scene of repeated props
+	std::mt19937 random(1);
+	std::vector<std::shared_ptr<OldShader>> shaders;
+	std::vector<std::shared_ptr<OldMaterial>> materials;
+	std::vector<std::shared_ptr<OldMesh>> meshes;
+	for (int i = 0; i < 8; i++)
+		shaders.push_back(std::make_shared<OldShader>(OldShader{ (char)(i % 3) }));
+	for (int i = 0; i < 200; i++)
+		materials.push_back(std::make_shared<OldMaterial>(OldMaterial{ shaders[random() % shaders.size()] }));
+	for (int i = 0; i < 50; i++)
+		meshes.push_back(std::make_shared<OldMesh>(OldMesh{ i }));
+
+	for (size_t count : { 1000, 10000, 100000 })
+	{
+		std::vector<OldCommand> commands;
+		std::vector<uint64_t> sortKeys; // Same layout as RenderSortKey::MakeOpaque
+		for (size_t i = 0; i < count; i++)
+		{
+			const uint32_t material = (uint32_t)(random() % materials.size());
+			const uint32_t mesh = (uint32_t)(random() % meshes.size());
+			const float distance = (float)(random() % 1000);
+			commands.push_back({ materials[material], meshes[mesh], distance });
+
+			const uint64_t priority = (uint8_t)((int)materials[material]->shader->priority + 128);
+			const uint64_t depthBucket = (uint64_t)std::min(std::log2(1.0f + distance) * 256.0f, 4095.0f);
+			sortKeys.push_back((priority << 56) | (uint64_t)material << 28 | (uint64_t)mesh << 14 | depthBucket);
+		}
+
+		std::vector<uint32_t> order;
+		const double oldTime = Tests::Measure([&] {
+			order.clear();
+			for (size_t i = 0; i < count; i++)
+				order.push_back((uint32_t)i);
+			std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return commands[a] < commands[b]; });
+		}, 200.0);
+
+		std::vector<RadixSort::KeyIndex> keys;
+		std::vector<RadixSort::KeyIndex> scratch;
+		const double newTime = Tests::Measure([&] {
+			keys.clear();
+			for (size_t i = 0; i < count; i++)
+				keys.push_back({ sortKeys[i], (uint32_t)i });
+			RadixSort::Sort(keys, scratch);
+
+			order.clear();
+			for (auto& key : keys)
+				order.push_back(key.index);
+		}, 200.0);
+
+		std::printf("    %zu commands : comparison sort %.3f ms, radix sort %.3f ms (x%.1f)\n", count, oldTime, newTime, oldTime / newTime);
+	}
+}
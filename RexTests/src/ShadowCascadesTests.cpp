@@ -0,0 +1,207 @@
+#include <REPch.h>
+
+#include "Test.h"
+#include "rendering/ShadowCascades.h"
+
+using namespace RexEngine;
+
+namespace
+{
+	const ShadowCascades::Settings Settings = { 4, 0.8f, 100.0f, 0.1f, 50.0f, 1024 };
+	constexpr float Fov = 60.0f;
+	constexpr float Aspect = 16.0f / 9.0f;
+	constexpr float ZNear = 0.1f;
+	constexpr float ZFar = 500.0f;
+
+	Vector3 LightDirection() { return Vector3(glm::normalize(glm::vec3(0.3f, -1.0f, 0.2f))); }
+
+	Vector4 Transform(const Matrix4& matrix, const Vector3& p)
+	{
+		return Vector4(matrix * glm::vec4(p.x, p.y, p.z, 1.0f));
+	}
+
+	// Corners of the part of the view between two depths, the camera looks at +z
+	std::vector<Vector3> SliceCorners(const Vector3& cameraPos, float sliceNear, float sliceFar)
+	{
+		const float tanY = std::tan(glm::radians(Fov) * 0.5f);
+		const float tanX = tanY * Aspect;
+
+		std::vector<Vector3> corners;
+		for (float depth : { sliceNear, sliceFar })
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				const float x = (i & 1) ? depth * tanX : -depth * tanX;
+				const float y = (i & 2) ? depth * tanY : -depth * tanY;
+				corners.push_back(Vector3(cameraPos.x + x, cameraPos.y + y, cameraPos.z + depth));
+			}
+		}
+		return corners;
+	}
+
+	BoxList SingleBox(const Vector3& center, float extent)
+	{
+		BoxList boxes;
+		boxes.Add({ center - Vector3(extent, extent, extent), center + Vector3(extent, extent, extent) });
+		return boxes;
+	}
+}
+
+RE_TEST(ShadowCascadesUniformSplits)
+{
+	const auto splits = ShadowCascades::ComputeSplits(4, 1.0f, 101.0f, 0.0f);
+	RE_CHECK_NEAR(splits[0], 26.0f, 1e-3f);
+	RE_CHECK_NEAR(splits[1], 51.0f, 1e-3f);
+	RE_CHECK_NEAR(splits[2], 76.0f, 1e-3f);
+	RE_CHECK(splits[3] == 101.0f);
+}
+
+RE_TEST(ShadowCascadesLogarithmicSplits)
+{
+	const auto splits = ShadowCascades::ComputeSplits(3, 1.0f, 1000.0f, 1.0f);
+	RE_CHECK_NEAR(splits[0], 10.0f, 1e-3f);
+	RE_CHECK_NEAR(splits[1], 100.0f, 1e-2f);
+	RE_CHECK(splits[2] == 1000.0f);
+	RE_CHECK(splits[3] == 1000.0f); // Unused cascades end at the far distance
+}
+
+RE_TEST(ShadowCascadesSplitsIncrease)
+{
+	for (uint32_t count = 1; count <= ShadowCascades::MaxCascades; count++)
+	{
+		for (float lambda : { 0.0f, 0.25f, 0.5f, 0.75f, 1.0f })
+		{
+			const auto splits = ShadowCascades::ComputeSplits(count, 0.1f, 200.0f, lambda);
+			RE_CHECK(splits[0] > 0.1f);
+			for (uint32_t i = 1; i < count; i++)
+				RE_CHECK(splits[i] > splits[i - 1]);
+			RE_CHECK(splits[count - 1] == 200.0f);
+		}
+	}
+}
+
+RE_TEST(ShadowCascadesSchedule)
+{
+	// Over 8 frames : cascade i is rendered 8 / 2^i times, never more than 2 cascades in a frame
+	std::array<int, ShadowCascades::MaxCascades> renders = {};
+	for (uint64_t frame = 100; frame < 108; frame++)
+	{
+		int cascades = 0;
+		for (uint32_t i = 0; i < ShadowCascades::MaxCascades; i++)
+		{
+			if (ShadowCascades::IsScheduled(i, frame))
+			{
+				renders[i]++;
+				cascades++;
+			}
+		}
+		RE_CHECK(cascades <= 2);
+	}
+
+	RE_CHECK(renders[0] == 8);
+	RE_CHECK(renders[1] == 4);
+	RE_CHECK(renders[2] == 2);
+	RE_CHECK(renders[3] == 1);
+}
+
+RE_TEST(ShadowCascadesCoverTheSlices)
+{
+	const Vector3 cameraPos(3.0f, 2.0f, -7.0f);
+	ShadowCascades cascades;
+	const uint32_t refitted = cascades.Fit(cameraPos, Vector3(0, 0, 1), Fov, Aspect, ZNear, ZFar, LightDirection(), Settings);
+	RE_CHECK(refitted == 0b1111);
+	RE_CHECK(cascades.Count() == 4);
+
+	float sliceNear = ZNear;
+	for (uint32_t i = 0; i < cascades.Count(); i++)
+	{
+		const auto& cascade = cascades[i];
+		RE_CHECK(cascade.valid);
+
+		// Every corner of the slice is in the clip space of the cascade
+		int outside = 0;
+		for (auto& corner : SliceCorners(cameraPos, sliceNear, cascade.splitFar))
+		{
+			const Vector4 clip = Transform(cascade.viewProjection, corner);
+			if (std::abs(clip.x) > 1.0f || std::abs(clip.y) > 1.0f || std::abs(clip.z) > 1.0f)
+				outside++;
+		}
+		RE_CHECK(outside == 0);
+
+		sliceNear = cascade.splitFar;
+	}
+	RE_CHECK(cascades[3].splitFar == Settings.maxDistance);
+}
+
+RE_TEST(ShadowCascadesSnapToTexels)
+{
+	ShadowCascades cascades;
+	cascades.Fit(Vector3(12.3f, 4.5f, 6.7f), Vector3(0, 0, 1), Fov, Aspect, ZNear, ZFar, LightDirection(), Settings);
+
+	// The center is on the texel grid of the light
+	const Matrix4 lightRotation = Matrix4::MakeLookAt(Vector3(0, 0, 0), LightDirection(), Vector3(0, 1, 0));
+	for (uint32_t i = 0; i < cascades.Count(); i++)
+	{
+		const float texel = 2.0f * cascades[i].radius / (float)Settings.resolution;
+		const Vector4 lightCenter = Transform(lightRotation, cascades[i].center);
+
+		const float x = lightCenter.x / texel;
+		const float y = lightCenter.y / texel;
+		RE_CHECK_NEAR(x, std::round(x), 0.01f);
+		RE_CHECK_NEAR(y, std::round(y), 0.01f);
+	}
+}
+
+RE_TEST(ShadowCascadesRefitOnlyWhenNeeded)
+{
+	const Vector3 cameraPos(0, 1, 0);
+	const Vector3 forward(0, 0, 1);
+	ShadowCascades cascades;
+	cascades.Fit(cameraPos, forward, Fov, Aspect, ZNear, ZFar, LightDirection(), Settings);
+	const Matrix4 first = cascades[0].viewProjection;
+
+	// Small moves stay in the margin, the cached layers are kept
+	RE_CHECK(cascades.Fit(Vector3(0.01f, 1.0f, 0.01f), forward, Fov, Aspect, ZNear, ZFar, LightDirection(), Settings) == 0);
+	RE_CHECK(cascades[0].viewProjection == first);
+
+	// The slices of the near cascades leave their sphere first
+	const uint32_t moved = cascades.Fit(Vector3(0, 1, 1.0f), forward, Fov, Aspect, ZNear, ZFar, LightDirection(), Settings);
+	RE_CHECK((moved & 1) != 0);
+	RE_CHECK((moved & 0b1000) == 0);
+
+	RE_CHECK(cascades.Fit(Vector3(0, 1, 500.0f), forward, Fov, Aspect, ZNear, ZFar, LightDirection(), Settings) == 0b1111);
+
+	// A new light direction or new settings refit everything
+	const Vector3 otherLight = Vector3(glm::normalize(glm::vec3(-0.5f, -1.0f, 0.0f)));
+	RE_CHECK(cascades.Fit(Vector3(0, 1, 500.0f), forward, Fov, Aspect, ZNear, ZFar, otherLight, Settings) == 0b1111);
+
+	ShadowCascades::Settings lowResolution = Settings;
+	lowResolution.resolution = 512;
+	RE_CHECK(cascades.Fit(Vector3(0, 1, 500.0f), forward, Fov, Aspect, ZNear, ZFar, otherLight, lowResolution) == 0b1111);
+
+	ShadowCascades::Settings twoCascades = Settings;
+	twoCascades.count = 2;
+	RE_CHECK(cascades.Fit(Vector3(0, 1, 500.0f), forward, Fov, Aspect, ZNear, ZFar, otherLight, twoCascades) == 0b11);
+	RE_CHECK(cascades.Count() == 2);
+}
+
+RE_TEST(ShadowCascadesCullCasters)
+{
+	ShadowCascades cascades;
+	cascades.Fit(Vector3(0, 1, 0), Vector3(0, 0, 1), Fov, Aspect, ZNear, ZFar, LightDirection(), Settings);
+	const auto& cascade = cascades[1];
+
+	const Vector3 towardsLight = -LightDirection();
+	const Vector3 side = Vector3(glm::normalize(glm::cross(glm::vec3(towardsLight), glm::vec3(0, 0, 1))));
+
+	std::vector<uint8_t> visible;
+	RE_CHECK(ShadowCascades::CullCasters(cascade, SingleBox(cascade.center, 0.5f), visible) == 1);
+
+	// Between the light and the covered sphere, casts a shadow in it
+	RE_CHECK(ShadowCascades::CullCasters(cascade, SingleBox(cascade.center + towardsLight * (cascade.radius + Settings.depthExtent * 0.5f), 0.5f), visible) == 1);
+
+	// Further than the depth extent, or on the side
+	RE_CHECK(ShadowCascades::CullCasters(cascade, SingleBox(cascade.center + towardsLight * (cascade.radius + Settings.depthExtent + 5.0f), 0.5f), visible) == 0);
+	RE_CHECK(ShadowCascades::CullCasters(cascade, SingleBox(cascade.center + side * (cascade.radius * 2.0f), 0.5f), visible) == 0);
+	RE_CHECK(visible.size() == 1 && visible[0] == 0);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdio>
+#include <cmath>
+#include <chrono>
+#include <vector>
+
+// Minimal test runner, the tests only use the cpu so they run headless
+namespace RexEngine::Tests
+{
+	struct TestCase
+	{
+		const char* name;
+		void(*function)();
+		bool benchmark; // Only run with --bench
+	};
+
+	inline std::vector<TestCase>& Registry() { static std::vector<TestCase> tests; return tests; }
+
+	// Failed checks of the running test
+	inline int& Failures() { static int failures = 0; return failures; }
+
+	inline int Register(const char* name, void(*function)(), bool benchmark)
+	{
+		Registry().push_back({ name, function, benchmark });
+		return 0;
+	}
+
+	inline void Fail(const char* condition, const char* file, int line)
+	{
+		std::printf("    %s(%d) : %s\n", file, line, condition);
+		Failures()++;
+	}
+
+	// Average time of a call in ms, the function is called until it ran for minDuration ms
+	template<typename Function>
+	double Measure(Function&& function, double minDuration = 500.0)
+	{
+		using Clock = std::chrono::steady_clock;
+
+		function(); // Warm up
+		int runs = 0;
+		const auto start = Clock::now();
+		double elapsed = 0.0;
+		do
+		{
+			function();
+			runs++;
+			elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		} while (elapsed < minDuration);
+
+		return elapsed / runs;
+	}
+}
+
+// Usage : RE_TEST(Name) { RE_CHECK(1 + 1 == 2); }
+#define RE_TEST(NAME) static void NAME(); [[maybe_unused]] static int NAME##Registered = RexEngine::Tests::Register(#NAME, &NAME, false); static void NAME()
+
+// Same as RE_TEST, print the timings with std::printf
+#define RE_BENCHMARK(NAME) static void NAME(); [[maybe_unused]] static int NAME##Registered = RexEngine::Tests::Register(#NAME, &NAME, true); static void NAME()
+
+#define RE_CHECK(CONDITION) { if(!(CONDITION)) RexEngine::Tests::Fail(#CONDITION, __FILE__, __LINE__); }
+
+#define RE_CHECK_NEAR(A, B, EPSILON) RE_CHECK(std::abs((A) - (B)) <= (EPSILON))
@@ -136,4 +136,34 @@ project "RexEditor"
 			end)
 	end
 
+-- Headless tests of the cpu side of the engine, "RexTests --bench" also runs the benchmarks
+project "RexTests"
+	defines {"GLM_FORCE_LEFT_HANDED"}
+    location "RexTests"
+    kind "ConsoleApp"
+    language "C++"
+    cppdialect "C++latest"
+	warnings "Extra"
+	flags { "FatalCompileWarnings" }
+
+    targetdir (TargetDir .. "/%{prj.name}")
+    objdir (ObjDir .. "/%{prj.name}")
+
+    files {
+		"%{prj.name}/src/**.h",
+		"%{prj.name}/src/**.cpp"
+	}
+
+    includedirs {
+        "RexEngine/src",
+        "RexEngine/vendor",
+
+		"%{prj.name}/src"
+    }
+
+	links { "RexEngine" }
+
+	-- The benchmarks read the test project assets relative to the root
+	debugdir "%{wks.location}"
+
 group ""
\ No newline at end of file